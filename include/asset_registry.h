@@ -0,0 +1,177 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include "model.h"
+#include "shader.h"
+#include "program_cache.h"
+#include "texture_streamer.h"
+
+// 64-bit FNV-1a, used for content hashes
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Lightweight reference to a registry entry. The generation detects handles to evicted slots.
+template <typename T>
+struct AssetHandle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    AssetHandle() : index(0xFFFFFFFFu), generation(0) {}
+    AssetHandle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+    bool valid() const { return index != 0xFFFFFFFFu; }
+};
+
+typedef AssetHandle<Model> ModelHandle;
+typedef AssetHandle<Shader> ShaderHandle;
+
+// What a loader thread may read of a shared model, copied under the registry lock: reload()
+// replaces a model's geometry on the render thread while other rooms are being built
+struct ModelInfo
+{
+    bool loaded;
+    float lightmapExtent;
+    std::vector<std::string> partNames;  // In file order
+
+    ModelInfo() : loaded(false), lightmapExtent(0.0f) {}
+    bool hasPart(const std::string& name) const
+    {
+        for (size_t i = 0; i < partNames.size(); i++)
+        {
+            if (partNames[i] == name)
+                return true;
+        }
+        return false;
+    }
+};
+
+// Shared, reference-counted models and shaders. Assets are deduplicated by path and by content
+// hash, so identical rooms share one set of GPU buffers. Unreferenced assets stay cached until
+// trim() evicts them, least recently released first.
+//
+// acquireModel() and modelInfo() only parse and copy, and may be called from loader threads;
+// everything that touches GL (uploadModel, acquireShader, trim, reload) must run on the render
+// thread. Loader threads must not read a Model directly: reload() swaps its geometry.
+class AssetRegistry
+{
+public:
+    // Material textures; GL thread only, with update() once per frame
+    TextureStreamer textures;
+
+    AssetRegistry();
+
+    // Vertices are freed after upload unless some user passes keepVertices (picking, physics)
+    ModelHandle acquireModel(const std::string& path, bool keepVertices = false);
+    // features (ShaderFeature bits) selects a permutation; each one is a separate program
+    ShaderHandle acquireShader(const std::string& vertexPath, const std::string& fragmentPath,
+                               unsigned int features = 0);
+    void release(ModelHandle handle);
+    void release(ShaderHandle handle);
+
+    // NULL for stale handles. Pointers stay valid while the caller holds a reference.
+    Model* model(ModelHandle handle);
+    // Snapshot of the fields a loader thread needs; false for stale handles
+    bool modelInfo(ModelHandle handle, ModelInfo& info);
+    // Upload a model's buffers and free its CPU copy unless a user keeps the vertices; the copy
+    // is freed under the lock keepVertices is set under, so neither side misses the other
+    void uploadModel(ModelHandle handle);
+    Shader* shader(ShaderHandle handle);
+
+    // Evict unreferenced assets until GPU usage fits byteBudget; returns the number evicted
+    size_t trim(size_t byteBudget);
+
+    // Re-read an asset from disk in place; handles and pointers stay valid
+    bool reload(ModelHandle handle);
+    bool reload(ShaderHandle handle);
+
+    // Reload every asset whose file content changed; returns the number reloaded
+    size_t reloadChanged();
+
+    // Restore linked programs from (and save them to) a program binary cache in directory.
+    // Needs a current GL context; call before the first acquireShader().
+    void enableProgramCache(const std::string& directory);
+
+    // Hot reload: start recompiling every shader that uses path without waiting for the driver.
+    // finishPendingShaders() swaps finished programs in, once per frame; a program that fails to
+    // link is dropped and the previous one stays in use. Both return the number of shaders.
+    size_t shaderFileChanged(const std::string& path);
+    size_t finishPendingShaders();
+
+    size_t gpuBytes();
+    // GPU bytes of every live asset by path (the report's figures, for metrics)
+    void assetGpuBytes(std::vector<std::pair<std::string, size_t> >& bytes);
+    // Seconds taken by each shader program build (compile and link, or a program cache load)
+    // since the last call, in completion order; returns how many
+    size_t drainCompileTimes(std::vector<double>& seconds);
+    // Host (CPU copy) and GPU bytes per asset
+    void report(std::ostream& out);
+
+private:
+    struct Entry
+    {
+        std::string path;          // Model path, or "vertex|fragment[#features]" for shaders
+        std::string vertexPath, fragmentPath;
+        unsigned int features;     // Shader permutation
+        uint64_t hash;
+        uint32_t generation;
+        int refs;
+        uint64_t releasedAt;       // Release order, for least-recently-released eviction
+        bool alive;
+        size_t programBytes;       // Driver-reported program binary size, when available
+        bool hostFreed;            // Model's CPU copy freed after upload
+        std::unique_ptr<Model> model;
+        std::unique_ptr<Shader> shader;
+        Shader::PendingProgram pending;  // Hot-reload compile in flight
+        uint64_t pendingHash, pendingKey;
+        std::chrono::steady_clock::time_point pendingStarted;
+
+        Entry() : features(0), hash(0), generation(0), refs(0), releasedAt(0), alive(false), programBytes(0),
+                  hostFreed(false), pendingHash(0), pendingKey(0) {}
+    };
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Entry> > models;
+    std::vector<std::unique_ptr<Entry> > shaders;
+    std::map<std::string, uint32_t> modelByPath, shaderByPath;
+    std::map<uint64_t, uint32_t> modelByHash, shaderByHash;
+    uint64_t releaseCounter;
+    std::unique_ptr<ProgramBinaryCache> programCache;
+    std::vector<double> compileSeconds;  // Waiting for drainCompileTimes()
+
+    static bool readFile(const std::string& path, std::string& contents);
+    static bool readShaderSources(const Entry& entry, std::string& vertexCode, std::string& fragmentCode);
+    ModelHandle acquireSharedModel(const std::string& path);
+    void retainModelVertices(ModelHandle handle);
+    void freeUploadedModel(Entry& entry);
+    uint32_t allocate(std::vector<std::unique_ptr<Entry> >& entries);
+    Entry* lookup(std::vector<std::unique_ptr<Entry> >& entries, uint32_t index, uint32_t generation);
+    void releaseEntry(Entry* entry);
+    void evict(std::vector<std::unique_ptr<Entry> >& entries, uint32_t index,
+               std::map<std::string, uint32_t>& byPath, std::map<uint64_t, uint32_t>& byHash);
+    size_t gpuBytesLocked() const;
+    static size_t entryBytes(const Entry& entry);
+    static size_t programBinaryLength(const Shader& shader);
+    static uint64_t sourceHash(const std::string& vertexCode, const std::string& fragmentCode);
+    bool buildProgram(Shader& shader, const std::string& vertexCode, const std::string& fragmentCode);
+    void recordCompile(std::chrono::steady_clock::time_point started);
+    void rehashShader(Entry& entry, uint32_t index, uint64_t hash);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef BATCH_TRANSFORM_H
+#define BATCH_TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+
+// Kernel implementations; the best one the CPU supports is picked at startup
+enum TransformPath
+{
+    TRANSFORM_SCALAR,
+    TRANSFORM_SSE,   // SSE2, 4 instances per iteration
+    TRANSFORM_AVX2   // 8 instances per iteration
+};
+
+// Structure-of-arrays instance placement: translate(origin + pos) * rotateY(yaw) * scale
+struct TransformInput
+{
+    const float* posX;
+    const float* posY;
+    const float* posZ;
+    const float* yaw;    // Degrees around Y
+    const float* scale;  // Uniform scale; NULL means 1
+    size_t count;
+    glm::vec3 origin;    // Added to every position (room placement)
+
+    TransformInput() : posX(NULL), posY(NULL), posZ(NULL), yaw(NULL), scale(NULL), count(0), origin(0.0f) {}
+};
+
+// Per-instance results: model matrices, normal matrices and world-space AABBs (SoA, for culling)
+struct InstanceTransforms
+{
+    std::vector<glm::mat4> models;
+    std::vector<glm::mat3> normals;
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    void resize(size_t count);
+    size_t size() const { return models.size(); }
+};
+
+// Transform in.count instances that share one model-space bounding box, writing results at
+// out[first...]. The output must already be sized.
+void batchTransform(const TransformInput& in, const glm::vec3& localMin, const glm::vec3& localMax,
+                    InstanceTransforms& out, size_t first);
+
+TransformPath transformPath();
+// Force a path (benchmarks); falls back to the best supported one if the CPU lacks it
+void setTransformPath(TransformPath path);
+const char* transformPathName(TransformPath path);
+
+// Time every supported path on count random instances and print instances per microsecond
+// and the largest deviation from the scalar path
+void benchmarkBatchTransforms(size_t count);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+// Fixed-capacity lock-free queue for any number of producers and consumers (Vyukov's bounded
+// MPMC queue): every cell carries a sequence number telling whose turn it is, so a push or pop
+// is one compare-and-swap on a position counter and never blocks. Capacity is rounded up to a
+// power of two; tryPush fails when full and tryPop when empty.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool tryPush(const T& value)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t turn = (ptrdiff_t)sequence - (ptrdiff_t)position;
+            if (turn == 0)
+            {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (turn < 0)
+                return false;  // Full: the cell still holds an unpopped value
+            else
+                position = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPop(T& value)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t turn = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+            if (turn == 0)
+            {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (turn < 0)
+                return false;  // Empty
+            else
+                position = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Approximate while other threads push and pop
+    size_t size() const
+    {
+        size_t t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+
+        Cell() : sequence(0), value() {}
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    // Consumers and producers on separate cache lines
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+
+// Closest intersection of a ray; triangle is the index passed to build()
+struct RayHit
+{
+    float t;
+    unsigned int triangle;
+    float u, v;  // Barycentric coordinates of vertices 1 and 2
+
+    RayHit() : t(0.0f), triangle(0), u(0.0f), v(0.0f) {}
+};
+
+// Bounding volume hierarchy over static triangles for CPU ray queries (lightmap baking,
+// visibility analysis). Built top-down with a binned surface area heuristic; nodes are stored
+// depth-first so a node's left child directly follows it. Queries are const and may run on any
+// number of threads at once.
+class TriangleBVH
+{
+public:
+    TriangleBVH() : maxDepth(0) {}
+
+    // Three vertices per triangle
+    void build(const std::vector<glm::vec3>& vertices);
+
+    // Closest hit with t in (0, tMax); direction need not be normalized
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, float tMax, RayHit& hit) const;
+
+    // Any hit with t in (0, tMax), for shadow rays
+    bool occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const;
+
+    size_t triangleCount() const { return triangles.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    unsigned int depth() const { return maxDepth; }
+
+private:
+    struct Node
+    {
+        glm::vec3 boundsMin;
+        unsigned int offset;  // Leaf: first triangle; interior: index of the right child
+        glm::vec3 boundsMax;
+        unsigned int count;   // Triangles in a leaf, 0 for interior nodes
+    };
+
+    // Precomputed for the Moller-Trumbore test
+    struct Triangle
+    {
+        glm::vec3 v0, e1, e2;
+        unsigned int id;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;  // In leaf order
+    unsigned int maxDepth;
+
+    unsigned int buildNode(std::vector<unsigned int>& order, const std::vector<glm::vec3>& centroids,
+                           const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax,
+                           size_t begin, size_t end, unsigned int depth);
+    template <bool AnyHit>
+    bool traverse(const glm::vec3& origin, const glm::vec3& direction, float tMax, RayHit* hit) const;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include "camera.h"
+
+// Camera state of one recorded frame
+struct CameraPathSample
+{
+    float time;         // Seconds since the recording started
+    uint32_t tick;      // Frame number in the recording
+    float simTime;      // Campus animation clock
+    glm::vec3 position;
+    float yaw, pitch, zoom;
+
+    CameraPathSample() : time(0.0f), tick(0), simTime(0.0f), position(0.0f), yaw(0.0f), pitch(0.0f), zoom(ZOOM) {}
+
+    void apply(Camera& camera) const;
+};
+
+// A fly-through: the camera of every frame of a live session, saved as a compact binary file
+// (.campath: "CCAM", version, count, then 36 bytes per frame). Replays sample it at any time,
+// interpolating between frames, so a path plays back identically at any frame rate.
+class CameraPath
+{
+public:
+    std::vector<CameraPathSample> samples;
+
+    void record(float time, uint32_t tick, float simTime, const Camera& camera);
+    float duration() const { return samples.empty() ? 0.0f : samples.back().time; }
+
+    // State at time t, clamped to the ends of the path
+    CameraPathSample at(float time) const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+// Timings of one replayed frame
+struct ReplayFrame
+{
+    uint32_t frame;
+    float time;       // Path time shown
+    double cpuMs;     // Frame start to buffer swap on the CPU
+    double frameMs;   // Present to present
+    double gpuMs;     // Scene pass on the GPU; negative when it was not timed
+    unsigned int pacerFrame;
+};
+
+// Per-frame timings of a replay, written as CSV for frame-by-frame comparison of builds
+class ReplayTimings
+{
+public:
+    std::vector<ReplayFrame> frames;
+
+    void add(uint32_t frame, float time, double cpuMs, double frameMs, unsigned int pacerFrame);
+    // GPU times arrive a few frames late, keyed by the pacer's frame number
+    void setGpu(unsigned int pacerFrame, double gpuMs);
+
+    bool writeCsv(const std::string& path) const;
+    // Averages and percentiles of every column
+    void report(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef CAMPUS_H
+#define CAMPUS_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <deque>
+#include <string>
+#include <ostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "classroom.h"
+#include "asset_registry.h"
+#include "render_queue.h"
+#include "scene.h"
+
+enum CellState
+{
+    CELL_UNLOADED,
+    CELL_LOADING,    // Queued for or being built by the loader thread
+    CELL_UPLOADING,  // Built, buffers being uploaded a slice per frame
+    CELL_RESIDENT
+};
+
+// One streamable piece of the campus: a classroom or a corridor
+struct CampusCell
+{
+    std::string name;
+    std::string scenePath;
+    glm::vec3 origin;
+    Scene scene;                      // Parsed when the campus is loaded; read-only afterwards
+    glm::vec3 boundsMin, boundsMax;   // World-space room extents
+    CellState state;
+    std::unique_ptr<Classroom> room;  // Set while uploading or resident
+    float retryDistance;              // Not re-requested until the camera is closer than this
+};
+
+struct StreamingStats
+{
+    unsigned int cellsLoaded;
+    unsigned int cellsEvicted;
+    unsigned int frames;
+    unsigned int hitchFrames;   // Frames whose update() exceeded hitchThresholdMs
+    double maxUpdateMs;
+    double totalUpdateMs;
+    size_t residentBytes;
+    size_t bytesUploaded;       // Room geometry sent to the GPU
+
+    StreamingStats() { reset(); }
+    void reset()
+    {
+        cellsLoaded = cellsEvicted = frames = hitchFrames = 0;
+        maxUpdateMs = totalUpdateMs = 0.0;
+        residentBytes = bytesUploaded = 0;
+    }
+};
+
+// World partition of a whole building. Cells near the camera are built on a loader thread and
+// uploaded under a per-frame byte budget; far cells are evicted to stay within a memory budget.
+//
+// Campus file format, one directive per line, '#' starts a comment:
+//   cell <name> <scene path> <origin x> <origin y> <origin z>
+//   stream <load radius> <unload radius> <memory budget MB> <upload KB per frame>
+//   camera <x> <y> <z> <yaw> <pitch>
+class Campus
+{
+public:
+    float loadRadius;            // Cells closer than this (to their bounds) are loaded
+    float unloadRadius;          // Cells farther than this are evicted
+    size_t memoryBudget;         // GPU bytes for room buffers plus registry assets
+    size_t uploadBytesPerFrame;  // Upload slice per frame, bounds transition hitches
+    float hitchThresholdMs;
+    StreamingStats stats;
+    // Rooms keep their CPU geometry (see Classroom::retainGeometry); set before load()
+    bool retainGeometry;
+
+    glm::vec3 startPosition;
+    float startYaw, startPitch;
+
+    explicit Campus(AssetRegistry& registry);
+    ~Campus();
+
+    // Load a .campus file, or wrap a single .scene file as a one-cell campus
+    bool load(const std::string& path);
+
+    // Synchronously load every cell within the load radius (before the first frame)
+    void loadAround(const glm::vec3& position);
+
+    // Per frame: advance animation, request/upload/evict cells around the camera
+    void update(float deltaTime, const glm::vec3& cameraPosition);
+
+    void submit(RenderQueue& queue, ShaderVariants& shaders);
+    void submit(SoftwareRasterizer& raster);
+    // A whole software rasterizer frame of the resident rooms, lit by a cell's light the way
+    // setFrameUniforms lights the GL frame
+    void rasterize(SoftwareRasterizer& raster, const CampusCell& cell, const glm::mat4& projection,
+                   const glm::mat4& view, const glm::vec3& viewPosition);
+    // Light of a cell and the animation clock on every compiled variant (the camera itself is in
+    // ViewUniforms); after submit(), which compiles any variant not seen before
+    void setFrameUniforms(ShaderVariants& shaders, const CampusCell& cell) const;
+
+    // Fully uploaded rooms, the ones submit() draws
+    void residentRooms(std::vector<Classroom*>& rooms) const;
+
+    // Changes whenever a room becomes resident or is evicted
+    unsigned int residency() const { return residencyVersion; }
+
+    // Seconds of animation applied to every room
+    double animationClock() const { return animationTime; }
+
+    // Cell containing (or nearest to) a world position
+    const CampusCell* cellAt(const glm::vec3& position) const;
+
+    size_t residentBytes();
+
+    // Host and GPU bytes of every loaded room's own geometry
+    void report(std::ostream& out) const;
+    size_t cellCount() const { return cells.size(); }
+    const CampusCell& cell(size_t index) const { return *cells[index]; }
+
+private:
+    std::vector<std::unique_ptr<CampusCell> > cells;
+    AssetRegistry& assets;
+    double animationTime;
+    unsigned int residencyVersion;
+
+    // Loader thread
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<size_t> requests;
+    std::vector<std::pair<size_t, Classroom*> > finished;
+    bool quit;
+
+    bool addCell(const std::string& name, const std::string& scenePath, const glm::vec3& origin);
+    void loaderLoop();
+    Classroom* buildCell(size_t index);
+    void request(size_t index);
+    void evict(size_t index);
+    float distanceTo(const CampusCell& cell, const glm::vec3& position) const;
+};
+
+#endif
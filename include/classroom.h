@@ -5,79 +5,214 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
+#include <string>
+#include <memory>
 #include "shader.h"
 #include "model.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "asset_registry.h"
+#include "shader_variants.h"
+#include "batch_transform.h"
+#include "geometry_arena.h"
+#include "lightmap.h"
+
+class SoftwareRasterizer;
+
+// GPU buffers plus generated vertex data for one procedural component. The vertices live in the
+// room's geometry arena only until upload; the count and bounds are kept.
+struct MeshPart
+{
+    unsigned int VAO, VBO;
+    float* vertices;     // Interleaved position/normal/uv (8 floats each); NULL once uploaded
+                         // unless Classroom::retainGeometry is set
+    size_t count;        // Number of vertices
+    glm::vec3 center;    // Bounding-box centre, used as the sort depth reference
+    glm::vec3 boundsMin, boundsMax;
+    uint16_t material;   // Index into Scene::materials
+    bool emissive;       // Drawn with the light shader
+    // Lightmap UVs (attribute 4, freed with the vertices) and the part's region of the room's
+    // atlas: scale in xy, offset in zw; zero for parts without baked lighting
+    std::vector<float> lightmapUVs;
+    float lightmapExtent;
+    unsigned int lightmapVBO;
+    glm::vec4 lightmapRect;
+
+    MeshPart() : VAO(0), VBO(0), vertices(NULL), count(0), center(0.0f), boundsMin(0.0f), boundsMax(0.0f),
+                 material(0), emissive(false), lightmapExtent(0.0f), lightmapVBO(0), lightmapRect(0.0f) {}
+    size_t vertexCount() const { return count; }
+    size_t bytes() const { return count * (lightmapUVs.empty() && lightmapVBO == 0 ? 8 : 10) * sizeof(float); }
+};
+
+// Atlas of a room's baked lighting. Rects map a mesh's lightmap UVs to the atlas (scale in xy,
+// offset in zw); surfaces with a zero rect are lit dynamically.
+struct LightmapLayout
+{
+    unsigned int width, height;
+    uint64_t hash;                          // Identifies the layout a lightmap was baked for
+    std::vector<glm::vec4> instanceRects;   // Indexed like scene.instances
+
+    LightmapLayout() : width(0), height(0), hash(0) {}
+};
+
+// One instanced draw of every spinning instance of a model whose scene entry names a spin group.
+// The VAO reads the shared model's vertex buffer plus this room's instance buffer (placement
+// matrix and animation); the vertex shader spins the group, so nothing changes per frame.
+struct AnimatedBatch
+{
+    uint16_t model;                  // Index into Classroom::models
+    std::vector<uint32_t> instances; // Indices into scene.instances
+    unsigned int VAO, instanceBuffer;
+    unsigned int modelRevision;      // Model::revision the VAO was built against
+    glm::vec3 center;                // Sort depth reference, world space
+    unsigned int divisor;            // Instance attribute divisor: the views each placement is drawn for
+
+    AnimatedBatch() : model(0), VAO(0), instanceBuffer(0), modelRevision(0), center(0.0f), divisor(1) {}
+};
+
+// One instanced draw of the static instances sharing a model, material and lightmap (with or
+// without a rect in the room's atlas). Placements never change, so the instance buffer (world
+// matrix and rect) is only rebuilt when the model is uploaded or reloaded, or the views change.
+struct StaticBatch
+{
+    uint16_t model;                  // Index into Classroom::models
+    uint16_t material;
+    bool lightmapped;                // The instances have lightmap rects
+    std::vector<uint32_t> instances; // Indices into scene.instances
+    unsigned int VAO, instanceBuffer;
+    bool modelLoaded;                // Built on the model's buffer, not its stand-in's
+    unsigned int modelRevision;      // Model::revision the VAO was built against
+    glm::vec3 center;                // Sort depth reference, world space
+    unsigned int divisor;            // Instance attribute divisor: the views each placement is drawn for
+
+    StaticBatch() : model(0), material(0), lightmapped(false), VAO(0), instanceBuffer(0), modelLoaded(false),
+                    modelRevision(0), center(0.0f), divisor(1) {}
+};
 
 class Classroom
 {
 public:
-    // Classroom dimensions (in meters, typical for Indian classroom)
-    static constexpr float ROOM_WIDTH = 12.0f;
-    static constexpr float ROOM_LENGTH = 8.0f;
-    static constexpr float ROOM_HEIGHT = 3.5f;
-    static constexpr float WALL_THICKNESS = 0.2f;
-
-    // VAOs and VBOs for different components
-    unsigned int floorVAO, floorVBO;
-    unsigned int ceilingVAO, ceilingVBO;
-    unsigned int wallsVAO, wallsVBO;
-    unsigned int doorsVAO, doorsVBO;
-    unsigned int windowsVAO, windowsVBO;
-    unsigned int benchesVAO, benchesVBO;
-    unsigned int podiumVAO, podiumVBO;
-    unsigned int boardVAO, boardVBO;
-    unsigned int lightsVAO, lightsVBO;
-
-    // OBJ models
-    Model fanModel;
-    Model podiumModel;
-    Model benchModel;
-    float fanRotation;
-
-    // Vertex data containers
-    std::vector<float> floorVertices;
-    std::vector<float> ceilingVertices;
-    std::vector<float> wallVertices;
-    std::vector<float> doorVertices;
-    std::vector<float> windowVertices;
-    std::vector<float> benchVertices;
-    std::vector<float> podiumVertices;
-    std::vector<float> boardVertices;
-    std::vector<float> lightVertices;
+    // Layout, materials and model references, loaded from a scene file
+    Scene scene;
+
+    // Static room geometry: floor, ceiling, walls, then boxes grouped by material
+    std::vector<MeshPart> shellParts;
+
+    // OBJ models indexed like scene.models, shared with other rooms through the asset registry,
+    // plus procedural stand-ins (in model space, meters) drawn for models whose OBJ could not be
+    // loaded and as their low-detail LOD
+    std::vector<ModelHandle> modelHandles;
+    std::vector<Model*> models;  // Resolved from modelHandles; valid while the handles are held
+    std::vector<ModelInfo> modelInfo;  // What buildGeometry reads on the loader thread
+    std::vector<MeshPart> fallbackParts;
+
+    // World-space position of the room's local origin (campus placement)
+    glm::vec3 origin;
+
+    // Keep generated vertices, model vertices and lightmap texels after upload (picking, physics,
+    // the software rasterizer); set before buildGeometry. Off by default.
+    bool retainGeometry;
+
+    // Baked lighting of the static surfaces (see bakeLightmap): read by buildGeometry when the
+    // file exists and matches the layout, uploaded with the geometry. 0 when there is none.
+    std::string lightmapPath;
+    LightmapLayout lightmapLayout;
+    unsigned int lightmapTexture;
+
+    // Seconds of animation applied to spinning instances (ceiling fans)
+    double animationTime;
+
+    // World-space matrices and bounds of every instance (indexed like scene.instances), refreshed
+    // by updateTransforms()
+    InstanceTransforms transforms;
 
     Classroom();
     ~Classroom();
 
-    void initializeGeometry();
-    void render(Shader& shader);
-    void renderLights(Shader& lightShader);
+    // Owns GL buffers and asset references
+    Classroom(const Classroom&) = delete;
+    Classroom& operator=(const Classroom&) = delete;
+
+    // Load the room description; call before initializeGeometry()
+    bool loadScene(const std::string& path);
+
+    // Build and upload everything at once
+    void initializeGeometry(AssetRegistry& registry);
+
+    // Generate vertices and acquire models without touching GL; safe on a loader thread
+    void buildGeometry(AssetRegistry& registry);
+
+    // Upload pending buffers on the GL thread, deducting from byteBudget and stopping once it
+    // is spent. Returns true when everything is resident; the CPU copies are freed then and the
+    // materials' textures are acquired.
+    bool uploadGeometry(size_t& byteBudget);
+
+    // GPU bytes of this room's own buffers and host bytes of its generated vertices (shared
+    // models are not included)
+    size_t gpuBytes() const;
+    size_t hostBytes() const;
+
     void updateFan(float deltaTime);
-    void renderFan(Shader& shader);
-    void renderPodium(Shader& shader);
-    void renderBenches(Shader& shader);
+
+    // Recompute instance transforms for the current animation time with the batch kernels
+    void updateTransforms();
+
+    // Queue every draw of the room with the shader variant each part needs; the queue decides
+    // the actual order
+    void submit(RenderQueue& queue, ShaderVariants& shaders);
+
+    // The same draws for the software rasterizer, from the CPU copies kept by retainGeometry
+    // (parts whose vertices were freed are skipped)
+    void submit(SoftwareRasterizer& raster);
+
+    // Shader features a material needs
+    static unsigned int materialFeatures(const Material& material);
+
+    // Whether an instance never moves, so its lighting can be baked
+    bool staticInstance(size_t index) const { return scene.instances.spin[index] == 0.0f; }
 
 private:
-    void generateFloor();
-    void generateCeiling();
-    void generateWalls();
-    void generateDoors();
-    void generateWindows();
-    void generateBenches();
-    void generatePodium();
-    void generateGreenBoard();
-    void generateLights();
-
-    void addQuad(std::vector<float>& vertices, 
-                glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec3 v4, 
+    AssetRegistry* assets;
+    std::vector<float> angles;  // Scratch: yaw plus spin for the current frame
+    std::vector<TextureRef> textureRefs;  // Indexed like scene.materials once acquired
+    LightmapImage lightmapImage;          // Read by buildGeometry, freed once uploaded (unless retained)
+    std::vector<AnimatedBatch> animatedBatches;
+    std::vector<StaticBatch> staticBatches;
+
+    // Generated vertices of every part, sized exactly before generation, released after upload
+    GeometryArena arena;
+
+    void releaseModels();
+    void acquireTextures();
+    void releaseTextures();
+    void ceilingTiles(int& tilesX, int& tilesZ) const;
+    void planBoxes(std::vector<size_t>& boxPart);
+    void planFallbacks();
+    void planLightmap();
+    void loadLightmapImage();
+    void uploadLightmap();
+    void planAnimation();
+    void uploadAnimation(AnimatedBatch& batch);
+    const AnimatedBatch* animatedBatch(size_t model) const;
+    void planStaticBatches();
+    void uploadStaticBatch(StaticBatch& batch, bool loaded);
+    void generateFloor(MeshPart& part);
+    void generateCeiling(MeshPart& part);
+    void generateWalls(MeshPart& part);
+    void generateBoxes(const std::vector<size_t>& boxPart);
+    void generateFallbacks();
+    void addBench(float*& out);
+
+    // Writers advance `out` past the vertices they emit
+    void addQuad(float*& out,
+                glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec3 v4,
                 glm::vec3 normal, glm::vec2 uv1, glm::vec2 uv2, glm::vec2 uv3, glm::vec2 uv4);
-    
-    void addCube(std::vector<float>& vertices, 
+
+    void addCube(float*& out,
                 glm::vec3 position, glm::vec3 size);
 
-    void setupBuffers(unsigned int& VAO, unsigned int& VBO, const std::vector<float>& vertices);
-    void renderBuffer(unsigned int VAO, size_t vertexCount, const glm::vec3& materialAmbient, 
-                     const glm::vec3& materialDiffuse, const glm::vec3& materialSpecular, 
-                     Shader& shader);
+    void setupBuffers(MeshPart& part);
+    void submitInstances(RenderQueue& queue, ShaderVariants& shaders);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,97 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+class Campus;
+class Classroom;
+
+// The camera's body: a vertical capsule hanging from the eye
+struct CollisionCapsule
+{
+    float radius;
+    float below;  // Eye to the bottom of the capsule (feet clear desks and benches below this)
+    float above;  // Eye to the top
+
+    CollisionCapsule() : radius(0.25f), below(1.7f), above(0.15f) {}
+};
+
+// Since the last report()
+struct CollisionStats
+{
+    unsigned int moves;
+    unsigned int queries;     // Grid lookups, one per resolve iteration
+    unsigned int candidates;  // Boxes tested
+    unsigned int contacts;    // Boxes the capsule was pushed out of
+
+    CollisionStats() { reset(); }
+    void reset() { moves = queries = candidates = contacts = 0; }
+};
+
+// Static collision boxes in a uniform spatial hash. A room contributes its floor, ceiling and
+// walls, its scene boxes and the world-space bounds of its model instances (spinning instances
+// the bounds of their whole sweep). A move only tests boxes in the grid cells the capsule touches,
+// so its cost does not grow with the number of rooms.
+class CollisionWorld
+{
+public:
+    float cellSize;  // Grid spacing in meters; boxes are listed in every cell they overlap
+    CollisionStats stats;
+
+    CollisionWorld();
+
+    void clear();
+    void addBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    // A room's shell, boxes and instances at its origin; models that failed to load use their
+    // stand-in's bounds
+    void addRoom(const Classroom& room);
+    // Rebuild the grid after adding boxes
+    void build();
+
+    // Rebuild from the campus's resident rooms when they changed; true when rebuilt
+    bool update(const Campus& campus);
+
+    // Move the eye by delta, sliding along whatever the capsule runs into. Long moves are split
+    // into steps shorter than the radius, so thin walls cannot be skipped; a move longer than 256
+    // steps stops short.
+    glm::vec3 move(const glm::vec3& eye, const glm::vec3& delta, const CollisionCapsule& capsule);
+
+    size_t boxCount() const { return boxes.size(); }
+    size_t cellCount() const { return cells.size(); }
+
+    void report(std::ostream& out);
+
+private:
+    struct Box
+    {
+        glm::vec3 boundsMin, boundsMax;
+    };
+    struct CellRange
+    {
+        uint32_t first, count;
+    };
+
+    std::vector<Box> boxes;
+    std::unordered_map<uint64_t, CellRange> cells;
+    std::vector<uint32_t> cellBoxes;    // Box indices grouped by cell
+    std::vector<uint32_t> visitStamps;  // Per box: the last query that listed it
+    uint32_t queryStamp;
+    std::vector<uint32_t> candidates;   // Scratch
+    unsigned int builtResidency;
+
+    uint64_t cellKey(int x, int y, int z) const;
+    void cellRange(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int lo[3], int hi[3]) const;
+    void gather(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    bool resolve(glm::vec3& eye, const CollisionCapsule& capsule);
+};
+
+// Build a grid of count random boxes and time capsule moves through it, printing microseconds
+// and boxes tested per move (constant when the grid works)
+void benchmarkCollision(size_t count);
+
+#endif
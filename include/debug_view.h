@@ -0,0 +1,153 @@
+#ifndef DEBUG_VIEW_H
+#define DEBUG_VIEW_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "shader.h"
+
+class ShaderVariants;
+class RenderQueue;
+class Campus;
+struct CampusCell;
+
+// What the scene pass shows instead of the shaded scene
+enum DebugViewMode
+{
+    DEBUG_VIEW_OFF = 0,
+    DEBUG_VIEW_OVERDRAW,   // Fragments shaded per pixel: every draw added up, depth test off
+    DEBUG_VIEW_TRIANGLES,  // Triangles per pixel of the visible surface (1 / its triangle's area)
+    DEBUG_VIEW_COST,       // GPU time of the draw each visible pixel belongs to
+    DEBUG_VIEW_WIREFRAME,  // Triangle edges, shaded as usual
+    DEBUG_VIEW_MODE_COUNT
+};
+
+// GPU time of every draw of the render queue: a GL_TIMESTAMP query before the first draw and
+// after each (timestamps, unlike GL_TIME_ELAPSED, nest inside the frame pacer's timing), a draw
+// taking the gap to the stamp before it. Results are read a few flushes later without waiting; a
+// flush whose queries are all still busy is not timed. Draws are told apart by an id of their
+// geometry and placement (see RenderQueue), so times carry over to the same draws in another
+// pass or frame.
+class DrawCosts
+{
+public:
+    static const unsigned int FRAME_COUNT = 4;  // Results arrive up to this many flushes late
+
+    DrawCosts();
+    ~DrawCosts();
+    DrawCosts(const DrawCosts&) = delete;
+    DrawCosts& operator=(const DrawCosts&) = delete;
+
+    // Around one flush, and after each of its draws
+    void beginFrame();
+    void drawn(uint64_t id);
+    void endFrame();
+
+    // Smoothed microseconds of a draw; negative until it was timed
+    float cost(uint64_t id) const;
+    // Of the draws in the last frame read back
+    float maxCost() const { return lastMax; }
+    size_t lastDraws() const { return lastCount; }
+    // Block until every frame in flight is read back (tests)
+    void finish();
+
+private:
+    struct Frame
+    {
+        std::vector<unsigned int> queries;  // Grows to the largest flush, plus one
+        std::vector<uint64_t> ids;          // Draw ending at each query after the first
+        bool pending;
+    };
+
+    Frame frames[FRAME_COUNT];
+    unsigned int next;
+    int active;  // Frame being recorded, -1 when this flush is not timed
+    std::unordered_map<uint64_t, float> costs;
+    float lastMax;
+    size_t lastCount;
+
+    void collect(bool wait);
+};
+
+// One debug view's values over the frame: labelled buckets of pixels
+struct DebugHistogram
+{
+    DebugViewMode mode;
+    int width, height;
+    size_t covered;  // Pixels with geometry
+    double mean;     // Over covered pixels
+    float max;
+    std::vector<std::string> labels;
+    std::vector<size_t> pixels;
+
+    DebugHistogram() : mode(DEBUG_VIEW_OFF), width(0), height(0), covered(0), mean(0.0), max(0.0f) {}
+};
+
+// Runtime debug views of the render queue's draws. The heatmap views draw the scene with the
+// DEBUG_VIEW program variants into a float target, one value per pixel (overdraw through
+// additive blending), and map the values onto the frame with a colour ramp; the last frame's
+// values stay readable for a histogram. Wireframe only switches the polygon mode.
+//
+//   shaders.require(debugView.shaderFeatures());  before the scene is queued
+//   debugView.begin();  renderQueue.flush();  debugView.end();
+//
+// The cost view times the draws with their own programs first (renderQueue.setDrawTimer), then
+// queues the scene again to colour each draw by its time (renderQueue.setDrawCosts); draw() does
+// either in place of the frame's flush.
+class DebugView
+{
+public:
+    DrawCosts costs;
+
+    DebugView();
+    ~DebugView();
+    DebugView(const DebugView&) = delete;
+    DebugView& operator=(const DebugView&) = delete;
+
+    // Compile the program that maps values to colours; false, with an error, when it fails
+    bool initialize(const std::string& vertexPath, const std::string& fragmentPath);
+
+    void setMode(DebugViewMode mode) { current = mode; }
+    DebugViewMode mode() const { return current; }
+    // Off, then every view in turn
+    DebugViewMode next() const { return (DebugViewMode)((current + 1) % DEBUG_VIEW_MODE_COUNT); }
+    static const char* modeName(DebugViewMode mode);
+    // "overdraw", "triangles", "cost" or "wireframe"; false for anything else
+    static bool parseMode(const std::string& name, DebugViewMode& mode);
+
+    bool heatmap() const;
+    // Features of the programs the heatmap views draw with
+    unsigned int shaderFeatures() const { return heatmap() ? FEATURE_DEBUG_VIEW : 0; }
+    // The view's debugMode on every compiled variant, after their other per-frame uniforms
+    void setUniforms(ShaderVariants& shaders) const;
+
+    // Around the scene's draws: redirect them into the value target at the viewport's size, and
+    // map them onto the framebuffer that was bound, at the same viewport
+    void begin();
+    void end();
+    // The queued scene as the view shows it, in place of renderQueue.flush(), after the frame's
+    // uniforms. The cost view's colours trail the frame by the few frames its times take to
+    // come back.
+    void draw(Campus& campus, ShaderVariants& shaders, RenderQueue& renderQueue, const CampusCell& cell);
+
+    // The last frame's values; false, with a warning, when the view has none
+    bool histogram(DebugHistogram& out) const;
+    static bool writeHistogram(const std::string& path, const std::vector<DebugHistogram>& histograms);
+
+private:
+    DebugViewMode current;
+    Shader resolveProgram;
+    unsigned int emptyVAO;
+    unsigned int framebuffer, values, depthBuffer;
+    int targetWidth, targetHeight;
+    int viewport[4];
+    int previousFramebuffer;
+    float drawnScale;  // Cost of the hottest colour in the last frame
+    DebugViewMode drawnMode;
+
+    void resize(int width, int height);
+};
+
+#endif
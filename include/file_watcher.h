@@ -0,0 +1,32 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+// Reports edits to a set of files through inotify, without blocking. Parent directories are
+// watched rather than the files themselves so editors that save by renaming are still seen.
+// On platforms without inotify watch() fails and poll() never reports anything.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    bool watch(const std::string& path);
+
+    // Appends each watched path written since the last poll, once, as passed to watch()
+    void poll(std::vector<std::string>& changed);
+
+private:
+    int fd;
+    std::map<int, std::string> directories;  // inotify watch descriptor -> directory
+    std::set<std::string> files;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include "bounded_queue.h"
+
+// Since start()
+struct CaptureStats
+{
+    unsigned int frames;        // frame() calls
+    unsigned int captured;      // Frames read back and encoded
+    unsigned int written;       // Video frames written, counting repeats
+    unsigned int gpuDrops;      // The next readback buffer was still being filled by the GPU
+    unsigned int encoderDrops;  // ... or still held by the encoders
+    unsigned int sizeDrops;     // The framebuffer was no longer the capture size
+    unsigned int failedWrites;
+    size_t maxQueueDepth;
+    double totalQueueDepth;     // Summed over captured frames, for the mean
+    double renderMs, maxRenderMs;  // On the render thread per frame: polling, mapping, starting reads
+    double encodeMs;            // Encoder threads, summed
+    double writeMs;
+    size_t bytesWritten;
+
+    CaptureStats() : frames(0), captured(0), written(0), gpuDrops(0), encoderDrops(0), sizeDrops(0),
+                     failedWrites(0), maxQueueDepth(0), totalQueueDepth(0.0), renderMs(0.0), maxRenderMs(0.0),
+                     encodeMs(0.0), writeMs(0.0), bytesWritten(0) {}
+};
+
+// Planar I420 of RGBA8 pixels stored bottom row first (as glReadPixels returns them): full-range
+// BT.601 luma, then the quarter-size Cb and Cr planes, top row first. Even sizes only.
+void convertToI420(const uint8_t* rgba, int width, int height, uint8_t* out);
+
+// Records the frames the window shows into a video without stalling the render loop. Each
+// captured frame is read into one of a ring of pixel pack buffers behind a fence; once the fence
+// has passed, the buffer is mapped and handed to encoder threads through a lock-free queue, and
+// they convert it to I420 and write it, in frame order, to a YUV4MPEG2 file or to the standard
+// input of an encoder process. The render thread never waits: when the next buffer is still busy
+// the frame is dropped, and the video repeats the next captured frame in its place so it keeps
+// the session's timing.
+//
+//   capture.start("walkthrough.y4m", 30, width, height);
+//   per frame, after the scene is drawn:  capture.frame(time, width, height);
+//   capture.finish();
+class FrameCapture
+{
+public:
+    static const unsigned int RING_SIZE = 6;
+
+    CaptureStats stats;
+
+    FrameCapture();
+    ~FrameCapture();
+
+    // Owns GL objects, encoder threads and the output
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // output: a .y4m path, or "|command" to pipe the stream into (e.g. "|ffmpeg -i - out.mp4");
+    // frames of width x height (rounded down to even) at fps; encoders 0 for one per spare core
+    bool start(const std::string& output, float fps, int width, int height, unsigned int encoders = 0);
+    bool active() const { return output != NULL; }
+    int width() const { return captureWidth; }
+    int height() const { return captureHeight; }
+
+    // Hand finished readbacks to the encoders and, when a frame is due at time (seconds on any
+    // clock; the first call starts the video), read the bound read framebuffer, which is
+    // width x height; never blocks
+    void frame(double time, int width, int height);
+    // Wait for every frame in flight, stop the encoders and close the output
+    void finish();
+
+    void report(std::ostream& out) const;
+
+private:
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_READING,   // Behind a fence
+        SLOT_ENCODING   // Mapped, owned by an encoder until it comes back through returned
+    };
+
+    struct Slot
+    {
+        unsigned int buffer;
+        GLsync fence;
+        SlotState state;
+        const uint8_t* mapped;
+        uint32_t sequence;  // Order of the frame in the video
+        unsigned int repeats;  // Video frames it fills
+    };
+
+    std::string outputName;
+    FILE* output;
+    bool piped;
+    int captureWidth, captureHeight;
+    double frameSeconds;
+    double startTime;
+    bool started;
+    long long lastTick;           // Video frame of the last capture or drop
+    unsigned int pendingRepeats;  // Video frames dropped since the last capture
+    Slot ring[RING_SIZE];
+    unsigned int ringNext;
+    unsigned int reading;         // Oldest slot behind a fence
+    size_t frameBytes;            // RGBA8 readback of one frame
+    uint32_t nextSequence;
+    bool warnedSize;
+
+    // Render thread -> encoders: slots to convert; encoders -> render thread: slots to unmap
+    BoundedQueue<unsigned int> work;
+    BoundedQueue<unsigned int> returned;
+    std::vector<std::thread> encoders;
+    std::atomic<bool> quit;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    // Frames are written in sequence order
+    std::mutex writeMutex;
+    std::condition_variable turn;
+    uint32_t nextWrite;
+
+    void poll(bool wait);
+    void read(Slot& slot);
+    void encoderLoop();
+    void write(uint32_t sequence, const std::vector<uint8_t>& frame, unsigned int repeats, double encodeMs);
+};
+
+#endif
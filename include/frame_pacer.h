@@ -0,0 +1,126 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <ostream>
+#include <vector>
+#include <utility>
+
+// How buffer swaps wait for the display
+enum SwapPolicy
+{
+    SWAP_IMMEDIATE = 0,  // No vsync; the pacer sleeps to the target frame time instead
+    SWAP_VSYNC = 1,      // Wait for vblank, every N refreshes to match the target
+    SWAP_ADAPTIVE = 2    // Vsync, but tear rather than wait a whole refresh when late
+};
+
+struct FramePacingSettings
+{
+    float targetFrameMs;     // Frame time to hold, e.g. 16.67 for 60 fps; 0 runs unpaced (benchmarks)
+    SwapPolicy swapPolicy;
+    bool dynamicResolution;  // Scale the render resolution to keep GPU time within the target
+    float minScale, maxScale;
+
+    FramePacingSettings() : targetFrameMs(1000.0f / 60.0f), swapPolicy(SWAP_VSYNC), dynamicResolution(true),
+                            minScale(0.5f), maxScale(1.0f) {}
+};
+
+// Since the last report()
+struct FramePacingStats
+{
+    unsigned int frames;
+    unsigned int missedDeadlines;  // Frame intervals more than 10% over the target
+    unsigned int scaleChanges;
+    unsigned int gpuSamples;
+    double totalFrameMs, maxFrameMs;
+    double totalGpuMs, maxGpuMs;
+
+    FramePacingStats() { reset(); }
+    void reset()
+    {
+        frames = missedDeadlines = scaleChanges = gpuSamples = 0;
+        totalFrameMs = maxFrameMs = totalGpuMs = maxGpuMs = 0.0;
+    }
+};
+
+// Holds a steady frame rate on slow GPUs. Every frame's scene pass is timed with GL_TIME_ELAPSED
+// queries (read back a few frames later, never stalling) and, when the GPU time nears the target,
+// the scene is drawn at a lower resolution into an offscreen framebuffer and stretched to the
+// window with a linear blit. Without vsync the pacer also sleeps out the rest of the frame.
+//
+// Per frame: beginFrame() before drawing the scene, endFrame() after it, then swap buffers and
+// call present().
+class FramePacer
+{
+public:
+    FramePacingSettings settings;
+    FramePacingStats stats;
+
+    FramePacer();
+    ~FramePacer();
+
+    // Needs a current GL context; false (and a fixed full resolution) without timer queries
+    bool initialize(const FramePacingSettings& pacingSettings, int width, int height);
+
+    // Window framebuffer size changed; takes effect at the next beginFrame()
+    void resize(int width, int height);
+
+    // Swap interval for glfwSwapInterval under the policy: the number of refreshes per frame at
+    // the display's rate, -1 for adaptive vsync when the driver supports tearing
+    int swapInterval(int refreshRate, bool tearControl) const;
+
+    // Bind the render target at the current scale, set the viewport, start timing the GPU
+    void beginFrame();
+    // Stop timing and stretch the scaled frame onto the window's back buffer
+    void endFrame();
+    // After the buffer swap: wait out the frame without vsync, update deadline statistics
+    void present();
+
+    // Benchmarks: keep every frame's GPU time, keyed by frameNumber() at its beginFrame(), until
+    // drained; finishTiming() waits for the frames still in flight
+    void keepGpuTimes(bool keep) { keepingGpuTimes = keep; }
+    size_t drainGpuTimes(std::vector<std::pair<unsigned int, double> >& times);
+    void finishTiming();
+    unsigned int frameNumber() const { return frameCount; }
+
+    float scale() const { return currentScale; }
+    int renderWidth() const;
+    int renderHeight() const;
+    // Aspect ratio of the window (the projection must not follow the scaled size)
+    float aspect() const { return height > 0 ? (float)width / (float)height : 1.0f; }
+
+    void report(std::ostream& out);
+
+private:
+    static const int QUERY_COUNT = 4;  // GPU results arrive up to this many frames late
+
+    int width, height;
+    int pendingWidth, pendingHeight;  // Resize waiting for the next frame
+    float currentScale;
+    double gpuMs;              // Smoothed GPU time of the scene pass
+    unsigned int samplesSinceChange;
+
+    unsigned int queries[QUERY_COUNT];
+    unsigned int queryFrame[QUERY_COUNT];
+    bool queryPending[QUERY_COUNT];
+    int nextQuery, activeQuery;
+    bool timing;
+    unsigned int frameCount;
+    bool keepingGpuTimes;
+    std::vector<std::pair<unsigned int, double> > gpuTimes;
+
+    unsigned int framebuffer, colorBuffer, depthBuffer;
+    int bufferWidth, bufferHeight;
+    bool offscreen;            // This frame is drawn into the framebuffer
+
+    std::chrono::steady_clock::time_point lastPresent;
+    bool presented;
+
+    void collectQueries(bool wait = false);
+    void updateScale(double sampleMs);
+    void allocateTarget();
+    void releaseTarget();
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <vector>
+#include <cstddef>
+
+// Bump allocator for generated vertex data. Callers size it up front with reserve() so a whole
+// room's geometry lands in one block, write vertices in place, and release() everything once the
+// buffers are on the GPU. reset() keeps the memory for reuse as a per-frame scratch arena.
+class GeometryArena
+{
+public:
+    explicit GeometryArena(size_t blockFloats = 64 * 1024);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // Guarantee that the next `floats` floats of allocations fit in a single block
+    void reserve(size_t floats);
+
+    // Uninitialised storage for `floats` floats; never moves earlier allocations
+    float* allocate(size_t floats);
+
+    // Forget all allocations but keep the blocks
+    void reset();
+
+    // Free every block
+    void release();
+
+    size_t usedBytes() const;
+    size_t capacityBytes() const;
+
+private:
+    struct Block
+    {
+        float* data;
+        size_t capacity;
+        size_t used;
+    };
+
+    std::vector<Block> blocks;
+    size_t current;      // Block allocations are taken from
+    size_t blockFloats;  // Minimum size of new blocks
+
+    void addBlock(size_t floats);
+};
+
+#endif
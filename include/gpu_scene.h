@@ -0,0 +1,129 @@
+#ifndef GPU_SCENE_H
+#define GPU_SCENE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include "campus.h"
+#include "shader_variants.h"
+
+// Shader variant groups drawn by the GPU path, one multi-draw each
+enum GpuDrawGroup
+{
+    GPU_GROUP_SPECULAR,
+    GPU_GROUP_DIFFUSE,
+    GPU_GROUP_EMISSIVE,
+    GPU_GROUP_COUNT
+};
+
+// GPU-driven rendering of every resident room (optional, GL 4.3+). Geometry is packed into one
+// vertex buffer and every object (shell part or model instance) into a storage buffer; each
+// frame a compute shader animates, LOD-selects and frustum-culls the objects and writes the
+// instance counts of indirect draw commands, which are drawn with one glMultiDrawArraysIndirect
+// per shader variant. The CPU only rebuilds the tables when rooms stream in or out.
+class GpuScene
+{
+public:
+    // Multiplies the LOD switch distances; 0 always draws the full models
+    float lodScale;
+
+    GpuScene();
+    ~GpuScene();
+
+    // Owns GL objects
+    GpuScene(const GpuScene&) = delete;
+    GpuScene& operator=(const GpuScene&) = delete;
+
+    // True when the current context can run this path: GL 4.3 with storage buffers in the
+    // vertex stage. Otherwise callers stay on the RenderQueue path.
+    static bool supported();
+
+    // Compile the culling shader; false when it fails to build
+    bool initialize(const std::string& computePath);
+    bool active() const { return cullProgram != 0; }
+
+    // Rebuild the tables if the campus' resident rooms changed since the last call
+    void update(Campus& campus);
+
+    // Force a rebuild on the next update() (models reloaded)
+    void invalidate() { builtResidency = ~0u; }
+
+    // Compile the variants render() uses; call before setting per-frame uniforms
+    void prepare(ShaderVariants& shaders);
+
+    // Cull and draw. Uniforms other than those of the culling pass must already be set.
+    void render(ShaderVariants& shaders, const glm::mat4& projection, const glm::mat4& view,
+                const glm::vec3& viewPos, float time);
+
+    size_t objectCount() const { return objects.size(); }
+    size_t commandCount() const { return commands.size(); }
+
+    // Objects drawn by the last render(); reads the commands back, so it stalls
+    unsigned int visibleCount();
+
+    // Same frustum test on the CPU against the rooms' own transforms, for validation
+    static unsigned int cpuVisibleCount(Campus& campus, const glm::mat4& viewProjection);
+
+private:
+    // std430 layouts shared with shaders/cull.comp and the INDIRECT vertex shader
+    struct GpuObject
+    {
+        float position[3], yaw;        // World position, degrees around Y
+        float scale, spin;             // Uniform scale, degrees per second
+        float spinFirst, spinCount;    // Vertices the vertex shader spins (count 0: the whole object turns)
+        unsigned int batch, material, lightmapLayer, pad2;
+        float lightmapRect[4];         // Chart placement in the layer; zero without baked lighting
+    };
+    struct GpuLod
+    {
+        float boundsMin[3], applyScale;      // Model-space bounds; 1 when the instance scale applies
+        float boundsMax[3], switchDistance;  // Use the next LOD beyond this distance (0: never)
+        unsigned int command, pad[3];
+    };
+    struct GpuBatch
+    {
+        GpuLod lods[2];
+        unsigned int lodCount, pad[3];
+    };
+    struct GpuMaterial
+    {
+        float ambient[4], diffuse[4], specular[4];  // specular[3] is the shininess
+        unsigned int texture[4];                    // Texture slot (NO_TEXTURE: none), layer
+    };
+    struct DrawCommand
+    {
+        unsigned int count, instanceCount, first, baseInstance;
+    };
+
+    unsigned int cullProgram;
+    unsigned int VAO;
+    unsigned int vertexBuffer, objectBuffer, batchBuffer, commandBuffer, visibleBuffer,
+                 matrixBuffer, materialBuffer, lightmapBuffer;
+    unsigned int builtResidency;
+
+    std::vector<GpuObject> objects;
+    std::vector<GpuBatch> batches;
+    std::vector<GpuMaterial> materials;
+    std::vector<DrawCommand> commands;  // Template with zero instance counts, re-uploaded per frame
+    unsigned int groupFirst[GPU_GROUP_COUNT], groupCount[GPU_GROUP_COUNT];
+
+    // Texture arrays of the materials, bound to units 0..TEXTURE_SLOTS-1 ("diffuseMaps" in
+    // fragment_shader.glsl); materials whose array does not get a slot are drawn untextured
+    static const unsigned int TEXTURE_SLOTS = 4;
+    static const unsigned int NO_TEXTURE = 0xFFFFFFFFu;
+    unsigned int textureArrays[TEXTURE_SLOTS];
+    unsigned int textureCount;
+
+    // Every resident room's lightmap as one layer of an array ("lightmaps", LIGHTMAP_TEXTURE_UNIT);
+    // 0 when no room has baked lighting
+    unsigned int lightmapArray;
+    bool animated;  // Some object spins a sub-mesh (FEATURE_ANIMATED)
+
+    void build(const std::vector<Classroom*>& rooms);
+    void upload(size_t visibleTotal);
+    void releaseBuffers();
+    unsigned int groupFeatures(int group) const;
+};
+
+#endif
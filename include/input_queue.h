@@ -0,0 +1,64 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+
+enum InputEventType
+{
+    INPUT_MOUSE_MOVE,  // x, y: cursor offset in pixels (y up)
+    INPUT_SCROLL       // y: wheel offset
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    double time;  // glfwGetTime() when the event was received
+    float x, y;
+};
+
+// Input events waiting for the renderer. Window callbacks only queue and timestamp what arrived;
+// the frame applies everything at once when it latches the camera, right before the view is
+// uploaded, so the view reflects the last event polled instead of the first of the frame.
+// Safe to push from any thread.
+class InputQueue
+{
+public:
+    InputQueue() {}
+    InputQueue(const InputQueue&) = delete;
+    InputQueue& operator=(const InputQueue&) = delete;
+
+    void push(InputEventType type, double time, float x, float y);
+
+    // Move every queued event into events (in arrival order, replacing its contents); returns
+    // how many there were
+    size_t drain(std::vector<InputEvent>& events);
+
+private:
+    std::mutex mutex;
+    std::vector<InputEvent> pending;
+};
+
+// Commands bound to keys, run once when a key goes down rather than every frame it is held
+class KeyActions
+{
+public:
+    void bind(int key, const std::function<void()>& action);
+
+    // Run the action of every bound key that is down now and was up at the last poll, in binding
+    // order; isDown reports a key's state (glfwGetKey in the application)
+    void poll(const std::function<bool(int)>& isDown);
+
+private:
+    struct Binding
+    {
+        int key;
+        bool held;
+        std::function<void()> action;
+    };
+    std::vector<Binding> bindings;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef LATENCY_METER_H
+#define LATENCY_METER_H
+
+#include <GL/glew.h>
+#include <ostream>
+
+// Since the last report()
+struct LatencyStats
+{
+    unsigned int frames;   // Frames that latched input and whose GPU timestamp came back
+    unsigned int latched;  // Input events applied
+    double totalMs, maxMs;
+
+    LatencyStats() { reset(); }
+    void reset()
+    {
+        frames = latched = 0;
+        totalMs = maxMs = 0.0;
+    }
+};
+
+// Input-to-photon latency. Each frame that applied input records the oldest event's time, and a
+// GL_TIMESTAMP query after its last draw tells when the GPU finished the frame; the GPU clock is
+// mapped onto the input clock (glfwGetTime) at every latch. The measured time stops short of
+// scan-out by the swap's queueing and up to one refresh.
+//
+// For an external check the overlay draws the latched input time (milliseconds, low 16 bits,
+// white = 1, most significant bit left) as a strip of squares in the window's top-left corner:
+// film the screen with a clock or the logged input times, and read the frame that was shown.
+class LatencyMeter
+{
+public:
+    bool overlay;
+    LatencyStats stats;
+
+    LatencyMeter();
+    ~LatencyMeter();
+    LatencyMeter(const LatencyMeter&) = delete;
+    LatencyMeter& operator=(const LatencyMeter&) = delete;
+
+    // Needs a current GL context; false without timestamp queries (the overlay still works)
+    bool initialize();
+
+    // The camera was latched from input received at inputTime (0: no input this frame); now is
+    // the same clock
+    void latch(double inputTime, unsigned int events, double now);
+    // After the frame's last draw into the window's back buffer: overlay, then the timestamp
+    void endFrame(int windowWidth, int windowHeight);
+
+    void report(std::ostream& out);
+
+private:
+    static const int QUERY_COUNT = 4;  // Timestamps arrive up to this many frames late
+
+    unsigned int queries[QUERY_COUNT];
+    double queryInput[QUERY_COUNT];  // Latched input time on the GPU clock, seconds
+    bool queryPending[QUERY_COUNT];
+    int nextQuery;
+    bool timing;
+    double clockOffset;    // Input clock minus GPU clock, seconds
+    double latchedInput;   // This frame's oldest applied input
+
+    void collectQueries();
+    void drawOverlay(int windowWidth, int windowHeight);
+};
+
+#endif
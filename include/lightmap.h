@@ -0,0 +1,51 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Texel density of baked lighting and the empty border kept around every chart, so bilinear
+// filtering never blends in a neighbouring chart
+static const float LIGHTMAP_TEXELS_PER_METER = 16.0f;
+static const float LIGHTMAP_GUTTER_TEXELS = 1.5f;
+
+// Lightmap UVs (a second UV channel) for non-indexed triangles with 8-float vertices. Every
+// planar quad (two consecutive triangles sharing an edge) or lone triangle becomes a chart laid
+// flat at its true size and shelf-packed into a square, with `gutter` mesh units around each
+// chart. uvs gets 2 floats per vertex in [0, 1]; returns the side of the square in mesh units.
+float unwrapLightmap(const float* vertices, size_t count, float gutter, std::vector<float>& uvs);
+
+// Region of the atlas, in texels
+struct LightmapRect
+{
+    unsigned int x, y, width, height;
+};
+
+// Shelf-pack rectangles (tallest first) into an atlas whose width is the smallest power of two
+// keeping it about square. rects must have their sizes set; x and y are filled in.
+void packLightmap(std::vector<LightmapRect>& rects, unsigned int& width, unsigned int& height);
+
+// Baked lighting of one room. Texels are RGB9_E5 (shared exponent HDR, the GL_RGB9_E5 layout),
+// tied to the atlas layout they were baked for by layoutHash.
+struct LightmapImage
+{
+    unsigned int width, height;
+    uint64_t layoutHash;
+    std::vector<uint32_t> texels;
+
+    LightmapImage() : width(0), height(0), layoutHash(0) {}
+};
+
+bool saveLightmap(const std::string& path, const LightmapImage& image);
+bool loadLightmap(const std::string& path, LightmapImage& image);
+
+// scenes/classroom.scene (or .sceneb) -> scenes/classroom.lightmap
+std::string lightmapPathFor(const std::string& scenePath);
+
+uint32_t packRGB9E5(const glm::vec3& color);
+glm::vec3 unpackRGB9E5(uint32_t texel);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <cstddef>
+#include "classroom.h"
+#include "lightmap.h"
+
+struct LightmapBakeSettings
+{
+    unsigned int lightSamples;     // Shadow rays per fixture for every texel
+    unsigned int indirectSamples;  // Hemisphere rays per texel for the bounce
+    unsigned int threads;          // 0: one per hardware thread
+    float fixtureRadiance;         // Brightness of a fixture's lit face, times the scene light colour
+
+    LightmapBakeSettings() : lightSamples(8), indirectSamples(64), threads(0), fixtureRadiance(24.0f) {}
+};
+
+struct LightmapBakeStats
+{
+    size_t triangles;  // Occluders in the ray-tracing BVH
+    size_t texels;     // Texels covered by a chart
+    size_t rays;
+    double seconds;
+
+    LightmapBakeStats() : triangles(0), texels(0), rays(0), seconds(0.0) {}
+};
+
+// Bake the diffuse lighting of a room's static surfaces into its lightmap layout: direct light
+// from every fixture (area light on the fixture's underside, with ray-traced shadows) plus one
+// diffuse bounce. Runs on the CPU across worker threads and needs no GL context, only a room
+// after buildGeometry(). The result matches room.lightmapLayout and is saved with saveLightmap.
+bool bakeLightmap(const Classroom& room, const LightmapBakeSettings& settings, LightmapImage& image,
+                  LightmapBakeStats& stats);
+
+#endif
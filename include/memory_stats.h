@@ -0,0 +1,26 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+// Resident set size of this process from /proc/self/status ("VmRSS" now, "VmHWM" peak), in
+// bytes; 0 where /proc is unavailable
+inline size_t processMemoryField(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = std::string(field).size();
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+            return (size_t)std::strtoull(line.c_str() + length + 1, NULL, 10) * 1024;
+    }
+    return 0;
+}
+
+inline size_t residentSetBytes() { return processMemoryField("VmRSS"); }
+inline size_t peakResidentSetBytes() { return processMemoryField("VmHWM"); }
+
+#endif
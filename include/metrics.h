@@ -0,0 +1,117 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <memory>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+enum MetricType
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+};
+
+// One time series. Values are relaxed atomics: the render thread writes without locks or
+// allocation, a scrape reads whatever was last written (a histogram's sum and buckets may be one
+// observation apart).
+class Metric
+{
+public:
+    static const int MAX_BUCKETS = 16;
+
+    Metric();
+    Metric(const Metric&) = delete;
+    Metric& operator=(const Metric&) = delete;
+
+    void add(double amount);       // Counter or gauge
+    void set(double value);        // Gauge
+    void observe(double value);    // Histogram
+
+    double value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    friend class MetricsRegistry;
+
+    // Fixed at registration, before the metric is published
+    MetricType type;
+    std::string name, help, labels;
+    double bounds[MAX_BUCKETS];    // Histogram upper bounds, ascending; +Inf is implicit
+    int boundCount;
+
+    std::atomic<double> current;   // Counter/gauge value, histogram sum
+    std::atomic<uint64_t> buckets[MAX_BUCKETS + 1];  // Observations per bucket, not cumulative
+};
+
+// Append-only set of metrics served in the Prometheus text format. Metrics are registered by the
+// render thread (any time, e.g. when an asset first appears) into preallocated slots and
+// published with one atomic store, so the server thread reads them without a lock. Registering
+// a name and label set that already exists returns the existing metric; pointers stay valid
+// for the registry's lifetime.
+class MetricsRegistry
+{
+public:
+    static const size_t CAPACITY = 1024;
+
+    MetricsRegistry();
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // labels: the inside of the braces, e.g. metricLabel("asset", path); empty for none
+    Metric* counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Metric* gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Metric* histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds);
+
+    size_t size() const { return published.load(std::memory_order_acquire); }
+
+    // Text exposition format 0.0.4; safe from any thread
+    std::string exposition() const;
+
+private:
+    std::unique_ptr<Metric[]> slots;
+    std::atomic<size_t> published;
+    std::map<std::string, size_t> byKey;  // Render thread only
+    Metric overflow;                      // Handed out when the slots run out; never served
+
+    Metric* add(MetricType type, const std::string& name, const std::string& help, const std::string& labels,
+                const std::vector<double>& bounds);
+};
+
+// key="value" with the value escaped for the exposition format
+std::string metricLabel(const std::string& key, const std::string& value);
+
+// Answers HTTP GET requests with the registry's exposition on a background thread. The address
+// is "unix:<path>" for a Unix domain socket (scrape with curl --unix-socket) or a port number on
+// 127.0.0.1; nothing listens beyond the local machine.
+class MetricsServer
+{
+public:
+    explicit MetricsServer(const MetricsRegistry& registry);
+    ~MetricsServer();
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // False, with an error, when the socket cannot be opened
+    bool start(const std::string& address);
+    void stop();
+
+    unsigned long long requests() const { return served.load(std::memory_order_relaxed); }
+
+private:
+    const MetricsRegistry& registry;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<unsigned long long> served;
+    int listenSocket;
+    std::string socketPath;  // Unix socket file to remove on stop
+
+    void serve();
+    void answer(int client);
+};
+
+#endif
@@ -8,36 +8,77 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <atomic>
+#include "lightmap.h"
+
+// Named sub-mesh from an OBJ `o` or `g` line: a contiguous range of the model's vertices
+struct ModelPart
+{
+    std::string name;
+    size_t first, count;
+};
 
 class Model
 {
 public:
-    std::vector<float> vertices;  // Interleaved: position (3) + normal (3) + texcoord (2)
-    unsigned int VAO, VBO;
+    // Interleaved: position (3) + normal (3) + texcoord (2). Freed once uploaded unless
+    // retainVertices is set (picking, physics and other CPU consumers).
+    std::vector<float> vertices;
+    // Second UV channel for baked lighting (2 floats per vertex, attribute 4), freed with the
+    // vertices; lightmapExtent is the model-space size the unit square of these UVs covers
+    std::vector<float> lightmapUVs;
+    float lightmapExtent;
+    unsigned int VAO, VBO, lightmapVBO;
+    size_t vertexCount;              // Survives freeing the vertices; 0 means nothing loaded
+    glm::vec3 boundsMin, boundsMax;  // Model-space bounding box
+    std::vector<ModelPart> parts;    // In file order; faces before the first group form an unnamed part
+    unsigned int revision;           // Bumped by every upload, so VAOs built on VBO can tell a reload
+    std::atomic<bool> retainVertices;
     
-    Model() : VAO(0), VBO(0) {}
+    Model() : lightmapExtent(0.0f), VAO(0), VBO(0), lightmapVBO(0), vertexCount(0), boundsMin(0.0f), boundsMax(0.0f),
+              revision(0), retainVertices(false) {}
     
     ~Model()
     {
         if (VAO != 0) glDeleteVertexArrays(1, &VAO);
         if (VBO != 0) glDeleteBuffers(1, &VBO);
+        if (lightmapVBO != 0) glDeleteBuffers(1, &lightmapVBO);
     }
+
+    // Owns GL objects, so copies would double-free them
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
     
     // Load OBJ file and setup buffers
     bool loadOBJ(const std::string& path)
     {
-        std::vector<glm::vec3> temp_vertices;
-        std::vector<glm::vec3> temp_normals;
-        std::vector<glm::vec2> temp_uvs;
-        
-        std::vector<unsigned int> vertexIndices, normalIndices, uvIndices;
-        
+        if (!parseOBJ(path))
+            return false;
+        setupBuffers();
+        return true;
+    }
+
+    // Parse an OBJ file into vertices without touching GL, so it can run on a loader thread
+    bool parseOBJ(const std::string& path)
+    {
         std::ifstream file(path);
         if (!file.is_open())
         {
             std::cout << "ERROR::MODEL::Failed to open OBJ file: " << path << std::endl;
             return false;
         }
+        return parseOBJ(file, path);
+    }
+
+    // Parse OBJ text from any stream; path is only used for log messages
+    bool parseOBJ(std::istream& file, const std::string& path)
+    {
+        std::vector<glm::vec3> temp_vertices;
+        std::vector<glm::vec3> temp_normals;
+        std::vector<glm::vec2> temp_uvs;
+        
+        std::vector<unsigned int> vertexIndices, normalIndices, uvIndices;
+        parts.clear();
         
         std::string line;
         while (std::getline(file, line))
@@ -64,6 +105,17 @@ public:
                 iss >> uv.x >> uv.y;
                 temp_uvs.push_back(uv);
             }
+            else if (prefix == "o" || prefix == "g")  // Object or group: starts a sub-mesh
+            {
+                ModelPart part;
+                std::getline(iss >> std::ws, part.name);
+                part.first = vertexIndices.size();
+                part.count = 0;
+                if (!parts.empty() && parts.back().first == part.first)
+                    parts.back() = part;  // No faces since the previous group
+                else
+                    parts.push_back(part);
+            }
             else if (prefix == "f")  // Face
             {
                 std::string vertex1, vertex2, vertex3;
@@ -112,8 +164,6 @@ public:
             }
         }
         
-        file.close();
-        
         // Build interleaved vertex data
         vertices.clear();
         bool hasNormals = normalIndices.size() == vertexIndices.size();
@@ -158,16 +208,82 @@ public:
             }
         }
         
+        vertexCount = vertices.size() / 8;
+        computeBounds();
+        if (parts.empty() || parts[0].first > 0)
+        {
+            ModelPart unnamed = { "", 0, 0 };
+            parts.insert(parts.begin(), unnamed);
+        }
+        for (size_t i = 0; i < parts.size(); i++)
+            parts[i].count = (i + 1 < parts.size() ? parts[i + 1].first : vertexCount) - parts[i].first;
+        // OBJ units are taken as meters for the lightmap gutter
+        lightmapExtent = unwrapLightmap(vertices.data(), vertexCount, LIGHTMAP_GUTTER_TEXELS / LIGHTMAP_TEXELS_PER_METER,
+                                        lightmapUVs);
+
         std::cout << "MODEL::Loaded OBJ file: " << path << std::endl;
         std::cout << "  Vertices: " << temp_vertices.size() << std::endl;
         std::cout << "  Normals: " << temp_normals.size() << std::endl;
         std::cout << "  Faces: " << vertexIndices.size() / 3 << std::endl;
         
-        setupBuffers();
         return true;
     }
+
+    void computeBounds()
+    {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        if (vertices.empty())
+            return;
+        boundsMin = boundsMax = glm::vec3(vertices[0], vertices[1], vertices[2]);
+        for (size_t i = 0; i < vertices.size(); i += 8)
+        {
+            glm::vec3 p(vertices[i], vertices[i + 1], vertices[i + 2]);
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+    }
+
+    // Sub-mesh by OBJ group name; NULL when there is none
+    const ModelPart* part(const std::string& name) const
+    {
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (parts[i].name == name)
+                return &parts[i];
+        }
+        return NULL;
+    }
+
+    bool loaded() const { return vertexCount > 0; }
+    bool uploaded() const { return VAO != 0; }
+    size_t gpuBytes() const { return uploaded() ? vertexCount * (lightmapVBO ? 10 : 8) * sizeof(float) : 0; }
+    size_t hostBytes() const { return (vertices.capacity() + lightmapUVs.capacity()) * sizeof(float); }
+
+    // Delete GL objects and vertex data, e.g. before reloading in place
+    void unload()
+    {
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        if (VBO != 0) glDeleteBuffers(1, &VBO);
+        if (lightmapVBO != 0) glDeleteBuffers(1, &lightmapVBO);
+        VAO = VBO = lightmapVBO = 0;
+        vertices.clear();
+        lightmapUVs.clear();
+        vertexCount = 0;
+    }
     
+    // Upload, then free the CPU copy unless it is retained. Models shared through the asset
+    // registry are uploaded with AssetRegistry::uploadModel instead, which frees under its lock.
     void setupBuffers()
+    {
+        if (VAO != 0)
+            return;  // Already uploaded
+        uploadBuffers();
+        if (!retainVertices)
+            freeHostCopy();
+    }
+
+    // GL objects from the CPU copy, which stays
+    void uploadBuffers()
     {
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -188,15 +304,33 @@ public:
         // Texture coordinate attribute
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glEnableVertexAttribArray(2);
+
+        // Lightmap coordinate attribute, from its own buffer
+        if (!lightmapUVs.empty())
+        {
+            glGenBuffers(1, &lightmapVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, lightmapVBO);
+            glBufferData(GL_ARRAY_BUFFER, lightmapUVs.size() * sizeof(float), lightmapUVs.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(4);
+        }
         
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+        revision++;
+    }
+
+    // The GPU has its own copy now
+    void freeHostCopy()
+    {
+        std::vector<float>().swap(vertices);
+        std::vector<float>().swap(lightmapUVs);
     }
     
     void render()
     {
         glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 8);
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertexCount);
         glBindVertexArray(0);
     }
 };
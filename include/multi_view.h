@@ -0,0 +1,89 @@
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "camera.h"
+
+// Where the views of a multi-view frame are drawn
+enum MultiViewMode
+{
+    MULTIVIEW_LAYERED,  // One texture array layer per view (gl_Layer from the vertex shader), copied to columns
+    MULTIVIEW_SPLIT     // Side by side in the bound framebuffer, each view clipped to its column
+};
+
+struct MultiViewCamera
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 position;
+};
+
+// Several camera views (a stereo pair for a dual-projector wall, or more) drawn by one pass over
+// the render queue: every draw is instanced once per view and the vertex shader picks the view's
+// matrices from MultiViewBlock, so the CPU cost of a frame does not grow with the view count.
+// The output is always the views side by side in columns of the framebuffer bound at begin().
+class MultiView
+{
+public:
+    static const unsigned int MAX_VIEWS = 16;  // Array size of MultiViewBlock
+
+    MultiView();
+    ~MultiView();
+
+    // Owns GL objects
+    MultiView(const MultiView&) = delete;
+    MultiView& operator=(const MultiView&) = delete;
+
+    // Layered rendering needs gl_Layer in vertex shaders through ARB_shader_viewport_layer_array,
+    // the extension the shaders require; needs a current GL context
+    static bool layeredSupported();
+    static const char* modeName(MultiViewMode mode);
+
+    // 2 to MAX_VIEWS views; layered falls back to split when unsupported
+    bool initialize(unsigned int views, MultiViewMode preferred);
+
+    unsigned int viewCount() const { return count; }
+    MultiViewMode mode() const { return viewMode; }
+    // Features the programs of the frame need (see ShaderVariants::require)
+    unsigned int shaderFeatures() const;
+
+    // Views spread evenly across a baseline of separation metres along the camera's right
+    // vector, parallel and with off-axis frusta meeting at the convergence distance (the zero
+    // parallax plane of the wall); aspect is that of one column
+    void stereoCameras(const Camera& camera, float aspect, float separation, float convergence,
+                       MultiViewCamera* cameras) const;
+
+    // Upload the views to MultiViewBlock
+    void update(const MultiViewCamera* cameras);
+
+    // Direct the frame's draws at the views: width x height is the output (all columns) in the
+    // framebuffer bound now. Layered: clears and binds the layer target.
+    void begin(int width, int height);
+    // Layered: copy each layer to its column of the output framebuffer (after begin()) or just
+    // rebind it (after beginLayers())
+    void end();
+
+    // Layered only: draw to the layers themselves, width x height each, for callers that read
+    // them back (see ThumbnailBatch); pairs with end() like begin()
+    void beginLayers(int width, int height);
+    // Colour texture array of the layered target, one RGBA8 layer per view
+    unsigned int layerTexture() const { return colorArray; }
+
+private:
+    unsigned int count;
+    MultiViewMode viewMode;
+    unsigned int uniformBuffer;
+    // Layered target: colour and depth texture arrays, one layer per view
+    unsigned int framebuffer, readFramebuffer, colorArray, depthArray;
+    int layerWidth, layerHeight;
+    // Output of the frame: framebuffer and size at begin()
+    int output, outputWidth, outputHeight;
+    bool blitLayers;  // begin() rather than beginLayers()
+
+    void allocateLayers(int width, int height);
+    void releaseLayers();
+};
+
+#endif
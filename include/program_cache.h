@@ -0,0 +1,41 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+#include <string>
+#include <cstdint>
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary). Entries are
+// keyed on the shader sources plus the driver's vendor/renderer/version strings, so a driver
+// update or a source edit simply misses instead of loading an incompatible binary.
+//
+// File layout (shader_cache/<key>.bin): "CPRG", version, key, binary format, length, bytes
+class ProgramBinaryCache
+{
+public:
+    unsigned int hits;
+    unsigned int misses;
+
+    // Queries driver strings, so a GL context must be current
+    explicit ProgramBinaryCache(const std::string& directory);
+
+    // False when the driver exposes no program binary formats; load/store then do nothing
+    bool enabled() const { return supported; }
+
+    uint64_t key(const std::string& vertexCode, const std::string& fragmentCode) const;
+
+    // Returns a linked program restored from disk, or 0 on a miss or a rejected binary
+    unsigned int load(uint64_t key);
+
+    // Writes the binary of a linked program created with the retrievable hint
+    bool store(uint64_t key, unsigned int program);
+
+private:
+    std::string directory;
+    uint64_t driverHash;
+    bool supported;
+
+    std::string pathFor(uint64_t key) const;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "shader.h"
+
+class DrawCosts;
+
+// Phong material, uploaded to the "material" struct in fragment_shader.glsl
+struct Material
+{
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    float shininess;
+    unsigned int id;  // Small index used in draw sort keys
+    // Diffuse map as a texture array layer (see TextureStreamer); set once the room's textures
+    // are resident, 0 for untextured materials
+    unsigned int diffuseMap;
+    float diffuseLayer;
+
+    Material() : ambient(0.5f), diffuse(0.7f), specular(0.3f), shininess(32.0f), id(0), diffuseMap(0),
+                 diffuseLayer(0.0f) {}
+    Material(const glm::vec3& a, const glm::vec3& d, const glm::vec3& s, float shine = 32.0f)
+        : ambient(a), diffuse(d), specular(s), shininess(shine), id(0), diffuseMap(0), diffuseLayer(0.0f) {}
+};
+
+// Draw layers in submission order. Opaque geometry is sorted front-to-back within its layer.
+enum RenderLayer
+{
+    LAYER_OPAQUE = 0,
+    LAYER_EMISSIVE = 1,
+    LAYER_TRANSPARENT = 2
+};
+
+// One queued draw call. Everything needed to issue it is stored by value so packets can be reordered.
+struct DrawPacket
+{
+    uint64_t key;
+    const Shader* shader;
+    unsigned int VAO;
+    GLint first;
+    GLsizei count;
+    const Material* material;  // NULL for programs without a material (light fixtures)
+    glm::mat4 model;
+    unsigned int lightmap;     // Baked lighting texture, 0 for dynamically lit draws
+    glm::vec4 lightmapRect;    // Scale (xy) and offset (zw) of the draw's chart in the lightmap
+    GLsizei instanceCount;     // 0: plain draw with the model uniform; otherwise the VAO carries placements
+};
+
+// Texture unit of the "lightmap" sampler, clear of the diffuse map units
+static const unsigned int LIGHTMAP_TEXTURE_UNIT = 4;
+
+// Number of GL calls issued for one frame
+struct RenderStats
+{
+    unsigned int drawCalls;
+    unsigned int programBinds;
+    unsigned int vaoBinds;
+    unsigned int uniformUploads;
+    unsigned int textureBinds;
+    unsigned long long triangles;
+
+    RenderStats() { reset(); }
+    void reset()
+    {
+        drawCalls = programBinds = vaoBinds = uniformUploads = textureBinds = 0;
+        triangles = 0;
+    }
+    // GL calls issued for the flush
+    unsigned int glCalls() const { return drawCalls + programBinds + vaoBinds + uniformUploads + textureBinds; }
+};
+
+// Remembers bound program, VAO and per-program uniforms so redundant GL calls can be skipped
+class GLStateCache
+{
+public:
+    RenderStats stats;
+
+    GLStateCache() { reset(); }
+
+    // Forget everything; call whenever GL state may have been changed behind the cache's back
+    void reset();
+    // Also drop cached uniform locations; call after programs were relinked or replaced
+    void forgetPrograms() { programs.clear(); reset(); }
+    void useProgram(const Shader& shader);
+    void bindVertexArray(unsigned int VAO);
+    void setMaterial(const Shader& shader, const Material& material);
+    void setModel(const Shader& shader, const glm::mat4& model);
+    void setLightmap(const Shader& shader, unsigned int lightmap, const glm::vec4& rect);
+    // The cost debug view's per-draw value (see DebugView)
+    void setDrawCost(const Shader& shader, float cost);
+
+private:
+    struct ProgramState
+    {
+        unsigned int program;
+        int modelLoc, ambientLoc, diffuseLoc, specularLoc, shininessLoc, layerLoc, lightmapRectLoc, drawCostLoc;
+        const Material* material;
+        glm::mat4 model;
+        glm::vec4 lightmapRect;
+        float drawCost;
+        bool hasModel, hasLightmapRect, hasDrawCost;
+    };
+
+    unsigned int currentProgram;
+    unsigned int currentVAO;
+    unsigned int currentTexture;   // Texture array on unit 0
+    unsigned int currentLightmap;  // Lightmap on LIGHTMAP_TEXTURE_UNIT
+    bool programValid, vaoValid, textureValid, lightmapValid;
+    std::vector<ProgramState> programs;
+
+    ProgramState& programState(const Shader& shader);
+};
+
+// A packet's sort key and submission index
+struct DrawSortEntry
+{
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort by key, 8 bits per pass, skipping passes where every key shares the byte;
+// scratch is resized to match. RenderQueue::flush() orders its packets with it.
+void radixSortEntries(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch);
+
+// Per-frame draw queue. Packets are sorted by a 64-bit key with an LSD radix sort before execution.
+//
+// Key layout (most significant first):
+//   layer (4) | program (8) | material (12) | VAO (16) | depth (24)
+class RenderQueue
+{
+public:
+    RenderStats lastStats;       // Calls actually issued by the last flush()
+    RenderStats lastNaiveStats;  // Calls an unsorted, uncached submission would have issued
+
+    RenderQueue();
+
+    // Eye position used to compute the depth part of sort keys
+    void setViewPosition(const glm::vec3& eye) { viewPosition = eye; }
+
+    // Views every packet is drawn for (see MultiView): above 1, each draw is instanced that many
+    // times more and its programs must be MULTIVIEW variants
+    void setViewCount(unsigned int count) { views = count > 0 ? count : 1; }
+    unsigned int viewCount() const { return views; }
+
+    void submit(RenderLayer layer, const Shader& shader, unsigned int VAO, GLsizei count,
+                const Material* material, const glm::mat4& model, const glm::vec3& worldCenter,
+                unsigned int lightmap = 0, const glm::vec4& lightmapRect = glm::vec4(0.0f));
+
+    // Instanced draw whose VAO supplies per-instance placement (see AnimatedBatch and StaticBatch);
+    // no model uniform, and lightmap rects (if any) come from the VAO too
+    void submitInstanced(RenderLayer layer, const Shader& shader, unsigned int VAO, GLsizei count,
+                         GLsizei instanceCount, const Material* material, const glm::vec3& worldCenter,
+                         unsigned int lightmap = 0);
+
+    // Sort and issue all queued packets, then clear the queue
+    void flush();
+
+    size_t size() const { return packets.size(); }
+
+    // Shader programs were swapped (hot reload): re-query their uniform locations
+    void invalidatePrograms() { stateCache.forgetPrograms(); }
+
+    // Debug views (NULL: off): time every draw of each flush into costs, or hand each draw its
+    // time from costs as the drawCost uniform. Draws match across passes by drawId().
+    void setDrawTimer(DrawCosts* costs) { drawTimer = costs; }
+    void setDrawCosts(const DrawCosts* costs) { drawCosts = costs; }
+    // Geometry and placement of a draw, not its program
+    static uint64_t drawId(const DrawPacket& packet);
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<DrawSortEntry> sortEntries;
+    std::vector<DrawSortEntry> sortScratch;
+    glm::vec3 viewPosition;
+    unsigned int views;
+    GLStateCache stateCache;
+    DrawCosts* drawTimer;
+    const DrawCosts* drawCosts;
+
+    static uint64_t makeKey(RenderLayer layer, unsigned int program, unsigned int material,
+                            unsigned int VAO, float depth);
+    void radixSort();
+    void countNaiveCalls();
+};
+
+#endif
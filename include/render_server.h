@@ -0,0 +1,184 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "thumbnail_batch.h"
+#include "seating.h"
+
+// Wire protocol of RenderServer over a stream socket; integers and floats little-endian.
+//   client -> server, any time:  "CCAM", uint32 sequence, float x, y, z, yaw, pitch, uint64 stamp
+//   server -> client, per frame: "CFRM", uint32 sequence, uint32 tick, uint16 width, height,
+//                                uint64 stamp, uint32 size, then size bytes of QOI image
+// A frame carries the sequence and stamp of the camera update it shows; stamps are the client's
+// own (e.g. its send time), echoed so it can time the round trip.
+struct CameraUpdate
+{
+    uint32_t sequence;
+    glm::vec3 position;
+    float yaw, pitch;
+    uint64_t stamp;
+
+    CameraUpdate() : sequence(0), position(0.0f), yaw(0.0f), pitch(0.0f), stamp(0) {}
+};
+
+struct FrameHeader
+{
+    uint32_t sequence, tick;
+    unsigned int width, height;
+    uint64_t stamp;
+    uint32_t size;
+
+    FrameHeader() : sequence(0), tick(0), width(0), height(0), stamp(0), size(0) {}
+};
+
+const size_t CAMERA_MESSAGE_SIZE = 36;
+const size_t FRAME_HEADER_SIZE = 28;
+
+void encodeCameraUpdate(const CameraUpdate& update, uint8_t out[CAMERA_MESSAGE_SIZE]);
+bool decodeCameraUpdate(const uint8_t in[CAMERA_MESSAGE_SIZE], CameraUpdate& update);
+void encodeFrameHeader(const FrameHeader& header, uint8_t out[FRAME_HEADER_SIZE]);
+bool decodeFrameHeader(const uint8_t in[FRAME_HEADER_SIZE], FrameHeader& header);
+
+// One client since the last report()
+struct ServerClientStats
+{
+    unsigned int id;
+    unsigned int frames;     // Sent whole
+    unsigned int dropped;    // Encoded, then replaced by a newer frame before it could be sent
+    unsigned int skipped;    // Ticks the client was not drawn: too many of its frames in flight
+    size_t bytes;
+    std::vector<float> latencyMs;  // Camera update arrival to the first frame showing it sent
+    double seconds;          // Connected during the interval
+
+    ServerClientStats() : id(0), frames(0), dropped(0), skipped(0), bytes(0), seconds(0.0) {}
+};
+
+// Renders for thin clients: each connects to the address ("unix:<path>" or a port on 127.0.0.1,
+// "*:<port>" on every interface), streams camera updates and receives its view as QOI frames.
+// A network thread accepts clients, parses their cameras and sends frames; the render loop asks
+// for the views of a tick (every client with a camera), draws them with a ThumbnailBatch whose
+// sink this is, and the batch's writers hand the encoded frames back here. A slow client keeps
+// only its newest frame queued and is not drawn while MAX_IN_FLIGHT of its frames are pending,
+// so it cannot hold the others back.
+class RenderServer : public ThumbnailSink
+{
+public:
+    static const unsigned int MAX_IN_FLIGHT = 3;
+
+    RenderServer();
+    ~RenderServer();
+    RenderServer(const RenderServer&) = delete;
+    RenderServer& operator=(const RenderServer&) = delete;
+
+    // Frames are width x height (the batch's view size); false, with an error, when the socket
+    // cannot be opened
+    bool start(const std::string& address, int width, int height);
+    void stop();
+
+    // Views to draw for tick, one per client with a camera, named for thumbnail()
+    void views(uint32_t tick, std::vector<ViewPose>& poses);
+    size_t clientCount();
+
+    // From the batch's writer threads
+    void thumbnail(const std::string& name, std::vector<uint8_t>& qoi);
+
+    // Per client and in total since the last report; departed clients appear once more
+    void report(std::ostream& out);
+
+    // The render loop, on the GL thread after start(): every tick, draw the view of each client
+    // that has sent a camera with batch (whose sink this is). Clients in the same cell share
+    // passes, so the scene is submitted and sorted once per pass for all of them; finished
+    // readbacks are collected between ticks. Runs for seconds (0: until Ctrl+C), reporting every
+    // 5 s; false when the batch failed to deliver frames.
+    bool run(Campus& campus, AssetRegistry& assets, ShaderVariants& shaders, RenderQueue& queue,
+             ThumbnailBatch& batch, float tickRate, float seconds);
+
+private:
+    // A frame drawn and not yet sent
+    struct PendingFrame
+    {
+        unsigned int client;
+        uint32_t sequence, tick;
+        uint64_t stamp;
+        std::chrono::steady_clock::time_point arrival;  // Of its camera update
+    };
+
+    struct OutgoingFrame
+    {
+        std::vector<uint8_t> bytes;  // Header and image
+        size_t sent;
+        PendingFrame frame;
+    };
+
+    struct Client
+    {
+        int connection;
+        bool closed;
+        std::vector<uint8_t> inbox;  // Partial camera message
+        bool hasCamera;
+        CameraUpdate camera;
+        std::chrono::steady_clock::time_point arrival;
+        uint32_t lastSentSequence;
+        bool sentAny;
+        unsigned int inFlight;   // Drawn, not yet sent or dropped
+        long long newestTick;    // Of the newest frame queued
+        std::deque<OutgoingFrame> outbox;  // Front may be partly sent
+        ServerClientStats stats;
+        std::chrono::steady_clock::time_point since;  // Start of the stats interval
+    };
+
+    std::mutex mutex;  // Everything below; the network thread only sends and receives under it
+    std::map<unsigned int, Client> clients;
+    std::vector<ServerClientStats> departed;
+    std::map<uint32_t, PendingFrame> pending;  // By view name
+    uint32_t nextKey;
+    unsigned int nextClient;
+    int frameWidth, frameHeight;
+    std::chrono::steady_clock::time_point reportStart;
+
+    std::thread thread;
+    std::atomic<bool> running;
+    int listenSocket;
+    int wakePipe[2];         // Written when frames are queued, so the network thread sends them
+    std::string socketPath;  // Unix socket file to remove on stop
+
+    void serve();
+    void receiveFrom(Client& client);
+    void sendTo(Client& client);
+    void drop(Client& client);
+};
+
+// The other end, for clients and tests: blocking connect, then camera updates out and frames in
+class RenderClient
+{
+public:
+    RenderClient();
+    ~RenderClient();
+    RenderClient(const RenderClient&) = delete;
+    RenderClient& operator=(const RenderClient&) = delete;
+
+    bool connect(const std::string& address);
+    void disconnect();
+    bool connected() const { return connection >= 0; }
+
+    bool send(const CameraUpdate& update);
+    // The next frame within timeoutMs: true with header and image filled; false on timeout or a
+    // closed connection (connected() tells which)
+    bool receive(FrameHeader& header, std::vector<uint8_t>& qoi, int timeoutMs);
+
+private:
+    int connection;
+    std::vector<uint8_t> buffer;  // Received, not yet returned
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef RENDERER_METRICS_H
+#define RENDERER_METRICS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "render_queue.h"
+
+class AssetRegistry;
+class Campus;
+
+// The viewer's counters in a MetricsRegistry: frame times, draws and state changes every frame,
+// memory and upload totals on a slower cadence (they take the asset registry's lock). All series
+// are registered up front, except per-asset GPU memory, which appears as assets load.
+class RendererMetrics
+{
+public:
+    explicit RendererMetrics(MetricsRegistry& registry);
+
+    // After the frame's draws: its CPU frame time and the render queue's counts (for the
+    // GPU-driven path, only the indirect command count is known on the CPU)
+    void frame(double seconds, const RenderStats& stats);
+    void gpuFrame(double seconds, size_t commands);
+
+    // Memory, upload totals and finished shader compiles; about once a second
+    void sample(AssetRegistry& assets, Campus& campus);
+
+private:
+    MetricsRegistry& registry;
+    Metric* frames;
+    Metric* frameSeconds;
+    Metric* drawCalls;
+    Metric* triangles;
+    Metric* programBinds;
+    Metric* vaoBinds;
+    Metric* uniformUploads;
+    Metric* textureBinds;
+    Metric* textureUploadBytes;
+    Metric* geometryUploadBytes;
+    Metric* textureResidentBytes;
+    Metric* campusResidentBytes;
+    Metric* processResidentBytes;
+    Metric* compileSeconds;
+    struct AssetSeries
+    {
+        Metric* metric;
+        unsigned int sampled;  // Last sample() that saw the asset
+    };
+    std::map<std::string, AssetSeries> assetBytes;  // By asset path
+    unsigned int samples;
+
+    std::vector<std::pair<std::string, size_t> > assetScratch;
+    std::vector<double> compileScratch;
+
+    void countFrame(double seconds, unsigned int draws);
+};
+
+#endif
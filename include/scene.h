@@ -0,0 +1,129 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "render_queue.h"
+
+// Room shell dimensions (in meters) and the materials of its surfaces
+struct RoomShell
+{
+    float width, length, height, wallThickness;
+    uint16_t floorMaterial, ceilingMaterial, wallMaterial;
+
+    RoomShell() : width(12.0f), length(8.0f), height(3.5f), wallThickness(0.2f),
+                  floorMaterial(0), ceilingMaterial(0), wallMaterial(0) {}
+};
+
+// The ceiling is built from square tiles; rooms needing more than MAX_CEILING_TILES are rejected
+// at load, since every tile is a quad of the room's geometry
+const float CEILING_TILE_SIZE = 0.5f;
+const int MAX_CEILING_TILES = 65536;
+
+// Procedural stand-in drawn when a model's OBJ file cannot be loaded
+enum FallbackKind
+{
+    FALLBACK_NONE = 0,
+    FALLBACK_BOX = 1,    // Box of fallbackSize standing on the instance origin
+    FALLBACK_BENCH = 2   // Built-in bench with seat, backrest, legs and beams
+};
+
+struct SceneModel
+{
+    std::string name;
+    std::string path;
+    uint32_t fallback;
+    glm::vec3 fallbackSize;
+    // OBJ group (o/g name) turned by the instance's spin in the vertex shader; the rest of the
+    // model stays put. Empty: spinning instances turn as a whole.
+    std::string spinGroup;
+    // Seating furniture: seatCount places spaced seatSpacing metres apart across the instance,
+    // seatOffset metres behind its origin (see sceneSeatPoses)
+    uint32_t seatCount;
+    float seatSpacing, seatOffset;
+};
+
+// Static axis-aligned boxes (doors, boards, light fixtures) stored as flat arrays
+struct SceneBoxes
+{
+    std::vector<uint16_t> material;
+    std::vector<uint8_t> emissive;  // 1 for light fixtures drawn with the light shader
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> sizeX, sizeY, sizeZ;
+
+    size_t size() const { return material.size(); }
+    void push(uint16_t mat, bool light, const glm::vec3& center, const glm::vec3& dims);
+};
+
+// Model instances as structure-of-arrays, sorted by model so each model's instances are contiguous
+struct SceneInstances
+{
+    std::vector<uint16_t> model;
+    std::vector<uint16_t> material;
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> yaw;    // Degrees around Y
+    std::vector<float> scale;  // Uniform scale
+    std::vector<float> spin;   // Degrees per second around Y, 0 for static instances
+
+    size_t size() const { return model.size(); }
+    void push(uint16_t mdl, uint16_t mat, const glm::vec3& pos, float yawDeg, float s, float spinDeg);
+    void sortByModel();
+};
+
+// Contiguous run of instances sharing one model
+struct InstanceRange
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+struct Scene
+{
+    RoomShell room;
+    std::vector<std::string> materialNames;
+    std::vector<Material> materials;
+    std::vector<std::string> materialTextures;  // Diffuse map path per material, empty for none
+    std::vector<SceneModel> models;
+    SceneBoxes boxes;
+    SceneInstances instances;
+    std::vector<InstanceRange> modelRanges;  // Indexed by model
+
+    // Point light and initial camera
+    glm::vec3 lightPosition, lightColor;
+    glm::vec3 cameraPosition;
+    float cameraYaw, cameraPitch;
+
+    // Size and content hash of the text the scene was read from (0 for none), kept in the
+    // compiled form to tell a stale copy from a current one
+    uint64_t sourceSize, sourceHash;
+
+    Scene();
+    void clear();
+    void buildModelRanges();
+};
+
+// Text form, for authoring. One directive per line, '#' starts a comment:
+//   room <width> <length> <height> <wallThickness>
+//   material <name> <ambient rgb> <diffuse rgb> <specular rgb> <shininess>
+//   texture <material> <.dds or .ktx2 path>
+//   shell <floor|ceiling|walls> <material>
+//   model <name> <obj path> [fallback box <sx> <sy> <sz> | fallback bench] [spin <obj group>]
+//         [seats <count> <spacing> <offset>]
+//   box <material> <cx> <cy> <cz> <sx> <sy> <sz>
+//   fixture <cx> <cy> <cz> <sx> <sy> <sz>
+//   instance <model> <material> <x> <y> <z> <yaw> <scale> [spin]
+//   light <x> <y> <z> <r> <g> <b>
+//   camera <x> <y> <z> <yaw> <pitch>
+bool loadSceneText(const std::string& path, Scene& scene);
+
+// Compiled binary form, for fast loading
+bool saveSceneBinary(const std::string& path, const Scene& scene);
+bool loadSceneBinary(const std::string& path, Scene& scene);
+
+// Load a scene by path. For a text scene, the compiled "<path>b" file is used when it is not
+// older and was compiled from the same text (size and hash), and is written after parsing otherwise.
+bool loadScene(const std::string& path, Scene& scene);
+
+#endif
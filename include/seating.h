@@ -0,0 +1,26 @@
+#ifndef SEATING_H
+#define SEATING_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include "scene.h"
+
+// A named camera, in the terms of Camera (degrees)
+struct ViewPose
+{
+    std::string name;
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+// Eye of every seat of a room placed at origin: instances of models with seats (see
+// SceneModel), looking the way the furniture faces, named <prefix><model><instance>_s<seat>
+void sceneSeatPoses(const Scene& scene, const glm::vec3& origin, const std::string& prefix,
+                    std::vector<ViewPose>& poses);
+
+// Pose file, one per line, '#' starts a comment:
+//   pose <name> <x> <y> <z> <yaw> <pitch>
+bool loadViewPoses(const std::string& path, std::vector<ViewPose>& poses);
+
+#endif
@@ -9,65 +9,240 @@
 #include <sstream>
 #include <iostream>
 
+// Optional features compiled into a program variant as #defines (see Shader::withFeatures)
+enum ShaderFeature
+{
+    FEATURE_EMISSIVE = 1 << 0,  // unlit, plain white output (light fixtures)
+    FEATURE_SPECULAR = 1 << 1,  // Phong specular term
+    FEATURE_INDIRECT = 1 << 2,  // GPU-driven draws: matrices and materials from storage buffers (GLSL 4.30)
+    FEATURE_TEXTURED = 1 << 3,  // diffuse map from a texture array layer
+    FEATURE_LIGHTMAP = 1 << 4,  // baked diffuse lighting from a lightmap (second UV channel)
+    FEATURE_ANIMATED = 1 << 5,  // sub-mesh spun in the vertex shader; instanced placement unless INDIRECT
+    FEATURE_MULTIVIEW = 1 << 6, // every draw instanced once per view of MultiViewBlock (see MultiView)
+    FEATURE_LAYERED = 1 << 7,   // with MULTIVIEW: view i to layer i (gl_Layer) instead of column i
+    FEATURE_DEBUG_VIEW = 1 << 8, // heatmap values instead of colour (see DebugView)
+    FEATURE_INSTANCED = 1 << 9, // static instanced draws: placement and lightmap rect per instance
+    SHADER_FEATURE_COUNT = 10
+};
+
+// Uniform buffer binding point of the shaders' ViewBlock (see ViewUniforms)
+const unsigned int VIEW_UNIFORM_BINDING = 0;
+// ... and of MultiViewBlock (see MultiView)
+const unsigned int MULTIVIEW_UNIFORM_BINDING = 1;
+
 class Shader
 {
 public:
     unsigned int ID;
     
+    // empty shader; call compile() before use
+    Shader() : ID(0) {}
+
     // constructor generates the shader on the fly
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath) : ID(0)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        readFile(vertexPath, vertexCode);
+        readFile(fragmentPath, fragmentCode);
+        // 2. compile shaders
+        compile(vertexCode, fragmentCode);
+    }
+
+    ~Shader()
+    {
+        if (ID != 0) glDeleteProgram(ID);
+    }
+
+    // Owns a GL program, so copies would delete it twice
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    // read a whole source file; prints and returns false on failure
+    static bool readFile(const char* path, std::string& code)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
+            // open file and read its buffer contents into a stream
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
             // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            code = shaderStream.str();
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << ": " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // #define name of a feature bit index, e.g. "EMISSIVE"
+    static const char* featureName(unsigned int bit)
+    {
+        static const char* names[SHADER_FEATURE_COUNT] = { "EMISSIVE", "SPECULAR", "INDIRECT", "TEXTURED", "LIGHTMAP", "ANIMATED",
+                                                           "MULTIVIEW", "LAYERED", "DEBUG_VIEW", "INSTANCED" };
+        return bit < SHADER_FEATURE_COUNT ? names[bit] : "";
+    }
+
+    // feature bit for a #define name; 0 when unknown
+    static unsigned int featureFromName(const std::string& name)
+    {
+        for (unsigned int bit = 0; bit < SHADER_FEATURE_COUNT; bit++)
+        {
+            if (name == featureName(bit))
+                return 1u << bit;
         }
+        return 0;
+    }
+
+    // #version line a feature combination needs, or NULL when the source's own one will do
+    static const char* featureVersion(unsigned int features)
+    {
+        return (features & FEATURE_INDIRECT) ? "#version 430 core" : NULL;
+    }
+
+    // inject one #define per enabled feature right after the #version line, raising the
+    // version when a feature needs a newer GLSL
+    static std::string withFeatures(const std::string& code, unsigned int features)
+    {
+        if (features == 0)
+            return code;
+        std::string defines;
+        for (unsigned int bit = 0; bit < SHADER_FEATURE_COUNT; bit++)
+        {
+            if (features & (1u << bit))
+                defines += std::string("#define ") + featureName(bit) + "\n";
+        }
+        const char* version = featureVersion(features);
+        size_t insertAt = 0;
+        if (code.compare(0, 8, "#version") == 0)
+        {
+            size_t eol = code.find('\n');
+            if (eol == std::string::npos)
+                return (version ? std::string(version) : code) + "\n" + defines;
+            insertAt = eol + 1;
+        }
+        std::string header = version ? std::string(version) + "\n" : code.substr(0, insertAt);
+        return header + defines + code.substr(insertAt);
+    }
+
+    // A program whose link has been started but not yet checked; see beginCompile()
+    struct PendingProgram
+    {
+        unsigned int program, vertex, fragment;
+        PendingProgram() : program(0), vertex(0), fragment(0) {}
+    };
+
+    // let the driver compile and link on its own threads (KHR/ARB_parallel_shader_compile);
+    // returns false when neither extension is available
+    static bool enableParallelCompile()
+    {
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else if (GLEW_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        else
+            return false;
+        return true;
+    }
+
+    // submit compile and link without waiting for the result. With parallel compile enabled the
+    // driver works in the background until linkComplete() returns true.
+    static PendingProgram beginCompile(const std::string& vertexCode, const std::string& fragmentCode,
+                                       bool retrievable = false)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        PendingProgram pending;
         // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(pending.vertex);
         // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(pending.fragment);
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        pending.program = glCreateProgram();
+        glAttachShader(pending.program, pending.vertex);
+        glAttachShader(pending.program, pending.fragment);
+        // needed for glGetProgramBinary on some drivers
+        if (retrievable && GLEW_ARB_get_program_binary)
+            glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(pending.program);
+        return pending;
+    }
+
+    // non-blocking poll; always true without parallel compile (the check then blocks instead)
+    static bool linkComplete(const PendingProgram& pending)
+    {
+        if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // check a pending program and take it over if it linked. The previous program (if any) is
+    // replaced only on success, so a broken edit never takes a working shader down.
+    bool finishCompile(PendingProgram& pending)
+    {
+        checkCompileErrors(pending.vertex, "VERTEX");
+        checkCompileErrors(pending.fragment, "FRAGMENT");
+        bool linked = checkCompileErrors(pending.program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+
+        if (!linked)
+        {
+            glDeleteProgram(pending.program);
+            pending = PendingProgram();
+            return false;
+        }
+        adopt(pending.program);
+        pending = PendingProgram();
+        return true;
+    }
+
+    // drop a pending program without using it
+    static void cancelCompile(PendingProgram& pending)
+    {
+        if (pending.program == 0)
+            return;
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glDeleteProgram(pending.program);
+        pending = PendingProgram();
+    }
+
+    // compile and link a program from source, blocking until done
+    bool compile(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        PendingProgram pending = beginCompile(vertexCode, fragmentCode);
+        return finishCompile(pending);
+    }
+
+    // take ownership of an already linked program (e.g. one restored from a program binary)
+    void adopt(unsigned int program)
+    {
+        if (ID != 0)
+            glDeleteProgram(ID);
+        ID = program;
+        // camera matrices come from the shared view buffer
+        unsigned int viewBlock = glGetUniformBlockIndex(ID, "ViewBlock");
+        if (viewBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, viewBlock, VIEW_UNIFORM_BINDING);
+        unsigned int multiViewBlock = glGetUniformBlockIndex(ID, "MultiViewBlock");
+        if (multiViewBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, multiViewBlock, MULTIVIEW_UNIFORM_BINDING);
     }
     
     // activate the shader
@@ -136,7 +311,7 @@ public:
 
 private:
     // utility function for checking shader compilation/linking errors.
-    void checkCompileErrors(unsigned int shader, std::string type)
+    static bool checkCompileErrors(unsigned int shader, std::string type)
     {
         int success;
         char infoLog[1024];
@@ -158,6 +333,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
\ No newline at end of file
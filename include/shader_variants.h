@@ -0,0 +1,56 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "shader.h"
+#include "asset_registry.h"
+
+// Permutations of one vertex/fragment pair, keyed by ShaderFeature bits. A variant is compiled
+// the first time a draw asks for it; precompile() builds the ones listed in a manifest up front
+// so the first frame that needs them does not stall.
+//
+// Manifest format, one directive per line, '#' starts a comment:
+//   variant <vertex path> <fragment path> [FEATURE ...]
+// Lines naming other shader files are ignored, so several tables can share one manifest.
+class ShaderVariants
+{
+public:
+    ShaderVariants(AssetRegistry& registry, const std::string& vertexPath, const std::string& fragmentPath);
+    ~ShaderVariants();
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // Program for a feature combination (plus the required ones), compiled on first use
+    Shader& get(unsigned int features);
+
+    // Features added to every variant handed out from now on, e.g. MULTIVIEW while the frame
+    // is drawn for several views
+    void require(unsigned int features) { required = features; }
+    unsigned int requiredFeatures() const { return required; }
+
+    // Compile the manifest's variants of this pair; false on a malformed manifest
+    bool precompile(const std::string& manifestPath);
+
+    // Every variant compiled so far, for per-frame uniforms
+    void compiled(std::vector<Shader*>& shaders) const;
+
+    const std::string& vertexPath() const { return vertex; }
+    const std::string& fragmentPath() const { return fragment; }
+
+private:
+    struct Variant
+    {
+        ShaderHandle handle;
+        Shader* shader;  // Valid while the handle is held
+    };
+
+    AssetRegistry& assets;
+    std::string vertex, fragment;
+    std::map<unsigned int, Variant> variants;
+    unsigned int required;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SIGHTLINES_H
+#define SIGHTLINES_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "classroom.h"
+#include "seating.h"
+
+struct SightlineSettings
+{
+    std::string targetMaterial;  // Boxes of this material are what the seats should see
+    float samplesPerMeter;       // Ray density across each target's face
+    unsigned int threads;        // 0: one per hardware thread
+
+    SightlineSettings() : targetMaterial("board"), samplesPerMeter(16.0f), threads(0) {}
+};
+
+// What one seat sees of the targets (the green boards)
+struct SeatSightline
+{
+    ViewPose seat;
+    float visible;               // Fraction of the targets' area in unobstructed view
+    std::vector<float> targets;  // ... of each target, in scene box order
+    float distance;   // Eye to the centre of the targets, meters
+    float angle;      // Off the targets' facing, degrees (0 is straight on)
+    float elevation;  // Of that centre above eye level, degrees
+    float span;       // Horizontal angle the targets cover, degrees
+};
+
+struct SightlineStats
+{
+    size_t seats, targets;
+    size_t triangles;  // Occluders in the BVH
+    size_t rays;
+    double seconds;
+
+    SightlineStats() : seats(0), targets(0), triangles(0), rays(0), seconds(0.0) {}
+};
+
+// Sightlines from every seat of a room (see sceneSeatPoses) to the front faces of its target
+// boxes: a grid of rays per target face from each seat's eye, traced against a BVH of the
+// room's static geometry, every instance (spinning ones in their rest pose) and the other
+// boxes. Seats are shared out to worker threads. Needs a room after buildGeometry(), no GL.
+bool analyzeSightlines(const Classroom& room, const SightlineSettings& settings, std::vector<SeatSightline>& seats,
+                       SightlineStats& stats);
+
+// One row per seat: name, eye position, visible fraction overall and per target, then distance,
+// angle, elevation and span
+bool writeSightlineCsv(const std::string& path, const std::vector<SeatSightline>& seats);
+
+// Floor plan (binary PPM, -Z at the top): boxes in grey, targets in white, each seat a disc
+// from red (nothing visible) through yellow to green (everything)
+bool writeSightlineHeatmap(const std::string& path, const Scene& scene, const std::string& targetMaterial,
+                           const std::vector<SeatSightline>& seats, float pixelsPerMeter);
+
+#endif
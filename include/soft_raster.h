@@ -0,0 +1,225 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+#include "scene.h"
+#include "lightmap.h"
+
+// Edge-function kernels; the best one the CPU supports is picked at startup
+enum RasterPath
+{
+    RASTER_SCALAR,
+    RASTER_AVX2   // 8 pixels of a block row per iteration
+};
+
+// Light of the frame, as Campus::setFrameUniforms hands it to the shaders
+struct SoftwareLight
+{
+    glm::vec3 position;
+    glm::vec3 ambient, diffuse, specular;
+
+    SoftwareLight() : position(0.0f), ambient(0.0f), diffuse(0.0f), specular(0.0f) {}
+};
+
+// One draw of non-indexed 8-float vertices (position, normal, uv), the buffers the GL path
+// uploads. Pointers must stay valid until SoftwareRasterizer::end().
+struct SoftwareDraw
+{
+    const float* vertices;
+    size_t count;
+    glm::mat4 model;
+    const Material* material;      // NULL: unlit white (light fixtures)
+    // Baked lighting (LIGHTMAP variant): per-vertex chart UVs placed in the atlas by the rect
+    const float* lightmapUVs;
+    glm::vec4 lightmapRect;
+    const LightmapImage* lightmap;
+    // Spinning sub-mesh (ANIMATED variant): vertices [spinFirst, spinFirst + spinCount) turn
+    // about the model's Y axis at spin degrees per second
+    float spin;
+    size_t spinFirst, spinCount;
+
+    SoftwareDraw() : vertices(NULL), count(0), model(1.0f), material(NULL), lightmapUVs(NULL), lightmapRect(0.0f),
+                     lightmap(NULL), spin(0.0f), spinFirst(0), spinCount(0) {}
+};
+
+struct SoftwareRasterStats
+{
+    size_t draws, triangles;   // Submitted
+    size_t setupTriangles;     // Left after frustum rejection and near/guard-band clipping
+    size_t binnedTriangles;    // Triangle-tile pairs
+    size_t blocks;             // 8x8 blocks an edge test could not reject
+    size_t hizRejected;        // ... of which the hierarchical depth buffer rejected
+    size_t shadedPixels;
+    double geometryMs, rasterMs;
+
+    SoftwareRasterStats() : draws(0), triangles(0), setupTriangles(0), binnedTriangles(0), blocks(0),
+                            hizRejected(0), shadedPixels(0), geometryMs(0.0), rasterMs(0.0) {}
+};
+
+// CPU renderer for machines without a GPU, producing the image the GL shaders would. Draws
+// are collected between begin() and end(); end() transforms and clips them in parallel chunks,
+// bins the triangles into 64x64 tiles (keeping submission order) and has every thread take
+// whole tiles: coverage and depth (GL_LESS) in 8x8 blocks against a per-block maximum depth,
+// then Phong (or baked lighting) shading once per visible pixel. Diffuse textures are not
+// sampled (albedo 1).
+class SoftwareRasterizer
+{
+public:
+    static const int TILE_SIZE = 64;
+    static const int BLOCK_SIZE = 8;
+
+    SoftwareRasterStats lastStats;
+
+    // threads: 0 for one per core
+    explicit SoftwareRasterizer(unsigned int threads = 0);
+    ~SoftwareRasterizer();
+
+    // Owns worker threads
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+    void resize(int width, int height);
+    int width() const { return viewWidth; }
+    int height() const { return viewHeight; }
+    unsigned int threadCount() const { return (unsigned int)workers.size() + 1; }
+
+    // Start a frame: camera, light and animation clock of the shaders, colour to clear to
+    void begin(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPosition,
+               const SoftwareLight& light, float time, const glm::vec3& clearColor);
+    void draw(const SoftwareDraw& draw);
+    // Render everything drawn since begin()
+    void end();
+
+    // RGBA8, bottom row first (the glReadPixels layout)
+    const std::vector<uint8_t>& pixels() const { return color; }
+
+    void report(std::ostream& out) const;
+
+    static RasterPath path();
+    // Force a path (tests); falls back to the best supported one if the CPU lacks it
+    static void setPath(RasterPath path);
+    static const char* pathName(RasterPath path);
+
+private:
+    friend struct SoftwareShading;  // Per-pixel kernels (soft_raster.cpp)
+
+    // Clipped, set-up triangle in window coordinates (pixel centres at +0.5): edge functions
+    // a*x + b*y + c (positive inside, counter-clockwise), the screen-space depth plane, and what
+    // shading interpolates perspective-correctly
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float edgeBias[3];   // Inside when a*x + b*y + c > bias: the top-left fill rule
+        float depthA, depthB, depthC;
+        float minDepth;
+        float inverseArea;
+        int minX, minY, maxX, maxY;
+        uint32_t draw;
+        float inverseW[3];
+        glm::vec3 position[3];  // World space
+        glm::vec3 normal[3];
+        glm::vec2 lightmapUV[3];
+    };
+
+    // Consecutive triangles of one draw, transformed by one job; its triangles and per-tile
+    // lists keep their capacity between frames
+    struct Chunk
+    {
+        uint32_t draw;
+        size_t first, count;  // Triangles of the draw
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint16_t> > bins;
+    };
+
+    // Shading constants of a draw for this frame's light
+    struct DrawState
+    {
+        glm::mat3 normalMatrix;
+        glm::vec3 ambientTerm, diffuseTerm, specularTerm;  // Light times material
+        glm::vec3 materialDiffuse;
+        bool specular;
+        float shininess;
+        int exponent;               // Shininess when a whole number, else -1
+        const glm::vec3* lightmap;  // Decoded atlas; NULL when unbaked
+        unsigned int lightmapWidth, lightmapHeight;
+    };
+
+    struct DecodedLightmap
+    {
+        uint64_t layoutHash;
+        unsigned int width, height;
+        std::vector<glm::vec3> texels;
+        unsigned int frame;  // Last frame drawn, dropped when stale
+    };
+
+    int viewWidth, viewHeight;
+    int tilesX, tilesY;
+    int bufferWidth, bufferHeight;  // Padded to whole tiles
+    std::vector<uint8_t> color;
+    std::vector<float> depth;        // Window depth, padded rows
+    std::vector<uint32_t> visible;   // Triangle covering each pixel: chunk << 16 | index
+    std::vector<float> blockMaxDepth;
+
+    glm::mat4 viewProjection;
+    glm::vec3 eye;
+    SoftwareLight frameLight;
+    float frameTime;
+    glm::vec3 background;
+    std::vector<SoftwareDraw> draws;
+    std::vector<DrawState> drawStates;
+    std::vector<Chunk> chunks;
+    size_t chunkCount;
+    std::vector<std::pair<const LightmapImage*, DecodedLightmap> > lightmaps;
+    unsigned int frameNumber;
+
+    // Worker pool: run() hands out items from an atomic counter to the workers and the caller
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::function<void(size_t, unsigned int)> job;
+    size_t jobItems;
+    std::atomic<size_t> nextItem;
+    unsigned int generation, busy;
+    bool quit;
+    std::vector<SoftwareRasterStats> threadStats;
+
+    void run(size_t items, const std::function<void(size_t, unsigned int)>& work);
+    void workerLoop(unsigned int index);
+    void work(unsigned int thread);
+
+    const glm::vec3* decodeLightmap(const LightmapImage* image);
+    void processChunk(Chunk& chunk, SoftwareRasterStats& stats);
+    void clipTriangle(Chunk& chunk, const float (*vertex)[12], SoftwareRasterStats& stats);
+    void setupTriangle(Chunk& chunk, const float* v0, const float* v1, const float* v2, SoftwareRasterStats& stats);
+    static bool edgesReach(const Triangle& triangle, int x0, int y0, int size);
+    void rasterTile(int tile, SoftwareRasterStats& stats);
+    void shadeTile(int tile, SoftwareRasterStats& stats);
+};
+
+// Shows the rasterizer's image in the bound draw framebuffer: a texture upload and a blit. The
+// texture follows the image's size; GL objects are made on the first present.
+class SoftwarePresenter
+{
+public:
+    SoftwarePresenter();
+    ~SoftwarePresenter();
+    SoftwarePresenter(const SoftwarePresenter&) = delete;
+    SoftwarePresenter& operator=(const SoftwarePresenter&) = delete;
+
+    void present(const SoftwareRasterizer& raster);
+
+private:
+    unsigned int texture, framebuffer;
+    int textureWidth, textureHeight;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Largest width or height a texture file may declare, the GL 4.x minimum for GL_MAX_TEXTURE_SIZE;
+// headers beyond it are rejected before their level sizes are computed
+const unsigned int MAX_TEXTURE_DIMENSION = 16384;
+
+// One mip level inside a texture file
+struct TextureLevel
+{
+    unsigned int width, height;
+    uint64_t offset;  // Byte offset in the file
+    size_t size;
+};
+
+// Header of a DDS or KTX2 texture: the GL format and where each mip level lives in the file, so
+// levels can be read one at a time and the fine ones streamed in later
+struct TextureFile
+{
+    std::string path;
+    GLenum internalFormat;  // Compressed GL format, or GL_RGBA8 / GL_SRGB8_ALPHA8
+    bool compressed;
+    unsigned int width, height;
+    std::vector<TextureLevel> levels;  // levels[0] is the full resolution
+
+    TextureFile() : internalFormat(0), compressed(false), width(0), height(0) {}
+    size_t bytes() const;
+};
+
+// Parse a .dds (legacy FourCC or DX10 header) or .ktx2 (no supercompression) file. BC1-BC5,
+// BC7 and RGBA8 are supported; cube maps, arrays and volumes are not.
+bool readTextureHeader(const std::string& path, TextureFile& file);
+
+// Read the data of one mip level
+bool readTextureLevel(const TextureFile& file, size_t level, std::vector<unsigned char>& data);
+
+// Whether the current context can sample the format (S3TC and BPTC are extensions on GL 3.3)
+bool textureFormatSupported(GLenum internalFormat);
+const char* textureFormatName(GLenum internalFormat);
+
+// Bytes of one level of a format
+size_t textureLevelSize(GLenum internalFormat, unsigned int width, unsigned int height);
+
+// Write a grey BC1 checkerboard with a full mip chain, as .dds or .ktx2 by extension; size is a
+// power of two from 4 to MAX_TEXTURE_DIMENSION. Test and placeholder content; real textures come
+// from an offline compressor.
+bool writeCheckerTexture(const std::string& path, unsigned int size, unsigned int tiles);
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "texture_file.h"
+
+// A texture as a layer of one of the streamer's texture arrays
+struct TextureRef
+{
+    int pool;
+    int layer;
+
+    TextureRef() : pool(-1), layer(-1) {}
+    bool valid() const { return pool >= 0; }
+};
+
+struct TextureStats
+{
+    unsigned int levelsStreamed;
+    unsigned int levelsEvicted;
+    unsigned int ringStalls;   // Uploads deferred because the PBO they needed was still in use
+    size_t bytesStreamed;
+
+    TextureStats() : levelsStreamed(0), levelsEvicted(0), ringStalls(0), bytesStreamed(0) {}
+};
+
+// Material textures, packed into GL_TEXTURE_2D_ARRAY pools by format, size and mip count so a
+// whole room binds one texture (and the GPU-driven path a handful) instead of one per draw.
+//
+// acquire() uploads the small mips (the tail) at once. Finer levels are read from disk on a worker
+// thread and uploaded through a ring of pixel unpack buffers, a slice per frame, while the pool's
+// base level keeps sampling to the levels every layer has. Levels are shared by all layers of a
+// pool, so residency is per pool: when the arrays exceed memoryBudget, the finest level of the
+// largest pool is dropped, and it is streamed back once it fits again.
+//
+// Everything but the disk reads runs on the GL thread.
+class TextureStreamer
+{
+public:
+    size_t memoryBudget;         // GPU bytes of all texture arrays
+    size_t uploadBytesPerFrame;  // Streaming upload slice
+    TextureStats stats;
+
+    TextureStreamer();
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Reference counted by path; invalid when the file cannot be used
+    TextureRef acquire(const std::string& path);
+    void release(const TextureRef& ref);
+
+    // Per frame: upload finished reads, request the next levels, enforce the budget
+    void update();
+
+    // GL texture array of a pool
+    unsigned int texture(const TextureRef& ref) const;
+
+    size_t residentBytes() const;
+    void report(std::ostream& out) const;
+
+private:
+    // Layers per texture array; a full pool starts a new one
+    static const int POOL_LAYERS = 16;
+
+    struct Layer
+    {
+        std::string path;
+        TextureFile file;
+        int refs;
+        unsigned int serial;          // Identifies this occupant to reads in flight
+        std::vector<bool> uploaded;   // Per level
+    };
+
+    struct Pool
+    {
+        unsigned int texture;
+        GLenum format;
+        unsigned int width, height, levelCount;
+        unsigned int tail;            // First level uploaded at acquire()
+        unsigned int base;            // Finest level every live layer has; GL_TEXTURE_BASE_LEVEL
+        std::vector<bool> allocated;  // Per level, storage for all layers
+        std::vector<Layer> layers;
+        unsigned int readsInFlight;
+    };
+
+    struct Read
+    {
+        int pool, layer;
+        unsigned int serial, level;
+        TextureFile file;
+        std::vector<unsigned char> data;
+        bool ok;
+    };
+
+    // Pixel unpack buffers, reused once their fence has passed
+    struct RingSlot
+    {
+        unsigned int buffer;
+        size_t size;
+        GLsync fence;
+    };
+
+    std::vector<Pool> pools;
+    unsigned int nextSerial;
+    RingSlot ring[3];
+    size_t ringNext;
+
+    // Reader thread
+    std::thread reader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Read> requests;
+    std::deque<Read> finished;
+    bool quit;
+
+    std::deque<Read> ready;  // Read, waiting for upload (GL thread only)
+
+    void readerLoop();
+    int findPool(const TextureFile& file);
+    void allocateLevel(Pool& pool, unsigned int level);
+    void freeLevel(Pool& pool, unsigned int level);
+    void uploadLevel(Pool& pool, int layer, unsigned int level, const unsigned char* data, size_t size);
+    bool uploadThroughRing(Pool& pool, int layer, unsigned int level, const std::vector<unsigned char>& data);
+    void updateBase(Pool& pool);
+    size_t levelBytes(const Pool& pool, unsigned int level) const;
+    size_t poolBytes(const Pool& pool) const;
+    void requestLevel(size_t poolIndex, unsigned int level);
+    void enforceBudget();
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef THUMBNAIL_BATCH_H
+#define THUMBNAIL_BATCH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <deque>
+#include <string>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "multi_view.h"
+#include "campus.h"
+#include "seating.h"
+
+// Eye of every seat of every cell (see sceneSeatPoses), named <cell>_<model><instance>_s<seat>
+void campusSeatPoses(const Campus& campus, std::vector<ViewPose>& poses);
+
+// QOI image (qoiformat.org) of RGBA8 pixels, top row first; written as RGB
+void encodeQoi(const uint8_t* pixels, unsigned int width, unsigned int height, std::vector<uint8_t>& out);
+
+struct ThumbnailStats
+{
+    size_t views, passes;
+    size_t bytesRead, bytesWritten;
+    double renderMs;    // Submitting passes (beginPass to endPass)
+    double readbackMs;  // Waiting on fences and copying mapped buffers out
+    double encodeMs;    // Writer threads, summed
+    double totalMs;     // First beginPass to finish()
+    unsigned int ringStalls;    // Passes that found their readback buffer still in flight
+    unsigned int queueStalls;   // Readbacks that waited for the writers
+    unsigned int failedWrites;
+
+    ThumbnailStats() : views(0), passes(0), bytesRead(0), bytesWritten(0), renderMs(0.0), readbackMs(0.0),
+                       encodeMs(0.0), totalMs(0.0), ringStalls(0), queueStalls(0), failedWrites(0) {}
+};
+
+// Where a batch delivers its views instead of files (see RenderServer); called on the writer
+// threads, so implementations lock what they share
+class ThumbnailSink
+{
+public:
+    virtual ~ThumbnailSink() {}
+    // name: the pose's; qoi: the encoded view, which the sink may keep (swap out)
+    virtual void thumbnail(const std::string& name, std::vector<uint8_t>& qoi) = 0;
+};
+
+// Offline renderer of many camera poses (seat views of a campus) into image files. Each pass
+// draws up to viewsPerPass poses with MultiView into a layered target (or one wide split
+// target), then reads it back asynchronously into a ring of pixel pack buffers; a pass's
+// pixels are collected when its buffer comes round again (or by poll()), so the GPU keeps
+// rendering while earlier passes are copied out, and a pool of writer threads encodes and saves
+// them, or hands them to a sink.
+//
+//   batch.beginPass(poses, n);  // then submit and flush the render queue
+//   batch.endPass();
+//   ...
+//   batch.finish();
+class ThumbnailBatch
+{
+public:
+    static const unsigned int RING_SIZE = 3;
+
+    ThumbnailStats stats;
+
+    ThumbnailBatch();
+    ~ThumbnailBatch();
+
+    // Owns GL objects and writer threads
+    ThumbnailBatch(const ThumbnailBatch&) = delete;
+    ThumbnailBatch& operator=(const ThumbnailBatch&) = delete;
+
+    // width x height per view, 2 to MultiView::MAX_VIEWS views per pass; creates the directory
+    bool initialize(const std::string& directory, int width, int height, unsigned int viewsPerPass,
+                    MultiViewMode mode, unsigned int writers);
+    // ... handing every view to sink instead of writing <directory>/<name>.qoi
+    bool initialize(ThumbnailSink* sink, int width, int height, unsigned int viewsPerPass, MultiViewMode mode,
+                    unsigned int writers);
+
+    unsigned int viewsPerPass() const { return multiView.viewCount(); }
+    MultiViewMode mode() const { return multiView.mode(); }
+    unsigned int shaderFeatures() const { return multiView.shaderFeatures(); }
+    unsigned int writerCount() const { return (unsigned int)writers.size(); }
+
+    // Direct the draws of a pass at count (1 to viewsPerPass) poses; spare views repeat the last
+    void beginPass(const ViewPose* poses, unsigned int count);
+    // Start the readback of the pass
+    void endPass();
+    // Collect the passes whose readback has finished, oldest first, without waiting (so views
+    // leave as soon as they are ready rather than when their buffer comes round again)
+    void poll();
+    // Collect every pass in flight and wait for the writers
+    void finish();
+
+    // Draw poses, as many views per pass as it takes. Poses are taken in order, a pass never
+    // spans two cells, and the cells around each pass are loaded before it is drawn.
+    void draw(Campus& campus, AssetRegistry& assets, ShaderVariants& shaders, RenderQueue& queue,
+              const std::vector<ViewPose>& poses);
+
+    void report(std::ostream& out) const;
+
+private:
+    // A pass being read back into a pixel pack buffer
+    struct Slot
+    {
+        unsigned int buffer;
+        size_t size;
+        GLsync fence;
+        std::vector<std::string> names;  // Views to write, in layer (column) order
+    };
+
+    struct Job
+    {
+        std::string path;
+        std::vector<uint8_t> pixels;  // RGBA8, top row first
+    };
+
+    MultiView multiView;
+    std::string directory;
+    ThumbnailSink* sink;
+    int viewWidth, viewHeight;
+    // Split mode: every view in a column of one wide target
+    unsigned int splitFramebuffer, splitColor, splitDepth;
+    int previousFramebuffer;
+    Slot ring[RING_SIZE];
+    unsigned int ringNext;
+    std::vector<std::string> passNames;
+    std::chrono::steady_clock::time_point passStart, batchStart;
+    bool started;
+
+    // Writer pool; the queue is bounded so readback cannot run ahead of the disk
+    std::vector<std::thread> writers;
+    std::mutex mutex;
+    std::condition_variable wake, space, idle;
+    std::deque<Job> jobs;
+    size_t maxJobs;
+    unsigned int busy;
+    bool quit;
+
+    bool setup(int width, int height, unsigned int viewsPerPass, MultiViewMode mode, unsigned int writers);
+    void collect(Slot& slot);
+    void push(Job& job);
+    void writerLoop();
+    void release();
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef VIEW_UNIFORMS_H
+#define VIEW_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include "shader.h"
+
+// The camera of the frame in one uniform buffer bound to VIEW_UNIFORM_BINDING, read by every
+// program through its ViewBlock. Written once per frame, as late as possible: the view can be
+// latched from the freshest input right before the draws without touching each program.
+class ViewUniforms
+{
+public:
+    ViewUniforms() : buffer(0) {}
+    ViewUniforms(const ViewUniforms&) = delete;
+    ViewUniforms& operator=(const ViewUniforms&) = delete;
+    ~ViewUniforms()
+    {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+    }
+
+    // Needs a current GL context; the buffer is created on first use
+    void update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos)
+    {
+        // std140: two column-major mat4s, then a vec4
+        float data[36];
+        std::memcpy(data, glm::value_ptr(projection), 16 * sizeof(float));
+        std::memcpy(data + 16, glm::value_ptr(view), 16 * sizeof(float));
+        data[32] = viewPos.x;
+        data[33] = viewPos.y;
+        data[34] = viewPos.z;
+        data[35] = 1.0f;
+
+        if (buffer == 0)
+        {
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(data), data, GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            // Orphan, so a frame still reading the old camera never stalls the write
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(data), NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), data);
+        }
+        glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_UNIFORM_BINDING, buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int buffer;
+};
+
+#endif
@@ -20,27 +20,140 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
 
-uniform vec3 viewPos;
-uniform Material material;
+layout (std140) uniform ViewBlock
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;  // xyz: eye
+};
+#ifdef MULTIVIEW
+layout (std140) uniform MultiViewBlock
+{
+    mat4 projections[16];
+    mat4 views[16];
+    vec4 viewPositions[16];
+    ivec4 viewCount;
+};
+flat in int ViewIndex;
+#endif
 uniform Light light;
 
+#ifdef INDIRECT
+struct MaterialData {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;  // w: shininess
+    uvec4 texture;  // x: diffuseMaps slot (0xFFFFFFFF: none), y: layer
+};
+layout (std430, binding = 5) readonly buffer Materials { MaterialData materials[]; };
+flat in uint MaterialIndex;
+#else
+uniform Material material;
+#endif
+
+#ifdef TEXTURED
+#ifdef INDIRECT
+// One texture array per slot (see GpuScene); the slot varies per draw, so it is sampled with
+// gradients taken outside the branch
+uniform sampler2DArray diffuseMaps[4];
+#else
+uniform sampler2DArray diffuseMap;
+uniform float diffuseLayer;
+#endif
+#endif
+
+#ifdef LIGHTMAP
+// Baked diffuse irradiance (direct light plus one bounce) of static surfaces
+in vec2 LightmapUV;
+#ifdef INDIRECT
+flat in uint LightmapLayer;
+uniform sampler2DArray lightmaps;
+#else
+uniform sampler2D lightmap;
+#endif
+#endif
+
+#ifdef DEBUG_VIEW
+// Heatmap values instead of colour, into DebugView's float target: 1 per fragment (overdraw),
+// the triangle's triangles per pixel, or the draw's GPU microseconds (negative: not timed yet)
+uniform int debugMode;
+uniform float drawCost;
+in vec3 Barycentric;
+#endif
+
 void main()
 {
+#ifdef DEBUG_VIEW
+    // The corner weights span an area of 1/2 over the triangle, so the determinant of their
+    // derivatives is half the share of the triangle one pixel covers here (local under
+    // perspective, and finite for triangles clipped at the near plane)
+    vec2 dx = dFdx(Barycentric.xy), dy = dFdy(Barycentric.xy);
+    float density = 2.0 * abs(dx.x * dy.y - dx.y * dy.x);
+    if (debugMode == 1)
+        FragColor = vec4(1.0);
+    else if (debugMode == 2)
+        FragColor = vec4(density);
+    else
+        FragColor = vec4(drawCost);
+    return;
+#endif
+#ifdef INDIRECT
+    MaterialData data = materials[MaterialIndex];
+    Material material = Material(data.ambient.rgb, data.diffuse.rgb, data.specular.rgb, data.specular.w);
+#endif
+#ifdef EMISSIVE
+    FragColor = vec4(1.0); // bright white light fixture
+#else
+    vec3 albedo = vec3(1.0);
+#ifdef TEXTURED
+#ifdef INDIRECT
+    vec3 coord = vec3(TexCoord, float(data.texture.y));
+    vec2 dx = dFdx(TexCoord), dy = dFdy(TexCoord);
+    switch (data.texture.x)
+    {
+    case 0u: albedo = textureGrad(diffuseMaps[0], coord, dx, dy).rgb; break;
+    case 1u: albedo = textureGrad(diffuseMaps[1], coord, dx, dy).rgb; break;
+    case 2u: albedo = textureGrad(diffuseMaps[2], coord, dx, dy).rgb; break;
+    case 3u: albedo = textureGrad(diffuseMaps[3], coord, dx, dy).rgb; break;
+    }
+#else
+    albedo = texture(diffuseMap, vec3(TexCoord, diffuseLayer)).rgb;
+#endif
+#endif
+
     // ambient
-    vec3 ambient = light.ambient * material.ambient;
+    vec3 ambient = light.ambient * material.ambient * albedo;
   	
     // diffuse 
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    vec3 diffuse = light.diffuse * (diff * material.diffuse * albedo);
     
+    vec3 result = ambient + diffuse;
+#ifdef LIGHTMAP
+    // Baked lighting replaces the ambient and diffuse terms; specular stays view dependent
+    if (LightmapUV.x >= 0.0)
+    {
+#ifdef INDIRECT
+        vec3 baked = texture(lightmaps, vec3(LightmapUV, float(LightmapLayer))).rgb;
+#else
+        vec3 baked = texture(lightmap, LightmapUV).rgb;
+#endif
+        result = baked * material.diffuse * albedo;
+    }
+#endif
+#ifdef SPECULAR
     // specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+#ifdef MULTIVIEW
+    vec3 viewDir = normalize(viewPositions[ViewIndex].xyz - FragPos);
+#else
+    vec3 viewDir = normalize(viewPosition.xyz - FragPos);
+#endif
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * (spec * material.specular);  
-        
-    vec3 result = ambient + diffuse + specular;
+    result += light.specular * (spec * material.specular);  
+#endif
     FragColor = vec4(result, 1.0);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#version 330 core
+out vec4 FragColor;
+
+// A debug view's values, one per pixel of the viewport (see DebugView); 0 where nothing was drawn
+uniform sampler2D values;
+uniform ivec2 origin;  // Of the viewport
+uniform int mode;      // 1: fragments, 2: triangles per pixel, 3: microseconds of the pixel's draw
+uniform float scale;   // Mode 3: microseconds of the hottest colour
+
+// Blue through cyan, green and yellow to red
+vec3 ramp(float t)
+{
+    t = clamp(t, 0.0, 1.0) * 4.0;
+    if (t < 1.0) return vec3(0.0, t, 1.0);
+    if (t < 2.0) return vec3(0.0, 1.0, 2.0 - t);
+    if (t < 3.0) return vec3(t - 2.0, 1.0, 0.0);
+    return vec3(1.0, 4.0 - t, 0.0);
+}
+
+void main()
+{
+    float value = texelFetch(values, ivec2(gl_FragCoord.xy) - origin, 0).r;
+    if (value == 0.0)
+    {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    float t;
+    if (mode == 1)
+        t = (value - 1.0) / 7.0;            // One fragment blue, eight and more red
+    else if (mode == 2)
+        t = 1.0 + log2(value) / 10.0;       // 1024 pixels per triangle blue, one or less red
+    else if (value < 0.0)
+    {
+        FragColor = vec4(0.5, 0.5, 0.5, 1.0);  // Not timed yet
+        return;
+    }
+    else
+        t = sqrt(value / scale);            // Spreads the many cheap draws apart
+    FragColor = vec4(ramp(t), 1.0);
+}
@@ -1,7 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-
-void main()
-{
-    FragColor = vec4(1.0); // set all 4 vector values to 1.0 for bright white light
-}
\ No newline at end of file
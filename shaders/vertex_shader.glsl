@@ -1,4 +1,7 @@
 #version 330 core
+#if defined(MULTIVIEW) && defined(LAYERED)
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
@@ -7,15 +10,143 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
 
+#ifdef LIGHTMAP
+// Chart coordinates in the mesh's own unwrap, placed in the room's atlas by the draw's rect
+// (scale xy, offset zw); a negative coordinate means the vertex has no baked lighting
+layout (location = 4) in vec2 aLightmapUV;
+out vec2 LightmapUV;
+#endif
+
+// Camera of the frame, shared by every program and latched just before the draws (see
+// view_uniforms.h); must match the block in the fragment shader
+layout (std140) uniform ViewBlock
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;  // xyz: eye
+};
+
+#ifdef DEBUG_VIEW
+// Corner weights of the triangle (draws are non-indexed, so the vertex index tells the corner);
+// their rate of change per pixel gives the triangle's size on screen
+out vec3 Barycentric;
+#endif
+
+#ifdef MULTIVIEW
+// Every view of the frame (see MultiView); a draw is instanced once per view, so consecutive
+// instances are the views of one placement. Must match the block in the fragment shader.
+layout (std140) uniform MultiViewBlock
+{
+    mat4 projections[16];
+    mat4 views[16];
+    vec4 viewPositions[16];
+    ivec4 viewCount;  // x: views drawn
+};
+flat out int ViewIndex;
+#endif
+
+#ifdef INDIRECT
+// GPU-driven draws (see GpuScene): the object index is a per-instance attribute offset by the
+// draw command's base instance; matrix and material come from the culling pass
+struct Object {
+    vec4 placement;
+    vec4 motion;  // x: scale, y: spin, z: first spinning vertex (packed), w: their count
+    uvec4 info;  // x: batch, y: material, z: lightmap layer
+    vec4 lightmap;  // Atlas rect, x = 0 when the object has no baked lighting
+};
+layout (location = 3) in uint aObject;
+layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };
+layout (std430, binding = 4) readonly buffer Matrices { mat4 matrices[]; };
+flat out uint MaterialIndex;
+#ifdef LIGHTMAP
+flat out uint LightmapLayer;
+#endif
+#elif defined(ANIMATED) || defined(INSTANCED)
+// Instanced draws (see Classroom): placement per instance, plus the animation of a spinning model
+// or the atlas rect of a static one
+layout (location = 5) in mat4 aInstanceModel;
+#ifdef ANIMATED
+layout (location = 9) in vec4 aAnimation;  // x: degrees per second, y: first spinning vertex, z: count
+#endif
+#if defined(INSTANCED) && defined(LIGHTMAP)
+layout (location = 10) in vec4 aLightmapRect;
+#endif
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+#if defined(LIGHTMAP) && !defined(INDIRECT) && !defined(INSTANCED)
+uniform vec4 lightmapRect;
+#endif
+
+#ifdef ANIMATED
+// Seconds of animation; vertices of the spinning sub-mesh turn about the model's Y axis, on top
+// of the instance's placement
+uniform float time;
+#endif
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+#ifdef INDIRECT
+    mat4 model = matrices[aObject];
+    MaterialIndex = objects[aObject].info.y;
+#elif defined(ANIMATED) || defined(INSTANCED)
+    mat4 model = aInstanceModel;
+#endif
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+#ifdef ANIMATED
+#ifdef INDIRECT
+    vec4 animation = vec4(objects[aObject].motion.y, objects[aObject].motion.zw, 0.0);
+#else
+    vec4 animation = aAnimation;
+#endif
+    float vertex = float(gl_VertexID);
+    if (vertex >= animation.y && vertex < animation.y + animation.z)
+    {
+        float angle = radians(mod(animation.x * time, 360.0));
+        float c = cos(angle);
+        float s = sin(angle);
+        mat3 spin = mat3(c, 0.0, -s, 0.0, 1.0, 0.0, s, 0.0, c);
+        position = spin * position;
+        normal = spin * normal;
+    }
+#endif
+    FragPos = vec3(model * vec4(position, 1.0));
+#ifdef EMISSIVE
+    // unlit: no normal needed, skip the per-vertex inverse
+    Normal = vec3(0.0);
+#else
+    Normal = mat3(transpose(inverse(model))) * normal;
+#endif
     TexCoord = aTexCoord;
-    
+#ifdef DEBUG_VIEW
+    int corner = gl_VertexID % 3;
+    Barycentric = vec3(corner == 0, corner == 1, corner == 2);
+#endif
+#ifdef LIGHTMAP
+#ifdef INDIRECT
+    vec4 lightmapRect = objects[aObject].lightmap;
+    LightmapLayer = objects[aObject].info.z;
+#elif defined(INSTANCED)
+    vec4 lightmapRect = aLightmapRect;
+#endif
+    LightmapUV = (lightmapRect.x > 0.0 && aLightmapUV.x >= 0.0) ? aLightmapUV * lightmapRect.xy + lightmapRect.zw
+                                                                  : vec2(-1.0);
+#endif
+
+#ifdef MULTIVIEW
+    ViewIndex = gl_InstanceID % viewCount.x;
+    gl_Position = projections[ViewIndex] * views[ViewIndex] * vec4(FragPos, 1.0);
+#ifdef LAYERED
+    gl_Layer = ViewIndex;
+#else
+    // Side by side: squeeze the view into its column of the viewport and clip it to the column
+    gl_ClipDistance[0] = gl_Position.w + gl_Position.x;
+    gl_ClipDistance[1] = gl_Position.w - gl_Position.x;
+    float columns = float(viewCount.x);
+    gl_Position.x = (gl_Position.x + gl_Position.w * (2.0 * float(ViewIndex) + 1.0 - columns)) / columns;
+#endif
+#else
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+#endif
+}
@@ -0,0 +1,670 @@
+#include "../include/asset_registry.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+AssetRegistry::AssetRegistry() : releaseCounter(0)
+{
+}
+
+bool AssetRegistry::readFile(const std::string& path, std::string& contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+bool AssetRegistry::readShaderSources(const Entry& entry, std::string& vertexCode, std::string& fragmentCode)
+{
+    if (!readFile(entry.vertexPath, vertexCode) || !readFile(entry.fragmentPath, fragmentCode))
+        return false;
+    vertexCode = Shader::withFeatures(vertexCode, entry.features);
+    fragmentCode = Shader::withFeatures(fragmentCode, entry.features);
+    return true;
+}
+
+uint32_t AssetRegistry::allocate(std::vector<std::unique_ptr<Entry> >& entries)
+{
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (!entries[i]->alive)
+            return (uint32_t)i;
+    }
+    entries.push_back(std::unique_ptr<Entry>(new Entry()));
+    return (uint32_t)(entries.size() - 1);
+}
+
+AssetRegistry::Entry* AssetRegistry::lookup(std::vector<std::unique_ptr<Entry> >& entries,
+                                            uint32_t index, uint32_t generation)
+{
+    if (index >= entries.size())
+        return NULL;
+    Entry* entry = entries[index].get();
+    if (!entry->alive || entry->generation != generation)
+        return NULL;
+    return entry;
+}
+
+size_t AssetRegistry::entryBytes(const Entry& entry)
+{
+    if (entry.model)
+        return entry.model->gpuBytes();
+    return entry.programBytes;
+}
+
+size_t AssetRegistry::programBinaryLength(const Shader& shader)
+{
+    if (shader.ID == 0 || !GLEW_ARB_get_program_binary)
+        return 0;
+    GLint length = 0;
+    glGetProgramiv(shader.ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    return (size_t)length;
+}
+
+uint64_t AssetRegistry::sourceHash(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    return hashBytes(fragmentCode.data(), fragmentCode.size(), hashBytes(vertexCode.data(), vertexCode.size()));
+}
+
+void AssetRegistry::enableProgramCache(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    programCache.reset(new ProgramBinaryCache(directory));
+    if (!programCache->enabled())
+        std::cout << "SHADER::Driver exposes no program binary formats, cache disabled" << std::endl;
+}
+
+bool AssetRegistry::buildProgram(Shader& shader, const std::string& vertexCode, const std::string& fragmentCode)
+{
+    // Reads only the program cache, which belongs to the render thread, so it runs without the lock
+    bool cached = programCache && programCache->enabled();
+    uint64_t key = cached ? programCache->key(vertexCode, fragmentCode) : 0;
+    unsigned int program = cached ? programCache->load(key) : 0;
+    if (program != 0)
+    {
+        shader.adopt(program);
+        return true;
+    }
+    // compile() semantics: the previous program survives a failed link
+    Shader::PendingProgram pending = Shader::beginCompile(vertexCode, fragmentCode, cached);
+    if (!shader.finishCompile(pending))
+        return false;
+    if (cached)
+        programCache->store(key, shader.ID);
+    return true;
+}
+
+void AssetRegistry::recordCompile(std::chrono::steady_clock::time_point started)
+{
+    // Bounded when nobody drains them
+    if (compileSeconds.size() < 4096)
+        compileSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+}
+
+size_t AssetRegistry::drainCompileTimes(std::vector<double>& seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    seconds.clear();
+    seconds.swap(compileSeconds);
+    return seconds.size();
+}
+
+void AssetRegistry::rehashShader(Entry& entry, uint32_t index, uint64_t hash)
+{
+    std::map<uint64_t, uint32_t>::iterator h = shaderByHash.find(entry.hash);
+    if (h != shaderByHash.end() && h->second == index)
+        shaderByHash.erase(h);
+    entry.hash = hash;
+    shaderByHash[hash] = index;
+}
+
+ModelHandle AssetRegistry::acquireModel(const std::string& path, bool keepVertices)
+{
+    ModelHandle handle = acquireSharedModel(path);
+    if (keepVertices)
+        retainModelVertices(handle);
+    return handle;
+}
+
+void AssetRegistry::retainModelVertices(ModelHandle handle)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Entry* entry = lookup(models, handle.index, handle.generation);
+    if (!entry)
+        return;
+    entry->model->retainVertices = true;
+    if (!entry->hostFreed)
+        return;  // Copy still there (uploadModel checks the flag under this lock before freeing)
+
+    // Already uploaded and freed for an earlier user: parse the file again, outside the lock
+    std::string path = entry->path;
+    lock.unlock();
+    std::string contents;
+    Model parsed;
+    if (!readFile(path, contents))
+        return;
+    std::istringstream stream(contents);
+    parsed.parseOBJ(stream, path);
+
+    lock.lock();
+    entry = lookup(models, handle.index, handle.generation);
+    if (entry && entry->hostFreed && parsed.vertexCount == entry->model->vertexCount)
+    {
+        entry->model->vertices.swap(parsed.vertices);
+        entry->model->lightmapUVs.swap(parsed.lightmapUVs);
+        entry->hostFreed = false;
+    }
+}
+
+void AssetRegistry::uploadModel(ModelHandle handle)
+{
+    // The GL work happens outside the lock; loader threads only write the CPU copy once it is freed
+    Model* uploading = model(handle);
+    if (!uploading || uploading->uploaded() || !uploading->loaded())
+        return;
+    uploading->uploadBuffers();
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = lookup(models, handle.index, handle.generation);
+    if (entry)
+        freeUploadedModel(*entry);
+}
+
+void AssetRegistry::freeUploadedModel(Entry& entry)
+{
+    // Called with the lock held
+    if (entry.model->retainVertices || entry.hostFreed)
+        return;
+    entry.model->freeHostCopy();
+    entry.hostFreed = true;
+}
+
+ModelHandle AssetRegistry::acquireSharedModel(const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, uint32_t>::iterator it = modelByPath.find(path);
+        if (it != modelByPath.end())
+        {
+            Entry& entry = *models[it->second];
+            entry.refs++;
+            return ModelHandle(it->second, entry.generation);
+        }
+    }
+
+    // File I/O and parsing happen outside the lock
+    std::string contents;
+    bool readOk = readFile(path, contents);
+    uint64_t hash = readOk ? hashBytes(contents.data(), contents.size()) : 0;
+    {
+        // Same content under another path: alias it
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<uint64_t, uint32_t>::iterator it = modelByHash.find(hash);
+        if (readOk && it != modelByHash.end())
+        {
+            Entry& entry = *models[it->second];
+            entry.refs++;
+            modelByPath[path] = it->second;
+            return ModelHandle(it->second, entry.generation);
+        }
+    }
+
+    std::unique_ptr<Model> model(new Model());
+    if (readOk)
+    {
+        std::istringstream stream(contents);
+        model->parseOBJ(stream, path);
+    }
+    else
+        std::cout << "ERROR::MODEL::Failed to open OBJ file: " << path << std::endl;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, uint32_t>::iterator it = modelByPath.find(path);
+    if (it != modelByPath.end())
+    {
+        // Another thread loaded it meanwhile
+        Entry& entry = *models[it->second];
+        entry.refs++;
+        return ModelHandle(it->second, entry.generation);
+    }
+
+    // Failed loads are kept too (with no vertices) so they are not retried on every room load
+    uint32_t index = allocate(models);
+    Entry& entry = *models[index];
+    entry.path = path;
+    entry.hash = hash;
+    entry.refs = 1;
+    entry.alive = true;
+    entry.model = std::move(model);
+    modelByPath[path] = index;
+    if (readOk)
+        modelByHash[hash] = index;
+    return ModelHandle(index, entry.generation);
+}
+
+ShaderHandle AssetRegistry::acquireShader(const std::string& vertexPath, const std::string& fragmentPath,
+                                          unsigned int features)
+{
+    std::string key = vertexPath + "|" + fragmentPath;
+    if (features != 0)
+    {
+        std::ostringstream suffix;
+        suffix << "#" << features;
+        key += suffix.str();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, uint32_t>::iterator it = shaderByPath.find(key);
+        if (it != shaderByPath.end())
+        {
+            Entry& entry = *shaders[it->second];
+            entry.refs++;
+            return ShaderHandle(it->second, entry.generation);
+        }
+    }
+
+    // File I/O and the compile happen outside the lock, like a model's parse
+    std::string vertexCode, fragmentCode;
+    Entry probe;
+    probe.vertexPath = vertexPath;
+    probe.fragmentPath = fragmentPath;
+    probe.features = features;
+    if (!readShaderSources(probe, vertexCode, fragmentCode))
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << key << std::endl;
+    uint64_t hash = sourceHash(vertexCode, fragmentCode);
+    {
+        // Same sources under another key: alias it
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<uint64_t, uint32_t>::iterator same = shaderByHash.find(hash);
+        if (same != shaderByHash.end())
+        {
+            Entry& entry = *shaders[same->second];
+            entry.refs++;
+            shaderByPath[key] = same->second;
+            return ShaderHandle(same->second, entry.generation);
+        }
+    }
+
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::unique_ptr<Shader> shader(new Shader());
+    // A shader that fails to compile keeps its entry so reload() can fix it
+    bool built = buildProgram(*shader, vertexCode, fragmentCode);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Another caller may have built the same key or the same sources meanwhile: the first entry in
+    // wins and ours is dropped with its program
+    std::map<std::string, uint32_t>::iterator it = shaderByPath.find(key);
+    std::map<uint64_t, uint32_t>::iterator same = shaderByHash.find(hash);
+    if (it != shaderByPath.end() || same != shaderByHash.end())
+    {
+        uint32_t existing = it != shaderByPath.end() ? it->second : same->second;
+        Entry& entry = *shaders[existing];
+        entry.refs++;
+        shaderByPath[key] = existing;
+        return ShaderHandle(existing, entry.generation);
+    }
+
+    uint32_t index = allocate(shaders);
+    Entry& entry = *shaders[index];
+    entry.path = key;
+    entry.vertexPath = vertexPath;
+    entry.fragmentPath = fragmentPath;
+    entry.features = features;
+    entry.hash = hash;
+    entry.refs = 1;
+    entry.alive = true;
+    entry.shader = std::move(shader);
+    if (built)
+    {
+        entry.programBytes = programBinaryLength(*entry.shader);
+        recordCompile(started);
+    }
+    shaderByPath[key] = index;
+    shaderByHash[hash] = index;
+    return ShaderHandle(index, entry.generation);
+}
+
+void AssetRegistry::releaseEntry(Entry* entry)
+{
+    if (entry && entry->refs > 0 && --entry->refs == 0)
+        entry->releasedAt = ++releaseCounter;
+}
+
+void AssetRegistry::release(ModelHandle handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseEntry(lookup(models, handle.index, handle.generation));
+}
+
+void AssetRegistry::release(ShaderHandle handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseEntry(lookup(shaders, handle.index, handle.generation));
+}
+
+Model* AssetRegistry::model(ModelHandle handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = lookup(models, handle.index, handle.generation);
+    return entry ? entry->model.get() : NULL;
+}
+
+bool AssetRegistry::modelInfo(ModelHandle handle, ModelInfo& info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = lookup(models, handle.index, handle.generation);
+    if (!entry)
+        return false;
+    const Model& model = *entry->model;
+    info.loaded = model.loaded();
+    info.lightmapExtent = model.lightmapExtent;
+    info.partNames.resize(model.parts.size());
+    for (size_t i = 0; i < model.parts.size(); i++)
+        info.partNames[i] = model.parts[i].name;
+    return true;
+}
+
+Shader* AssetRegistry::shader(ShaderHandle handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = lookup(shaders, handle.index, handle.generation);
+    return entry ? entry->shader.get() : NULL;
+}
+
+void AssetRegistry::evict(std::vector<std::unique_ptr<Entry> >& entries, uint32_t index,
+                          std::map<std::string, uint32_t>& byPath, std::map<uint64_t, uint32_t>& byHash)
+{
+    Entry& entry = *entries[index];
+    // Drop every path alias of this entry
+    std::map<std::string, uint32_t>::iterator it = byPath.begin();
+    while (it != byPath.end())
+    {
+        if (it->second == index)
+            byPath.erase(it++);
+        else
+            ++it;
+    }
+    std::map<uint64_t, uint32_t>::iterator h = byHash.find(entry.hash);
+    if (h != byHash.end() && h->second == index)
+        byHash.erase(h);
+
+    Shader::cancelCompile(entry.pending);
+    entry.model.reset();
+    entry.shader.reset();
+    entry.programBytes = 0;
+    entry.alive = false;
+    entry.generation++;
+}
+
+size_t AssetRegistry::gpuBytesLocked() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < models.size(); i++)
+        bytes += models[i]->alive ? entryBytes(*models[i]) : 0;
+    for (size_t i = 0; i < shaders.size(); i++)
+        bytes += shaders[i]->alive ? entryBytes(*shaders[i]) : 0;
+    return bytes;
+}
+
+size_t AssetRegistry::gpuBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return gpuBytesLocked();
+}
+
+size_t AssetRegistry::trim(size_t byteBudget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t evicted = 0;
+    while (gpuBytesLocked() > byteBudget)
+    {
+        // Least recently released unreferenced asset
+        std::vector<std::unique_ptr<Entry> >* list = NULL;
+        uint32_t victim = 0;
+        uint64_t oldest = (uint64_t)-1;
+        std::vector<std::unique_ptr<Entry> >* lists[] = { &models, &shaders };
+        for (int l = 0; l < 2; l++)
+        {
+            for (size_t i = 0; i < lists[l]->size(); i++)
+            {
+                const Entry& entry = *(*lists[l])[i];
+                if (entry.alive && entry.refs == 0 && entryBytes(entry) > 0 && entry.releasedAt < oldest)
+                {
+                    list = lists[l];
+                    victim = (uint32_t)i;
+                    oldest = entry.releasedAt;
+                }
+            }
+        }
+        if (!list)
+            break;
+
+        if (list == &models)
+            evict(models, victim, modelByPath, modelByHash);
+        else
+            evict(shaders, victim, shaderByPath, shaderByHash);
+        evicted++;
+    }
+    return evicted;
+}
+
+bool AssetRegistry::reload(ModelHandle handle)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* entry = lookup(models, handle.index, handle.generation);
+        if (!entry)
+            return false;
+        path = entry->path;
+    }
+
+    // File I/O and parsing happen outside the lock, into a model nobody else can see
+    std::string contents;
+    if (!readFile(path, contents))
+        return false;
+    Model parsed;
+    std::istringstream stream(contents);
+    if (!parsed.parseOBJ(stream, path) || !parsed.loaded())
+        return false;  // Keep the old geometry
+
+    bool wasUploaded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* entry = lookup(models, handle.index, handle.generation);
+        if (!entry)
+            return false;  // Evicted meanwhile
+
+        // Swap the new vertices in place so existing pointers stay valid; only the render thread
+        // reads the model itself, loader threads go through modelInfo()
+        Model& model = *entry->model;
+        wasUploaded = model.uploaded();
+        model.unload();
+        model.vertices.swap(parsed.vertices);
+        model.lightmapUVs.swap(parsed.lightmapUVs);
+        model.lightmapExtent = parsed.lightmapExtent;
+        model.vertexCount = parsed.vertexCount;
+        model.boundsMin = parsed.boundsMin;
+        model.boundsMax = parsed.boundsMax;
+        model.parts.swap(parsed.parts);
+        entry->hostFreed = false;
+
+        std::map<uint64_t, uint32_t>::iterator h = modelByHash.find(entry->hash);
+        if (h != modelByHash.end() && h->second == handle.index)
+            modelByHash.erase(h);
+        entry->hash = hashBytes(contents.data(), contents.size());
+        modelByHash[entry->hash] = handle.index;
+    }
+    if (wasUploaded)
+        uploadModel(handle);
+    return true;
+}
+
+bool AssetRegistry::reload(ShaderHandle handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry = lookup(shaders, handle.index, handle.generation);
+    std::string vertexCode, fragmentCode;
+    if (!entry || !readShaderSources(*entry, vertexCode, fragmentCode))
+        return false;
+
+    // The previous program stays if the new one fails to link
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    if (!buildProgram(*entry->shader, vertexCode, fragmentCode))
+        return false;
+    entry->programBytes = programBinaryLength(*entry->shader);
+    recordCompile(started);
+    Shader::cancelCompile(entry->pending);
+    rehashShader(*entry, handle.index, sourceHash(vertexCode, fragmentCode));
+    return true;
+}
+
+size_t AssetRegistry::shaderFileChanged(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t started = 0;
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        Entry& entry = *shaders[i];
+        if (!entry.alive || (entry.vertexPath != path && entry.fragmentPath != path))
+            continue;
+
+        std::string vertexCode, fragmentCode;
+        if (!readShaderSources(entry, vertexCode, fragmentCode))
+            continue;
+        uint64_t hash = sourceHash(vertexCode, fragmentCode);
+        if (entry.pending.program != 0 ? hash == entry.pendingHash : hash == entry.hash)
+            continue;  // Touched but unchanged, or already compiling this version
+
+        // A newer edit supersedes a compile still in flight
+        Shader::cancelCompile(entry.pending);
+
+        bool cached = programCache && programCache->enabled();
+        uint64_t key = cached ? programCache->key(vertexCode, fragmentCode) : 0;
+        unsigned int program = cached ? programCache->load(key) : 0;
+        if (program != 0)
+        {
+            // Reverting to a version seen before: no compile needed
+            entry.shader->adopt(program);
+            entry.programBytes = programBinaryLength(*entry.shader);
+            rehashShader(entry, (uint32_t)i, hash);
+            std::cout << "SHADER::Reloaded " << entry.path << " from program cache" << std::endl;
+            continue;
+        }
+
+        entry.pending = Shader::beginCompile(vertexCode, fragmentCode, cached);
+        entry.pendingStarted = std::chrono::steady_clock::now();
+        entry.pendingHash = hash;
+        entry.pendingKey = key;
+        started++;
+    }
+    return started;
+}
+
+size_t AssetRegistry::finishPendingShaders()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t swapped = 0;
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        Entry& entry = *shaders[i];
+        if (!entry.alive || entry.pending.program == 0 || !Shader::linkComplete(entry.pending))
+            continue;
+
+        if (!entry.shader->finishCompile(entry.pending))
+        {
+            std::cout << "ERROR::SHADER::Reload of " << entry.path << " failed, keeping the previous program"
+                      << std::endl;
+            continue;
+        }
+        if (programCache && programCache->enabled())
+            programCache->store(entry.pendingKey, entry.shader->ID);
+        entry.programBytes = programBinaryLength(*entry.shader);
+        rehashShader(entry, (uint32_t)i, entry.pendingHash);
+        // From the start of the background compile to the swap
+        recordCompile(entry.pendingStarted);
+        std::cout << "SHADER::Reloaded " << entry.path << std::endl;
+        swapped++;
+    }
+    return swapped;
+}
+
+size_t AssetRegistry::reloadChanged()
+{
+    // Collect changed entries first; reload() takes the lock itself
+    std::vector<ModelHandle> changedModels;
+    std::vector<ShaderHandle> changedShaders;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            const Entry& entry = *models[i];
+            std::string contents;
+            if (entry.alive && readFile(entry.path, contents) &&
+                hashBytes(contents.data(), contents.size()) != entry.hash)
+                changedModels.push_back(ModelHandle((uint32_t)i, entry.generation));
+        }
+        for (size_t i = 0; i < shaders.size(); i++)
+        {
+            const Entry& entry = *shaders[i];
+            std::string vertexCode, fragmentCode;
+            if (entry.alive && readShaderSources(entry, vertexCode, fragmentCode) &&
+                sourceHash(vertexCode, fragmentCode) != entry.hash)
+                changedShaders.push_back(ShaderHandle((uint32_t)i, entry.generation));
+        }
+    }
+
+    size_t reloaded = 0;
+    for (size_t i = 0; i < changedModels.size(); i++)
+        reloaded += reload(changedModels[i]) ? 1 : 0;
+    for (size_t i = 0; i < changedShaders.size(); i++)
+        reloaded += reload(changedShaders[i]) ? 1 : 0;
+    return reloaded;
+}
+
+void AssetRegistry::assetGpuBytes(std::vector<std::pair<std::string, size_t> >& bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bytes.clear();
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        if (models[i]->alive)
+            bytes.push_back(std::make_pair(models[i]->path, entryBytes(*models[i])));
+    }
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        if (shaders[i]->alive)
+            bytes.push_back(std::make_pair(shaders[i]->path, entryBytes(*shaders[i])));
+    }
+}
+
+void AssetRegistry::report(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0, totalHost = 0;
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        const Entry& entry = *models[i];
+        if (!entry.alive)
+            continue;
+        size_t host = entry.model->hostBytes();
+        out << "ASSETS::model " << entry.path << " refs " << entry.refs << ", host " << host / 1024
+            << " KB" << (entry.model->retainVertices ? " (retained)" : "") << ", GPU "
+            << entryBytes(entry) / 1024 << " KB" << std::endl;
+        total += entryBytes(entry);
+        totalHost += host;
+    }
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        const Entry& entry = *shaders[i];
+        if (!entry.alive)
+            continue;
+        out << "ASSETS::shader " << entry.path << " refs " << entry.refs << ", GPU "
+            << entryBytes(entry) / 1024 << " KB" << std::endl;
+        total += entryBytes(entry);
+    }
+    out << "ASSETS::Total host " << totalHost / 1024 << " KB, GPU " << total / 1024 << " KB" << std::endl;
+}
@@ -0,0 +1,407 @@
+#include "../include/batch_transform.h"
+#include <cmath>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH_TRANSFORM_X86 1
+#include <immintrin.h>
+#endif
+
+static const float DEG_TO_RAD = 0.017453292519943295f;
+
+void InstanceTransforms::resize(size_t count)
+{
+    models.resize(count);
+    normals.resize(count);
+    minX.resize(count);
+    minY.resize(count);
+    minZ.resize(count);
+    maxX.resize(count);
+    maxY.resize(count);
+    maxZ.resize(count);
+}
+
+// Reference implementation; also handles the tails of the SIMD paths
+static void transformScalar(const TransformInput& in, size_t begin, const glm::vec3& center,
+                            const glm::vec3& half, InstanceTransforms& out, size_t first)
+{
+    for (size_t i = begin; i < in.count; i++)
+    {
+        float angle = in.yaw[i] * DEG_TO_RAD;
+        float c = std::cos(angle), sn = std::sin(angle);
+        float s = in.scale ? in.scale[i] : 1.0f;
+        float inv = 1.0f / s;
+        glm::vec3 p = in.origin + glm::vec3(in.posX[i], in.posY[i], in.posZ[i]);
+
+        glm::mat4& m = out.models[first + i];
+        m[0] = glm::vec4(c * s, 0.0f, -sn * s, 0.0f);
+        m[1] = glm::vec4(0.0f, s, 0.0f, 0.0f);
+        m[2] = glm::vec4(sn * s, 0.0f, c * s, 0.0f);
+        m[3] = glm::vec4(p, 1.0f);
+
+        // transpose(inverse(R * S)) = R / s for a rotation and uniform scale
+        glm::mat3& n = out.normals[first + i];
+        n[0] = glm::vec3(c * inv, 0.0f, -sn * inv);
+        n[1] = glm::vec3(0.0f, inv, 0.0f);
+        n[2] = glm::vec3(sn * inv, 0.0f, c * inv);
+
+        float as = std::fabs(s), ac = std::fabs(c), asn = std::fabs(sn);
+        glm::vec3 wc = p + s * glm::vec3(c * center.x + sn * center.z, center.y, -sn * center.x + c * center.z);
+        glm::vec3 wh = as * glm::vec3(ac * half.x + asn * half.z, half.y, asn * half.x + ac * half.z);
+        out.minX[first + i] = wc.x - wh.x;
+        out.minY[first + i] = wc.y - wh.y;
+        out.minZ[first + i] = wc.z - wh.z;
+        out.maxX[first + i] = wc.x + wh.x;
+        out.maxY[first + i] = wc.y + wh.y;
+        out.maxZ[first + i] = wc.z + wh.z;
+    }
+}
+
+#ifdef BATCH_TRANSFORM_X86
+
+// Cody-Waite range reduction to [-pi/4, pi/4] plus minimax polynomials (cephes sinf/cosf);
+// accurate to a few ulp for the angles used here
+static const float SC_TWO_OVER_PI = 0.63661977236758134f;
+static const float SC_DP1 = 1.5703125f;
+static const float SC_DP2 = 4.837512969970703125e-4f;
+static const float SC_DP3 = 7.54978995489188216e-8f;
+static const float SC_S1 = -1.6666654611e-1f, SC_S2 = 8.3321608736e-3f, SC_S3 = -1.9515295891e-4f;
+static const float SC_C1 = 4.166664568298827e-2f, SC_C2 = -1.388731625493765e-3f, SC_C3 = 2.443315711809948e-5f;
+
+static inline void sincos4(__m128 x, __m128& sinOut, __m128& cosOut)
+{
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(SC_TWO_OVER_PI)));
+    __m128 j = _mm_cvtepi32_ps(quadrant);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(SC_DP1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(SC_DP2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(SC_DP3)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_set1_ps(SC_S2), _mm_mul_ps(r2, _mm_set1_ps(SC_S3)));
+    s = _mm_add_ps(_mm_set1_ps(SC_S1), _mm_mul_ps(r2, s));
+    s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+    __m128 c = _mm_add_ps(_mm_set1_ps(SC_C2), _mm_mul_ps(r2, _mm_set1_ps(SC_C3)));
+    c = _mm_add_ps(_mm_set1_ps(SC_C1), _mm_mul_ps(r2, c));
+    c = _mm_mul_ps(_mm_mul_ps(r2, r2), c);
+    c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))), c);
+
+    // Odd quadrants swap sin and cos; quadrant bit 1 flips the sign of sin, bit 1 of q+1 of cos
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    sinOut = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sinSign);
+    cosOut = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosSign);
+}
+
+// Store four columns, one per instance, as rows of a 4x4 transpose
+static inline void storeColumns4(InstanceTransforms& out, size_t index, int column,
+                                 __m128 x, __m128 y, __m128 z, __m128 w)
+{
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(&out.models[index + 0][column][0], x);
+    _mm_storeu_ps(&out.models[index + 1][column][0], y);
+    _mm_storeu_ps(&out.models[index + 2][column][0], z);
+    _mm_storeu_ps(&out.models[index + 3][column][0], w);
+}
+
+static void transformSSE(const TransformInput& in, const glm::vec3& center, const glm::vec3& half,
+                         InstanceTransforms& out, size_t first)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 hx = _mm_set1_ps(half.x), hy = _mm_set1_ps(half.y), hz = _mm_set1_ps(half.z);
+    const __m128 ox = _mm_set1_ps(in.origin.x), oy = _mm_set1_ps(in.origin.y), oz = _mm_set1_ps(in.origin.z);
+    float nc[4], ns[4], ni[4];
+
+    size_t i = 0;
+    for (; i + 4 <= in.count; i += 4)
+    {
+        __m128 sn, c;
+        sincos4(_mm_mul_ps(_mm_loadu_ps(in.yaw + i), _mm_set1_ps(DEG_TO_RAD)), sn, c);
+        __m128 s = in.scale ? _mm_loadu_ps(in.scale + i) : one;
+        __m128 px = _mm_add_ps(_mm_loadu_ps(in.posX + i), ox);
+        __m128 py = _mm_add_ps(_mm_loadu_ps(in.posY + i), oy);
+        __m128 pz = _mm_add_ps(_mm_loadu_ps(in.posZ + i), oz);
+        __m128 cs = _mm_mul_ps(c, s), ss = _mm_mul_ps(sn, s);
+        __m128 negSs = _mm_sub_ps(zero, ss);
+
+        size_t o = first + i;
+        storeColumns4(out, o, 0, cs, zero, negSs, zero);
+        storeColumns4(out, o, 1, zero, s, zero, zero);
+        storeColumns4(out, o, 2, ss, zero, cs, zero);
+        storeColumns4(out, o, 3, px, py, pz, one);
+
+        // Normal matrices are 9 floats each, too ragged for vector stores
+        __m128 inv = _mm_div_ps(one, s);
+        _mm_storeu_ps(nc, _mm_mul_ps(c, inv));
+        _mm_storeu_ps(ns, _mm_mul_ps(sn, inv));
+        _mm_storeu_ps(ni, inv);
+        for (int k = 0; k < 4; k++)
+        {
+            glm::mat3& n = out.normals[o + k];
+            n[0] = glm::vec3(nc[k], 0.0f, -ns[k]);
+            n[1] = glm::vec3(0.0f, ni[k], 0.0f);
+            n[2] = glm::vec3(ns[k], 0.0f, nc[k]);
+        }
+
+        __m128 as = _mm_and_ps(s, absMask), ac = _mm_and_ps(c, absMask), asn = _mm_and_ps(sn, absMask);
+        __m128 wcx = _mm_add_ps(px, _mm_mul_ps(s, _mm_add_ps(_mm_mul_ps(c, cx), _mm_mul_ps(sn, cz))));
+        __m128 wcy = _mm_add_ps(py, _mm_mul_ps(s, cy));
+        __m128 wcz = _mm_add_ps(pz, _mm_mul_ps(s, _mm_sub_ps(_mm_mul_ps(c, cz), _mm_mul_ps(sn, cx))));
+        __m128 whx = _mm_mul_ps(as, _mm_add_ps(_mm_mul_ps(ac, hx), _mm_mul_ps(asn, hz)));
+        __m128 why = _mm_mul_ps(as, hy);
+        __m128 whz = _mm_mul_ps(as, _mm_add_ps(_mm_mul_ps(asn, hx), _mm_mul_ps(ac, hz)));
+        _mm_storeu_ps(&out.minX[o], _mm_sub_ps(wcx, whx));
+        _mm_storeu_ps(&out.minY[o], _mm_sub_ps(wcy, why));
+        _mm_storeu_ps(&out.minZ[o], _mm_sub_ps(wcz, whz));
+        _mm_storeu_ps(&out.maxX[o], _mm_add_ps(wcx, whx));
+        _mm_storeu_ps(&out.maxY[o], _mm_add_ps(wcy, why));
+        _mm_storeu_ps(&out.maxZ[o], _mm_add_ps(wcz, whz));
+    }
+    transformScalar(in, i, center, half, out, first);
+}
+
+// AVX2 versions: same math, 8 lanes. Compiled for AVX2 only in these functions so the rest of
+// the program still runs on any x86-64 CPU.
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static inline void sincos8(__m256 x, __m256& sinOut, __m256& cosOut)
+{
+    __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(SC_TWO_OVER_PI)));
+    __m256 j = _mm256_cvtepi32_ps(quadrant);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(SC_DP1)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(SC_DP2)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(SC_DP3)));
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 s = _mm256_add_ps(_mm256_set1_ps(SC_S2), _mm256_mul_ps(r2, _mm256_set1_ps(SC_S3)));
+    s = _mm256_add_ps(_mm256_set1_ps(SC_S1), _mm256_mul_ps(r2, s));
+    s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), s));
+
+    __m256 c = _mm256_add_ps(_mm256_set1_ps(SC_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SC_C3)));
+    c = _mm256_add_ps(_mm256_set1_ps(SC_C1), _mm256_mul_ps(r2, c));
+    c = _mm256_mul_ps(_mm256_mul_ps(r2, r2), c);
+    c = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), c);
+
+    __m256 swap = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+    __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+    sinOut = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign);
+    cosOut = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign);
+}
+
+// Columns of instances 0-3 come out of the low 128-bit lanes, 4-7 out of the high ones
+AVX2_TARGET static inline void storeColumns8(InstanceTransforms& out, size_t index, int column,
+                                             __m256 x, __m256 y, __m256 z, __m256 w)
+{
+    __m256 t0 = _mm256_unpacklo_ps(x, y), t1 = _mm256_unpackhi_ps(x, y);
+    __m256 t2 = _mm256_unpacklo_ps(z, w), t3 = _mm256_unpackhi_ps(z, w);
+    __m256 rows[4] = {
+        _mm256_shuffle_ps(t0, t2, 0x44), _mm256_shuffle_ps(t0, t2, 0xEE),
+        _mm256_shuffle_ps(t1, t3, 0x44), _mm256_shuffle_ps(t1, t3, 0xEE)
+    };
+    for (int k = 0; k < 4; k++)
+    {
+        _mm_storeu_ps(&out.models[index + k][column][0], _mm256_castps256_ps128(rows[k]));
+        _mm_storeu_ps(&out.models[index + 4 + k][column][0], _mm256_extractf128_ps(rows[k], 1));
+    }
+}
+
+AVX2_TARGET static void transformAVX2(const TransformInput& in, const glm::vec3& center, const glm::vec3& half,
+                                      InstanceTransforms& out, size_t first)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 cx = _mm256_set1_ps(center.x), cy = _mm256_set1_ps(center.y), cz = _mm256_set1_ps(center.z);
+    const __m256 hx = _mm256_set1_ps(half.x), hy = _mm256_set1_ps(half.y), hz = _mm256_set1_ps(half.z);
+    const __m256 ox = _mm256_set1_ps(in.origin.x), oy = _mm256_set1_ps(in.origin.y);
+    const __m256 oz = _mm256_set1_ps(in.origin.z);
+    float nc[8], ns[8], ni[8];
+
+    size_t i = 0;
+    for (; i + 8 <= in.count; i += 8)
+    {
+        __m256 sn, c;
+        sincos8(_mm256_mul_ps(_mm256_loadu_ps(in.yaw + i), _mm256_set1_ps(DEG_TO_RAD)), sn, c);
+        __m256 s = in.scale ? _mm256_loadu_ps(in.scale + i) : one;
+        __m256 px = _mm256_add_ps(_mm256_loadu_ps(in.posX + i), ox);
+        __m256 py = _mm256_add_ps(_mm256_loadu_ps(in.posY + i), oy);
+        __m256 pz = _mm256_add_ps(_mm256_loadu_ps(in.posZ + i), oz);
+        __m256 cs = _mm256_mul_ps(c, s), ss = _mm256_mul_ps(sn, s);
+        __m256 negSs = _mm256_sub_ps(zero, ss);
+
+        size_t o = first + i;
+        storeColumns8(out, o, 0, cs, zero, negSs, zero);
+        storeColumns8(out, o, 1, zero, s, zero, zero);
+        storeColumns8(out, o, 2, ss, zero, cs, zero);
+        storeColumns8(out, o, 3, px, py, pz, one);
+
+        __m256 inv = _mm256_div_ps(one, s);
+        _mm256_storeu_ps(nc, _mm256_mul_ps(c, inv));
+        _mm256_storeu_ps(ns, _mm256_mul_ps(sn, inv));
+        _mm256_storeu_ps(ni, inv);
+        for (int k = 0; k < 8; k++)
+        {
+            glm::mat3& n = out.normals[o + k];
+            n[0] = glm::vec3(nc[k], 0.0f, -ns[k]);
+            n[1] = glm::vec3(0.0f, ni[k], 0.0f);
+            n[2] = glm::vec3(ns[k], 0.0f, nc[k]);
+        }
+
+        __m256 as = _mm256_and_ps(s, absMask), ac = _mm256_and_ps(c, absMask), asn = _mm256_and_ps(sn, absMask);
+        __m256 wcx = _mm256_add_ps(px, _mm256_mul_ps(s, _mm256_add_ps(_mm256_mul_ps(c, cx), _mm256_mul_ps(sn, cz))));
+        __m256 wcy = _mm256_add_ps(py, _mm256_mul_ps(s, cy));
+        __m256 wcz = _mm256_add_ps(pz, _mm256_mul_ps(s, _mm256_sub_ps(_mm256_mul_ps(c, cz), _mm256_mul_ps(sn, cx))));
+        __m256 whx = _mm256_mul_ps(as, _mm256_add_ps(_mm256_mul_ps(ac, hx), _mm256_mul_ps(asn, hz)));
+        __m256 why = _mm256_mul_ps(as, hy);
+        __m256 whz = _mm256_mul_ps(as, _mm256_add_ps(_mm256_mul_ps(asn, hx), _mm256_mul_ps(ac, hz)));
+        _mm256_storeu_ps(&out.minX[o], _mm256_sub_ps(wcx, whx));
+        _mm256_storeu_ps(&out.minY[o], _mm256_sub_ps(wcy, why));
+        _mm256_storeu_ps(&out.minZ[o], _mm256_sub_ps(wcz, whz));
+        _mm256_storeu_ps(&out.maxX[o], _mm256_add_ps(wcx, whx));
+        _mm256_storeu_ps(&out.maxY[o], _mm256_add_ps(wcy, why));
+        _mm256_storeu_ps(&out.maxZ[o], _mm256_add_ps(wcz, whz));
+    }
+    transformScalar(in, i, center, half, out, first);
+}
+
+#endif
+
+static TransformPath bestPath()
+{
+#ifdef BATCH_TRANSFORM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return TRANSFORM_AVX2;
+    return TRANSFORM_SSE;
+#else
+    return TRANSFORM_SCALAR;
+#endif
+}
+
+static TransformPath activePath = bestPath();
+
+TransformPath transformPath()
+{
+    return activePath;
+}
+
+void setTransformPath(TransformPath path)
+{
+    activePath = std::min(path, bestPath());
+}
+
+const char* transformPathName(TransformPath path)
+{
+    switch (path)
+    {
+    case TRANSFORM_SSE: return "SSE2";
+    case TRANSFORM_AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+void batchTransform(const TransformInput& in, const glm::vec3& localMin, const glm::vec3& localMax,
+                    InstanceTransforms& out, size_t first)
+{
+    glm::vec3 center = (localMin + localMax) * 0.5f;
+    glm::vec3 half = (localMax - localMin) * 0.5f;
+#ifdef BATCH_TRANSFORM_X86
+    if (activePath == TRANSFORM_AVX2)
+    {
+        transformAVX2(in, center, half, out, first);
+        return;
+    }
+    if (activePath == TRANSFORM_SSE)
+    {
+        transformSSE(in, center, half, out, first);
+        return;
+    }
+#endif
+    transformScalar(in, 0, center, half, out, first);
+}
+
+// Largest absolute difference over every output value
+static float maxDifference(const InstanceTransforms& a, const InstanceTransforms& b)
+{
+    float diff = 0.0f;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                diff = std::max(diff, std::fabs(a.models[i][c][r] - b.models[i][c][r]));
+        for (int c = 0; c < 3; c++)
+            for (int r = 0; r < 3; r++)
+                diff = std::max(diff, std::fabs(a.normals[i][c][r] - b.normals[i][c][r]));
+        diff = std::max(diff, std::fabs(a.minX[i] - b.minX[i]));
+        diff = std::max(diff, std::fabs(a.minY[i] - b.minY[i]));
+        diff = std::max(diff, std::fabs(a.minZ[i] - b.minZ[i]));
+        diff = std::max(diff, std::fabs(a.maxX[i] - b.maxX[i]));
+        diff = std::max(diff, std::fabs(a.maxY[i] - b.maxY[i]));
+        diff = std::max(diff, std::fabs(a.maxZ[i] - b.maxZ[i]));
+    }
+    return diff;
+}
+
+void benchmarkBatchTransforms(size_t count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(0.0f, 360.0f), size(0.1f, 2.0f);
+    std::vector<float> px(count), py(count), pz(count), yaw(count), scale(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        px[i] = position(rng);
+        py[i] = position(rng);
+        pz[i] = position(rng);
+        yaw[i] = angle(rng);
+        scale[i] = size(rng);
+    }
+
+    TransformInput in;
+    in.posX = &px[0];
+    in.posY = &py[0];
+    in.posZ = &pz[0];
+    in.yaw = &yaw[0];
+    in.scale = &scale[0];
+    in.count = count;
+    glm::vec3 localMin(-0.5f, 0.0f, -0.3f), localMax(0.5f, 1.2f, 0.3f);
+
+    TransformPath best = transformPath();
+    InstanceTransforms reference;
+    reference.resize(count);
+    setTransformPath(TRANSFORM_SCALAR);
+    batchTransform(in, localMin, localMax, reference, 0);
+
+    std::cout << "BENCH::Batch transforms, " << count << " instances" << std::endl;
+    for (int p = TRANSFORM_SCALAR; p <= best; p++)
+    {
+        setTransformPath((TransformPath)p);
+        InstanceTransforms out;
+        out.resize(count);
+        batchTransform(in, localMin, localMax, out, 0);  // Warm up caches and page in the output
+
+        const int runs = 10;
+        double bestSeconds = 1e30;
+        for (int r = 0; r < runs; r++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            batchTransform(in, localMin, localMax, out, 0);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            bestSeconds = std::min(bestSeconds, seconds);
+        }
+        std::cout << "BENCH::  " << transformPathName((TransformPath)p) << ": "
+                  << count / (bestSeconds * 1e6) << " instances/us, max error vs scalar "
+                  << maxDifference(out, reference) << std::endl;
+    }
+    setTransformPath(best);
+}
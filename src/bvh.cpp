@@ -0,0 +1,277 @@
+#include "../include/bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+static const unsigned int SAH_BINS = 12;
+static const size_t LEAF_TRIANGLES = 4;
+static const unsigned int MAX_DEPTH = 64;  // Traversal stack size
+
+static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 d = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+void TriangleBVH::build(const std::vector<glm::vec3>& vertices)
+{
+    nodes.clear();
+    triangles.clear();
+    maxDepth = 0;
+    size_t count = vertices.size() / 3;
+    if (count == 0)
+        return;
+
+    std::vector<unsigned int> order(count);
+    std::vector<glm::vec3> centroids(count), boxMin(count), boxMax(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::vec3& a = vertices[i * 3];
+        const glm::vec3& b = vertices[i * 3 + 1];
+        const glm::vec3& c = vertices[i * 3 + 2];
+        order[i] = (unsigned int)i;
+        boxMin[i] = glm::min(a, glm::min(b, c));
+        boxMax[i] = glm::max(a, glm::max(b, c));
+        centroids[i] = (boxMin[i] + boxMax[i]) * 0.5f;
+    }
+
+    nodes.reserve(count * 2);
+    buildNode(order, centroids, boxMin, boxMax, 0, count, 1);
+
+    triangles.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned int t = order[i];
+        Triangle& tri = triangles[i];
+        tri.v0 = vertices[t * 3];
+        tri.e1 = vertices[t * 3 + 1] - tri.v0;
+        tri.e2 = vertices[t * 3 + 2] - tri.v0;
+        tri.id = t;
+    }
+}
+
+unsigned int TriangleBVH::buildNode(std::vector<unsigned int>& order, const std::vector<glm::vec3>& centroids,
+                                    const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax,
+                                    size_t begin, size_t end, unsigned int depth)
+{
+    unsigned int index = (unsigned int)nodes.size();
+    nodes.push_back(Node());
+    maxDepth = std::max(maxDepth, depth);
+
+    glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+    for (size_t i = begin; i < end; i++)
+    {
+        unsigned int t = order[i];
+        bmin = glm::min(bmin, boxMin[t]);
+        bmax = glm::max(bmax, boxMax[t]);
+        cmin = glm::min(cmin, centroids[t]);
+        cmax = glm::max(cmax, centroids[t]);
+    }
+    nodes[index].boundsMin = bmin;
+    nodes[index].boundsMax = bmax;
+
+    size_t count = end - begin;
+    glm::vec3 extent = cmax - cmin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    bool makeLeaf = count <= LEAF_TRIANGLES || extent[axis] <= 0.0f || depth >= MAX_DEPTH;
+
+    // Binned SAH along the widest centroid axis
+    size_t split = begin;
+    if (!makeLeaf)
+    {
+        struct Bin
+        {
+            glm::vec3 boundsMin, boundsMax;
+            size_t count;
+        };
+        Bin bins[SAH_BINS];
+        for (unsigned int b = 0; b < SAH_BINS; b++)
+        {
+            bins[b].boundsMin = glm::vec3(FLT_MAX);
+            bins[b].boundsMax = glm::vec3(-FLT_MAX);
+            bins[b].count = 0;
+        }
+        float scale = SAH_BINS / extent[axis];
+        for (size_t i = begin; i < end; i++)
+        {
+            unsigned int t = order[i];
+            unsigned int b = std::min(SAH_BINS - 1, (unsigned int)((centroids[t][axis] - cmin[axis]) * scale));
+            bins[b].boundsMin = glm::min(bins[b].boundsMin, boxMin[t]);
+            bins[b].boundsMax = glm::max(bins[b].boundsMax, boxMax[t]);
+            bins[b].count++;
+        }
+
+        // Sweep from the right, then evaluate every plane from the left
+        float rightArea[SAH_BINS];
+        size_t rightCount[SAH_BINS];
+        glm::vec3 rmin(FLT_MAX), rmax(-FLT_MAX);
+        size_t rcount = 0;
+        for (unsigned int b = SAH_BINS - 1; b > 0; b--)
+        {
+            rmin = glm::min(rmin, bins[b].boundsMin);
+            rmax = glm::max(rmax, bins[b].boundsMax);
+            rcount += bins[b].count;
+            rightArea[b] = surfaceArea(rmin, rmax);
+            rightCount[b] = rcount;
+        }
+        glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX);
+        size_t lcount = 0;
+        float bestCost = FLT_MAX;
+        unsigned int bestPlane = 0;
+        for (unsigned int b = 0; b + 1 < SAH_BINS; b++)
+        {
+            lmin = glm::min(lmin, bins[b].boundsMin);
+            lmax = glm::max(lmax, bins[b].boundsMax);
+            lcount += bins[b].count;
+            if (lcount == 0 || rightCount[b + 1] == 0)
+                continue;
+            float cost = surfaceArea(lmin, lmax) * lcount + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestPlane = b + 1;
+            }
+        }
+
+        // A leaf is cheaper when no split beats testing every triangle
+        if (bestPlane == 0 || bestCost >= surfaceArea(bmin, bmax) * count)
+        {
+            makeLeaf = count <= LEAF_TRIANGLES * 4;
+            if (!makeLeaf)
+            {
+                // Too many to keep together: median split
+                split = begin + count / 2;
+                std::nth_element(order.begin() + begin, order.begin() + split, order.begin() + end,
+                                 [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+            }
+        }
+        else
+        {
+            float plane = cmin[axis] + bestPlane / scale;
+            split = std::partition(order.begin() + begin, order.begin() + end,
+                                   [&](unsigned int t) { return centroids[t][axis] < plane; }) - order.begin();
+            if (split == begin || split == end)
+                split = begin + count / 2;
+        }
+    }
+
+    if (makeLeaf)
+    {
+        nodes[index].offset = (unsigned int)begin;
+        nodes[index].count = (unsigned int)count;
+        return index;
+    }
+
+    buildNode(order, centroids, boxMin, boxMax, begin, split, depth + 1);
+    unsigned int right = buildNode(order, centroids, boxMin, boxMax, split, end, depth + 1);
+    nodes[index].offset = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+// Slab test; returns the entry distance, or FLT_MAX on a miss
+static inline float boxEntry(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& origin,
+                             const glm::vec3& inverse, float tMax)
+{
+    glm::vec3 t0 = (boundsMin - origin) * inverse;
+    glm::vec3 t1 = (boundsMax - origin) * inverse;
+    glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+template <bool AnyHit>
+bool TriangleBVH::traverse(const glm::vec3& origin, const glm::vec3& direction, float tMax, RayHit* hit) const
+{
+    if (nodes.empty())
+        return false;
+    // Zero components become huge but finite, so the slab test stays NaN-free
+    glm::vec3 inverse(1.0f / (std::fabs(direction.x) > 1e-12f ? direction.x : 1e-12f),
+                      1.0f / (std::fabs(direction.y) > 1e-12f ? direction.y : 1e-12f),
+                      1.0f / (std::fabs(direction.z) > 1e-12f ? direction.z : 1e-12f));
+    const float epsilon = 1e-5f;
+
+    unsigned int stack[MAX_DEPTH + 1];
+    unsigned int top = 0;
+    unsigned int current = 0;
+    bool found = false;
+    float closest = tMax;
+    if (boxEntry(nodes[0].boundsMin, nodes[0].boundsMax, origin, inverse, closest) == FLT_MAX)
+        return false;
+
+    while (true)
+    {
+        const Node& node = nodes[current];
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.offset; i < node.offset + node.count; i++)
+            {
+                const Triangle& tri = triangles[i];
+                glm::vec3 p = glm::cross(direction, tri.e2);
+                float det = glm::dot(tri.e1, p);
+                if (std::fabs(det) < 1e-12f)
+                    continue;
+                float invDet = 1.0f / det;
+                glm::vec3 s = origin - tri.v0;
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0.0f || u > 1.0f)
+                    continue;
+                glm::vec3 q = glm::cross(s, tri.e1);
+                float v = glm::dot(direction, q) * invDet;
+                if (v < 0.0f || u + v > 1.0f)
+                    continue;
+                float t = glm::dot(tri.e2, q) * invDet;
+                if (t <= epsilon || t >= closest)
+                    continue;
+                if (AnyHit)
+                    return true;
+                found = true;
+                closest = t;
+                hit->t = t;
+                hit->triangle = tri.id;
+                hit->u = u;
+                hit->v = v;
+            }
+        }
+        else
+        {
+            // Visit the nearer child first, push the other
+            unsigned int left = current + 1, right = node.offset;
+            float tLeft = boxEntry(nodes[left].boundsMin, nodes[left].boundsMax, origin, inverse, closest);
+            float tRight = boxEntry(nodes[right].boundsMin, nodes[right].boundsMax, origin, inverse, closest);
+            if (tLeft != FLT_MAX && tRight != FLT_MAX)
+            {
+                if (tRight < tLeft)
+                    std::swap(left, right);
+                stack[top++] = right;
+                current = left;
+                continue;
+            }
+            if (tLeft != FLT_MAX)
+            {
+                current = left;
+                continue;
+            }
+            if (tRight != FLT_MAX)
+            {
+                current = right;
+                continue;
+            }
+        }
+        if (top == 0)
+            break;
+        current = stack[--top];
+    }
+    return found;
+}
+
+bool TriangleBVH::intersect(const glm::vec3& origin, const glm::vec3& direction, float tMax, RayHit& hit) const
+{
+    return traverse<false>(origin, direction, tMax, &hit);
+}
+
+bool TriangleBVH::occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const
+{
+    return traverse<true>(origin, direction, tMax, NULL);
+}
@@ -0,0 +1,236 @@
+#include "../include/camera_path.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+static const uint32_t CAMERA_PATH_MAGIC = 0x4D414343;  // "CCAM"
+static const uint32_t CAMERA_PATH_VERSION = 1;
+// Bytes per sample in the file: time, tick, simTime, position, yaw, pitch, zoom
+static const uint64_t CAMERA_PATH_SAMPLE_BYTES = 9 * 4;
+
+template <typename T>
+static void writePOD(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readPOD(std::ifstream& in, T& value)
+{
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+void CameraPathSample::apply(Camera& camera) const
+{
+    camera.Position = position;
+    camera.Zoom = zoom;
+    camera.SetOrientation(yaw, pitch);
+}
+
+void CameraPath::record(float time, uint32_t tick, float simTime, const Camera& camera)
+{
+    CameraPathSample sample;
+    sample.time = time;
+    sample.tick = tick;
+    sample.simTime = simTime;
+    sample.position = camera.Position;
+    sample.yaw = camera.Yaw;
+    sample.pitch = camera.Pitch;
+    sample.zoom = camera.Zoom;
+    samples.push_back(sample);
+}
+
+CameraPathSample CameraPath::at(float time) const
+{
+    if (samples.empty())
+        return CameraPathSample();
+    if (time <= samples.front().time)
+        return samples.front();
+    if (time >= samples.back().time)
+        return samples.back();
+
+    // First sample after time; the one before it is at or before time
+    size_t lo = 1, hi = samples.size() - 1;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (samples[mid].time > time)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    const CameraPathSample& a = samples[lo - 1];
+    const CameraPathSample& b = samples[lo];
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    // Yaw is recorded unwrapped (mouse input accumulates), so plain interpolation is correct
+    CameraPathSample result;
+    result.time = time;
+    result.tick = a.tick;
+    result.simTime = a.simTime + (b.simTime - a.simTime) * t;
+    result.position = a.position + (b.position - a.position) * t;
+    result.yaw = a.yaw + (b.yaw - a.yaw) * t;
+    result.pitch = a.pitch + (b.pitch - a.pitch) * t;
+    result.zoom = a.zoom + (b.zoom - a.zoom) * t;
+    return result;
+}
+
+bool CameraPath::save(const std::string& path) const
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out)
+    {
+        std::cout << "ERROR::CAMERA_PATH::Failed to write " << path << std::endl;
+        return false;
+    }
+    writePOD(out, CAMERA_PATH_MAGIC);
+    writePOD(out, CAMERA_PATH_VERSION);
+    writePOD(out, (uint32_t)samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        // Field by field, so the file layout does not depend on struct padding
+        const CameraPathSample& s = samples[i];
+        writePOD(out, s.time);
+        writePOD(out, s.tick);
+        writePOD(out, s.simTime);
+        writePOD(out, s.position.x);
+        writePOD(out, s.position.y);
+        writePOD(out, s.position.z);
+        writePOD(out, s.yaw);
+        writePOD(out, s.pitch);
+        writePOD(out, s.zoom);
+    }
+    return (bool)out;
+}
+
+bool CameraPath::load(const std::string& path)
+{
+    samples.clear();
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+    {
+        std::cout << "ERROR::CAMERA_PATH::Failed to open " << path << std::endl;
+        return false;
+    }
+    uint32_t magic = 0, version = 0, count = 0;
+    if (!readPOD(in, magic) || !readPOD(in, version) || !readPOD(in, count) ||
+        magic != CAMERA_PATH_MAGIC || version != CAMERA_PATH_VERSION)
+    {
+        std::cout << "ERROR::CAMERA_PATH::Not a camera path (or an older version): " << path << std::endl;
+        return false;
+    }
+    // The samples must all be in the file before any are allocated
+    std::streamoff start = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streamoff end = in.tellg();
+    in.seekg(start);
+    if (start < 0 || end < start || (uint64_t)count * CAMERA_PATH_SAMPLE_BYTES > (uint64_t)(end - start))
+    {
+        std::cout << "ERROR::CAMERA_PATH::" << path << " is shorter than its " << count << " samples" << std::endl;
+        return false;
+    }
+    samples.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        CameraPathSample& s = samples[i];
+        bool ok = readPOD(in, s.time) && readPOD(in, s.tick) && readPOD(in, s.simTime) &&
+                  readPOD(in, s.position.x) && readPOD(in, s.position.y) && readPOD(in, s.position.z) &&
+                  readPOD(in, s.yaw) && readPOD(in, s.pitch) && readPOD(in, s.zoom);
+        if (!ok)
+        {
+            std::cout << "ERROR::CAMERA_PATH::Truncated samples in " << path << std::endl;
+            samples.clear();
+            return false;
+        }
+        // at() searches by time: times must not go back (written this way round to reject NaN)
+        if (!(s.time >= (i > 0 ? samples[i - 1].time : 0.0f)))
+        {
+            std::cout << "ERROR::CAMERA_PATH::Sample " << i << " of " << path << " is out of order" << std::endl;
+            samples.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReplayTimings::add(uint32_t frame, float time, double cpuMs, double frameMs, unsigned int pacerFrame)
+{
+    ReplayFrame f;
+    f.frame = frame;
+    f.time = time;
+    f.cpuMs = cpuMs;
+    f.frameMs = frameMs;
+    f.gpuMs = -1.0;
+    f.pacerFrame = pacerFrame;
+    frames.push_back(f);
+}
+
+void ReplayTimings::setGpu(unsigned int pacerFrame, double gpuMs)
+{
+    for (size_t i = frames.size(); i-- > 0;)
+    {
+        if (frames[i].pacerFrame == pacerFrame)
+        {
+            frames[i].gpuMs = gpuMs;
+            return;
+        }
+        if (frames[i].pacerFrame < pacerFrame)
+            return;
+    }
+}
+
+bool ReplayTimings::writeCsv(const std::string& path) const
+{
+    std::ofstream out(path.c_str());
+    if (!out)
+    {
+        std::cout << "ERROR::REPLAY::Failed to write " << path << std::endl;
+        return false;
+    }
+    out << "frame,time,cpu_ms,frame_ms,gpu_ms\n";
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const ReplayFrame& f = frames[i];
+        out << f.frame << "," << f.time << "," << f.cpuMs << "," << f.frameMs << ",";
+        if (f.gpuMs >= 0.0)
+            out << f.gpuMs;
+        out << "\n";
+    }
+    return (bool)out;
+}
+
+static void reportColumn(std::ostream& out, const char* name, std::vector<double>& values)
+{
+    if (values.empty())
+    {
+        out << " " << name << " n/a;";
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    double total = 0.0;
+    for (size_t i = 0; i < values.size(); i++)
+        total += values[i];
+    out << " " << name << " avg " << total / values.size() << ", p50 " << values[values.size() / 2] << ", p95 "
+        << values[values.size() * 95 / 100] << ", p99 " << values[values.size() * 99 / 100] << ", max "
+        << values.back() << " ms;";
+}
+
+void ReplayTimings::report(std::ostream& out) const
+{
+    std::vector<double> cpu, frame, gpu;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        cpu.push_back(frames[i].cpuMs);
+        // The first frame has no previous present
+        if (i > 0)
+            frame.push_back(frames[i].frameMs);
+        if (frames[i].gpuMs >= 0.0)
+            gpu.push_back(frames[i].gpuMs);
+    }
+    out << "REPLAY::" << frames.size() << " frames:";
+    reportColumn(out, "CPU", cpu);
+    reportColumn(out, "frame", frame);
+    reportColumn(out, "GPU", gpu);
+    out << std::endl;
+}
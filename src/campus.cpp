@@ -0,0 +1,395 @@
+#include "../include/campus.h"
+#include "../include/soft_raster.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+Campus::Campus(AssetRegistry& registry)
+    : loadRadius(10.0f), unloadRadius(16.0f), memoryBudget(64u << 20), uploadBytesPerFrame(256u << 10),
+      hitchThresholdMs(4.0f), retainGeometry(false), startPosition(0.0f, 2.0f, 3.5f), startYaw(-90.0f), startPitch(0.0f),
+      assets(registry), animationTime(0.0), residencyVersion(0), quit(false)
+{
+    loader = std::thread(&Campus::loaderLoop, this);
+}
+
+Campus::~Campus()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    loader.join();
+
+    for (size_t i = 0; i < finished.size(); i++)
+        delete finished[i].second;
+}
+
+bool Campus::addCell(const std::string& name, const std::string& scenePath, const glm::vec3& origin)
+{
+    std::unique_ptr<CampusCell> cell(new CampusCell());
+    cell->name = name;
+    cell->scenePath = scenePath;
+    cell->origin = origin;
+    if (!loadScene(scenePath, cell->scene))
+        return false;
+
+    const RoomShell& room = cell->scene.room;
+    cell->boundsMin = origin + glm::vec3(-room.width / 2, 0.0f, -room.length / 2);
+    cell->boundsMax = origin + glm::vec3(room.width / 2, room.height, room.length / 2);
+    cell->state = CELL_UNLOADED;
+    cell->retryDistance = std::numeric_limits<float>::max();
+    cells.push_back(std::move(cell));
+    return true;
+}
+
+bool Campus::load(const std::string& path)
+{
+    bool isCampus = path.size() >= 7 && path.compare(path.size() - 7, 7, ".campus") == 0;
+    if (!isCampus)
+    {
+        // A single room is a one-cell campus
+        if (!addCell("room", path, glm::vec3(0.0f)))
+            return false;
+        startPosition = cells[0]->scene.cameraPosition;
+        startYaw = cells[0]->scene.cameraYaw;
+        startPitch = cells[0]->scene.cameraPitch;
+        return true;
+    }
+
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cout << "ERROR::CAMPUS::Failed to open campus file: " << path << std::endl;
+        return false;
+    }
+
+    bool hasCamera = false;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream iss(line);
+        std::string directive;
+        if (!(iss >> directive))
+            continue;
+
+        bool ok = false;
+        if (directive == "cell")
+        {
+            std::string name, scenePath;
+            glm::vec3 origin;
+            ok = (iss >> name >> scenePath >> origin.x >> origin.y >> origin.z) &&
+                 addCell(name, scenePath, origin);
+        }
+        else if (directive == "stream")
+        {
+            float budgetMB = 0.0f, uploadKB = 0.0f;
+            ok = (bool)(iss >> loadRadius >> unloadRadius >> budgetMB >> uploadKB);
+            memoryBudget = (size_t)(budgetMB * 1024.0f * 1024.0f);
+            uploadBytesPerFrame = (size_t)(uploadKB * 1024.0f);
+        }
+        else if (directive == "camera")
+        {
+            ok = (bool)(iss >> startPosition.x >> startPosition.y >> startPosition.z >> startYaw >> startPitch);
+            hasCamera = ok;
+        }
+
+        if (!ok)
+        {
+            std::cout << "ERROR::CAMPUS::" << path << ":" << lineNumber << ": invalid '" << directive
+                      << "' directive" << std::endl;
+            return false;
+        }
+    }
+
+    if (cells.empty())
+    {
+        std::cout << "ERROR::CAMPUS::" << path << ": campus has no cells" << std::endl;
+        return false;
+    }
+    if (!hasCamera)
+    {
+        startPosition = cells[0]->origin + cells[0]->scene.cameraPosition;
+        startYaw = cells[0]->scene.cameraYaw;
+        startPitch = cells[0]->scene.cameraPitch;
+    }
+    std::cout << "CAMPUS::Loaded " << path << ": " << cells.size() << " cells" << std::endl;
+    return true;
+}
+
+float Campus::distanceTo(const CampusCell& cell, const glm::vec3& position) const
+{
+    glm::vec3 closest = glm::clamp(position, cell.boundsMin, cell.boundsMax);
+    return glm::length(position - closest);
+}
+
+const CampusCell* Campus::cellAt(const glm::vec3& position) const
+{
+    const CampusCell* nearest = NULL;
+    float nearestDistance = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        float d = distanceTo(*cells[i], position);
+        if (d < nearestDistance)
+        {
+            nearest = cells[i].get();
+            nearestDistance = d;
+        }
+    }
+    return nearest;
+}
+
+Classroom* Campus::buildCell(size_t index)
+{
+    const CampusCell& cell = *cells[index];
+    Classroom* room = new Classroom();
+    room->scene = cell.scene;
+    room->origin = cell.origin;
+    room->lightmapPath = lightmapPathFor(cell.scenePath);
+    room->retainGeometry = retainGeometry;
+    room->buildGeometry(assets);
+    return room;
+}
+
+void Campus::loaderLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return quit || !requests.empty(); });
+        if (quit)
+            return;
+
+        size_t index = requests.front();
+        requests.pop_front();
+
+        lock.unlock();
+        Classroom* room = buildCell(index);
+        lock.lock();
+
+        finished.push_back(std::make_pair(index, room));
+    }
+}
+
+void Campus::request(size_t index)
+{
+    cells[index]->state = CELL_LOADING;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(index);
+    }
+    wake.notify_one();
+}
+
+void Campus::evict(size_t index)
+{
+    CampusCell& cell = *cells[index];
+    if (cell.state == CELL_LOADING)
+    {
+        // Cancel if the loader has not picked it up yet; otherwise let it finish
+        std::lock_guard<std::mutex> lock(mutex);
+        std::deque<size_t>::iterator it = std::find(requests.begin(), requests.end(), index);
+        if (it != requests.end())
+        {
+            requests.erase(it);
+            cell.state = CELL_UNLOADED;
+        }
+        return;
+    }
+
+    if (cell.state == CELL_RESIDENT)
+        residencyVersion++;
+    cell.room.reset();
+    cell.state = CELL_UNLOADED;
+    stats.cellsEvicted++;
+}
+
+void Campus::loadAround(const glm::vec3& position)
+{
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        CampusCell& cell = *cells[i];
+        if (cell.state != CELL_UNLOADED || distanceTo(cell, position) >= loadRadius)
+            continue;
+        cell.room.reset(buildCell(i));
+        size_t unlimited = (size_t)-1;
+        cell.room->uploadGeometry(unlimited);
+        cell.state = CELL_RESIDENT;
+        residencyVersion++;
+        stats.cellsLoaded++;
+    }
+}
+
+size_t Campus::residentBytes()
+{
+    size_t bytes = assets.gpuBytes();
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cells[i]->room)
+            bytes += cells[i]->room->gpuBytes();
+    }
+    return bytes;
+}
+
+void Campus::report(std::ostream& out) const
+{
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        const CampusCell& cell = *cells[i];
+        if (!cell.room)
+            continue;
+        out << "ASSETS::room " << cell.name << " host " << cell.room->hostBytes() / 1024 << " KB, GPU "
+            << cell.room->gpuBytes() / 1024 << " KB" << std::endl;
+    }
+}
+
+void Campus::update(float deltaTime, const glm::vec3& cameraPosition)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    animationTime += deltaTime;
+
+    // Take over rooms finished by the loader thread
+    std::vector<std::pair<size_t, Classroom*> > done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(finished);
+    }
+    for (size_t i = 0; i < done.size(); i++)
+    {
+        CampusCell& cell = *cells[done[i].first];
+        cell.room.reset(done[i].second);
+        cell.state = CELL_UPLOADING;
+    }
+
+    // Distances for this frame; uploads go nearest-first
+    std::vector<std::pair<float, size_t> > byDistance;
+    for (size_t i = 0; i < cells.size(); i++)
+        byDistance.push_back(std::make_pair(distanceTo(*cells[i], cameraPosition), i));
+    std::sort(byDistance.begin(), byDistance.end());
+
+    size_t uploadBudget = uploadBytesPerFrame;
+    for (size_t i = 0; i < byDistance.size(); i++)
+    {
+        CampusCell& cell = *cells[byDistance[i].second];
+        float distance = byDistance[i].first;
+
+        if (cell.state == CELL_UNLOADED && distance < loadRadius && distance < cell.retryDistance)
+            request(byDistance[i].second);
+        else if (cell.state != CELL_UNLOADED && distance > unloadRadius)
+            evict(byDistance[i].second);
+        else if (cell.state == CELL_UPLOADING && uploadBudget > 0)
+        {
+            if (cell.room->uploadGeometry(uploadBudget))
+            {
+                cell.state = CELL_RESIDENT;
+                residencyVersion++;
+                cell.retryDistance = std::numeric_limits<float>::max();
+                stats.cellsLoaded++;
+            }
+        }
+    }
+
+    stats.bytesUploaded += uploadBytesPerFrame - uploadBudget;
+
+    // Enforce the memory budget: drop cached but unused assets first, then the farthest rooms
+    // (never the camera's own) together with the assets only they used
+    size_t roomBytes = residentBytes() - assets.gpuBytes();
+    assets.trim(memoryBudget > roomBytes ? memoryBudget - roomBytes : 0);
+
+    const CampusCell* current = cellAt(cameraPosition);
+    size_t resident = residentBytes();
+    for (size_t i = byDistance.size(); i-- > 0 && resident > memoryBudget;)
+    {
+        CampusCell& cell = *cells[byDistance[i].second];
+        if (&cell == current || !cell.room)
+            continue;
+        evict(byDistance[i].second);
+        cell.retryDistance = byDistance[i].first - 1.0f;
+        roomBytes = residentBytes() - assets.gpuBytes();
+        assets.trim(memoryBudget > roomBytes ? memoryBudget - roomBytes : 0);
+        resident = residentBytes();
+    }
+
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cells[i]->room)
+            cells[i]->room->animationTime = animationTime;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.frames++;
+    stats.totalUpdateMs += ms;
+    stats.maxUpdateMs = std::max(stats.maxUpdateMs, ms);
+    if (ms > hitchThresholdMs)
+        stats.hitchFrames++;
+    stats.residentBytes = resident;
+}
+
+void Campus::submit(RenderQueue& queue, ShaderVariants& shaders)
+{
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cells[i]->state == CELL_RESIDENT)
+            cells[i]->room->submit(queue, shaders);
+    }
+}
+
+void Campus::submit(SoftwareRasterizer& raster)
+{
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cells[i]->state == CELL_RESIDENT)
+            cells[i]->room->submit(raster);
+    }
+}
+
+void Campus::rasterize(SoftwareRasterizer& raster, const CampusCell& cell, const glm::mat4& projection,
+                       const glm::mat4& view, const glm::vec3& viewPosition)
+{
+    SoftwareLight light;
+    light.position = cell.origin + cell.scene.lightPosition;
+    light.ambient = 0.3f * cell.scene.lightColor;
+    light.diffuse = 0.8f * cell.scene.lightColor;
+    light.specular = 1.0f * cell.scene.lightColor;
+    raster.begin(projection, view, viewPosition, light, (float)animationTime, glm::vec3(0.1f));
+    submit(raster);
+    raster.end();
+}
+
+void Campus::setFrameUniforms(ShaderVariants& shaders, const CampusCell& cell) const
+{
+    glm::vec3 lightColor = cell.scene.lightColor;
+    glm::vec3 lightPos = cell.origin + cell.scene.lightPosition;
+
+    std::vector<Shader*> variants;
+    shaders.compiled(variants);
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        Shader& shader = *variants[i];
+        shader.use();
+        shader.setVec3("light.position", lightPos);
+        shader.setVec3("light.ambient", 0.3f * lightColor);
+        shader.setVec3("light.diffuse", 0.8f * lightColor);
+        shader.setVec3("light.specular", 1.0f * lightColor);
+        shader.setFloat("time", (float)animationTime);
+    }
+}
+
+void Campus::residentRooms(std::vector<Classroom*>& rooms) const
+{
+    rooms.clear();
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cells[i]->state == CELL_RESIDENT)
+            rooms.push_back(cells[i]->room.get());
+    }
+}
@@ -1,108 +1,549 @@
 #include "../include/classroom.h"
+#include "../include/soft_raster.h"
 #include <iostream>
+#include <cmath>
+#include <cstring>
+
+// Exact vertex counts of the generated primitives, for sizing the geometry arena
+static const size_t QUAD_VERTICES = 6;
+static const size_t CUBE_VERTICES = 6 * QUAD_VERTICES;
+static const size_t BENCH_VERTICES = 10 * CUBE_VERTICES;
+static const size_t VERTEX_FLOATS = 8;
+
+// Attributes 0-2 (position, normal, texcoord) of an interleaved vertex buffer, into the bound VAO
+static void bindVertexAttributes(unsigned int VBO)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+}
 
 Classroom::Classroom()
 {
     // Constructor - buffers will be initialized in initializeGeometry()
-    fanRotation = 0.0f;
+    animationTime = 0.0;
+    origin = glm::vec3(0.0f);
+    retainGeometry = false;
+    lightmapTexture = 0;
+    assets = NULL;
 }
 
 Classroom::~Classroom()
 {
     // Clean up OpenGL resources
-    glDeleteVertexArrays(1, &floorVAO);
-    glDeleteBuffers(1, &floorVBO);
-    glDeleteVertexArrays(1, &ceilingVAO);
-    glDeleteBuffers(1, &ceilingVBO);
-    glDeleteVertexArrays(1, &wallsVAO);
-    glDeleteBuffers(1, &wallsVBO);
-    glDeleteVertexArrays(1, &doorsVAO);
-    glDeleteBuffers(1, &doorsVBO);
-    glDeleteVertexArrays(1, &windowsVAO);
-    glDeleteBuffers(1, &windowsVBO);
-    glDeleteVertexArrays(1, &benchesVAO);
-    glDeleteBuffers(1, &benchesVBO);
-    glDeleteVertexArrays(1, &podiumVAO);
-    glDeleteBuffers(1, &podiumVBO);
-    glDeleteVertexArrays(1, &boardVAO);
-    glDeleteBuffers(1, &boardVBO);
-    glDeleteVertexArrays(1, &lightsVAO);
-    glDeleteBuffers(1, &lightsVBO);
+    for (size_t i = 0; i < shellParts.size(); i++)
+    {
+        if (shellParts[i].VAO != 0) glDeleteVertexArrays(1, &shellParts[i].VAO);
+        if (shellParts[i].VBO != 0) glDeleteBuffers(1, &shellParts[i].VBO);
+        if (shellParts[i].lightmapVBO != 0) glDeleteBuffers(1, &shellParts[i].lightmapVBO);
+    }
+    for (size_t i = 0; i < fallbackParts.size(); i++)
+    {
+        if (fallbackParts[i].VAO != 0) glDeleteVertexArrays(1, &fallbackParts[i].VAO);
+        if (fallbackParts[i].VBO != 0) glDeleteBuffers(1, &fallbackParts[i].VBO);
+    }
+    for (size_t i = 0; i < animatedBatches.size(); i++)
+    {
+        if (animatedBatches[i].VAO != 0) glDeleteVertexArrays(1, &animatedBatches[i].VAO);
+        if (animatedBatches[i].instanceBuffer != 0) glDeleteBuffers(1, &animatedBatches[i].instanceBuffer);
+    }
+    for (size_t i = 0; i < staticBatches.size(); i++)
+    {
+        if (staticBatches[i].VAO != 0) glDeleteVertexArrays(1, &staticBatches[i].VAO);
+        if (staticBatches[i].instanceBuffer != 0) glDeleteBuffers(1, &staticBatches[i].instanceBuffer);
+    }
+    if (lightmapTexture != 0) glDeleteTextures(1, &lightmapTexture);
+    releaseTextures();
+    releaseModels();
 }
 
-void Classroom::initializeGeometry()
+void Classroom::releaseModels()
 {
-    // Generate all geometry
-    generateFloor();
-    generateCeiling();
-    generateWalls();
-    generateDoors();
-    generateWindows();
-    generateBenches();
-    generatePodium();
-    generateGreenBoard();
-    generateLights();
+    for (size_t i = 0; assets && i < modelHandles.size(); i++)
+        assets->release(modelHandles[i]);
+    modelHandles.clear();
+    models.clear();
+    modelInfo.clear();
+}
 
-    // Setup all buffers
-    setupBuffers(floorVAO, floorVBO, floorVertices);
-    setupBuffers(ceilingVAO, ceilingVBO, ceilingVertices);
-    setupBuffers(wallsVAO, wallsVBO, wallVertices);
-    setupBuffers(doorsVAO, doorsVBO, doorVertices);
-    setupBuffers(windowsVAO, windowsVBO, windowVertices);
-    setupBuffers(benchesVAO, benchesVBO, benchVertices);
-    setupBuffers(podiumVAO, podiumVBO, podiumVertices);
-    setupBuffers(boardVAO, boardVBO, boardVertices);
-    setupBuffers(lightsVAO, lightsVBO, lightVertices);
-    
-    // Load OBJ models
-    if (!fanModel.loadOBJ("models/fan_up.obj"))
+void Classroom::acquireTextures()
+{
+    // Shared through the registry's streamer: rooms using the same file get the same layer
+    textureRefs.assign(scene.materials.size(), TextureRef());
+    for (size_t i = 0; i < scene.materials.size(); i++)
     {
-        std::cout << "Warning: Failed to load fan model. Please place fan_up.obj in models/ directory" << std::endl;
+        Material& material = scene.materials[i];
+        if (scene.materialTextures[i].empty())
+            continue;
+        textureRefs[i] = assets->textures.acquire(scene.materialTextures[i]);
+        material.diffuseMap = assets->textures.texture(textureRefs[i]);
+        material.diffuseLayer = (float)textureRefs[i].layer;
+        if (!textureRefs[i].valid())
+        {
+            std::cout << "Warning: Failed to load texture " << scene.materialTextures[i] << " of material "
+                      << scene.materialNames[i] << ", drawing it untextured" << std::endl;
+        }
     }
-    
-    if (!podiumModel.loadOBJ("models/podium.obj"))
+}
+
+void Classroom::releaseTextures()
+{
+    for (size_t i = 0; assets && i < textureRefs.size(); i++)
+        assets->textures.release(textureRefs[i]);
+    textureRefs.clear();
+    for (size_t i = 0; i < scene.materials.size(); i++)
+        scene.materials[i].diffuseMap = 0;
+}
+
+bool Classroom::loadScene(const std::string& path)
+{
+    if (!::loadScene(path, scene))
+        return false;
+    lightmapPath = lightmapPathFor(path);
+    std::cout << "SCENE::Loaded " << path << ": " << scene.materials.size() << " materials, "
+              << scene.models.size() << " models, " << scene.boxes.size() << " boxes, "
+              << scene.instances.size() << " instances" << std::endl;
+    return true;
+}
+
+void Classroom::initializeGeometry(AssetRegistry& registry)
+{
+    buildGeometry(registry);
+    size_t unlimited = (size_t)-1;
+    uploadGeometry(unlimited);
+}
+
+void Classroom::buildGeometry(AssetRegistry& registry)
+{
+    // Load OBJ models first (shared with every other room using the same file); which
+    // procedural stand-ins are needed depends on them
+    releaseModels();
+    assets = &registry;
+    for (size_t i = 0; i < scene.models.size(); i++)
     {
-        std::cout << "Warning: Failed to load podium model. Please place podium.obj in models/ directory" << std::endl;
+        modelHandles.push_back(registry.acquireModel(scene.models[i].path, retainGeometry));
+        models.push_back(registry.model(modelHandles.back()));
+        // Render-thread reloads may swap the model's geometry, so plan from a snapshot
+        modelInfo.push_back(ModelInfo());
+        registry.modelInfo(modelHandles.back(), modelInfo.back());
+        if (!modelInfo.back().loaded)
+        {
+            std::cout << "Warning: Failed to load " << scene.models[i].name << " model. Please place "
+                      << scene.models[i].path << " in models/ directory" << std::endl;
+        }
     }
-    
-    if (!benchModel.loadOBJ("models/classroom_desk.obj"))
+
+    // Lay out every part with its exact vertex count...
+    const RoomShell& room = scene.room;
+    shellParts.clear();
+    shellParts.resize(3);
+    int tilesX, tilesZ;
+    ceilingTiles(tilesX, tilesZ);
+    shellParts[0].count = QUAD_VERTICES;
+    shellParts[0].material = room.floorMaterial;
+    shellParts[1].count = QUAD_VERTICES * tilesX * tilesZ;
+    shellParts[1].material = room.ceilingMaterial;
+    shellParts[2].count = 4 * QUAD_VERTICES;
+    shellParts[2].material = room.wallMaterial;
+    std::vector<size_t> boxPart;
+    planBoxes(boxPart);
+    planFallbacks();
+
+    // ...then generate straight into one arena block, with no reallocation
+    size_t floats = 0;
+    for (size_t i = 0; i < shellParts.size(); i++)
+        floats += shellParts[i].count * VERTEX_FLOATS;
+    for (size_t i = 0; i < fallbackParts.size(); i++)
+        floats += fallbackParts[i].count * VERTEX_FLOATS;
+    arena.release();
+    arena.reserve(floats);
+    for (size_t i = 0; i < shellParts.size(); i++)
+        shellParts[i].vertices = arena.allocate(shellParts[i].count * VERTEX_FLOATS);
+    for (size_t i = 0; i < fallbackParts.size(); i++)
+        fallbackParts[i].vertices = fallbackParts[i].count ? arena.allocate(fallbackParts[i].count * VERTEX_FLOATS) : NULL;
+
+    generateFloor(shellParts[0]);
+    generateCeiling(shellParts[1]);
+    generateWalls(shellParts[2]);
+    generateBoxes(boxPart);
+    generateFallbacks();
+
+    planLightmap();
+    loadLightmapImage();
+    planAnimation();
+    planStaticBatches();
+}
+
+void Classroom::planAnimation()
+{
+    // Spinning instances of models with a spin group; the others keep turning as a whole
+    animatedBatches.clear();
+    for (size_t m = 0; m < scene.models.size(); m++)
+    {
+        const std::string& group = scene.models[m].spinGroup;
+        if (group.empty() || !modelInfo[m].loaded)
+            continue;
+        if (!modelInfo[m].hasPart(group))
+        {
+            std::cout << "Warning: Model " << scene.models[m].name << " has no OBJ group '" << group
+                      << "'; its instances spin as a whole" << std::endl;
+            continue;
+        }
+        AnimatedBatch batch;
+        batch.model = (uint16_t)m;
+        const InstanceRange& range = scene.modelRanges[m];
+        for (uint32_t i = range.first; i < range.first + range.count; i++)
+        {
+            if (scene.instances.spin[i] != 0.0f)
+                batch.instances.push_back(i);
+        }
+        if (!batch.instances.empty())
+            animatedBatches.push_back(batch);
+    }
+}
+
+void Classroom::uploadAnimation(AnimatedBatch& batch)
+{
+    const Model& model = *models[batch.model];
+    const ModelPart* part = model.part(scene.models[batch.model].spinGroup);
+    const SceneInstances& inst = scene.instances;
+
+    // Per instance: placement without the spin (column-major mat4), then degrees per second and
+    // the vertex range of the spin group
+    const size_t INSTANCE_FLOATS = 20;
+    std::vector<float> data(batch.instances.size() * INSTANCE_FLOATS);
+    batch.center = glm::vec3(0.0f);
+    for (size_t k = 0; k < batch.instances.size(); k++)
+    {
+        uint32_t i = batch.instances[k];
+        glm::vec3 position = origin + glm::vec3(inst.posX[i], inst.posY[i], inst.posZ[i]);
+        glm::mat4 placement = glm::translate(glm::mat4(1.0f), position);
+        placement = glm::rotate(placement, glm::radians(inst.yaw[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+        placement = glm::scale(placement, glm::vec3(inst.scale[i]));
+        float* out = &data[k * INSTANCE_FLOATS];
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                out[c * 4 + r] = placement[c][r];
+        out[16] = inst.spin[i];
+        out[17] = part ? (float)part->first : 0.0f;
+        out[18] = part ? (float)part->count : 0.0f;
+        out[19] = 0.0f;
+        batch.center += position / (float)batch.instances.size();
+    }
+
+    if (batch.VAO == 0)
+    {
+        glGenVertexArrays(1, &batch.VAO);
+        glGenBuffers(1, &batch.instanceBuffer);
+    }
+    glBindVertexArray(batch.VAO);
+    bindVertexAttributes(model.VBO);
+
+    // Instance attributes: the matrix takes locations 5-8, the animation 9
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+    for (unsigned int a = 0; a < 5; a++)
+    {
+        glVertexAttribPointer(5 + a, 4, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float),
+                              (void*)(a * 4 * sizeof(float)));
+        glEnableVertexAttribArray(5 + a);
+        glVertexAttribDivisor(5 + a, batch.divisor);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    batch.modelRevision = model.revision;
+}
+
+void Classroom::planStaticBatches()
+{
+    // Instances are sorted by model, so each model's batches are gathered in one pass
+    staticBatches.clear();
+    const SceneInstances& inst = scene.instances;
+    for (size_t m = 0; m < scene.modelRanges.size(); m++)
+    {
+        const InstanceRange& range = scene.modelRanges[m];
+        size_t firstBatch = staticBatches.size();
+        for (uint32_t i = range.first; i < range.first + range.count; i++)
+        {
+            if (!staticInstance(i))
+                continue;
+            bool lightmapped = lightmapLayout.instanceRects[i].x > 0.0f;
+            size_t b = firstBatch;
+            while (b < staticBatches.size() &&
+                   (staticBatches[b].material != inst.material[i] || staticBatches[b].lightmapped != lightmapped))
+                b++;
+            if (b == staticBatches.size())
+            {
+                staticBatches.push_back(StaticBatch());
+                staticBatches[b].model = (uint16_t)m;
+                staticBatches[b].material = inst.material[i];
+                staticBatches[b].lightmapped = lightmapped;
+            }
+            staticBatches[b].instances.push_back(i);
+        }
+    }
+}
+
+void Classroom::uploadStaticBatch(StaticBatch& batch, bool loaded)
+{
+    // Per instance: world matrix (column-major mat4, from updateTransforms) and lightmap rect
+    const size_t INSTANCE_FLOATS = 20;
+    std::vector<float> data(batch.instances.size() * INSTANCE_FLOATS);
+    batch.center = glm::vec3(0.0f);
+    for (size_t k = 0; k < batch.instances.size(); k++)
+    {
+        uint32_t i = batch.instances[k];
+        float* out = &data[k * INSTANCE_FLOATS];
+        std::memcpy(out, &transforms.models[i][0][0], 16 * sizeof(float));
+        std::memcpy(out + 16, &lightmapLayout.instanceRects[i][0], 4 * sizeof(float));
+        glm::vec3 center((transforms.minX[i] + transforms.maxX[i]) * 0.5f,
+                         (transforms.minY[i] + transforms.maxY[i]) * 0.5f,
+                         (transforms.minZ[i] + transforms.maxZ[i]) * 0.5f);
+        batch.center += center / (float)batch.instances.size();
+    }
+
+    // A new VAO each time: the lightmap coordinates come and go with the model
+    if (batch.VAO != 0)
+        glDeleteVertexArrays(1, &batch.VAO);
+    glGenVertexArrays(1, &batch.VAO);
+    if (batch.instanceBuffer == 0)
+        glGenBuffers(1, &batch.instanceBuffer);
+    glBindVertexArray(batch.VAO);
+    const Model& model = *models[batch.model];
+    bindVertexAttributes(loaded ? model.VBO : fallbackParts[batch.model].VBO);
+    if (loaded && model.lightmapVBO != 0)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, model.lightmapVBO);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(4);
+    }
+
+    // Instance attributes: the matrix takes locations 5-8, the rect 10 (9 is the animation's)
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+    for (unsigned int a = 0; a < 5; a++)
+    {
+        unsigned int location = a < 4 ? 5 + a : 10;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, INSTANCE_FLOATS * sizeof(float),
+                              (void*)(a * 4 * sizeof(float)));
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, batch.divisor);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    batch.modelLoaded = loaded;
+    batch.modelRevision = model.revision;
+}
+
+const AnimatedBatch* Classroom::animatedBatch(size_t model) const
+{
+    for (size_t i = 0; i < animatedBatches.size(); i++)
+    {
+        if (animatedBatches[i].model == model)
+            return &animatedBatches[i];
+    }
+    return NULL;
+}
+
+void Classroom::planLightmap()
+{
+    // Charts of every lit shell part and static model instance, sized at a fixed texel density.
+    // Stand-ins and spinning instances stay dynamically lit.
+    float gutter = LIGHTMAP_GUTTER_TEXELS / LIGHTMAP_TEXELS_PER_METER;
+    std::vector<LightmapRect> rects;
+    std::vector<glm::vec4*> targets;
+    lightmapLayout = LightmapLayout();
+    lightmapLayout.instanceRects.assign(scene.instances.size(), glm::vec4(0.0f));
+
+    uint64_t hash = hashBytes(&LIGHTMAP_TEXELS_PER_METER, sizeof(float));
+    for (size_t i = 0; i < shellParts.size(); i++)
+    {
+        MeshPart& part = shellParts[i];
+        part.lightmapRect = glm::vec4(0.0f);
+        if (part.emissive || part.count == 0)
+            continue;
+        part.lightmapExtent = unwrapLightmap(part.vertices, part.count, gutter, part.lightmapUVs);
+        hash = hashBytes(&part.lightmapUVs[0], part.lightmapUVs.size() * sizeof(float), hash);
+        LightmapRect rect = { 0, 0, 0, 0 };
+        rect.width = rect.height = (unsigned int)std::ceil(part.lightmapExtent * LIGHTMAP_TEXELS_PER_METER);
+        rects.push_back(rect);
+        targets.push_back(&part.lightmapRect);
+    }
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        const ModelInfo& model = modelInfo[scene.instances.model[i]];
+        if (!staticInstance(i) || !model.loaded || model.lightmapExtent <= 0.0f)
+            continue;
+        float extent = model.lightmapExtent * scene.instances.scale[i];
+        hash = hashBytes(&extent, sizeof(float), hash);
+        LightmapRect rect = { 0, 0, 0, 0 };
+        rect.width = rect.height = (unsigned int)std::ceil(extent * LIGHTMAP_TEXELS_PER_METER);
+        rects.push_back(rect);
+        targets.push_back(&lightmapLayout.instanceRects[i]);
+    }
+    if (rects.empty())
+        return;
+
+    packLightmap(rects, lightmapLayout.width, lightmapLayout.height);
+    glm::vec2 size((float)lightmapLayout.width, (float)lightmapLayout.height);
+    for (size_t i = 0; i < rects.size(); i++)
     {
-        std::cout << "Warning: Failed to load bench model. Please place bench.obj in models/ directory" << std::endl;
+        *targets[i] = glm::vec4(rects[i].width / size.x, rects[i].height / size.y, rects[i].x / size.x,
+                                rects[i].y / size.y);
+        hash = hashBytes(&rects[i], sizeof(LightmapRect), hash);
     }
+    lightmapLayout.hash = hashBytes(&lightmapLayout.width, sizeof(unsigned int) * 2, hash);
+}
 
+void Classroom::loadLightmapImage()
+{
+    lightmapImage = LightmapImage();
+    if (lightmapPath.empty() || lightmapLayout.width == 0 || !loadLightmap(lightmapPath, lightmapImage))
+        return;
+    if (lightmapImage.width != lightmapLayout.width || lightmapImage.height != lightmapLayout.height ||
+        lightmapImage.layoutHash != lightmapLayout.hash)
+    {
+        std::cout << "Warning: Lightmap " << lightmapPath << " was baked for different geometry, lighting "
+                  << "dynamically; rebake with --bake-lightmap" << std::endl;
+        lightmapImage = LightmapImage();
+    }
+}
 
+void Classroom::uploadLightmap()
+{
+    if (lightmapImage.texels.empty() || lightmapTexture != 0)
+        return;
+    glGenTextures(1, &lightmapTexture);
+    glBindTexture(GL_TEXTURE_2D, lightmapTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB9_E5, lightmapImage.width, lightmapImage.height, 0, GL_RGB,
+                 GL_UNSIGNED_INT_5_9_9_9_REV, &lightmapImage.texels[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (!retainGeometry)
+        std::vector<uint32_t>().swap(lightmapImage.texels);
 }
 
-void Classroom::generateFloor()
+bool Classroom::uploadGeometry(size_t& byteBudget)
 {
-    floorVertices.clear();
+    // Always make progress by at least one buffer per call
+    bool first = true;
+    std::vector<MeshPart*> parts;
+    for (size_t i = 0; i < shellParts.size(); i++)
+        parts.push_back(&shellParts[i]);
+    for (size_t i = 0; i < fallbackParts.size(); i++)
+        parts.push_back(&fallbackParts[i]);
+
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        if (parts[i]->VAO != 0 || parts[i]->count == 0)
+            continue;
+        if (!first && byteBudget == 0)
+            return false;
+        setupBuffers(*parts[i]);
+        size_t bytes = parts[i]->bytes();
+        byteBudget = bytes < byteBudget ? byteBudget - bytes : 0;
+        first = false;
+    }
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        if (models[i]->uploaded() || !models[i]->loaded())
+            continue;
+        if (!first && byteBudget == 0)
+            return false;
+        assets->uploadModel(modelHandles[i]);
+        size_t bytes = models[i]->gpuBytes();
+        byteBudget = bytes < byteBudget ? byteBudget - bytes : 0;
+        first = false;
+    }
+
+    // Everything is on the GPU: the generated vertices are no longer needed unless asked for
+    if (!retainGeometry)
+    {
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            parts[i]->vertices = NULL;
+            std::vector<float>().swap(parts[i]->lightmapUVs);
+        }
+        arena.release();
+    }
+    if (textureRefs.empty())
+        acquireTextures();
+    uploadLightmap();
+    return true;
+}
+
+size_t Classroom::hostBytes() const
+{
+    size_t bytes = arena.capacityBytes() + lightmapImage.texels.capacity() * sizeof(uint32_t);
+    for (size_t i = 0; i < shellParts.size(); i++)
+        bytes += shellParts[i].lightmapUVs.capacity() * sizeof(float);
+    return bytes;
+}
+
+size_t Classroom::gpuBytes() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < shellParts.size(); i++)
+        bytes += shellParts[i].VAO ? shellParts[i].bytes() : 0;
+    for (size_t i = 0; i < fallbackParts.size(); i++)
+        bytes += fallbackParts[i].VAO ? fallbackParts[i].bytes() : 0;
+    if (lightmapTexture != 0)
+        bytes += (size_t)lightmapLayout.width * lightmapLayout.height * sizeof(uint32_t);
+    for (size_t i = 0; i < animatedBatches.size(); i++)
+        bytes += animatedBatches[i].VAO ? animatedBatches[i].instances.size() * 20 * sizeof(float) : 0;
+    for (size_t i = 0; i < staticBatches.size(); i++)
+        bytes += staticBatches[i].VAO ? staticBatches[i].instances.size() * 20 * sizeof(float) : 0;
+    return bytes;
+}
+
+void Classroom::ceilingTiles(int& tilesX, int& tilesZ) const
+{
+    // Scene loading rejects larger rooms; clamped as well for scenes built in code
+    float tilesAcross = std::floor(scene.room.width / CEILING_TILE_SIZE);
+    float tilesDeep = std::floor(scene.room.length / CEILING_TILE_SIZE);
+    tilesX = tilesAcross >= 1.0f ? (int)std::min(tilesAcross, (float)MAX_CEILING_TILES) : 0;
+    tilesZ = tilesDeep >= 1.0f && tilesX > 0 ? (int)std::min(tilesDeep, (float)(MAX_CEILING_TILES / tilesX)) : 0;
+}
+
+void Classroom::generateFloor(MeshPart& part)
+{
+    const RoomShell& room = scene.room;
+    float* out = part.vertices;
     
     // Create floor as a large quad
-    glm::vec3 v1(-ROOM_WIDTH/2, 0.0f, -ROOM_LENGTH/2);
-    glm::vec3 v2(ROOM_WIDTH/2, 0.0f, -ROOM_LENGTH/2);
-    glm::vec3 v3(ROOM_WIDTH/2, 0.0f, ROOM_LENGTH/2);
-    glm::vec3 v4(-ROOM_WIDTH/2, 0.0f, ROOM_LENGTH/2);
+    glm::vec3 v1(-room.width/2, 0.0f, -room.length/2);
+    glm::vec3 v2(room.width/2, 0.0f, -room.length/2);
+    glm::vec3 v3(room.width/2, 0.0f, room.length/2);
+    glm::vec3 v4(-room.width/2, 0.0f, room.length/2);
     
     glm::vec3 normal(0.0f, 1.0f, 0.0f);
     
-    addQuad(floorVertices, v1, v2, v3, v4, normal,
+    addQuad(out, v1, v2, v3, v4, normal,
            glm::vec2(0.0f, 0.0f), glm::vec2(4.0f, 0.0f), 
            glm::vec2(4.0f, 3.0f), glm::vec2(0.0f, 3.0f));
 }
 
-void Classroom::generateCeiling()
+void Classroom::generateCeiling(MeshPart& part)
 {
-    ceilingVertices.clear();
+    const RoomShell& room = scene.room;
+    float* out = part.vertices;
     
     // Create ceiling with square tiles
-    float tileSize = 0.5f;  // Size of each square tile (60cm x 60cm)
+    float tileSize = CEILING_TILE_SIZE;
     float gap = 0.01f;      // Small gap between tiles for visible grid lines
     
-    int numTilesX = (int)(ROOM_WIDTH / tileSize);
-    int numTilesZ = (int)(ROOM_LENGTH / tileSize);
+    int numTilesX, numTilesZ;
+    ceilingTiles(numTilesX, numTilesZ);
     
-    float startX = -ROOM_WIDTH / 2.0f;
-    float startZ = -ROOM_LENGTH / 2.0f;
+    float startX = -room.width / 2.0f;
+    float startZ = -room.length / 2.0f;
     
     glm::vec3 normal(0.0f, -1.0f, 0.0f);
     
@@ -115,91 +556,143 @@ void Classroom::generateCeiling()
             float z1 = startZ + j * tileSize + gap;
             float z2 = startZ + (j + 1) * tileSize - gap;
             
-            glm::vec3 v1(x1, ROOM_HEIGHT, z1);
-            glm::vec3 v2(x2, ROOM_HEIGHT, z1);
-            glm::vec3 v3(x2, ROOM_HEIGHT, z2);
-            glm::vec3 v4(x1, ROOM_HEIGHT, z2);
+            glm::vec3 v1(x1, room.height, z1);
+            glm::vec3 v2(x2, room.height, z1);
+            glm::vec3 v3(x2, room.height, z2);
+            glm::vec3 v4(x1, room.height, z2);
             
-            addQuad(ceilingVertices, v1, v2, v3, v4, normal,
+            addQuad(out, v1, v2, v3, v4, normal,
                    glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), 
                    glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
         }
     }
 }
 
-void Classroom::generateWalls()
+void Classroom::generateWalls(MeshPart& part)
 {
-    wallVertices.clear();
+    const RoomShell& room = scene.room;
+    const float W = room.width, L = room.length, H = room.height;
+    float* out = part.vertices;
     
     // Front wall (where green board is)
-    glm::vec3 front_v1(-ROOM_WIDTH/2, 0.0f, ROOM_LENGTH/2);
-    glm::vec3 front_v2(ROOM_WIDTH/2, 0.0f, ROOM_LENGTH/2);
-    glm::vec3 front_v3(ROOM_WIDTH/2, ROOM_HEIGHT, ROOM_LENGTH/2);
-    glm::vec3 front_v4(-ROOM_WIDTH/2, ROOM_HEIGHT, ROOM_LENGTH/2);
+    glm::vec3 front_v1(-W/2, 0.0f, L/2);
+    glm::vec3 front_v2(W/2, 0.0f, L/2);
+    glm::vec3 front_v3(W/2, H, L/2);
+    glm::vec3 front_v4(-W/2, H, L/2);
     
-    addQuad(wallVertices, front_v1, front_v2, front_v3, front_v4, 
+    addQuad(out, front_v1, front_v2, front_v3, front_v4, 
            glm::vec3(0.0f, 0.0f, -1.0f),
            glm::vec2(0.0f, 0.0f), glm::vec2(6.0f, 0.0f), 
            glm::vec2(6.0f, 2.0f), glm::vec2(0.0f, 2.0f));
     
     // Back wall (entrance side)
-    glm::vec3 back_v1(ROOM_WIDTH/2, 0.0f, -ROOM_LENGTH/2);
-    glm::vec3 back_v2(-ROOM_WIDTH/2, 0.0f, -ROOM_LENGTH/2);
-    glm::vec3 back_v3(-ROOM_WIDTH/2, ROOM_HEIGHT, -ROOM_LENGTH/2);
-    glm::vec3 back_v4(ROOM_WIDTH/2, ROOM_HEIGHT, -ROOM_LENGTH/2);
+    glm::vec3 back_v1(W/2, 0.0f, -L/2);
+    glm::vec3 back_v2(-W/2, 0.0f, -L/2);
+    glm::vec3 back_v3(-W/2, H, -L/2);
+    glm::vec3 back_v4(W/2, H, -L/2);
     
-    addQuad(wallVertices, back_v1, back_v2, back_v3, back_v4, 
+    addQuad(out, back_v1, back_v2, back_v3, back_v4, 
            glm::vec3(0.0f, 0.0f, 1.0f),
            glm::vec2(0.0f, 0.0f), glm::vec2(6.0f, 0.0f), 
            glm::vec2(6.0f, 2.0f), glm::vec2(0.0f, 2.0f));
     
     // Left wall (windows side)
-    glm::vec3 left_v1(-ROOM_WIDTH/2, 0.0f, -ROOM_LENGTH/2);
-    glm::vec3 left_v2(-ROOM_WIDTH/2, 0.0f, ROOM_LENGTH/2);
-    glm::vec3 left_v3(-ROOM_WIDTH/2, ROOM_HEIGHT, ROOM_LENGTH/2);
-    glm::vec3 left_v4(-ROOM_WIDTH/2, ROOM_HEIGHT, -ROOM_LENGTH/2);
+    glm::vec3 left_v1(-W/2, 0.0f, -L/2);
+    glm::vec3 left_v2(-W/2, 0.0f, L/2);
+    glm::vec3 left_v3(-W/2, H, L/2);
+    glm::vec3 left_v4(-W/2, H, -L/2);
     
-    addQuad(wallVertices, left_v1, left_v2, left_v3, left_v4, 
+    addQuad(out, left_v1, left_v2, left_v3, left_v4, 
            glm::vec3(1.0f, 0.0f, 0.0f),
            glm::vec2(0.0f, 0.0f), glm::vec2(4.0f, 0.0f), 
            glm::vec2(4.0f, 2.0f), glm::vec2(0.0f, 2.0f));
     
     // Right wall
-    glm::vec3 right_v1(ROOM_WIDTH/2, 0.0f, ROOM_LENGTH/2);
-    glm::vec3 right_v2(ROOM_WIDTH/2, 0.0f, -ROOM_LENGTH/2);
-    glm::vec3 right_v3(ROOM_WIDTH/2, ROOM_HEIGHT, -ROOM_LENGTH/2);
-    glm::vec3 right_v4(ROOM_WIDTH/2, ROOM_HEIGHT, ROOM_LENGTH/2);
+    glm::vec3 right_v1(W/2, 0.0f, L/2);
+    glm::vec3 right_v2(W/2, 0.0f, -L/2);
+    glm::vec3 right_v3(W/2, H, -L/2);
+    glm::vec3 right_v4(W/2, H, L/2);
     
-    addQuad(wallVertices, right_v1, right_v2, right_v3, right_v4, 
+    addQuad(out, right_v1, right_v2, right_v3, right_v4, 
            glm::vec3(-1.0f, 0.0f, 0.0f),
            glm::vec2(0.0f, 0.0f), glm::vec2(4.0f, 0.0f), 
            glm::vec2(4.0f, 2.0f), glm::vec2(0.0f, 2.0f));
 }
 
-void Classroom::generateDoors()
+void Classroom::planBoxes(std::vector<size_t>& boxPart)
 {
-    doorVertices.clear();
-    
-    // Door on the left wall near the front
-    float doorWidth = 1.0f;
-    float doorHeight = 2.1f;
-    float doorZ = -ROOM_LENGTH/2 + 1.5f; // Near the front wall (1.5m from front)
-    
-    addCube(doorVertices, 
-           glm::vec3(-ROOM_WIDTH/2 + 0.05f, doorHeight/2, doorZ), 
-           glm::vec3(0.001f, doorHeight, doorWidth));
+    // Doors, boards and light fixtures: one part per material, one more for all fixtures
+    const SceneBoxes& boxes = scene.boxes;
+    size_t firstBoxPart = shellParts.size();
+    boxPart.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        bool emissive = boxes.emissive[i] != 0;
+        size_t p = firstBoxPart;
+        while (p < shellParts.size() &&
+               !(shellParts[p].emissive == emissive && (emissive || shellParts[p].material == boxes.material[i])))
+            p++;
+        if (p == shellParts.size())
+        {
+            shellParts.push_back(MeshPart());
+            shellParts.back().material = boxes.material[i];
+            shellParts.back().emissive = emissive;
+        }
+        shellParts[p].count += CUBE_VERTICES;
+        boxPart[i] = p;
+    }
 }
 
-void Classroom::generateWindows()
+void Classroom::generateBoxes(const std::vector<size_t>& boxPart)
 {
-    windowVertices.clear();
-    // No windows - keep the function but don't generate any geometry
+    const SceneBoxes& boxes = scene.boxes;
+    std::vector<float*> cursors(shellParts.size());
+    for (size_t p = 0; p < shellParts.size(); p++)
+        cursors[p] = shellParts[p].vertices;
+
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        addCube(cursors[boxPart[i]],
+               glm::vec3(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]),
+               glm::vec3(boxes.sizeX[i], boxes.sizeY[i], boxes.sizeZ[i]));
+    }
 }
 
-void Classroom::generateBenches()
+void Classroom::planFallbacks()
+{
+    // Built even when the model loads: the GPU path draws them as the distant LOD
+    fallbackParts.assign(scene.models.size(), MeshPart());
+    for (size_t i = 0; i < scene.models.size(); i++)
+    {
+        if (scene.models[i].fallback == FALLBACK_BOX)
+            fallbackParts[i].count = CUBE_VERTICES;
+        else if (scene.models[i].fallback == FALLBACK_BENCH)
+            fallbackParts[i].count = BENCH_VERTICES;
+    }
+}
+
+void Classroom::generateFallbacks()
+{
+    for (size_t i = 0; i < scene.models.size(); i++)
+    {
+        const SceneModel& model = scene.models[i];
+        float* out = fallbackParts[i].vertices;
+        if (fallbackParts[i].count == 0)
+            continue;
+
+        if (model.fallback == FALLBACK_BOX)
+        {
+            addCube(out, glm::vec3(0.0f, model.fallbackSize.y / 2, 0.0f), model.fallbackSize);
+        }
+        else if (model.fallback == FALLBACK_BENCH)
+        {
+            addBench(out);
+        }
+    }
+}
+
+void Classroom::addBench(float*& out)
 {
-    benchVertices.clear();
-    
     // Realistic classroom bench dimensions
     float benchWidth = 1.8f;
     float benchDepth = 0.45f;     // Slightly deeper for comfort
@@ -215,177 +708,96 @@ void Classroom::generateBenches()
     float beamHeight = 0.08f;
     float beamDepth = 0.06f;
     
-    // 4 rows of benches, 3 benches per row - shifted forward from green board
-    for(int row = 0; row < 4; row++)
-    {
-        for(int col = 0; col < 3; col++)
-        {
-            float x = -3.0f + col * 2.2f;
-            float z = -0.5f + row * 1.2f; // Shifted 1.5m forward to create gap from green board
-            
-            // Bench seat (main seating surface)
-            addCube(benchVertices, 
-                   glm::vec3(x, seatHeight, z), 
-                   glm::vec3(benchWidth, seatThickness, benchDepth));
-            
-            // Backrest
-            addCube(benchVertices, 
-                   glm::vec3(x, seatHeight + seatThickness/2 + backrestHeight/2, z + benchDepth/2 - backrestThickness/2), 
-                   glm::vec3(benchWidth, backrestHeight, backrestThickness));
-            
-            // Front legs (2 legs)
-            float frontLegZ = z - benchDepth/2 + legDepth/2;
-            addCube(benchVertices, 
-                   glm::vec3(x - benchWidth/2 + legWidth/2, seatHeight/2, frontLegZ), 
-                   glm::vec3(legWidth, seatHeight, legDepth));
-            addCube(benchVertices, 
-                   glm::vec3(x + benchWidth/2 - legWidth/2, seatHeight/2, frontLegZ), 
-                   glm::vec3(legWidth, seatHeight, legDepth));
-            
-            // Back legs (2 legs) - supporting the backrest
-            float backLegZ = z + benchDepth/2 - legDepth/2;
-            float backLegHeight = seatHeight + backrestHeight;
-            addCube(benchVertices, 
-                   glm::vec3(x - benchWidth/2 + legWidth/2, backLegHeight/2, backLegZ), 
-                   glm::vec3(legWidth, backLegHeight, legDepth));
-            addCube(benchVertices, 
-                   glm::vec3(x + benchWidth/2 - legWidth/2, backLegHeight/2, backLegZ), 
-                   glm::vec3(legWidth, backLegHeight, legDepth));
-            
-            // Horizontal support beams for stability
-            // Front support beam
-            addCube(benchVertices, 
-                   glm::vec3(x, seatHeight * 0.3f, frontLegZ), 
-                   glm::vec3(beamWidth, beamHeight, beamDepth));
-            
-            // Back support beam
-            addCube(benchVertices, 
-                   glm::vec3(x, seatHeight * 0.3f, backLegZ), 
-                   glm::vec3(beamWidth, beamHeight, beamDepth));
-            
-            // Side support beams (connecting front and back)
-            float sideBeamX1 = x - benchWidth/2 + legWidth/2;
-            float sideBeamX2 = x + benchWidth/2 - legWidth/2;
-            addCube(benchVertices, 
-                   glm::vec3(sideBeamX1, seatHeight * 0.3f, z), 
-                   glm::vec3(beamDepth, beamHeight, benchDepth - legDepth));
-            addCube(benchVertices, 
-                   glm::vec3(sideBeamX2, seatHeight * 0.3f, z), 
-                   glm::vec3(beamDepth, beamHeight, benchDepth - legDepth));
-        }
-    }
-}
-
-
-
-void Classroom::generatePodium()
-{
-    podiumVertices.clear();
-    
-    // Teacher's podium beside the green board on back wall
-    float podiumWidth = 0.8f;  // Decreased width for better proportions
-    float podiumDepth = 0.8f;
-    float podiumHeight = 1.2f; // Increased height for better functionality
-    
-    // Position podium to the right side of the green board - shifted for better accessibility
-    float podiumX = 3.2f; // Slightly closer to center for better positioning relative to benches
-    float podiumZ = -ROOM_LENGTH/2 + podiumDepth/2 + 0.8f; // Further from back wall, closer to teaching area
-    
-    addCube(podiumVertices, 
-           glm::vec3(podiumX, podiumHeight/2, podiumZ), 
-           glm::vec3(podiumWidth, podiumHeight, podiumDepth));
+    // Single bench centred on the origin, seat facing -Z
+    float x = 0.0f;
+    float z = 0.0f;
+    
+    // Bench seat (main seating surface)
+    addCube(out, 
+           glm::vec3(x, seatHeight, z), 
+           glm::vec3(benchWidth, seatThickness, benchDepth));
+    
+    // Backrest
+    addCube(out, 
+           glm::vec3(x, seatHeight + seatThickness/2 + backrestHeight/2, z + benchDepth/2 - backrestThickness/2), 
+           glm::vec3(benchWidth, backrestHeight, backrestThickness));
+    
+    // Front legs (2 legs)
+    float frontLegZ = z - benchDepth/2 + legDepth/2;
+    addCube(out, 
+           glm::vec3(x - benchWidth/2 + legWidth/2, seatHeight/2, frontLegZ), 
+           glm::vec3(legWidth, seatHeight, legDepth));
+    addCube(out, 
+           glm::vec3(x + benchWidth/2 - legWidth/2, seatHeight/2, frontLegZ), 
+           glm::vec3(legWidth, seatHeight, legDepth));
+    
+    // Back legs (2 legs) - supporting the backrest
+    float backLegZ = z + benchDepth/2 - legDepth/2;
+    float backLegHeight = seatHeight + backrestHeight;
+    addCube(out, 
+           glm::vec3(x - benchWidth/2 + legWidth/2, backLegHeight/2, backLegZ), 
+           glm::vec3(legWidth, backLegHeight, legDepth));
+    addCube(out, 
+           glm::vec3(x + benchWidth/2 - legWidth/2, backLegHeight/2, backLegZ), 
+           glm::vec3(legWidth, backLegHeight, legDepth));
+    
+    // Horizontal support beams for stability
+    // Front support beam
+    addCube(out, 
+           glm::vec3(x, seatHeight * 0.3f, frontLegZ), 
+           glm::vec3(beamWidth, beamHeight, beamDepth));
+    
+    // Back support beam
+    addCube(out, 
+           glm::vec3(x, seatHeight * 0.3f, backLegZ), 
+           glm::vec3(beamWidth, beamHeight, beamDepth));
+    
+    // Side support beams (connecting front and back)
+    float sideBeamX1 = x - benchWidth/2 + legWidth/2;
+    float sideBeamX2 = x + benchWidth/2 - legWidth/2;
+    addCube(out, 
+           glm::vec3(sideBeamX1, seatHeight * 0.3f, z), 
+           glm::vec3(beamDepth, beamHeight, benchDepth - legDepth));
+    addCube(out, 
+           glm::vec3(sideBeamX2, seatHeight * 0.3f, z), 
+           glm::vec3(beamDepth, beamHeight, benchDepth - legDepth));
 }
 
-void Classroom::generateGreenBoard()
+static inline void writeVertex(float*& out, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv)
 {
-    boardVertices.clear();
-    
-    // Two green boards on the front wall - side by side
-    float boardWidth = 4.3f;  // Width of each board
-    float boardHeight = 1.5f; // Height of boards
-    float boardY = 1.8f;      // Vertical position
-    float boardThickness = 0.08f; // Thickness
-    float spacing = 0.04f;     // Space between the two boards
-    
-    // Left board
-    addCube(boardVertices, 
-           glm::vec3(-boardWidth/2 - spacing/2, boardY, -ROOM_LENGTH/2 + boardThickness/2), 
-           glm::vec3(boardWidth, boardHeight, boardThickness));
-    
-    // Right board
-    addCube(boardVertices, 
-           glm::vec3(boardWidth/2 + spacing/2, boardY, -ROOM_LENGTH/2 + boardThickness/2), 
-           glm::vec3(boardWidth, boardHeight, boardThickness));
+    out[0] = position.x;
+    out[1] = position.y;
+    out[2] = position.z;
+    out[3] = normal.x;
+    out[4] = normal.y;
+    out[5] = normal.z;
+    out[6] = uv.x;
+    out[7] = uv.y;
+    out += VERTEX_FLOATS;
 }
 
-void Classroom::generateLights()
-{
-    lightVertices.clear();
-    
-    // Ceiling lights - fluorescent tubes
-    float lightWidth = 1.5f;
-    float lightDepth = 0.3f;
-    float lightHeight = 0.1f;
-    
-    // 6 lights arranged in 2 rows
-    for(int row = 0; row < 2; row++)
-    {
-        for(int col = 0; col < 3; col++)
-        {
-            float x = -3.0f + col * 3.0f;
-            float z = -1.0f + row * 2.0f;
-            
-            addCube(lightVertices, 
-                   glm::vec3(x, ROOM_HEIGHT - lightHeight/2, z), 
-                   glm::vec3(lightWidth, lightHeight, lightDepth));
-        }
-    }
-}
-
-void Classroom::addQuad(std::vector<float>& vertices, 
+void Classroom::addQuad(float*& out, 
                        glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec3 v4, 
                        glm::vec3 normal, glm::vec2 uv1, glm::vec2 uv2, glm::vec2 uv3, glm::vec2 uv4)
 {
     // First triangle (v1, v2, v3)
-    // Vertex 1
-    vertices.insert(vertices.end(), {v1.x, v1.y, v1.z});
-    vertices.insert(vertices.end(), {normal.x, normal.y, normal.z});
-    vertices.insert(vertices.end(), {uv1.x, uv1.y});
-    
-    // Vertex 2
-    vertices.insert(vertices.end(), {v2.x, v2.y, v2.z});
-    vertices.insert(vertices.end(), {normal.x, normal.y, normal.z});
-    vertices.insert(vertices.end(), {uv2.x, uv2.y});
-    
-    // Vertex 3
-    vertices.insert(vertices.end(), {v3.x, v3.y, v3.z});
-    vertices.insert(vertices.end(), {normal.x, normal.y, normal.z});
-    vertices.insert(vertices.end(), {uv3.x, uv3.y});
+    writeVertex(out, v1, normal, uv1);
+    writeVertex(out, v2, normal, uv2);
+    writeVertex(out, v3, normal, uv3);
     
     // Second triangle (v1, v3, v4)
-    // Vertex 1
-    vertices.insert(vertices.end(), {v1.x, v1.y, v1.z});
-    vertices.insert(vertices.end(), {normal.x, normal.y, normal.z});
-    vertices.insert(vertices.end(), {uv1.x, uv1.y});
-    
-    // Vertex 3
-    vertices.insert(vertices.end(), {v3.x, v3.y, v3.z});
-    vertices.insert(vertices.end(), {normal.x, normal.y, normal.z});
-    vertices.insert(vertices.end(), {uv3.x, uv3.y});
-    
-    // Vertex 4
-    vertices.insert(vertices.end(), {v4.x, v4.y, v4.z});
-    vertices.insert(vertices.end(), {normal.x, normal.y, normal.z});
-    vertices.insert(vertices.end(), {uv4.x, uv4.y});
+    writeVertex(out, v1, normal, uv1);
+    writeVertex(out, v3, normal, uv3);
+    writeVertex(out, v4, normal, uv4);
 }
 
-void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::vec3 size)
+void Classroom::addCube(float*& out, glm::vec3 position, glm::vec3 size)
 {
     float x = position.x, y = position.y, z = position.z;
     float w = size.x / 2.0f, h = size.y / 2.0f, d = size.z / 2.0f;
     
     // Front face
-    addQuad(vertices, 
+    addQuad(out, 
            glm::vec3(x-w, y-h, z+d), glm::vec3(x+w, y-h, z+d), 
            glm::vec3(x+w, y+h, z+d), glm::vec3(x-w, y+h, z+d),
            glm::vec3(0.0f, 0.0f, 1.0f),
@@ -393,7 +805,7 @@ void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::v
            glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
     
     // Back face
-    addQuad(vertices, 
+    addQuad(out, 
            glm::vec3(x+w, y-h, z-d), glm::vec3(x-w, y-h, z-d), 
            glm::vec3(x-w, y+h, z-d), glm::vec3(x+w, y+h, z-d),
            glm::vec3(0.0f, 0.0f, -1.0f),
@@ -401,7 +813,7 @@ void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::v
            glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
     
     // Left face
-    addQuad(vertices, 
+    addQuad(out, 
            glm::vec3(x-w, y-h, z-d), glm::vec3(x-w, y-h, z+d), 
            glm::vec3(x-w, y+h, z+d), glm::vec3(x-w, y+h, z-d),
            glm::vec3(-1.0f, 0.0f, 0.0f),
@@ -409,7 +821,7 @@ void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::v
            glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
     
     // Right face
-    addQuad(vertices, 
+    addQuad(out, 
            glm::vec3(x+w, y-h, z+d), glm::vec3(x+w, y-h, z-d), 
            glm::vec3(x+w, y+h, z-d), glm::vec3(x+w, y+h, z+d),
            glm::vec3(1.0f, 0.0f, 0.0f),
@@ -417,7 +829,7 @@ void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::v
            glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
     
     // Top face
-    addQuad(vertices, 
+    addQuad(out, 
            glm::vec3(x-w, y+h, z+d), glm::vec3(x+w, y+h, z+d), 
            glm::vec3(x+w, y+h, z-d), glm::vec3(x-w, y+h, z-d),
            glm::vec3(0.0f, 1.0f, 0.0f),
@@ -425,7 +837,7 @@ void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::v
            glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
     
     // Bottom face
-    addQuad(vertices, 
+    addQuad(out, 
            glm::vec3(x-w, y-h, z-d), glm::vec3(x+w, y-h, z-d), 
            glm::vec3(x+w, y-h, z+d), glm::vec3(x-w, y-h, z+d),
            glm::vec3(0.0f, -1.0f, 0.0f),
@@ -433,15 +845,31 @@ void Classroom::addCube(std::vector<float>& vertices, glm::vec3 position, glm::v
            glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f));
 }
 
-void Classroom::setupBuffers(unsigned int& VAO, unsigned int& VBO, const std::vector<float>& vertices)
+void Classroom::setupBuffers(MeshPart& part)
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    // Bounding box, its centre is the depth sorting reference
+    if (part.count > 0)
+    {
+        glm::vec3 minPos(part.vertices[0], part.vertices[1], part.vertices[2]);
+        glm::vec3 maxPos = minPos;
+        for (size_t i = 0; i < part.count * VERTEX_FLOATS; i += VERTEX_FLOATS)
+        {
+            glm::vec3 p(part.vertices[i], part.vertices[i + 1], part.vertices[i + 2]);
+            minPos = glm::min(minPos, p);
+            maxPos = glm::max(maxPos, p);
+        }
+        part.boundsMin = minPos;
+        part.boundsMax = maxPos;
+        part.center = (minPos + maxPos) * 0.5f;
+    }
 
-    glBindVertexArray(VAO);
+    glGenVertexArrays(1, &part.VAO);
+    glGenBuffers(1, &part.VBO);
+
+    glBindVertexArray(part.VAO);
     
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, part.VBO);
+    glBufferData(GL_ARRAY_BUFFER, part.count * VERTEX_FLOATS * sizeof(float), part.vertices, GL_STATIC_DRAW);
 
     // Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -455,209 +883,251 @@ void Classroom::setupBuffers(unsigned int& VAO, unsigned int& VBO, const std::ve
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // Lightmap coordinate attribute, from its own buffer
+    if (!part.lightmapUVs.empty())
+    {
+        glGenBuffers(1, &part.lightmapVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, part.lightmapVBO);
+        glBufferData(GL_ARRAY_BUFFER, part.lightmapUVs.size() * sizeof(float), &part.lightmapUVs[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(4);
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
-void Classroom::renderBuffer(unsigned int VAO, size_t vertexCount, 
-                           const glm::vec3& materialAmbient, 
-                           const glm::vec3& materialDiffuse, 
-                           const glm::vec3& materialSpecular, 
-                           Shader& shader)
+unsigned int Classroom::materialFeatures(const Material& material)
 {
-    shader.setVec3("material.ambient", materialAmbient);
-    shader.setVec3("material.diffuse", materialDiffuse);
-    shader.setVec3("material.specular", materialSpecular);
-    
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    // Materials without a highlight skip the specular term
+    unsigned int features = glm::dot(material.specular, material.specular) > 0.0f ? (unsigned int)FEATURE_SPECULAR : 0u;
+    if (material.diffuseMap != 0)
+        features |= FEATURE_TEXTURED;
+    return features;
 }
 
-void Classroom::render(Shader& shader)
+void Classroom::submit(RenderQueue& queue, ShaderVariants& shaders)
 {
-    // Render floor (gray tiles)
-    renderBuffer(floorVAO, floorVertices.size() / 8, 
-    glm::vec3(0.8f, 0.8f, 0.8f),   // Ambient - soft white
-    glm::vec3(0.95f, 0.95f, 0.95f), // Diffuse - bright white
-    glm::vec3(0.6f, 0.6f, 0.6f),   // Specular - adds slight shine
-    shader);
-
-    
-    // Render ceiling (white)
-    renderBuffer(ceilingVAO, ceilingVertices.size() / 8, 
-    glm::vec3(0.9f, 0.9f, 0.9f),   // Ambient - almost pure white
-    glm::vec3(1.0f, 1.0f, 1.0f),   // Diffuse - perfect white under light
-    glm::vec3(0.3f, 0.3f, 0.3f),   // Specular - slight shine to reflect light naturally
-    shader);
-
-    
-    // Render walls (light beige)
-    renderBuffer(wallsVAO, wallVertices.size() / 8, 
-                glm::vec3(0.8f, 0.75f, 0.65f), 
-                glm::vec3(0.9f, 0.85f, 0.75f), 
-                glm::vec3(0.1f, 0.1f, 0.1f), shader);
-    
+    // Room shell; light fixtures use the unlit variant
+    glm::mat4 placement = glm::translate(glm::mat4(1.0f), origin);
+    for (size_t i = 0; i < shellParts.size(); i++)
+    {
+        const MeshPart& part = shellParts[i];
+        if (part.emissive)
+        {
+            queue.submit(LAYER_EMISSIVE, shaders.get(FEATURE_EMISSIVE), part.VAO, (GLsizei)part.vertexCount(),
+                         NULL, placement, origin + part.center);
+        }
+        else
+        {
+            const Material& material = scene.materials[part.material];
+            bool baked = lightmapTexture != 0 && part.lightmapRect.x > 0.0f;
+            unsigned int features = materialFeatures(material) | (baked ? (unsigned int)FEATURE_LIGHTMAP : 0u);
+            queue.submit(LAYER_OPAQUE, shaders.get(features), part.VAO, (GLsizei)part.vertexCount(), &material,
+                         placement, origin + part.center, baked ? lightmapTexture : 0, part.lightmapRect);
+        }
+    }
 
-       // Render door on right wall (blackish brown wood)
-       renderBuffer(doorsVAO, doorVertices.size() / 8, 
-       glm::vec3(0.08f, 0.05f, 0.02f),   // ambient - very dark blackish brown
-       glm::vec3(0.18f, 0.12f, 0.05f),   // diffuse - dark blackish brown
-       glm::vec3(0.1f, 0.08f, 0.04f),    // specular - minimal reflection
-       shader);
-    
-    // No windows or podium in this classroom design
+    submitInstances(queue, shaders);
+}
 
-       // Render benches from OBJ model if available, otherwise use procedural geometry
-       if (!benchModel.vertices.empty())
-       {
-           renderBenches(shader);
-       }
-       else
-       {
-           renderBuffer(benchesVAO, benchVertices.size() / 8,
-           glm::vec3(0.35f, 0.20f, 0.07f),   // ambient - darker base
-           glm::vec3(0.65f, 0.40f, 0.15f),   // diffuse - rich teak color
-           glm::vec3(0.25f, 0.18f, 0.10f),   // specular - slight shine
-           shader);
-       }
+void Classroom::submit(SoftwareRasterizer& raster)
+{
+    // Mirrors submit(RenderQueue&) and submitInstances() draw for draw
+    const LightmapImage* baked = lightmapTexture != 0 && !lightmapImage.texels.empty() ? &lightmapImage : NULL;
+    glm::mat4 placement = glm::translate(glm::mat4(1.0f), origin);
+    for (size_t i = 0; i < shellParts.size(); i++)
+    {
+        const MeshPart& part = shellParts[i];
+        SoftwareDraw draw;
+        draw.vertices = part.vertices;
+        draw.count = part.vertexCount();
+        draw.model = placement;
+        if (!part.emissive)
+        {
+            draw.material = &scene.materials[part.material];
+            if (baked && part.lightmapRect.x > 0.0f && !part.lightmapUVs.empty())
+            {
+                draw.lightmap = baked;
+                draw.lightmapUVs = &part.lightmapUVs[0];
+                draw.lightmapRect = part.lightmapRect;
+            }
+        }
+        raster.draw(draw);
+    }
 
+    updateTransforms();
+    const SceneInstances& inst = scene.instances;
 
-    
-    // Render podium from OBJ model if available, otherwise use procedural geometry
-    if (!podiumModel.vertices.empty())
+    // Spinning sub-meshes: the instanced draw's placement (no spin) plus the spin group
+    for (size_t b = 0; b < animatedBatches.size(); b++)
     {
-        renderPodium(shader);
+        const AnimatedBatch& batch = animatedBatches[b];
+        const Model& model = *models[batch.model];
+        const ModelPart* part = model.part(scene.models[batch.model].spinGroup);
+        if (!model.uploaded() || model.vertices.empty() || !part)
+            continue;
+        const Material& material = scene.materials[inst.material[batch.instances[0]]];
+        for (size_t k = 0; k < batch.instances.size(); k++)
+        {
+            uint32_t i = batch.instances[k];
+            SoftwareDraw draw;
+            draw.vertices = &model.vertices[0];
+            draw.count = model.vertexCount;
+            draw.model = glm::translate(glm::mat4(1.0f), origin + glm::vec3(inst.posX[i], inst.posY[i], inst.posZ[i]));
+            draw.model = glm::rotate(draw.model, glm::radians(inst.yaw[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+            draw.model = glm::scale(draw.model, glm::vec3(inst.scale[i]));
+            draw.material = &material;
+            draw.spin = inst.spin[i];
+            draw.spinFirst = part->first;
+            draw.spinCount = part->count;
+            raster.draw(draw);
+        }
     }
-    else
+
+    for (size_t m = 0; m < scene.modelRanges.size(); m++)
     {
-        renderBuffer(podiumVAO, podiumVertices.size() / 8, 
-                    glm::vec3(0.2f, 0.15f, 0.1f), 
-                    glm::vec3(0.4f, 0.3f, 0.2f), 
-                    glm::vec3(0.15f, 0.1f, 0.08f), shader);
+        const InstanceRange& range = scene.modelRanges[m];
+        const Model& model = *models[m];
+        bool loaded = model.uploaded();
+        const MeshPart& fallback = fallbackParts[m];
+        const float* vertices = loaded ? (model.vertices.empty() ? NULL : &model.vertices[0]) : fallback.vertices;
+        if (!vertices)
+            continue;  // Freed after upload, or no stand-in
+        bool animated = loaded && animatedBatch(m) != NULL;
+
+        for (uint32_t i = range.first; i < range.first + range.count; i++)
+        {
+            if (animated && inst.spin[i] != 0.0f)
+                continue;  // Drawn with its animated batch
+            SoftwareDraw draw;
+            draw.vertices = vertices;
+            draw.count = loaded ? model.vertexCount : fallback.vertexCount();
+            draw.model = transforms.models[i];
+            draw.material = &scene.materials[inst.material[i]];
+            // Stand-ins have no lightmap coordinates
+            if (loaded && baked && lightmapLayout.instanceRects[i].x > 0.0f && !model.lightmapUVs.empty())
+            {
+                draw.lightmap = baked;
+                draw.lightmapUVs = &model.lightmapUVs[0];
+                draw.lightmapRect = lightmapLayout.instanceRects[i];
+            }
+            raster.draw(draw);
+        }
     }
-    
-    // Render green boards (blackish-green color)
-    renderBuffer(boardVAO, boardVertices.size() / 8,
-    glm::vec3(0.02f, 0.08f, 0.02f),   // ambient - very dark blackish-green
-    glm::vec3(0.05f, 0.15f, 0.05f),   // diffuse - dark blackish-green
-    glm::vec3(0.03f, 0.08f, 0.03f),   // specular - minimal highlights
-    shader);
 }
 
-void Classroom::renderLights(Shader& lightShader)
-{
-    // Set light color
-    lightShader.setVec3("lightColor", glm::vec3(1.0f, 1.0f, 0.9f));
-    
-    // Render light fixtures
-    glBindVertexArray(lightsVAO);
-    glDrawArrays(GL_TRIANGLES, 0, lightVertices.size() / 8);
-}
 void Classroom::updateFan(float deltaTime)
 {
-    // Rotate fan at 360 degrees per second (adjust speed as needed)
-    fanRotation += 360.0f * deltaTime;
-    if (fanRotation > 360.0f)
-        fanRotation -= 360.0f;
+    // Advance the animation clock of spinning instances (ceiling fans)
+    animationTime += deltaTime;
 }
 
-void Classroom::renderFan(Shader& shader)
+void Classroom::updateTransforms()
 {
-    if (fanModel.vertices.empty())
-        return;  // Fan model not loaded
-    
-    // Set fan material properties (bright cream/white color for visibility)
-    shader.setVec3("material.ambient", glm::vec3(0.6f, 0.55f, 0.5f));
-    shader.setVec3("material.diffuse", glm::vec3(0.9f, 0.85f, 0.75f));
-    shader.setVec3("material.specular", glm::vec3(0.3f, 0.3f, 0.3f));
-    shader.setFloat("material.shininess", 32.0f);
-    
-    // Render LEFT fan
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-3.0f, ROOM_HEIGHT - 0.5f, 0.0f));
-    model = glm::rotate(model, glm::radians(fanRotation), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-    shader.setMat4("model", model);
-    fanModel.render();
-    
-    // Render RIGHT fan
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(3.0f, ROOM_HEIGHT - 0.5f, 0.0f));
-    model = glm::rotate(model, glm::radians(fanRotation), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-    shader.setMat4("model", model);
-    fanModel.render();
-    
-    // Reset model matrix
-    model = glm::mat4(1.0f);
-    shader.setMat4("model", model);
-}
+    const SceneInstances& inst = scene.instances;
+    transforms.resize(inst.size());
+    angles.resize(inst.size());
+    for (size_t i = 0; i < inst.size(); i++)
+        angles[i] = inst.yaw[i] + (float)std::fmod(inst.spin[i] * animationTime, 360.0);
 
-void Classroom::renderPodium(Shader& shader)
-{
-    if (podiumModel.vertices.empty())
-        return;  // Podium model not loaded
-    
-    // Set podium material properties (dark wood)
-    shader.setVec3("material.ambient", glm::vec3(0.2f, 0.15f, 0.1f));
-    shader.setVec3("material.diffuse", glm::vec3(0.4f, 0.3f, 0.2f));
-    shader.setVec3("material.specular", glm::vec3(0.15f, 0.1f, 0.08f));
-    shader.setFloat("material.shininess", 32.0f);
-    
-    // Position podium on the right side of the green board - on the floor
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(3.2f, 0.0f, -ROOM_LENGTH/2 + 1.2f));
-    model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));  // Rotate 180° to face front
-    model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));  // Adjust scale as needed
-    
-    shader.setMat4("model", model);
-    
-    // Render the podium
-    podiumModel.render();
-    
-    // Reset model matrix
-    model = glm::mat4(1.0f);
-    shader.setMat4("model", model);
+    for (size_t m = 0; m < scene.modelRanges.size(); m++)
+    {
+        const InstanceRange& range = scene.modelRanges[m];
+        const Model& model = *models[m];
+        bool loaded = model.uploaded();
+        if (range.count == 0)
+            continue;
+
+        TransformInput in;
+        in.posX = &inst.posX[range.first];
+        in.posY = &inst.posY[range.first];
+        in.posZ = &inst.posZ[range.first];
+        in.yaw = &angles[range.first];
+        // Scale converts OBJ units; procedural stand-ins are already in meters
+        in.scale = loaded ? &inst.scale[range.first] : NULL;
+        in.count = range.count;
+        in.origin = origin;
+        const glm::vec3& localMin = loaded ? model.boundsMin : fallbackParts[m].boundsMin;
+        const glm::vec3& localMax = loaded ? model.boundsMax : fallbackParts[m].boundsMax;
+        batchTransform(in, localMin, localMax, transforms, range.first);
+    }
 }
 
-void Classroom::renderBenches(Shader& shader)
+void Classroom::submitInstances(RenderQueue& queue, ShaderVariants& shaders)
 {
-    if (benchModel.vertices.empty())
-        return;  // Bench model not loaded
-    
-    // Set bench material properties (wood)
-    shader.setVec3("material.ambient", glm::vec3(0.3f, 0.2f, 0.1f));
-    shader.setVec3("material.diffuse", glm::vec3(0.6f, 0.4f, 0.2f));
-    shader.setVec3("material.specular", glm::vec3(0.2f, 0.15f, 0.1f));
-    shader.setFloat("material.shininess", 32.0f);
-    
-    // Render benches in 4 rows with 4 benches each
-    int numRows = 4;
-    int benchesPerRow = 4;
-    float startZ = -ROOM_LENGTH/2 + 2.5f;  // Start from front, leave space near board
-    float rowSpacing = 1.5f;  // Space between rows
-    float benchSpacing = 2.8f;  // Space between benches in a row (adjusted for 4 columns)
-    
-    for (int row = 0; row < numRows; row++)
+    updateTransforms();
+
+    // Spinning sub-meshes: one instanced draw per model, re-pointed when the model is reloaded
+    for (size_t b = 0; b < animatedBatches.size(); b++)
     {
-        for (int col = 0; col < benchesPerRow; col++)
+        AnimatedBatch& batch = animatedBatches[b];
+        const Model& model = *models[batch.model];
+        if (!model.uploaded())
+            continue;
+        if (batch.VAO == 0 || batch.modelRevision != model.revision || batch.divisor != queue.viewCount())
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            
-            // Position: center benches horizontally, space vertically
-            float xPos = -4.5f + col * benchSpacing;
-            float zPos = startZ + row * rowSpacing;
-            
-            model = glm::translate(model, glm::vec3(xPos, 0.0f, zPos));
-            model = glm::rotate(model, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));  // Face front
-            model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));  // Reduced scale to fit classroom
-            
-            shader.setMat4("model", model);
-            benchModel.render();
+            // Multi-view draws step the placement once per view
+            batch.divisor = queue.viewCount();
+            uploadAnimation(batch);
+        }
+        const Material& material = scene.materials[scene.instances.material[batch.instances[0]]];
+        queue.submitInstanced(LAYER_OPAQUE, shaders.get(materialFeatures(material) | FEATURE_ANIMATED), batch.VAO,
+                              (GLsizei)model.vertexCount, (GLsizei)batch.instances.size(), &material, batch.center);
+    }
+
+    // Static instances: one instanced draw per model, material and lightmap, re-pointed when the
+    // model is uploaded or reloaded
+    for (size_t b = 0; b < staticBatches.size(); b++)
+    {
+        StaticBatch& batch = staticBatches[b];
+        const Model& model = *models[batch.model];
+        bool loaded = model.uploaded();
+        const MeshPart& fallback = fallbackParts[batch.model];
+        if (!loaded && fallback.VAO == 0)
+            continue;  // Model not loaded and no stand-in
+        if (batch.VAO == 0 || batch.modelLoaded != loaded || (loaded && batch.modelRevision != model.revision) ||
+            batch.divisor != queue.viewCount())
+        {
+            batch.divisor = queue.viewCount();
+            uploadStaticBatch(batch, loaded);
+        }
+        const Material& material = scene.materials[batch.material];
+        // Stand-ins have no lightmap coordinates
+        bool baked = loaded && batch.lightmapped && lightmapTexture != 0;
+        unsigned int features = materialFeatures(material) | FEATURE_INSTANCED;
+        if (baked)
+            features |= FEATURE_LIGHTMAP;
+        GLsizei count = (GLsizei)(loaded ? model.vertexCount : fallback.vertexCount());
+        queue.submitInstanced(LAYER_OPAQUE, shaders.get(features), batch.VAO, count, (GLsizei)batch.instances.size(),
+                              &material, batch.center, baked ? lightmapTexture : 0);
+    }
+
+    // Instances turning as a whole (no spin group, or its model not uploaded yet) move every frame
+    const SceneInstances& inst = scene.instances;
+    for (size_t m = 0; m < scene.modelRanges.size(); m++)
+    {
+        const InstanceRange& range = scene.modelRanges[m];
+        const Model& model = *models[m];
+        bool loaded = model.uploaded();
+        const MeshPart& fallback = fallbackParts[m];
+        if (!loaded && fallback.VAO == 0)
+            continue;  // Model not loaded and no stand-in
+
+        unsigned int VAO = loaded ? model.VAO : fallback.VAO;
+        GLsizei count = (GLsizei)(loaded ? model.vertexCount : fallback.vertexCount());
+        bool animated = loaded && animatedBatch(m) != NULL;
+
+        for (uint32_t i = range.first; i < range.first + range.count; i++)
+        {
+            if (staticInstance(i) || animated)
+                continue;  // Drawn by a static or animated batch
+            // Sort depth from the centre of the world-space bounds
+            glm::vec3 center((transforms.minX[i] + transforms.maxX[i]) * 0.5f,
+                             (transforms.minY[i] + transforms.maxY[i]) * 0.5f,
+                             (transforms.minZ[i] + transforms.maxZ[i]) * 0.5f);
+            queue.submit(LAYER_OPAQUE, shaders.get(materialFeatures(scene.materials[inst.material[i]])), VAO, count,
+                         &scene.materials[inst.material[i]], transforms.models[i], center);
         }
     }
-    
-    // Reset model matrix
-    glm::mat4 model = glm::mat4(1.0f);
-    shader.setMat4("model", model);
 }
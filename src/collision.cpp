@@ -0,0 +1,338 @@
+#include "../include/collision.h"
+#include "../include/campus.h"
+#include "../include/classroom.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+static const int RESOLVE_ITERATIONS = 4;  // Push-outs per step; corners need two
+static const int MAX_MOVE_STEPS = 256;
+
+CollisionWorld::CollisionWorld() : cellSize(1.0f), queryStamp(0), builtResidency(~0u)
+{
+}
+
+void CollisionWorld::clear()
+{
+    boxes.clear();
+    cells.clear();
+    cellBoxes.clear();
+    visitStamps.clear();
+    queryStamp = 0;
+}
+
+void CollisionWorld::addBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    Box box;
+    box.boundsMin = glm::min(boundsMin, boundsMax);
+    box.boundsMax = glm::max(boundsMin, boundsMax);
+    boxes.push_back(box);
+}
+
+void CollisionWorld::addRoom(const Classroom& room)
+{
+    const RoomShell& shell = room.scene.room;
+    const glm::vec3& o = room.origin;
+    float w = shell.width / 2, l = shell.length / 2, h = shell.height;
+
+    // Floor, ceiling and walls as their inner faces: flat boxes are enough since moves advance in
+    // steps shorter than the radius, and they stay out of adjoining rooms that share the wall
+    addBox(o + glm::vec3(-w, 0.0f, -l), o + glm::vec3(w, 0.0f, l));
+    addBox(o + glm::vec3(-w, h, -l), o + glm::vec3(w, h, l));
+    addBox(o + glm::vec3(-w, 0.0f, -l), o + glm::vec3(-w, h, l));
+    addBox(o + glm::vec3(w, 0.0f, -l), o + glm::vec3(w, h, l));
+    addBox(o + glm::vec3(-w, 0.0f, -l), o + glm::vec3(w, h, -l));
+    addBox(o + glm::vec3(-w, 0.0f, l), o + glm::vec3(w, h, l));
+
+    const SceneBoxes& sceneBoxes = room.scene.boxes;
+    for (size_t i = 0; i < sceneBoxes.size(); i++)
+    {
+        glm::vec3 center(sceneBoxes.centerX[i], sceneBoxes.centerY[i], sceneBoxes.centerZ[i]);
+        glm::vec3 half = glm::vec3(sceneBoxes.sizeX[i], sceneBoxes.sizeY[i], sceneBoxes.sizeZ[i]) * 0.5f;
+        addBox(o + center - half, o + center + half);
+    }
+
+    // Instances: model bounds turned by the yaw, or by every angle while spinning
+    const SceneInstances& inst = room.scene.instances;
+    for (size_t i = 0; i < inst.size(); i++)
+    {
+        uint16_t m = inst.model[i];
+        bool loaded = m < room.models.size() && room.models[m] && room.models[m]->loaded();
+        const MeshPart* fallback = m < room.fallbackParts.size() ? &room.fallbackParts[m] : NULL;
+        if (!loaded && (fallback == NULL || fallback->count == 0))
+            continue;
+        glm::vec3 localMin = loaded ? room.models[m]->boundsMin : fallback->boundsMin;
+        glm::vec3 localMax = loaded ? room.models[m]->boundsMax : fallback->boundsMax;
+        float scale = loaded ? inst.scale[i] : 1.0f;  // Stand-ins are in meters
+        localMin *= scale;
+        localMax *= scale;
+
+        glm::vec2 lo(0.0f), hi(0.0f);
+        if (inst.spin[i] != 0.0f)
+        {
+            float radius = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                glm::vec2 corner((c & 1) ? localMax.x : localMin.x, (c & 2) ? localMax.z : localMin.z);
+                radius = std::max(radius, glm::length(corner));
+            }
+            lo = glm::vec2(-radius);
+            hi = glm::vec2(radius);
+        }
+        else
+        {
+            float angle = glm::radians(inst.yaw[i]);
+            float c = std::cos(angle), s = std::sin(angle);
+            for (int k = 0; k < 4; k++)
+            {
+                float x = (k & 1) ? localMax.x : localMin.x;
+                float z = (k & 2) ? localMax.z : localMin.z;
+                glm::vec2 turned(c * x + s * z, -s * x + c * z);
+                lo = k == 0 ? turned : glm::min(lo, turned);
+                hi = k == 0 ? turned : glm::max(hi, turned);
+            }
+        }
+        glm::vec3 position = o + glm::vec3(inst.posX[i], inst.posY[i], inst.posZ[i]);
+        addBox(position + glm::vec3(lo.x, localMin.y, lo.y), position + glm::vec3(hi.x, localMax.y, hi.y));
+    }
+}
+
+uint64_t CollisionWorld::cellKey(int x, int y, int z) const
+{
+    // 21 bits per axis covers +-1M cells
+    return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+}
+
+void CollisionWorld::cellRange(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int lo[3], int hi[3]) const
+{
+    for (int a = 0; a < 3; a++)
+    {
+        lo[a] = (int)std::floor(boundsMin[a] / cellSize);
+        hi[a] = (int)std::floor(boundsMax[a] / cellSize);
+    }
+}
+
+void CollisionWorld::build()
+{
+    // Count per cell, then fill the flat index list cell by cell
+    cells.clear();
+    int lo[3], hi[3];
+    for (size_t b = 0; b < boxes.size(); b++)
+    {
+        cellRange(boxes[b].boundsMin, boxes[b].boundsMax, lo, hi);
+        for (int x = lo[0]; x <= hi[0]; x++)
+            for (int y = lo[1]; y <= hi[1]; y++)
+                for (int z = lo[2]; z <= hi[2]; z++)
+                {
+                    CellRange& range = cells[cellKey(x, y, z)];
+                    range.count++;
+                }
+    }
+    uint32_t offset = 0;
+    for (std::unordered_map<uint64_t, CellRange>::iterator it = cells.begin(); it != cells.end(); ++it)
+    {
+        it->second.first = offset;
+        offset += it->second.count;
+        it->second.count = 0;
+    }
+    cellBoxes.resize(offset);
+    for (size_t b = 0; b < boxes.size(); b++)
+    {
+        cellRange(boxes[b].boundsMin, boxes[b].boundsMax, lo, hi);
+        for (int x = lo[0]; x <= hi[0]; x++)
+            for (int y = lo[1]; y <= hi[1]; y++)
+                for (int z = lo[2]; z <= hi[2]; z++)
+                {
+                    CellRange& range = cells[cellKey(x, y, z)];
+                    cellBoxes[range.first + range.count++] = (uint32_t)b;
+                }
+    }
+    visitStamps.assign(boxes.size(), 0);
+    queryStamp = 0;
+}
+
+bool CollisionWorld::update(const Campus& campus)
+{
+    if (campus.residency() == builtResidency)
+        return false;
+    std::vector<Classroom*> rooms;
+    campus.residentRooms(rooms);
+    clear();
+    for (size_t i = 0; i < rooms.size(); i++)
+        addRoom(*rooms[i]);
+    build();
+    builtResidency = campus.residency();
+    return true;
+}
+
+void CollisionWorld::gather(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    candidates.clear();
+    stats.queries++;
+    if (++queryStamp == 0)
+    {
+        // Wrapped: forget every stamp
+        std::fill(visitStamps.begin(), visitStamps.end(), 0);
+        queryStamp = 1;
+    }
+    int lo[3], hi[3];
+    cellRange(boundsMin, boundsMax, lo, hi);
+    for (int x = lo[0]; x <= hi[0]; x++)
+        for (int y = lo[1]; y <= hi[1]; y++)
+            for (int z = lo[2]; z <= hi[2]; z++)
+            {
+                std::unordered_map<uint64_t, CellRange>::const_iterator it = cells.find(cellKey(x, y, z));
+                if (it == cells.end())
+                    continue;
+                for (uint32_t k = it->second.first; k < it->second.first + it->second.count; k++)
+                {
+                    uint32_t b = cellBoxes[k];
+                    if (visitStamps[b] == queryStamp)
+                        continue;
+                    visitStamps[b] = queryStamp;
+                    candidates.push_back(b);
+                }
+            }
+}
+
+bool CollisionWorld::resolve(glm::vec3& eye, const CollisionCapsule& capsule)
+{
+    float r = capsule.radius;
+    gather(eye - glm::vec3(r, capsule.below, r), eye + glm::vec3(r, capsule.above, r));
+
+    bool pushed = false;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        const Box& box = boxes[candidates[i]];
+        stats.candidates++;
+
+        // The capsule's axis runs from y0 to y1; take its point closest to the box
+        float y0 = eye.y - capsule.below + r;
+        float y1 = std::max(y0, eye.y + capsule.above - r);
+        float y;
+        if (y1 < box.boundsMin.y)
+            y = y1;
+        else if (y0 > box.boundsMax.y)
+            y = y0;
+        else
+            y = std::max(y0, box.boundsMin.y);
+        glm::vec3 p(eye.x, y, eye.z);
+        glm::vec3 d = p - glm::clamp(p, box.boundsMin, box.boundsMax);
+        float distance2 = glm::dot(d, d);
+        if (distance2 >= r * r)
+            continue;
+
+        glm::vec3 push(0.0f);
+        if (distance2 > 1e-12f)
+        {
+            float distance = std::sqrt(distance2);
+            push = d * ((r - distance) / distance);
+        }
+        else
+        {
+            // Axis inside the box: leave by the shortest way out
+            float depths[6] = { box.boundsMax.x - p.x + r, p.x - box.boundsMin.x + r,
+                                box.boundsMax.z - p.z + r, p.z - box.boundsMin.z + r,
+                                box.boundsMax.y - y0 + r, y1 + r - box.boundsMin.y };
+            int best = (int)(std::min_element(depths, depths + 6) - depths);
+            float depth = depths[best];
+            if (best == 0) push.x = depth;
+            else if (best == 1) push.x = -depth;
+            else if (best == 2) push.z = depth;
+            else if (best == 3) push.z = -depth;
+            else if (best == 4) push.y = depth;
+            else push.y = -depth;
+        }
+        eye += push;
+        pushed = true;
+        stats.contacts++;
+    }
+    return pushed;
+}
+
+glm::vec3 CollisionWorld::move(const glm::vec3& eye, const glm::vec3& delta, const CollisionCapsule& capsule)
+{
+    stats.moves++;
+    if (boxes.empty())
+        return eye + delta;
+
+    // Steps of at most half the radius; a move needing more than MAX_MOVE_STEPS of them is cut
+    // short rather than taken in longer steps that could pass through a wall
+    float stepLength = capsule.radius * 0.5f;
+    float length = glm::length(delta);
+    int steps = std::max(1, (int)std::ceil(length / stepLength));
+    glm::vec3 step = delta / (float)steps;
+    if (steps > MAX_MOVE_STEPS)
+    {
+        steps = MAX_MOVE_STEPS;
+        step = delta * (stepLength / length);
+    }
+    glm::vec3 position = eye;
+    for (int s = 0; s < steps; s++)
+    {
+        position += step;
+        for (int i = 0; i < RESOLVE_ITERATIONS; i++)
+        {
+            if (!resolve(position, capsule))
+                break;
+        }
+    }
+    return position;
+}
+
+void CollisionWorld::report(std::ostream& out)
+{
+    const CollisionStats& s = stats;
+    out << "COLLISION::" << boxes.size() << " boxes in " << cells.size() << " cells, " << s.moves << " moves, "
+        << (s.queries ? (double)s.candidates / s.queries : 0.0) << " boxes tested per query, " << s.contacts
+        << " contacts" << std::endl;
+    stats.reset();
+}
+
+void benchmarkCollision(size_t count)
+{
+    // Desk-sized boxes scattered over an area growing with the count, so the density around the
+    // capsule stays the same from one room's worth to a campus
+    std::vector<size_t> sizes;
+    for (size_t n = 1000; n < count; n *= 10)
+        sizes.push_back(n);
+    sizes.push_back(count);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> size(0.3f, 1.5f);
+    std::uniform_real_distribution<float> turn(-1.0f, 1.0f);
+    for (size_t k = 0; k < sizes.size(); k++)
+    {
+        size_t n = sizes[k];
+        float area = std::sqrt((float)n) * 2.0f;
+        std::uniform_real_distribution<float> place(0.0f, area);
+        CollisionWorld world;
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::vec3 corner(place(random), 0.0f, place(random));
+            world.addBox(corner, corner + glm::vec3(size(random), 0.8f, size(random)));
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        world.build();
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // A wandering walk at 2.5 m/s in 60 Hz frames
+        CollisionCapsule capsule;
+        glm::vec3 eye(area * 0.5f, 2.0f, area * 0.5f);
+        glm::vec3 heading(1.0f, 0.0f, 0.0f);
+        const int moves = 100000;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < moves; i++)
+        {
+            heading = glm::normalize(heading + glm::vec3(turn(random), 0.0f, turn(random)) * 0.2f);
+            eye = world.move(eye, heading * (2.5f / 60.0f), capsule);
+            eye = glm::clamp(eye, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(area, 2.0f, area));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "COLLISION::" << n << " boxes: build " << buildMs << " ms, " << seconds * 1e6 / moves
+                  << " us per move, " << (world.stats.queries ? (double)world.stats.candidates / world.stats.queries : 0.0)
+                  << " boxes tested per query" << std::endl;
+    }
+}
@@ -0,0 +1,413 @@
+#include "../include/debug_view.h"
+#include "../include/shader_variants.h"
+#include "../include/campus.h"
+#include "../include/render_queue.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+
+// Log2 buckets of the triangle and cost views: below 1, then 1-2 up to 4096 and over
+static const int LOG_BUCKETS = 14;
+// Overdraw buckets: 0 to 15 fragments, then 16 and over
+static const int OVERDRAW_BUCKETS = 17;
+
+DrawCosts::DrawCosts() : next(0), active(-1), lastMax(0.0f), lastCount(0)
+{
+    for (unsigned int i = 0; i < FRAME_COUNT; i++)
+        frames[i].pending = false;
+}
+
+DrawCosts::~DrawCosts()
+{
+    for (unsigned int i = 0; i < FRAME_COUNT; i++)
+    {
+        if (!frames[i].queries.empty())
+            glDeleteQueries((GLsizei)frames[i].queries.size(), &frames[i].queries[0]);
+    }
+}
+
+void DrawCosts::beginFrame()
+{
+    collect(false);
+    active = -1;
+    Frame& frame = frames[next];
+    if (frame.pending)
+        return;
+    active = (int)next;
+    next = (next + 1) % FRAME_COUNT;
+    frame.ids.clear();
+    if (frame.queries.empty())
+    {
+        frame.queries.push_back(0);
+        glGenQueries(1, &frame.queries[0]);
+    }
+    glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+}
+
+void DrawCosts::drawn(uint64_t id)
+{
+    if (active < 0)
+        return;
+    Frame& frame = frames[active];
+    frame.ids.push_back(id);
+    if (frame.queries.size() <= frame.ids.size())
+    {
+        frame.queries.push_back(0);
+        glGenQueries(1, &frame.queries.back());
+    }
+    glQueryCounter(frame.queries[frame.ids.size()], GL_TIMESTAMP);
+}
+
+void DrawCosts::endFrame()
+{
+    if (active >= 0)
+        frames[active].pending = !frames[active].ids.empty();
+    active = -1;
+}
+
+void DrawCosts::collect(bool wait)
+{
+    // Oldest first; frames finish in order, so the first one still busy ends the search
+    for (unsigned int k = 0; k < FRAME_COUNT; k++)
+    {
+        Frame& frame = frames[(next + k) % FRAME_COUNT];
+        if (!frame.pending)
+            continue;
+        if (!wait)
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(frame.queries[frame.ids.size()], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+        }
+        GLuint64 previous = 0;
+        glGetQueryObjectui64v(frame.queries[0], GL_QUERY_RESULT, &previous);
+        float frameMax = 0.0f;
+        for (size_t i = 0; i < frame.ids.size(); i++)
+        {
+            GLuint64 stamp = 0;
+            glGetQueryObjectui64v(frame.queries[i + 1], GL_QUERY_RESULT, &stamp);
+            // Never zero, so a timed draw stays apart from background pixels
+            float us = std::max((float)((double)(stamp - std::min(stamp, previous)) / 1000.0), 0.001f);
+            previous = stamp;
+            std::unordered_map<uint64_t, float>::iterator it = costs.find(frame.ids[i]);
+            if (it == costs.end())
+                costs[frame.ids[i]] = us;
+            else
+                it->second = it->second * 0.8f + us * 0.2f;
+            frameMax = std::max(frameMax, costs[frame.ids[i]]);
+        }
+        lastMax = frameMax;
+        lastCount = frame.ids.size();
+        frame.pending = false;
+    }
+}
+
+float DrawCosts::cost(uint64_t id) const
+{
+    std::unordered_map<uint64_t, float>::const_iterator it = costs.find(id);
+    return it != costs.end() ? it->second : -1.0f;
+}
+
+void DrawCosts::finish()
+{
+    collect(true);
+}
+
+DebugView::DebugView()
+    : current(DEBUG_VIEW_OFF), emptyVAO(0), framebuffer(0), values(0), depthBuffer(0), targetWidth(0),
+      targetHeight(0), previousFramebuffer(0), drawnScale(1.0f), drawnMode(DEBUG_VIEW_OFF)
+{
+    viewport[0] = viewport[1] = viewport[2] = viewport[3] = 0;
+}
+
+DebugView::~DebugView()
+{
+    if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+    if (values != 0) glDeleteTextures(1, &values);
+    if (depthBuffer != 0) glDeleteRenderbuffers(1, &depthBuffer);
+    if (emptyVAO != 0) glDeleteVertexArrays(1, &emptyVAO);
+}
+
+bool DebugView::initialize(const std::string& vertexPath, const std::string& fragmentPath)
+{
+    std::string vertexCode, fragmentCode;
+    if (!Shader::readFile(vertexPath.c_str(), vertexCode) || !Shader::readFile(fragmentPath.c_str(), fragmentCode) ||
+        !resolveProgram.compile(vertexCode, fragmentCode))
+    {
+        std::cout << "ERROR::DEBUG::Could not build the heatmap program" << std::endl;
+        return false;
+    }
+    resolveProgram.use();
+    resolveProgram.setInt("values", 0);
+    // The full-screen triangle comes from gl_VertexID, but core profiles still want a VAO bound
+    if (emptyVAO == 0)
+        glGenVertexArrays(1, &emptyVAO);
+    return true;
+}
+
+const char* DebugView::modeName(DebugViewMode mode)
+{
+    switch (mode)
+    {
+    case DEBUG_VIEW_OVERDRAW: return "overdraw";
+    case DEBUG_VIEW_TRIANGLES: return "triangles";
+    case DEBUG_VIEW_COST: return "cost";
+    case DEBUG_VIEW_WIREFRAME: return "wireframe";
+    default: return "off";
+    }
+}
+
+bool DebugView::parseMode(const std::string& name, DebugViewMode& mode)
+{
+    for (int m = DEBUG_VIEW_OVERDRAW; m < DEBUG_VIEW_MODE_COUNT; m++)
+    {
+        if (name == modeName((DebugViewMode)m))
+        {
+            mode = (DebugViewMode)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DebugView::heatmap() const
+{
+    return current == DEBUG_VIEW_OVERDRAW || current == DEBUG_VIEW_TRIANGLES || current == DEBUG_VIEW_COST;
+}
+
+void DebugView::setUniforms(ShaderVariants& shaders) const
+{
+    if (!heatmap())
+        return;
+    std::vector<Shader*> variants;
+    shaders.compiled(variants);
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        int location = glGetUniformLocation(variants[i]->ID, "debugMode");
+        if (location < 0)
+            continue;
+        glUseProgram(variants[i]->ID);
+        glUniform1i(location, (int)current);
+    }
+}
+
+void DebugView::resize(int width, int height)
+{
+    if (framebuffer != 0 && width == targetWidth && height == targetHeight)
+        return;
+    if (framebuffer == 0)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &values);
+        glGenRenderbuffers(1, &depthBuffer);
+    }
+    targetWidth = width;
+    targetHeight = height;
+    glBindTexture(GL_TEXTURE_2D, values);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, values, 0);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::DEBUG::Value target " << width << "x" << height << " is incomplete" << std::endl;
+}
+
+void DebugView::begin()
+{
+    if (current == DEBUG_VIEW_WIREFRAME)
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        return;
+    }
+    if (!heatmap())
+        return;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    resize(viewport[2], viewport[3]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, targetWidth, targetHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (current == DEBUG_VIEW_OVERDRAW)
+    {
+        // Every fragment adds one, hidden or not
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+}
+
+void DebugView::end()
+{
+    if (current == DEBUG_VIEW_WIREFRAME)
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        drawnMode = current;
+        return;
+    }
+    if (!heatmap())
+        return;
+    glDisable(GL_BLEND);
+    drawnMode = current;
+    drawnScale = std::max(costs.maxCost(), 0.001f);
+
+    // Values to colours over whatever the frame held
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (unsigned int)previousFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDisable(GL_DEPTH_TEST);
+    resolveProgram.use();
+    resolveProgram.setInt("mode", (int)current);
+    resolveProgram.setFloat("scale", drawnScale);
+    glUniform2i(glGetUniformLocation(resolveProgram.ID, "origin"), viewport[0], viewport[1]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, values);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void DebugView::draw(Campus& campus, ShaderVariants& shaders, RenderQueue& renderQueue, const CampusCell& cell)
+{
+    if (current == DEBUG_VIEW_COST)
+    {
+        renderQueue.setDrawTimer(&costs);
+        renderQueue.flush();
+        renderQueue.setDrawTimer(NULL);
+        shaders.require(shaderFeatures());
+        campus.submit(renderQueue, shaders);
+        shaders.require(0);
+        campus.setFrameUniforms(shaders, cell);
+        renderQueue.setDrawCosts(&costs);
+    }
+    setUniforms(shaders);
+    begin();
+    renderQueue.flush();
+    end();
+    renderQueue.setDrawCosts(NULL);
+}
+
+// Bucket of a value in the log2 histograms (infinite and NaN values end up in the outer ones)
+static int logBucket(float value)
+{
+    if (!(value >= 1.0f))
+        return 0;
+    if (value >= (float)(1 << (LOG_BUCKETS - 2)))
+        return LOG_BUCKETS - 1;
+    return 1 + (int)std::floor(std::log2(value));
+}
+
+static std::string logLabel(int bucket, const char* unit)
+{
+    if (bucket == 0)
+        return std::string("<1 ") + unit;
+    if (bucket == LOG_BUCKETS - 1)
+        return std::to_string(1 << (bucket - 1)) + "+ " + unit;
+    return std::to_string(1 << (bucket - 1)) + "-" + std::to_string(1 << bucket) + " " + unit;
+}
+
+bool DebugView::histogram(DebugHistogram& out) const
+{
+    if (framebuffer == 0 || (drawnMode != DEBUG_VIEW_OVERDRAW && drawnMode != DEBUG_VIEW_TRIANGLES &&
+                             drawnMode != DEBUG_VIEW_COST))
+    {
+        std::cout << "Warning: DEBUG::No heatmap view drawn, nothing to histogram" << std::endl;
+        return false;
+    }
+    std::vector<float> pixels((size_t)targetWidth * targetHeight);
+    int previousRead;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadPixels(0, 0, targetWidth, targetHeight, GL_RED, GL_FLOAT, &pixels[0]);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (unsigned int)previousRead);
+
+    out = DebugHistogram();
+    out.mode = drawnMode;
+    out.width = targetWidth;
+    out.height = targetHeight;
+    if (drawnMode == DEBUG_VIEW_OVERDRAW)
+    {
+        for (int b = 0; b < OVERDRAW_BUCKETS; b++)
+            out.labels.push_back(std::to_string(b) + (b == OVERDRAW_BUCKETS - 1 ? "+" : "") + " fragments");
+    }
+    else if (drawnMode == DEBUG_VIEW_TRIANGLES)
+    {
+        for (int b = 0; b < LOG_BUCKETS; b++)
+            out.labels.push_back(logLabel(b, "pixels per triangle"));
+    }
+    else
+    {
+        out.labels.push_back("untimed");
+        for (int b = 0; b < LOG_BUCKETS; b++)
+            out.labels.push_back(logLabel(b, "us"));
+    }
+    out.pixels.assign(out.labels.size(), 0);
+
+    double total = 0.0;
+    size_t counted = 0;
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        float value = pixels[i];
+        if (drawnMode == DEBUG_VIEW_OVERDRAW)
+        {
+            int fragments = (int)(value + 0.5f);
+            out.pixels[std::min(fragments, OVERDRAW_BUCKETS - 1)]++;
+            if (fragments == 0)
+                continue;
+        }
+        else if (value == 0.0f)
+            continue;
+        else if (drawnMode == DEBUG_VIEW_TRIANGLES)
+            out.pixels[logBucket(1.0f / value)]++;
+        else if (value < 0.0f)
+        {
+            out.pixels[0]++;
+            out.covered++;
+            continue;
+        }
+        else
+            out.pixels[1 + logBucket(value)]++;
+        out.covered++;
+        out.max = std::max(out.max, value);
+        total += value;
+        counted++;
+    }
+    out.mean = counted > 0 ? total / counted : 0.0;
+    return true;
+}
+
+bool DebugView::writeHistogram(const std::string& path, const std::vector<DebugHistogram>& histograms)
+{
+    std::ofstream file(path.c_str());
+    if (!file)
+    {
+        std::cout << "ERROR::DEBUG::Could not write " << path << std::endl;
+        return false;
+    }
+    for (size_t h = 0; h < histograms.size(); h++)
+    {
+        const DebugHistogram& histogram = histograms[h];
+        const char* unit = histogram.mode == DEBUG_VIEW_OVERDRAW ? "fragments per pixel" :
+                           histogram.mode == DEBUG_VIEW_TRIANGLES ? "triangles per pixel" : "us per pixel's draw";
+        size_t total = (size_t)histogram.width * histogram.height;
+        if (h > 0)
+            file << "\n";
+        file << "# " << modeName(histogram.mode) << ": " << histogram.width << "x" << histogram.height << ", "
+             << histogram.covered << " of " << total << " pixels covered, mean " << histogram.mean << " " << unit
+             << ", max " << histogram.max << "\n";
+        for (size_t b = 0; b < histogram.labels.size(); b++)
+        {
+            file << histogram.labels[b] << "\t" << histogram.pixels[b] << "\t"
+                 << (total > 0 ? 100.0 * histogram.pixels[b] / total : 0.0) << "%\n";
+        }
+    }
+    return (bool)file;
+}
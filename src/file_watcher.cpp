@@ -0,0 +1,93 @@
+#include "../include/file_watcher.h"
+#include <iostream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+FileWatcher::FileWatcher() : fd(-1)
+{
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+        std::cout << "ERROR::WATCH::inotify unavailable, hot reload disabled" << std::endl;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+bool FileWatcher::watch(const std::string& path)
+{
+#ifdef __linux__
+    if (fd < 0)
+        return false;
+
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    for (std::map<int, std::string>::iterator it = directories.begin(); it != directories.end(); ++it)
+    {
+        if (it->second == directory)
+        {
+            files.insert(path);
+            return true;
+        }
+    }
+
+    int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0)
+    {
+        std::cout << "ERROR::WATCH::Cannot watch directory: " << directory << std::endl;
+        return false;
+    }
+    directories[wd] = directory;
+    files.insert(path);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void FileWatcher::poll(std::vector<std::string>& changed)
+{
+#ifdef __linux__
+    if (fd < 0)
+        return;
+
+    size_t first = changed.size();
+    char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)]
+        __attribute__((aligned(__alignof__(inotify_event))));
+    while (true)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;  // EAGAIN: nothing more pending
+
+        for (char* p = buffer; p < buffer + length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            std::map<int, std::string>::const_iterator dir = directories.find(event->wd);
+            if (dir == directories.end() || event->len == 0)
+                continue;
+            std::string path = dir->second == "." ? std::string(event->name)
+                                                  : dir->second + "/" + event->name;
+            // Editors often produce several events per save; report each file once
+            if (files.count(path) && std::find(changed.begin() + first, changed.end(), path) == changed.end())
+                changed.push_back(path);
+        }
+    }
+#else
+    (void)changed;
+#endif
+}
@@ -0,0 +1,363 @@
+#include "../include/frame_capture.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+
+const unsigned int FrameCapture::RING_SIZE;
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void convertToI420(const uint8_t* rgba, int width, int height, uint8_t* out)
+{
+    // Full-range BT.601 in 8.8 fixed point; chroma of each 2x2 block from its summed RGB
+    uint8_t* luma = out;
+    uint8_t* cb = out + (size_t)width * height;
+    uint8_t* cr = cb + (size_t)(width / 2) * (height / 2);
+    size_t stride = (size_t)width * 4;
+    for (int y = 0; y < height; y += 2)
+    {
+        // Output rows y and y + 1 are source rows from the bottom
+        const uint8_t* top = rgba + (size_t)(height - 1 - y) * stride;
+        const uint8_t* bottom = top - stride;
+        uint8_t* lumaTop = luma + (size_t)y * width;
+        uint8_t* lumaBottom = lumaTop + width;
+        uint8_t* cbRow = cb + (size_t)(y / 2) * (width / 2);
+        uint8_t* crRow = cr + (size_t)(y / 2) * (width / 2);
+        for (int x = 0; x < width; x += 2)
+        {
+            const uint8_t* p[4] = { top + x * 4, top + x * 4 + 4, bottom + x * 4, bottom + x * 4 + 4 };
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                int l = (77 * p[i][0] + 150 * p[i][1] + 29 * p[i][2] + 128) >> 8;
+                (i < 2 ? lumaTop : lumaBottom)[x + (i & 1)] = (uint8_t)l;
+                r += p[i][0];
+                g += p[i][1];
+                b += p[i][2];
+            }
+            // Weights sum to zero, so the offset keeps the sums positive: 128 << 10 plus rounding
+            cbRow[x / 2] = (uint8_t)std::min(255, (-43 * r - 85 * g + 128 * b + 131584) >> 10);
+            crRow[x / 2] = (uint8_t)std::min(255, (128 * r - 107 * g - 21 * b + 131584) >> 10);
+        }
+    }
+}
+
+FrameCapture::FrameCapture()
+    : output(NULL), piped(false), captureWidth(0), captureHeight(0), frameSeconds(0.0), startTime(0.0),
+      started(false), lastTick(-1), pendingRepeats(0), ringNext(0), reading(0), frameBytes(0), nextSequence(0),
+      warnedSize(false), work(RING_SIZE), returned(RING_SIZE), quit(false), nextWrite(0)
+{
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        ring[i].buffer = 0;
+        ring[i].fence = 0;
+        ring[i].state = SLOT_FREE;
+        ring[i].mapped = NULL;
+        ring[i].sequence = 0;
+        ring[i].repeats = 0;
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+}
+
+bool FrameCapture::start(const std::string& name, float fps, int width, int height, unsigned int encoderThreads)
+{
+    if (active())
+        finish();
+    width &= ~1;
+    height &= ~1;
+    if (width <= 0 || height <= 0 || !(fps > 0.0f))
+    {
+        std::cout << "ERROR::CAPTURE::Invalid capture of " << width << "x" << height << " at " << fps << " fps"
+                  << std::endl;
+        return false;
+    }
+
+    // "|command": the stream goes to an encoder process; it exiting early must fail the writes
+    // rather than kill the renderer with SIGPIPE
+    piped = !name.empty() && name[0] == '|';
+    if (piped)
+    {
+        signal(SIGPIPE, SIG_IGN);
+        output = popen(name.c_str() + 1, "w");
+    }
+    else
+        output = fopen(name.c_str(), "wb");
+    if (output == NULL)
+    {
+        std::cout << "ERROR::CAPTURE::Could not open " << (piped ? "pipe to " : "") << (piped ? name.substr(1) : name)
+                  << std::endl;
+        return false;
+    }
+    outputName = name;
+
+    // YUV4MPEG2 header; the rate as a fraction when it is not a whole number
+    std::ostringstream header;
+    header << "YUV4MPEG2 W" << width << " H" << height << " F";
+    if (std::floor(fps) == fps)
+        header << (int)fps << ":1";
+    else
+        header << (int)std::lround(fps * 1000.0f) << ":1000";
+    header << " Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+    std::string text = header.str();
+    fwrite(text.data(), 1, text.size(), output);
+
+    stats = CaptureStats();
+    captureWidth = width;
+    captureHeight = height;
+    frameSeconds = 1.0 / fps;
+    started = false;
+    lastTick = -1;
+    pendingRepeats = 0;
+    ringNext = reading = 0;
+    frameBytes = (size_t)width * height * 4;
+    nextSequence = nextWrite = 0;
+    warnedSize = false;
+    quit = false;
+    unsigned int count = encoderThreads > 0 ? encoderThreads : std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned int i = 0; i < count; i++)
+        encoders.push_back(std::thread(&FrameCapture::encoderLoop, this));
+    std::cout << "CAPTURE::Recording " << width << "x" << height << " at " << fps << " fps to "
+              << (piped ? name.substr(1) : name) << " (" << count << " encoders)" << std::endl;
+    return true;
+}
+
+void FrameCapture::frame(double time, int width, int height)
+{
+    if (!active())
+        return;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    poll(false);
+
+    // Video frames since the last one taken or dropped; more than one means the renderer is
+    // slower than the capture rate, and the frame fills them all
+    if (!started)
+    {
+        startTime = time;
+        started = true;
+    }
+    long long tick = (long long)std::floor((time - startTime) / frameSeconds);
+    if (tick > lastTick)
+    {
+        unsigned int repeats = (unsigned int)(tick - lastTick) + pendingRepeats;
+        lastTick = tick;
+        Slot& slot = ring[ringNext];
+        if ((width & ~1) != captureWidth || (height & ~1) != captureHeight)
+        {
+            if (!warnedSize)
+                std::cout << "Warning: Capture is " << captureWidth << "x" << captureHeight << ", dropping "
+                          << width << "x" << height << " frames" << std::endl;
+            warnedSize = true;
+            stats.sizeDrops++;
+            pendingRepeats = repeats;
+        }
+        else if (slot.state != SLOT_FREE)
+        {
+            if (slot.state == SLOT_READING)
+                stats.gpuDrops++;
+            else
+                stats.encoderDrops++;
+            pendingRepeats = repeats;
+        }
+        else
+        {
+            slot.repeats = repeats;
+            pendingRepeats = 0;
+            read(slot);
+            ringNext = (ringNext + 1) % RING_SIZE;
+        }
+    }
+
+    double ms = elapsedMs(start);
+    stats.frames++;
+    stats.renderMs += ms;
+    stats.maxRenderMs = std::max(stats.maxRenderMs, ms);
+}
+
+void FrameCapture::read(Slot& slot)
+{
+    if (slot.buffer == 0)
+    {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)frameBytes, NULL, GL_STREAM_READ);
+    }
+    else
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SLOT_READING;
+}
+
+void FrameCapture::poll(bool wait)
+{
+    // Buffers the encoders are done with
+    unsigned int index;
+    while (returned.tryPop(index))
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[index].buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        ring[index].mapped = NULL;
+        ring[index].state = SLOT_FREE;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Readbacks finish in the order they were issued; hand over every one whose fence passed
+    while (ring[reading].state == SLOT_READING)
+    {
+        Slot& slot = ring[reading];
+        GLuint64 timeout = wait ? 100000000 : 0;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        slot.mapped = status == GL_WAIT_FAILED ? NULL :
+            (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frameBytes, GL_MAP_READ_BIT);
+        slot.sequence = nextSequence;
+        if (slot.mapped != NULL)
+            slot.state = SLOT_ENCODING;
+        if (slot.mapped == NULL || !work.tryPush(reading))
+        {
+            std::cout << "ERROR::CAPTURE::Readback of frame " << nextSequence << " failed" << std::endl;
+            if (slot.mapped != NULL)
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            slot.mapped = NULL;
+            slot.state = SLOT_FREE;
+            pendingRepeats += slot.repeats;
+            std::lock_guard<std::mutex> lock(writeMutex);
+            stats.failedWrites++;
+        }
+        else
+        {
+            nextSequence++;
+            stats.captured++;
+            size_t depth = work.size();
+            stats.maxQueueDepth = std::max(stats.maxQueueDepth, depth);
+            stats.totalQueueDepth += (double)depth;
+            wake.notify_one();
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        reading = (reading + 1) % RING_SIZE;
+    }
+}
+
+void FrameCapture::encoderLoop()
+{
+    std::vector<uint8_t> frame((size_t)captureWidth * captureHeight * 3 / 2);
+    while (true)
+    {
+        unsigned int index;
+        if (!work.tryPop(index))
+        {
+            // quit is only set once everything has been queued
+            if (quit.load())
+                return;
+            // The render thread notifies without the lock, so a wakeup can be missed; the timeout
+            // bounds how late that leaves a frame
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(2));
+            continue;
+        }
+        // The slot is the render thread's again once it is returned
+        const Slot& slot = ring[index];
+        uint32_t sequence = slot.sequence;
+        unsigned int repeats = slot.repeats;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        convertToI420(slot.mapped, captureWidth, captureHeight, &frame[0]);
+        double ms = elapsedMs(start);
+        returned.tryPush(index);
+        write(sequence, frame, repeats, ms);
+    }
+}
+
+void FrameCapture::write(uint32_t sequence, const std::vector<uint8_t>& frame, unsigned int repeats, double encodeMs)
+{
+    std::unique_lock<std::mutex> lock(writeMutex);
+    turn.wait(lock, [this, sequence] { return nextWrite == sequence; });
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool written = true;
+    for (unsigned int i = 0; i < repeats && written; i++)
+    {
+        written = fwrite("FRAME\n", 1, 6, output) == 6 && fwrite(&frame[0], 1, frame.size(), output) == frame.size();
+        if (written)
+        {
+            stats.written++;
+            stats.bytesWritten += 6 + frame.size();
+        }
+    }
+    if (!written)
+    {
+        if (stats.failedWrites == 0)
+            std::cout << "ERROR::CAPTURE::Could not write frame " << sequence << " to "
+                      << (piped ? outputName.substr(1) : outputName) << std::endl;
+        stats.failedWrites++;
+    }
+    stats.encodeMs += encodeMs;
+    stats.writeMs += elapsedMs(start);
+    nextWrite++;
+    lock.unlock();
+    turn.notify_all();
+}
+
+void FrameCapture::finish()
+{
+    if (!active())
+        return;
+
+    // Every readback still in flight goes to the encoders, then they drain the queue
+    poll(true);
+    quit = true;
+    wake.notify_all();
+    for (size_t i = 0; i < encoders.size(); i++)
+        encoders[i].join();
+    encoders.clear();
+    poll(false);
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        if (ring[i].fence != 0)
+            glDeleteSync(ring[i].fence);
+        if (ring[i].buffer != 0)
+            glDeleteBuffers(1, &ring[i].buffer);
+        ring[i].buffer = 0;
+        ring[i].fence = 0;
+        ring[i].state = SLOT_FREE;
+    }
+
+    int status = piped ? pclose(output) : fclose(output);
+    output = NULL;
+    if (status != 0)
+    {
+        std::cout << "ERROR::CAPTURE::" << (piped ? "Encoder " + outputName.substr(1) + " failed" :
+                                                   "Could not close " + outputName) << std::endl;
+        stats.failedWrites++;
+    }
+}
+
+void FrameCapture::report(std::ostream& out) const
+{
+    std::string name = piped ? outputName.substr(1) : outputName;
+    out << "CAPTURE::" << stats.captured << " frames captured, " << stats.written << " written ("
+        << captureWidth << "x" << captureHeight << ", " << stats.bytesWritten / (1024 * 1024) << " MB) to " << name
+        << "; dropped " << stats.gpuDrops << " (GPU busy), " << stats.encoderDrops << " (encoders busy), "
+        << stats.sizeDrops << " (window resized), " << stats.failedWrites << " failed" << std::endl;
+    out << "CAPTURE::Render thread avg " << (stats.frames ? stats.renderMs / stats.frames : 0.0) << " ms, max "
+        << stats.maxRenderMs << " ms per frame; queue depth max " << stats.maxQueueDepth << ", mean "
+        << (stats.captured ? stats.totalQueueDepth / stats.captured : 0.0) << "; encode avg "
+        << (stats.captured ? stats.encodeMs / stats.captured : 0.0) << " ms, write avg "
+        << (stats.captured ? stats.writeMs / stats.captured : 0.0) << " ms per frame" << std::endl;
+}
@@ -0,0 +1,290 @@
+#include "../include/frame_pacer.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Controller tuning: the scene pass may use this share of the frame (the rest is CPU overlap
+// and the blit), resolution rises again below the lower share, and changes wait for fresh samples
+static const double GPU_BUDGET = 0.85;
+static const double GPU_RAISE_BELOW = 0.6;
+static const unsigned int SAMPLES_BETWEEN_CHANGES = 8;
+static const float SCALE_STEP = 1.0f / 32.0f;  // Scales snap to this grid so small noise never resizes
+static const double MISSED_DEADLINE_SLACK = 1.1;
+
+FramePacer::FramePacer()
+    : width(0), height(0), pendingWidth(0), pendingHeight(0), currentScale(1.0f), gpuMs(0.0), samplesSinceChange(0), nextQuery(0), activeQuery(-1),
+      timing(false), frameCount(0), keepingGpuTimes(false), framebuffer(0), colorBuffer(0), depthBuffer(0), bufferWidth(0), bufferHeight(0),
+      offscreen(false), presented(false)
+{
+    for (int i = 0; i < QUERY_COUNT; i++)
+    {
+        queries[i] = 0;
+        queryFrame[i] = 0;
+        queryPending[i] = false;
+    }
+}
+
+FramePacer::~FramePacer()
+{
+    if (timing)
+        glDeleteQueries(QUERY_COUNT, queries);
+    releaseTarget();
+}
+
+bool FramePacer::initialize(const FramePacingSettings& pacingSettings, int windowWidth, int windowHeight)
+{
+    settings = pacingSettings;
+    settings.minScale = std::max(0.25f, std::min(settings.minScale, 1.0f));
+    settings.maxScale = std::max(settings.minScale, std::min(settings.maxScale, 1.0f));
+    currentScale = settings.maxScale;
+    width = windowWidth;
+    height = windowHeight;
+
+    // Timer queries are core in GL 3.3
+    timing = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (timing)
+        glGenQueries(QUERY_COUNT, queries);
+    else if (settings.dynamicResolution)
+    {
+        std::cout << "Warning: No GPU timer queries, dynamic resolution disabled" << std::endl;
+        settings.dynamicResolution = false;
+    }
+    stats.reset();
+    return timing;
+}
+
+void FramePacer::resize(int windowWidth, int windowHeight)
+{
+    if (windowWidth <= 0 || windowHeight <= 0)
+        return;  // Minimized: keep the old size until the window comes back
+    // Events are also polled mid-frame (the camera latch), so the size changes at the next frame
+    pendingWidth = windowWidth;
+    pendingHeight = windowHeight;
+}
+
+int FramePacer::swapInterval(int refreshRate, bool tearControl) const
+{
+    if (settings.swapPolicy == SWAP_IMMEDIATE)
+        return 0;
+    if (settings.swapPolicy == SWAP_ADAPTIVE && tearControl)
+        return -1;
+    // e.g. a 33 ms target on a 60 Hz display presents every second refresh
+    int refreshes = 1;
+    if (refreshRate > 0)
+        refreshes = std::max(1, (int)std::floor(settings.targetFrameMs * refreshRate / 1000.0f + 0.5f));
+    return refreshes;
+}
+
+int FramePacer::renderWidth() const
+{
+    return std::max(1, (int)(width * currentScale + 0.5f));
+}
+
+int FramePacer::renderHeight() const
+{
+    return std::max(1, (int)(height * currentScale + 0.5f));
+}
+
+void FramePacer::beginFrame()
+{
+    collectQueries();
+    if (pendingWidth > 0)
+    {
+        width = pendingWidth;
+        height = pendingHeight;
+        pendingWidth = pendingHeight = 0;
+        // Reallocated at the new size by the next offscreen frame
+        if (framebuffer != 0 && (bufferWidth != width || bufferHeight != height))
+            releaseTarget();
+    }
+
+    offscreen = settings.dynamicResolution && currentScale < 1.0f;
+    if (offscreen)
+    {
+        if (framebuffer == 0)
+            allocateTarget();
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, renderWidth(), renderHeight());
+    }
+    else
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+    }
+
+    // Skip timing this frame rather than wait for a query still in flight
+    frameCount++;
+    activeQuery = -1;
+    if (timing && !queryPending[nextQuery])
+    {
+        activeQuery = nextQuery;
+        queryFrame[activeQuery] = frameCount;
+        glBeginQuery(GL_TIME_ELAPSED, queries[activeQuery]);
+        nextQuery = (nextQuery + 1) % QUERY_COUNT;
+    }
+}
+
+void FramePacer::endFrame()
+{
+    if (activeQuery >= 0)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[activeQuery] = true;
+        activeQuery = -1;
+    }
+    if (!offscreen)
+        return;
+
+    // Stretch the scaled frame over the window
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, renderWidth(), renderHeight(), 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+void FramePacer::present()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!presented)
+    {
+        lastPresent = now;
+        presented = true;
+        return;
+    }
+
+    // Without vsync nothing else holds the frame rate: sleep most of the remainder, spin the rest
+    std::chrono::duration<double, std::milli> target(settings.targetFrameMs);
+    if (settings.swapPolicy == SWAP_IMMEDIATE)
+    {
+        std::chrono::steady_clock::time_point deadline =
+            lastPresent + std::chrono::duration_cast<std::chrono::steady_clock::duration>(target);
+        if (deadline - now > std::chrono::milliseconds(2))
+            std::this_thread::sleep_until(deadline - std::chrono::milliseconds(1));
+        while (std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        now = std::chrono::steady_clock::now();
+    }
+
+    double frameMs = std::chrono::duration<double, std::milli>(now - lastPresent).count();
+    lastPresent = now;
+    stats.frames++;
+    stats.totalFrameMs += frameMs;
+    stats.maxFrameMs = std::max(stats.maxFrameMs, frameMs);
+    if (settings.targetFrameMs > 0.0f && frameMs > settings.targetFrameMs * MISSED_DEADLINE_SLACK)
+        stats.missedDeadlines++;
+}
+
+size_t FramePacer::drainGpuTimes(std::vector<std::pair<unsigned int, double> >& times)
+{
+    times.clear();
+    times.swap(gpuTimes);
+    return times.size();
+}
+
+void FramePacer::finishTiming()
+{
+    collectQueries(true);
+}
+
+void FramePacer::collectQueries(bool wait)
+{
+    // Oldest first, so the smoothed time follows frame order
+    for (int k = 0; k < QUERY_COUNT; k++)
+    {
+        int i = (nextQuery + k) % QUERY_COUNT;
+        if (!queryPending[i])
+            continue;
+        GLint available = 0;
+        if (!wait)
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait)
+            break;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+        queryPending[i] = false;
+
+        double sampleMs = nanoseconds / 1.0e6;
+        if (keepingGpuTimes)
+            gpuTimes.push_back(std::make_pair(queryFrame[i], sampleMs));
+        stats.gpuSamples++;
+        stats.totalGpuMs += sampleMs;
+        stats.maxGpuMs = std::max(stats.maxGpuMs, sampleMs);
+        updateScale(sampleMs);
+    }
+}
+
+void FramePacer::updateScale(double sampleMs)
+{
+    // One hitch (a shader compile, a texture upload) weighs at most a few frames
+    sampleMs = std::min(sampleMs, (double)settings.targetFrameMs * 4.0);
+    gpuMs = gpuMs == 0.0 ? sampleMs : gpuMs * 0.8 + sampleMs * 0.2;
+    samplesSinceChange++;
+    if (!settings.dynamicResolution || samplesSinceChange < SAMPLES_BETWEEN_CHANGES || gpuMs <= 0.0)
+        return;
+
+    double budget = settings.targetFrameMs * GPU_BUDGET;
+    if (gpuMs <= budget && gpuMs >= settings.targetFrameMs * GPU_RAISE_BELOW)
+        return;
+
+    // GPU time follows the pixel count, the square of the scale; limit each step so one spike
+    // cannot halve the resolution
+    float wanted = currentScale * (float)std::sqrt(budget / gpuMs);
+    wanted = std::max(currentScale * 0.8f, std::min(wanted, currentScale * 1.1f));
+    wanted = std::floor(wanted / SCALE_STEP + 0.5f) * SCALE_STEP;
+    wanted = std::max(settings.minScale, std::min(wanted, settings.maxScale));
+    if (wanted == currentScale)
+        return;
+
+    // Expect the new resolution's cost until its own samples arrive
+    gpuMs *= (wanted * wanted) / (currentScale * currentScale);
+    currentScale = wanted;
+    samplesSinceChange = 0;
+    stats.scaleChanges++;
+}
+
+void FramePacer::allocateTarget()
+{
+    // Sized for the window, so any scale below 1 fits without reallocating
+    bufferWidth = width;
+    bufferHeight = height;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, bufferWidth, bufferHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, bufferWidth, bufferHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "ERROR::PACING::Offscreen framebuffer incomplete, dynamic resolution disabled" << std::endl;
+        releaseTarget();
+        settings.dynamicResolution = false;
+        currentScale = 1.0f;
+    }
+}
+
+void FramePacer::releaseTarget()
+{
+    if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+    if (colorBuffer != 0) glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer != 0) glDeleteRenderbuffers(1, &depthBuffer);
+    framebuffer = colorBuffer = depthBuffer = 0;
+    bufferWidth = bufferHeight = 0;
+}
+
+void FramePacer::report(std::ostream& out)
+{
+    const FramePacingStats& s = stats;
+    out << "PACING::Scale " << currentScale << " (" << renderWidth() << "x" << renderHeight() << "), frame avg "
+        << (s.frames ? s.totalFrameMs / s.frames : 0.0) << " ms, max " << s.maxFrameMs << " ms, target "
+        << settings.targetFrameMs << " ms, " << s.missedDeadlines << "/" << s.frames << " missed deadlines, GPU avg "
+        << (s.gpuSamples ? s.totalGpuMs / s.gpuSamples : 0.0) << " ms, max " << s.maxGpuMs << " ms, "
+        << s.scaleChanges << " scale changes" << std::endl;
+    stats.reset();
+}
@@ -0,0 +1,78 @@
+#include "../include/geometry_arena.h"
+#include <algorithm>
+
+GeometryArena::GeometryArena(size_t minimumBlockFloats) : current(0), blockFloats(minimumBlockFloats)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+    release();
+}
+
+void GeometryArena::addBlock(size_t floats)
+{
+    Block block;
+    block.capacity = std::max(floats, blockFloats);
+    block.data = new float[block.capacity];
+    block.used = 0;
+    blocks.push_back(block);
+    current = blocks.size() - 1;
+}
+
+void GeometryArena::reserve(size_t floats)
+{
+    // Reuse any block with enough room left (after reset() all of them are empty)
+    for (size_t i = current; i < blocks.size(); i++)
+    {
+        if (blocks[i].capacity - blocks[i].used >= floats)
+        {
+            current = i;
+            return;
+        }
+    }
+    addBlock(floats);
+}
+
+float* GeometryArena::allocate(size_t floats)
+{
+    if (blocks.empty() || blocks[current].capacity - blocks[current].used < floats)
+        reserve(floats);
+    Block& block = blocks[current];
+    float* result = block.data + block.used;
+    block.used += floats;
+    return result;
+}
+
+void GeometryArena::reset()
+{
+    for (size_t i = 0; i < blocks.size(); i++)
+        blocks[i].used = 0;
+    current = 0;
+}
+
+void GeometryArena::release()
+{
+    for (size_t i = 0; i < blocks.size(); i++)
+        delete[] blocks[i].data;
+    blocks.clear();
+    // Shrink the vector's own storage too
+    std::vector<Block>().swap(blocks);
+    current = 0;
+}
+
+size_t GeometryArena::usedBytes() const
+{
+    size_t floats = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+        floats += blocks[i].used;
+    return floats * sizeof(float);
+}
+
+size_t GeometryArena::capacityBytes() const
+{
+    size_t floats = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+        floats += blocks[i].capacity;
+    return floats * sizeof(float);
+}
@@ -0,0 +1,610 @@
+#include "../include/gpu_scene.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Objects per compute work group; must match local_size_x in shaders/cull.comp
+static const unsigned int CULL_GROUP_SIZE = 64;
+
+// Stand-ins replace a model beyond this many meters per meter of their bounding-box diagonal
+static const float LOD_DISTANCE_PER_METER = 15.0f;
+
+static const unsigned int NO_MESH = 0xFFFFFFu;
+
+// Six inward-facing planes (xyz normal, w distance) of a view-projection matrix
+static void extractFrustum(const glm::mat4& m, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    planes[0] = rows[3] + rows[0];  // left
+    planes[1] = rows[3] - rows[0];  // right
+    planes[2] = rows[3] + rows[1];  // bottom
+    planes[3] = rows[3] - rows[1];  // top
+    planes[4] = rows[3] + rows[2];  // near
+    planes[5] = rows[3] - rows[2];  // far
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+static bool boxInFrustum(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+    for (int i = 0; i < 6; i++)
+    {
+        glm::vec3 normal(planes[i]);
+        if (glm::dot(normal, center) + planes[i].w + glm::dot(glm::abs(normal), extent) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+static unsigned int compileCompute(const std::string& path)
+{
+    std::string code;
+    if (!Shader::readFile(path.c_str(), code))
+        return 0;
+    const char* source = code.c_str();
+    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int success;
+    char infoLog[1024];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+        std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: COMPUTE\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: COMPUTE\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GpuScene::GpuScene()
+    : lodScale(1.0f), cullProgram(0), VAO(0), vertexBuffer(0), objectBuffer(0), batchBuffer(0),
+      commandBuffer(0), visibleBuffer(0), matrixBuffer(0), materialBuffer(0), lightmapBuffer(0),
+      builtResidency(~0u), textureCount(0), lightmapArray(0), animated(false)
+{
+    for (int g = 0; g < GPU_GROUP_COUNT; g++)
+        groupFirst[g] = groupCount[g] = 0;
+    for (unsigned int i = 0; i < TEXTURE_SLOTS; i++)
+        textureArrays[i] = 0;
+}
+
+GpuScene::~GpuScene()
+{
+    releaseBuffers();
+    if (cullProgram != 0) glDeleteProgram(cullProgram);
+}
+
+bool GpuScene::supported()
+{
+    if (!GLEW_VERSION_4_3)
+        return false;
+    // GL 4.3 only requires storage buffers in the fragment and compute stages
+    GLint vertexBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+    return vertexBlocks >= 2;
+}
+
+bool GpuScene::initialize(const std::string& computePath)
+{
+    if (cullProgram != 0) glDeleteProgram(cullProgram);
+    cullProgram = compileCompute(computePath);
+    return cullProgram != 0;
+}
+
+void GpuScene::releaseBuffers()
+{
+    unsigned int buffers[] = { vertexBuffer, objectBuffer, batchBuffer, commandBuffer, visibleBuffer,
+                               matrixBuffer, materialBuffer, lightmapBuffer };
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+    {
+        if (buffers[i] != 0) glDeleteBuffers(1, &buffers[i]);
+    }
+    if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+    if (lightmapArray != 0) glDeleteTextures(1, &lightmapArray);
+    VAO = vertexBuffer = objectBuffer = batchBuffer = commandBuffer = visibleBuffer = 0;
+    matrixBuffer = materialBuffer = lightmapBuffer = lightmapArray = 0;
+}
+
+void GpuScene::update(Campus& campus)
+{
+    if (!active() || campus.residency() == builtResidency)
+        return;
+    std::vector<Classroom*> rooms;
+    campus.residentRooms(rooms);
+    build(rooms);
+    builtResidency = campus.residency();
+}
+
+void GpuScene::build(const std::vector<Classroom*>& rooms)
+{
+    // Every distinct vertex buffer becomes a range of the packed one (models are shared)
+    struct Mesh
+    {
+        unsigned int VBO, lightmapVBO;
+        unsigned int first, count;
+        glm::vec3 boundsMin, boundsMax;
+        bool scaled;  // OBJ models take the instance scale; procedural parts are in meters
+    };
+    std::vector<Mesh> meshes;
+    std::map<unsigned int, unsigned int> meshByBuffer;
+    unsigned int vertexTotal = 0;
+
+    struct Local
+    {
+        static unsigned int mesh(std::vector<Mesh>& meshes, std::map<unsigned int, unsigned int>& byBuffer,
+                                 unsigned int& total, unsigned int VBO, size_t count,
+                                 const glm::vec3& boundsMin, const glm::vec3& boundsMax, bool scaled,
+                                 unsigned int lightmapVBO = 0)
+        {
+            if (VBO == 0 || count == 0)
+                return NO_MESH;
+            std::map<unsigned int, unsigned int>::iterator it = byBuffer.find(VBO);
+            if (it != byBuffer.end())
+                return it->second;
+            Mesh mesh;
+            mesh.VBO = VBO;
+            mesh.lightmapVBO = lightmapVBO;
+            mesh.first = total;
+            mesh.count = (unsigned int)count;
+            mesh.boundsMin = boundsMin;
+            mesh.boundsMax = boundsMax;
+            mesh.scaled = scaled;
+            total += mesh.count;
+            meshes.push_back(mesh);
+            byBuffer[VBO] = (unsigned int)(meshes.size() - 1);
+            return (unsigned int)(meshes.size() - 1);
+        }
+    };
+
+    // Batches: objects sharing meshes (per LOD) and a shader variant group
+    std::map<unsigned long long, unsigned int> batchByKey;
+    std::vector<unsigned int> batchMeshes[2];
+    std::vector<int> batchGroup;
+    std::vector<unsigned int> batchObjects;
+
+    // Lightmap layers, sized to the largest room atlas
+    std::vector<unsigned int> lightmapLayers(rooms.size(), 0);
+    unsigned int lightmapWidth = 0, lightmapHeight = 0, lightmapCount = 0;
+    for (size_t r = 0; r < rooms.size(); r++)
+    {
+        if (rooms[r]->lightmapTexture == 0)
+            continue;
+        lightmapLayers[r] = lightmapCount++;
+        lightmapWidth = std::max(lightmapWidth, rooms[r]->lightmapLayout.width);
+        lightmapHeight = std::max(lightmapHeight, rooms[r]->lightmapLayout.height);
+    }
+
+    objects.clear();
+    materials.clear();
+    textureCount = 0;
+    animated = false;
+    for (size_t r = 0; r < rooms.size(); r++)
+    {
+        Classroom& room = *rooms[r];
+        const LightmapLayout& layout = room.lightmapLayout;
+        glm::vec2 atlasScale(0.0f);
+        if (room.lightmapTexture != 0)
+            atlasScale = glm::vec2((float)layout.width / lightmapWidth, (float)layout.height / lightmapHeight);
+        unsigned int materialBase = (unsigned int)materials.size();
+        for (size_t i = 0; i < room.scene.materials.size(); i++)
+        {
+            const Material& m = room.scene.materials[i];
+            GpuMaterial gm;
+            std::memcpy(gm.ambient, glm::value_ptr(m.ambient), sizeof(float) * 3);
+            std::memcpy(gm.diffuse, glm::value_ptr(m.diffuse), sizeof(float) * 3);
+            std::memcpy(gm.specular, glm::value_ptr(m.specular), sizeof(float) * 3);
+            gm.ambient[3] = gm.diffuse[3] = 1.0f;
+            gm.specular[3] = m.shininess;
+            gm.texture[0] = NO_TEXTURE;
+            gm.texture[1] = (unsigned int)m.diffuseLayer;
+            gm.texture[2] = gm.texture[3] = 0;
+            for (unsigned int t = 0; m.diffuseMap != 0 && t < TEXTURE_SLOTS; t++)
+            {
+                if (t == textureCount)
+                    textureArrays[textureCount++] = m.diffuseMap;
+                if (textureArrays[t] == m.diffuseMap)
+                {
+                    gm.texture[0] = t;
+                    break;
+                }
+            }
+            materials.push_back(gm);
+        }
+
+        // One placement per shell part, then one per model instance
+        const SceneInstances& inst = room.scene.instances;
+        size_t count = room.shellParts.size() + inst.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned int lod0, lod1 = NO_MESH;
+            uint16_t material;
+            int group;
+            GpuObject object;
+            std::memset(&object, 0, sizeof(object));
+            glm::vec4 rect(0.0f);
+
+            if (i < room.shellParts.size())
+            {
+                const MeshPart& part = room.shellParts[i];
+                lod0 = Local::mesh(meshes, meshByBuffer, vertexTotal, part.VBO, part.count,
+                                   part.boundsMin, part.boundsMax, false, part.lightmapVBO);
+                rect = part.lightmapRect;
+                material = part.material;
+                group = part.emissive ? GPU_GROUP_EMISSIVE : -1;
+                object.position[0] = room.origin.x;
+                object.position[1] = room.origin.y;
+                object.position[2] = room.origin.z;
+                object.scale = 1.0f;
+            }
+            else
+            {
+                size_t k = i - room.shellParts.size();
+                const Model& model = *room.models[inst.model[k]];
+                const MeshPart& fallback = room.fallbackParts[inst.model[k]];
+                unsigned int standIn = Local::mesh(meshes, meshByBuffer, vertexTotal, fallback.VBO, fallback.count,
+                                                   fallback.boundsMin, fallback.boundsMax, false);
+                if (model.uploaded())
+                {
+                    lod0 = Local::mesh(meshes, meshByBuffer, vertexTotal, model.VBO, model.vertexCount,
+                                       model.boundsMin, model.boundsMax, true, model.lightmapVBO);
+                    lod1 = standIn;
+                    rect = layout.instanceRects.empty() ? glm::vec4(0.0f) : layout.instanceRects[k];
+                    const std::string& spinGroup = room.scene.models[inst.model[k]].spinGroup;
+                    const ModelPart* spinning = spinGroup.empty() ? NULL : model.part(spinGroup);
+                    if (spinning != NULL && inst.spin[k] != 0.0f)
+                    {
+                        object.spinFirst = (float)(meshes[lod0].first + spinning->first);
+                        object.spinCount = (float)spinning->count;
+                        animated = true;
+                    }
+                }
+                else
+                {
+                    lod0 = standIn;
+                }
+                material = inst.material[k];
+                group = -1;
+                object.position[0] = room.origin.x + inst.posX[k];
+                object.position[1] = room.origin.y + inst.posY[k];
+                object.position[2] = room.origin.z + inst.posZ[k];
+                object.yaw = inst.yaw[k];
+                object.scale = inst.scale[k];
+                object.spin = inst.spin[k];
+            }
+            if (lod0 == NO_MESH)
+                continue;
+            if (group < 0)
+            {
+                bool specular = Classroom::materialFeatures(room.scene.materials[material]) & FEATURE_SPECULAR;
+                group = specular ? GPU_GROUP_SPECULAR : GPU_GROUP_DIFFUSE;
+            }
+
+            unsigned long long key = ((unsigned long long)lod0 << 32) | ((unsigned long long)lod1 << 8) |
+                                     (unsigned long long)group;
+            std::map<unsigned long long, unsigned int>::iterator it = batchByKey.find(key);
+            if (it == batchByKey.end())
+            {
+                it = batchByKey.insert(std::make_pair(key, (unsigned int)batchGroup.size())).first;
+                batchMeshes[0].push_back(lod0);
+                batchMeshes[1].push_back(lod1);
+                batchGroup.push_back(group);
+                batchObjects.push_back(0);
+            }
+            object.batch = it->second;
+            object.material = materialBase + material;
+            if (room.lightmapTexture != 0 && rect.x > 0.0f)
+            {
+                // Stand-ins have no lightmap coordinates, so distant LODs stay dynamically lit
+                object.lightmapLayer = lightmapLayers[r];
+                object.lightmapRect[0] = rect.x * atlasScale.x;
+                object.lightmapRect[1] = rect.y * atlasScale.y;
+                object.lightmapRect[2] = rect.z * atlasScale.x;
+                object.lightmapRect[3] = rect.w * atlasScale.y;
+            }
+            batchObjects[it->second]++;
+            objects.push_back(object);
+        }
+    }
+
+    // Commands ordered by group so each group is one contiguous multi-draw. Every LOD of a
+    // batch gets room for all of the batch's objects in the visible list.
+    batches.assign(batchGroup.size(), GpuBatch());
+    commands.clear();
+    unsigned int visibleTotal = 0;
+    for (int g = 0; g < GPU_GROUP_COUNT; g++)
+    {
+        groupFirst[g] = (unsigned int)commands.size();
+        for (size_t b = 0; b < batches.size(); b++)
+        {
+            if (batchGroup[b] != g)
+                continue;
+            GpuBatch& batch = batches[b];
+            for (int l = 0; l < 2; l++)
+            {
+                if (batchMeshes[l][b] == NO_MESH)
+                    continue;
+                const Mesh& mesh = meshes[batchMeshes[l][b]];
+                GpuLod& lod = batch.lods[batch.lodCount++];
+                std::memcpy(lod.boundsMin, glm::value_ptr(mesh.boundsMin), sizeof(float) * 3);
+                std::memcpy(lod.boundsMax, glm::value_ptr(mesh.boundsMax), sizeof(float) * 3);
+                lod.applyScale = mesh.scaled ? 1.0f : 0.0f;
+                lod.command = (unsigned int)commands.size();
+
+                DrawCommand command;
+                command.count = mesh.count;
+                command.instanceCount = 0;
+                command.first = mesh.first;
+                command.baseInstance = visibleTotal;
+                commands.push_back(command);
+                visibleTotal += batchObjects[b];
+            }
+            // Switch to the stand-in at a distance proportional to its size
+            if (batch.lodCount > 1)
+            {
+                const Mesh& standIn = meshes[batchMeshes[1][b]];
+                batch.lods[0].switchDistance = LOD_DISTANCE_PER_METER * glm::length(standIn.boundsMax - standIn.boundsMin);
+            }
+        }
+        groupCount[g] = (unsigned int)commands.size() - groupFirst[g];
+    }
+
+    // Pack the vertices GPU-side; the CPU copies are long gone
+    releaseBuffers();
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexTotal * 8 * sizeof(float), NULL, GL_STATIC_DRAW);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                            (GLintptr)meshes[i].first * 8 * sizeof(float),
+                            (GLsizeiptr)meshes[i].count * 8 * sizeof(float));
+    }
+
+    // Lightmap coordinates alongside; meshes without any keep the "no baked lighting" marker
+    if (lightmapCount > 0)
+    {
+        std::vector<float> none((size_t)vertexTotal * 2, -1.0f);
+        glGenBuffers(1, &lightmapBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, lightmapBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)none.size() * sizeof(float), none.empty() ? NULL : &none[0],
+                     GL_STATIC_DRAW);
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            if (meshes[i].lightmapVBO == 0)
+                continue;
+            glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].lightmapVBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                                (GLintptr)meshes[i].first * 2 * sizeof(float),
+                                (GLsizeiptr)meshes[i].count * 2 * sizeof(float));
+        }
+
+        glGenTextures(1, &lightmapArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, lightmapArray);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGB9_E5, lightmapWidth, lightmapHeight, lightmapCount);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        for (size_t r = 0; r < rooms.size(); r++)
+        {
+            const Classroom& room = *rooms[r];
+            if (room.lightmapTexture == 0)
+                continue;
+            glCopyImageSubData(room.lightmapTexture, GL_TEXTURE_2D, 0, 0, 0, 0, lightmapArray, GL_TEXTURE_2D_ARRAY,
+                               0, 0, 0, lightmapLayers[r], room.lightmapLayout.width, room.lightmapLayout.height, 1);
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    upload(visibleTotal);
+
+    std::cout << "GPU::Built " << objects.size() << " objects from " << rooms.size() << " rooms: "
+              << meshes.size() << " meshes (" << vertexTotal << " vertices), " << commands.size()
+              << " draw commands, " << textureCount << " texture arrays, " << lightmapCount << " lightmaps"
+              << std::endl;
+}
+
+void GpuScene::upload(size_t visibleTotal)
+{
+    struct Local
+    {
+        static unsigned int storage(const void* data, size_t bytes, GLenum usage)
+        {
+            unsigned int buffer;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            // Never zero-sized, so an empty campus still binds valid buffers
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(bytes ? bytes : 16), data, usage);
+            return buffer;
+        }
+    };
+    objectBuffer = Local::storage(objects.empty() ? NULL : &objects[0], objects.size() * sizeof(GpuObject), GL_STATIC_DRAW);
+    batchBuffer = Local::storage(batches.empty() ? NULL : &batches[0], batches.size() * sizeof(GpuBatch), GL_STATIC_DRAW);
+    materialBuffer = Local::storage(materials.empty() ? NULL : &materials[0], materials.size() * sizeof(GpuMaterial), GL_STATIC_DRAW);
+    commandBuffer = Local::storage(commands.empty() ? NULL : &commands[0], commands.size() * sizeof(DrawCommand), GL_DYNAMIC_DRAW);
+    visibleBuffer = Local::storage(NULL, visibleTotal * sizeof(unsigned int), GL_DYNAMIC_COPY);
+    matrixBuffer = Local::storage(NULL, objects.size() * sizeof(glm::mat4), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Same attribute layout as Model and MeshPart, plus the per-instance object index
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glVertexAttribDivisor(3, 1);
+    if (lightmapBuffer != 0)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, lightmapBuffer);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Shader features of each draw group
+static const unsigned int GROUP_FEATURES[GPU_GROUP_COUNT] =
+{
+    FEATURE_INDIRECT | FEATURE_SPECULAR,
+    FEATURE_INDIRECT,
+    FEATURE_INDIRECT | FEATURE_EMISSIVE
+};
+
+unsigned int GpuScene::groupFeatures(int group) const
+{
+    // Lit groups sample the texture arrays as soon as any material has one, the lightmaps as soon
+    // as any room has baked lighting, and spin sub-meshes as soon as any object has one
+    if (group == GPU_GROUP_EMISSIVE)
+        return GROUP_FEATURES[group];
+    return GROUP_FEATURES[group] | (textureCount > 0 ? (unsigned int)FEATURE_TEXTURED : 0u) |
+           (lightmapArray != 0 ? (unsigned int)FEATURE_LIGHTMAP : 0u) |
+           (animated ? (unsigned int)FEATURE_ANIMATED : 0u);
+}
+
+void GpuScene::prepare(ShaderVariants& shaders)
+{
+    for (int g = 0; g < GPU_GROUP_COUNT; g++)
+    {
+        if (groupCount[g] > 0)
+            shaders.get(groupFeatures(g));
+    }
+}
+
+void GpuScene::render(ShaderVariants& shaders, const glm::mat4& projection, const glm::mat4& view,
+                      const glm::vec3& viewPos, float time)
+{
+    if (!active() || objects.empty())
+        return;
+
+    // Reset the instance counts; per-command, not per-object, work
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(commands.size() * sizeof(DrawCommand)), &commands[0]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batchBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, matrixBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, materialBuffer);
+
+    glm::vec4 planes[6];
+    extractFrustum(projection * view, planes);
+    glUseProgram(cullProgram);
+    glUniform1ui(glGetUniformLocation(cullProgram, "objectCount"), (GLuint)objects.size());
+    glUniform4fv(glGetUniformLocation(cullProgram, "frustum"), 6, glm::value_ptr(planes[0]));
+    glUniform3fv(glGetUniformLocation(cullProgram, "viewPos"), 1, glm::value_ptr(viewPos));
+    glUniform1f(glGetUniformLocation(cullProgram, "time"), time);
+    glUniform1f(glGetUniformLocation(cullProgram, "lodScale"), lodScale);
+    glDispatchCompute(((GLuint)objects.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    static const GLint units[TEXTURE_SLOTS] = { 0, 1, 2, 3 };
+    for (unsigned int t = 0; t < textureCount; t++)
+    {
+        glActiveTexture(GL_TEXTURE0 + t);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArrays[t]);
+    }
+    if (lightmapArray != 0)
+    {
+        glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, lightmapArray);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    for (int g = 0; g < GPU_GROUP_COUNT; g++)
+    {
+        if (groupCount[g] == 0)
+            continue;
+        Shader& shader = shaders.get(groupFeatures(g));
+        shader.use();
+        if (textureCount > 0)
+            glUniform1iv(glGetUniformLocation(shader.ID, "diffuseMaps"), TEXTURE_SLOTS, units);
+        if (lightmapArray != 0)
+            glUniform1i(glGetUniformLocation(shader.ID, "lightmaps"), LIGHTMAP_TEXTURE_UNIT);
+        glMultiDrawArraysIndirect(GL_TRIANGLES, (const void*)(groupFirst[g] * sizeof(DrawCommand)),
+                                  (GLsizei)groupCount[g], 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+unsigned int GpuScene::visibleCount()
+{
+    if (commands.empty())
+        return 0;
+    std::vector<DrawCommand> drawn(commands.size());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(drawn.size() * sizeof(DrawCommand)), &drawn[0]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    unsigned int visible = 0;
+    for (size_t i = 0; i < drawn.size(); i++)
+        visible += drawn[i].instanceCount;
+    return visible;
+}
+
+unsigned int GpuScene::cpuVisibleCount(Campus& campus, const glm::mat4& viewProjection)
+{
+    glm::vec4 planes[6];
+    extractFrustum(viewProjection, planes);
+    std::vector<Classroom*> rooms;
+    campus.residentRooms(rooms);
+
+    unsigned int visible = 0;
+    for (size_t r = 0; r < rooms.size(); r++)
+    {
+        Classroom& room = *rooms[r];
+        for (size_t i = 0; i < room.shellParts.size(); i++)
+        {
+            const MeshPart& part = room.shellParts[i];
+            if (part.VBO != 0 && part.count > 0 &&
+                boxInFrustum(planes, room.origin + part.boundsMin, room.origin + part.boundsMax))
+                visible++;
+        }
+        room.updateTransforms();
+        const InstanceTransforms& t = room.transforms;
+        for (size_t i = 0; i < t.size(); i++)
+        {
+            uint16_t m = room.scene.instances.model[i];
+            if (!room.models[m]->uploaded() && room.fallbackParts[m].VBO == 0)
+                continue;
+            if (boxInFrustum(planes, glm::vec3(t.minX[i], t.minY[i], t.minZ[i]),
+                             glm::vec3(t.maxX[i], t.maxY[i], t.maxZ[i])))
+                visible++;
+        }
+    }
+    return visible;
+}
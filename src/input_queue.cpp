@@ -0,0 +1,43 @@
+#include "../include/input_queue.h"
+
+void InputQueue::push(InputEventType type, double time, float x, float y)
+{
+    InputEvent event;
+    event.type = type;
+    event.time = time;
+    event.x = x;
+    event.y = y;
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(event);
+}
+
+size_t InputQueue::drain(std::vector<InputEvent>& events)
+{
+    events.clear();
+    {
+        // Swap rather than copy; both vectors keep their capacity across frames
+        std::lock_guard<std::mutex> lock(mutex);
+        events.swap(pending);
+    }
+    return events.size();
+}
+
+void KeyActions::bind(int key, const std::function<void()>& action)
+{
+    Binding binding;
+    binding.key = key;
+    binding.held = false;
+    binding.action = action;
+    bindings.push_back(binding);
+}
+
+void KeyActions::poll(const std::function<bool(int)>& isDown)
+{
+    for (size_t i = 0; i < bindings.size(); i++)
+    {
+        bool down = isDown(bindings[i].key);
+        if (down && !bindings[i].held)
+            bindings[i].action();
+        bindings[i].held = down;
+    }
+}
@@ -0,0 +1,117 @@
+#include "../include/latency_meter.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// Overlay strip: this many bits, squares of this size in pixels
+static const int OVERLAY_BITS = 16;
+static const int OVERLAY_SQUARE = 12;
+
+LatencyMeter::LatencyMeter()
+    : overlay(false), nextQuery(0), timing(false), clockOffset(0.0), latchedInput(0.0)
+{
+    for (int i = 0; i < QUERY_COUNT; i++)
+    {
+        queries[i] = 0;
+        queryInput[i] = 0.0;
+        queryPending[i] = false;
+    }
+}
+
+LatencyMeter::~LatencyMeter()
+{
+    if (timing)
+        glDeleteQueries(QUERY_COUNT, queries);
+}
+
+bool LatencyMeter::initialize()
+{
+    // Timestamp queries are core in GL 3.3
+    timing = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (timing)
+        glGenQueries(QUERY_COUNT, queries);
+    else
+        std::cout << "Warning: No GPU timestamp queries, input latency is not measured" << std::endl;
+    stats.reset();
+    return timing;
+}
+
+void LatencyMeter::latch(double inputTime, unsigned int events, double now)
+{
+    latchedInput = inputTime;
+    stats.latched += events;
+    if (!timing)
+        return;
+    collectQueries();
+
+    // The GPU clock's current value, without waiting for queued commands
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    clockOffset = now - gpuNow / 1.0e9;
+}
+
+void LatencyMeter::endFrame(int windowWidth, int windowHeight)
+{
+    if (overlay)
+        drawOverlay(windowWidth, windowHeight);
+
+    // Skip the frame rather than wait for a timestamp still in flight
+    if (!timing || latchedInput <= 0.0 || queryPending[nextQuery])
+        return;
+    glQueryCounter(queries[nextQuery], GL_TIMESTAMP);
+    // Converted to the GPU clock with the offset of this frame, so a later estimate does not shift it
+    queryInput[nextQuery] = latchedInput - clockOffset;
+    queryPending[nextQuery] = true;
+    nextQuery = (nextQuery + 1) % QUERY_COUNT;
+}
+
+void LatencyMeter::collectQueries()
+{
+    for (int k = 0; k < QUERY_COUNT; k++)
+    {
+        int i = (nextQuery + k) % QUERY_COUNT;
+        if (!queryPending[i])
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+        queryPending[i] = false;
+
+        double latencyMs = (nanoseconds / 1.0e9 - queryInput[i]) * 1000.0;
+        if (latencyMs < 0.0)
+            continue;  // Clock estimate off by more than the latency; not a sample
+        stats.frames++;
+        stats.totalMs += latencyMs;
+        stats.maxMs = std::max(stats.maxMs, latencyMs);
+    }
+}
+
+void LatencyMeter::drawOverlay(int windowWidth, int windowHeight)
+{
+    unsigned int stamp = (unsigned int)(long long)std::floor(latchedInput * 1000.0) & ((1u << OVERLAY_BITS) - 1);
+    int top = windowHeight - OVERLAY_SQUARE;
+    if (top < 0 || windowWidth < OVERLAY_BITS * OVERLAY_SQUARE)
+        return;
+
+    // Scissored clears: no program or geometry, and nothing else's state to restore
+    glEnable(GL_SCISSOR_TEST);
+    for (int bit = 0; bit < OVERLAY_BITS; bit++)
+    {
+        float value = (stamp >> (OVERLAY_BITS - 1 - bit)) & 1u ? 1.0f : 0.0f;
+        glScissor(bit * OVERLAY_SQUARE, top, OVERLAY_SQUARE, OVERLAY_SQUARE);
+        glClearColor(value, value, value, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void LatencyMeter::report(std::ostream& out)
+{
+    const LatencyStats& s = stats;
+    out << "LATENCY::Input to GPU done avg " << (s.frames ? s.totalMs / s.frames : 0.0) << " ms, max " << s.maxMs
+        << " ms over " << s.frames << " frames, " << s.latched << " input events latched" << std::endl;
+    stats.reset();
+}
@@ -0,0 +1,262 @@
+#include "../include/lightmap.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+static const uint32_t LIGHTMAP_MAGIC = 0x504D4C43;  // "CLMP"
+static const uint32_t LIGHTMAP_VERSION = 1;
+
+// A chart: the triangles it covers and their vertices' positions in the chart plane
+struct Chart
+{
+    size_t firstVertex, vertexCount;
+    glm::vec2 points[6];
+    glm::vec2 size;
+    glm::vec2 offset;  // Placement in the packed square
+};
+
+static glm::vec3 vertexPosition(const float* vertices, size_t i)
+{
+    return glm::vec3(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]);
+}
+
+static bool samePosition(const glm::vec3& a, const glm::vec3& b)
+{
+    return glm::length(a - b) < 1e-5f;
+}
+
+// Whether triangles starting at vertices a and b share an edge and lie in one plane
+static bool formQuad(const float* vertices, size_t a, size_t b)
+{
+    glm::vec3 p[3], q[3];
+    for (int i = 0; i < 3; i++)
+    {
+        p[i] = vertexPosition(vertices, a + i);
+        q[i] = vertexPosition(vertices, b + i);
+    }
+    int shared = 0;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            shared += samePosition(p[i], q[j]) ? 1 : 0;
+    if (shared != 2)
+        return false;
+    glm::vec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+    glm::vec3 n2 = glm::cross(q[1] - q[0], q[2] - q[0]);
+    float l1 = glm::length(n1), l2 = glm::length(n2);
+    return l1 > 0.0f && l2 > 0.0f && glm::dot(n1, n2) / (l1 * l2) > 0.999f;
+}
+
+float unwrapLightmap(const float* vertices, size_t count, float gutter, std::vector<float>& uvs)
+{
+    uvs.assign(count * 2, 0.0f);
+    size_t triangles = count / 3;
+    if (triangles == 0)
+        return 0.0f;
+
+    // Charts in the plane of their first triangle, the first edge along x
+    std::vector<Chart> charts;
+    for (size_t t = 0; t < triangles;)
+    {
+        Chart chart;
+        chart.firstVertex = t * 3;
+        chart.vertexCount = (t + 1 < triangles && formQuad(vertices, t * 3, t * 3 + 3)) ? 6 : 3;
+        t += chart.vertexCount / 3;
+
+        glm::vec3 p0 = vertexPosition(vertices, chart.firstVertex);
+        glm::vec3 e1 = vertexPosition(vertices, chart.firstVertex + 1) - p0;
+        glm::vec3 e2 = vertexPosition(vertices, chart.firstVertex + 2) - p0;
+        glm::vec3 normal = glm::cross(e1, e2);
+        if (glm::length(e1) <= 0.0f || glm::length(normal) <= 0.0f)
+        {
+            // Degenerate: a point chart
+            for (size_t i = 0; i < chart.vertexCount; i++)
+                chart.points[i] = glm::vec2(0.0f);
+        }
+        else
+        {
+            glm::vec3 u = glm::normalize(e1);
+            glm::vec3 v = glm::normalize(glm::cross(glm::normalize(normal), u));
+            for (size_t i = 0; i < chart.vertexCount; i++)
+            {
+                glm::vec3 d = vertexPosition(vertices, chart.firstVertex + i) - p0;
+                chart.points[i] = glm::vec2(glm::dot(d, u), glm::dot(d, v));
+            }
+        }
+        glm::vec2 lo = chart.points[0], hi = chart.points[0];
+        for (size_t i = 1; i < chart.vertexCount; i++)
+        {
+            lo = glm::min(lo, chart.points[i]);
+            hi = glm::max(hi, chart.points[i]);
+        }
+        for (size_t i = 0; i < chart.vertexCount; i++)
+            chart.points[i] -= lo;
+        chart.size = hi - lo + glm::vec2(2.0f * gutter);
+        charts.push_back(chart);
+    }
+
+    // Shelf packing, tallest first, into the smallest square (in 5% steps) that holds everything
+    std::vector<size_t> order(charts.size());
+    float area = 0.0f, widest = 0.0f;
+    for (size_t i = 0; i < charts.size(); i++)
+    {
+        order[i] = i;
+        area += charts[i].size.x * charts[i].size.y;
+        widest = std::max(widest, charts[i].size.x);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return charts[a].size.y > charts[b].size.y; });
+
+    float side = std::max(std::sqrt(area), widest);
+    while (true)
+    {
+        float x = 0.0f, y = 0.0f, shelf = 0.0f;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            Chart& chart = charts[order[i]];
+            if (x + chart.size.x > side)
+            {
+                x = 0.0f;
+                y += shelf;
+                shelf = 0.0f;
+            }
+            chart.offset = glm::vec2(x, y);
+            x += chart.size.x;
+            shelf = std::max(shelf, chart.size.y);
+        }
+        if (y + shelf <= side)
+            break;
+        side *= 1.05f;
+    }
+
+    for (size_t c = 0; c < charts.size(); c++)
+    {
+        const Chart& chart = charts[c];
+        for (size_t i = 0; i < chart.vertexCount; i++)
+        {
+            glm::vec2 uv = (chart.offset + glm::vec2(gutter) + chart.points[i]) / side;
+            uvs[(chart.firstVertex + i) * 2] = uv.x;
+            uvs[(chart.firstVertex + i) * 2 + 1] = uv.y;
+        }
+    }
+    return side;
+}
+
+void packLightmap(std::vector<LightmapRect>& rects, unsigned int& width, unsigned int& height)
+{
+    size_t area = 0;
+    unsigned int widest = 1;
+    std::vector<size_t> order(rects.size());
+    for (size_t i = 0; i < rects.size(); i++)
+    {
+        order[i] = i;
+        area += (size_t)rects[i].width * rects[i].height;
+        widest = std::max(widest, rects[i].width);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return rects[a].height > rects[b].height; });
+
+    width = 1;
+    while ((size_t)width * width < area || width < widest)
+        width *= 2;
+    while (true)
+    {
+        unsigned int x = 0, y = 0, shelf = 0;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            LightmapRect& rect = rects[order[i]];
+            if (x + rect.width > width)
+            {
+                x = 0;
+                y += shelf;
+                shelf = 0;
+            }
+            rect.x = x;
+            rect.y = y;
+            x += rect.width;
+            shelf = std::max(shelf, rect.height);
+        }
+        height = y + shelf;
+        if (height <= width)
+            break;
+        width *= 2;
+    }
+    // Multiple of 4 rows keeps uploads aligned
+    height = std::max(4u, (height + 3) & ~3u);
+}
+
+bool saveLightmap(const std::string& path, const LightmapImage& image)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cout << "ERROR::LIGHTMAP::Failed to write lightmap: " << path << std::endl;
+        return false;
+    }
+    uint32_t header[4] = { LIGHTMAP_MAGIC, LIGHTMAP_VERSION, image.width, image.height };
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&image.layoutHash), sizeof(image.layoutHash));
+    out.write(reinterpret_cast<const char*>(image.texels.data()), image.texels.size() * sizeof(uint32_t));
+    return (bool)out;
+}
+
+bool loadLightmap(const std::string& path, LightmapImage& image)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+    uint32_t header[4] = { 0, 0, 0, 0 };
+    bool ok = (bool)in.read(reinterpret_cast<char*>(header), sizeof(header)) &&
+              header[0] == LIGHTMAP_MAGIC && header[1] == LIGHTMAP_VERSION &&
+              header[2] > 0 && header[3] > 0 && header[2] <= 16384 && header[3] <= 16384;
+    ok = ok && (bool)in.read(reinterpret_cast<char*>(&image.layoutHash), sizeof(image.layoutHash));
+    if (ok)
+    {
+        image.width = header[2];
+        image.height = header[3];
+        image.texels.resize((size_t)image.width * image.height);
+        ok = (bool)in.read(reinterpret_cast<char*>(image.texels.data()), image.texels.size() * sizeof(uint32_t));
+    }
+    if (!ok)
+    {
+        std::cout << "ERROR::LIGHTMAP::Corrupt or outdated lightmap: " << path << std::endl;
+        image = LightmapImage();
+    }
+    return ok;
+}
+
+std::string lightmapPathFor(const std::string& scenePath)
+{
+    size_t dot = scenePath.find_last_of('.');
+    size_t slash = scenePath.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return scenePath + ".lightmap";
+    return scenePath.substr(0, dot) + ".lightmap";
+}
+
+// Shared exponent encoding as specified for GL_RGB9_E5 (5-bit exponent, bias 15, 9-bit mantissas)
+uint32_t packRGB9E5(const glm::vec3& color)
+{
+    const float maxValue = 511.0f / 512.0f * 65536.0f;
+    float r = std::min(std::max(color.r, 0.0f), maxValue);
+    float g = std::min(std::max(color.g, 0.0f), maxValue);
+    float b = std::min(std::max(color.b, 0.0f), maxValue);
+    float largest = std::max(r, std::max(g, b));
+    if (largest < 1e-9f)
+        return 0;
+    int exponent = std::max(-16, (int)std::floor(std::log2(largest))) + 1 + 15;
+    float scale = std::ldexp(1.0f, exponent - 15 - 9);
+    if ((int)std::floor(largest / scale + 0.5f) == 512)
+    {
+        exponent++;
+        scale *= 2.0f;
+    }
+    uint32_t rm = (uint32_t)std::floor(r / scale + 0.5f);
+    uint32_t gm = (uint32_t)std::floor(g / scale + 0.5f);
+    uint32_t bm = (uint32_t)std::floor(b / scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | ((uint32_t)exponent << 27);
+}
+
+glm::vec3 unpackRGB9E5(uint32_t texel)
+{
+    float scale = std::ldexp(1.0f, (int)(texel >> 27) - 15 - 9);
+    return glm::vec3((float)(texel & 511), (float)((texel >> 9) & 511), (float)((texel >> 18) & 511)) * scale;
+}
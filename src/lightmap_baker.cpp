@@ -0,0 +1,387 @@
+#include "../include/lightmap_baker.h"
+#include "../include/bvh.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+static const float PI = 3.14159265358979f;
+static const float RAY_OFFSET = 1e-3f;       // Keeps rays from hitting the surface they start on
+static const float MIN_LIGHT_DISTANCE2 = 0.01f;
+static const float BOUNCE_DISTANCE = 100.0f;
+static const unsigned int DILATE_PASSES = 3;  // Covers LIGHTMAP_GUTTER_TEXELS
+static const size_t TEXELS_PER_TASK = 64;
+
+// What a ray hit: the bounce needs the surface's colour and facing
+struct Occluder
+{
+    glm::vec3 normal;
+    glm::vec3 albedo;
+    bool emissive;
+};
+
+// Underside of a light fixture, facing down
+struct AreaLight
+{
+    glm::vec3 corner, edgeX, edgeZ;
+    float area;
+};
+
+// Mesh whose texels are baked, in room space
+struct Receiver
+{
+    const float* vertices;
+    const float* uvs;
+    size_t count;
+    glm::mat4 transform;
+    glm::vec4 rect;
+};
+
+struct Texel
+{
+    glm::vec3 position, normal;
+    size_t index;  // In the atlas
+};
+
+struct BakeContext
+{
+    TriangleBVH bvh;
+    std::vector<Occluder> occluders;
+    std::vector<AreaLight> lights;
+    glm::vec3 radiance;
+    LightmapBakeSettings settings;
+};
+
+static uint32_t nextRandom(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float randomFloat(uint32_t& state)
+{
+    return (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Append a mesh's triangles to the occluders
+static void addOccluder(std::vector<glm::vec3>& triangles, std::vector<Occluder>& occluders, const float* vertices,
+                        size_t count, const glm::mat4& transform, const glm::vec3& albedo, bool emissive)
+{
+    for (size_t i = 0; i + 2 < count; i += 3)
+    {
+        glm::vec3 p[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const float* v = vertices + (i + k) * 8;
+            p[k] = glm::vec3(transform * glm::vec4(v[0], v[1], v[2], 1.0f));
+            triangles.push_back(p[k]);
+        }
+        Occluder occluder;
+        glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        float length = glm::length(normal);
+        occluder.normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        occluder.albedo = albedo;
+        occluder.emissive = emissive;
+        occluders.push_back(occluder);
+    }
+}
+
+// Irradiance from the fixtures over pi, so times albedo it is the outgoing radiance
+static glm::vec3 directLight(const BakeContext& context, const glm::vec3& position, const glm::vec3& normal,
+                             unsigned int samples, uint32_t& rng, size_t& rays)
+{
+    glm::vec3 origin = position + normal * RAY_OFFSET;
+    float total = 0.0f;
+    for (size_t l = 0; l < context.lights.size(); l++)
+    {
+        const AreaLight& light = context.lights[l];
+        float sum = 0.0f;
+        for (unsigned int s = 0; s < samples; s++)
+        {
+            // Stratified along the long edge, jittered across
+            glm::vec3 point = light.corner + light.edgeX * ((s + randomFloat(rng)) / samples) +
+                              light.edgeZ * randomFloat(rng);
+            glm::vec3 toLight = point - origin;
+            float distance2 = glm::dot(toLight, toLight);
+            float distance = std::sqrt(distance2);
+            float cosReceiver = glm::dot(normal, toLight) / distance;
+            float cosLight = toLight.y / distance;
+            if (cosReceiver <= 0.0f || cosLight <= 0.0f)
+                continue;
+            rays++;
+            if (context.bvh.occluded(origin, toLight, 1.0f - RAY_OFFSET))
+                continue;
+            sum += cosReceiver * cosLight / std::max(distance2, MIN_LIGHT_DISTANCE2);
+        }
+        total += sum * light.area / (samples * PI);
+    }
+    return context.radiance * total;
+}
+
+// One diffuse bounce of the direct light, cosine-weighted over the hemisphere
+static glm::vec3 indirectLight(const BakeContext& context, const glm::vec3& position, const glm::vec3& normal,
+                               uint32_t& rng, size_t& rays)
+{
+    unsigned int samples = context.settings.indirectSamples;
+    if (samples == 0)
+        return glm::vec3(0.0f);
+    glm::vec3 helper = std::fabs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+    glm::vec3 origin = position + normal * RAY_OFFSET;
+
+    glm::vec3 sum(0.0f);
+    for (unsigned int s = 0; s < samples; s++)
+    {
+        float r = std::sqrt(randomFloat(rng));
+        float phi = 2.0f * PI * randomFloat(rng);
+        glm::vec3 direction = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) +
+                              normal * std::sqrt(std::max(0.0f, 1.0f - r * r));
+        RayHit hit;
+        rays++;
+        if (!context.bvh.intersect(origin, direction, BOUNCE_DISTANCE, hit))
+            continue;
+        const Occluder& surface = context.occluders[hit.triangle];
+        if (surface.emissive)
+            continue;  // Already counted as direct light
+        glm::vec3 hitNormal = glm::dot(surface.normal, direction) > 0.0f ? -surface.normal : surface.normal;
+        sum += surface.albedo * directLight(context, origin + direction * hit.t, hitNormal, 1, rng, rays);
+    }
+    return sum / (float)samples;
+}
+
+// Texel centres covered by a receiver's triangles, with interpolated position and normal
+static void rasterizeReceiver(const Receiver& receiver, unsigned int width, unsigned int height,
+                              std::vector<int>& owner, std::vector<Texel>& texels)
+{
+    glm::mat3 normalMatrix(receiver.transform);
+    for (size_t i = 0; i + 2 < receiver.count; i += 3)
+    {
+        glm::vec2 uv[3];
+        glm::vec3 position[3], normal[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const float* v = receiver.vertices + (i + k) * 8;
+            const float* t = receiver.uvs + (i + k) * 2;
+            uv[k] = glm::vec2((t[0] * receiver.rect.x + receiver.rect.z) * width - 0.5f,
+                              (t[1] * receiver.rect.y + receiver.rect.w) * height - 0.5f);
+            position[k] = glm::vec3(receiver.transform * glm::vec4(v[0], v[1], v[2], 1.0f));
+            normal[k] = normalMatrix * glm::vec3(v[3], v[4], v[5]);
+        }
+        float area = (uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (uv[1].y - uv[0].y);
+        if (std::fabs(area) < 1e-12f)
+            continue;
+
+        int x0 = std::max(0, (int)std::floor(std::min(uv[0].x, std::min(uv[1].x, uv[2].x))));
+        int y0 = std::max(0, (int)std::floor(std::min(uv[0].y, std::min(uv[1].y, uv[2].y))));
+        int x1 = std::min((int)width - 1, (int)std::ceil(std::max(uv[0].x, std::max(uv[1].x, uv[2].x))));
+        int y1 = std::min((int)height - 1, (int)std::ceil(std::max(uv[0].y, std::max(uv[1].y, uv[2].y))));
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                size_t index = (size_t)y * width + x;
+                if (owner[index] >= 0)
+                    continue;
+                glm::vec2 p((float)x, (float)y);
+                float b1 = ((p.x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (p.y - uv[0].y)) / area;
+                float b2 = ((uv[1].x - uv[0].x) * (p.y - uv[0].y) - (p.x - uv[0].x) * (uv[1].y - uv[0].y)) / area;
+                float b0 = 1.0f - b1 - b2;
+                const float tolerance = -1e-4f;
+                if (b0 < tolerance || b1 < tolerance || b2 < tolerance)
+                    continue;
+                Texel texel;
+                texel.position = position[0] * b0 + position[1] * b1 + position[2] * b2;
+                texel.normal = glm::normalize(normal[0] * b0 + normal[1] * b1 + normal[2] * b2);
+                texel.index = index;
+                owner[index] = (int)texels.size();
+                texels.push_back(texel);
+            }
+        }
+    }
+}
+
+bool bakeLightmap(const Classroom& room, const LightmapBakeSettings& settings, LightmapImage& image,
+                  LightmapBakeStats& stats)
+{
+    const LightmapLayout& layout = room.lightmapLayout;
+    const Scene& scene = room.scene;
+    if (layout.width == 0 || layout.height == 0)
+    {
+        std::cout << "ERROR::LIGHTMAP::Room has no surfaces to bake" << std::endl;
+        return false;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Occluders and receivers in room space: every shell part (fixtures included) and every
+    // static instance. Spinning instances (the fan) cast no baked shadow.
+    BakeContext context;
+    context.settings = settings;
+    context.radiance = scene.lightColor * settings.fixtureRadiance;
+    std::vector<glm::vec3> triangles;
+    std::vector<Receiver> receivers;
+    for (size_t i = 0; i < room.shellParts.size(); i++)
+    {
+        const MeshPart& part = room.shellParts[i];
+        if (part.vertices == NULL)
+        {
+            std::cout << "ERROR::LIGHTMAP::Room geometry was already released" << std::endl;
+            return false;
+        }
+        addOccluder(triangles, context.occluders, part.vertices, part.count, glm::mat4(1.0f),
+                    scene.materials[part.material].diffuse, part.emissive);
+        if (part.lightmapRect.x > 0.0f)
+        {
+            Receiver receiver = { part.vertices, &part.lightmapUVs[0], part.count, glm::mat4(1.0f), part.lightmapRect };
+            receivers.push_back(receiver);
+        }
+    }
+    const SceneInstances& inst = scene.instances;
+    for (size_t i = 0; i < inst.size(); i++)
+    {
+        if (!room.staticInstance(i))
+            continue;
+        const Model& model = *room.models[inst.model[i]];
+        const MeshPart& fallback = room.fallbackParts[inst.model[i]];
+        bool loaded = model.loaded() && !model.vertices.empty();
+        if (!loaded && fallback.vertices == NULL)
+            continue;
+        // Stand-ins are already in meters, like updateTransforms()
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(inst.posX[i], inst.posY[i], inst.posZ[i]));
+        transform = glm::rotate(transform, glm::radians(inst.yaw[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+        if (loaded)
+            transform = glm::scale(transform, glm::vec3(inst.scale[i]));
+        const glm::vec3& albedo = scene.materials[inst.material[i]].diffuse;
+        if (loaded)
+        {
+            addOccluder(triangles, context.occluders, &model.vertices[0], model.vertexCount, transform, albedo, false);
+            glm::vec4 rect = layout.instanceRects.empty() ? glm::vec4(0.0f) : layout.instanceRects[i];
+            if (rect.x > 0.0f && !model.lightmapUVs.empty())
+            {
+                Receiver receiver = { &model.vertices[0], &model.lightmapUVs[0], model.vertexCount, transform, rect };
+                receivers.push_back(receiver);
+            }
+        }
+        else
+        {
+            addOccluder(triangles, context.occluders, fallback.vertices, fallback.count, transform, albedo, false);
+        }
+    }
+    for (size_t i = 0; i < scene.boxes.size(); i++)
+    {
+        if (!scene.boxes.emissive[i])
+            continue;
+        AreaLight light;
+        glm::vec3 size(scene.boxes.sizeX[i], scene.boxes.sizeY[i], scene.boxes.sizeZ[i]);
+        light.corner = glm::vec3(scene.boxes.centerX[i], scene.boxes.centerY[i], scene.boxes.centerZ[i]) - size * 0.5f;
+        bool alongX = size.x >= size.z;
+        light.edgeX = alongX ? glm::vec3(size.x, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, size.z);
+        light.edgeZ = alongX ? glm::vec3(0.0f, 0.0f, size.z) : glm::vec3(size.x, 0.0f, 0.0f);
+        light.area = size.x * size.z;
+        context.lights.push_back(light);
+    }
+    if (context.lights.empty())
+        std::cout << "Warning: Scene has no light fixtures; the lightmap will be black" << std::endl;
+    context.bvh.build(triangles);
+    stats.triangles = context.bvh.triangleCount();
+
+    // Texels to bake
+    unsigned int width = layout.width, height = layout.height;
+    std::vector<int> owner((size_t)width * height, -1);
+    std::vector<Texel> texels;
+    for (size_t i = 0; i < receivers.size(); i++)
+        rasterizeReceiver(receivers[i], width, height, owner, texels);
+    stats.texels = texels.size();
+
+    // Workers take texels in small chunks
+    std::vector<glm::vec3> light((size_t)width * height, glm::vec3(0.0f));
+    unsigned int threadCount = settings.threads ? settings.threads : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, threadCount);
+    std::atomic<size_t> nextTask(0), rayTotal(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threadCount; t++)
+    {
+        workers.push_back(std::thread([&]()
+        {
+            size_t rays = 0;
+            while (true)
+            {
+                size_t first = nextTask.fetch_add(TEXELS_PER_TASK);
+                if (first >= texels.size())
+                    break;
+                size_t last = std::min(first + TEXELS_PER_TASK, texels.size());
+                for (size_t i = first; i < last; i++)
+                {
+                    const Texel& texel = texels[i];
+                    uint32_t rng = (uint32_t)(texel.index * 2654435761u) | 1u;
+                    light[texel.index] = directLight(context, texel.position, texel.normal, settings.lightSamples, rng, rays) +
+                                         indirectLight(context, texel.position, texel.normal, rng, rays);
+                }
+            }
+            rayTotal += rays;
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    stats.rays = rayTotal;
+
+    // Grow every chart into its gutter so bilinear filtering at the edges reads baked texels
+    std::vector<char> filled(owner.size());
+    for (size_t i = 0; i < owner.size(); i++)
+        filled[i] = owner[i] >= 0;
+    for (unsigned int pass = 0; pass < DILATE_PASSES; pass++)
+    {
+        std::vector<char> next = filled;
+        for (unsigned int y = 0; y < height; y++)
+        {
+            for (unsigned int x = 0; x < width; x++)
+            {
+                size_t index = (size_t)y * width + x;
+                if (filled[index])
+                    continue;
+                glm::vec3 sum(0.0f);
+                int count = 0;
+                for (int dy = -1; dy <= 1; dy++)
+                {
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        int nx = (int)x + dx, ny = (int)y + dy;
+                        if (nx < 0 || ny < 0 || nx >= (int)width || ny >= (int)height)
+                            continue;
+                        size_t n = (size_t)ny * width + nx;
+                        if (filled[n])
+                        {
+                            sum += light[n];
+                            count++;
+                        }
+                    }
+                }
+                if (count > 0)
+                {
+                    light[index] = sum / (float)count;
+                    next[index] = 1;
+                }
+            }
+        }
+        filled.swap(next);
+    }
+
+    image.width = width;
+    image.height = height;
+    image.layoutHash = layout.hash;
+    image.texels.resize(light.size());
+    for (size_t i = 0; i < light.size(); i++)
+        image.texels[i] = packRGB9E5(light[i]);
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "LIGHTMAP::Baked " << width << "x" << height << " (" << stats.texels << " texels, "
+              << stats.triangles << " triangles, " << context.lights.size() << " fixtures) in " << stats.seconds
+              << " s on " << threadCount << " threads, " << stats.rays / std::max(stats.seconds, 1e-6) / 1e6
+              << " Mrays/s" << std::endl;
+    return true;
+}
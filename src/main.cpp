@@ -7,11 +7,42 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+#include <memory>
 
 // Include our custom headers
 #include "../include/shader.h"
 #include "../include/camera.h"
 #include "../include/classroom.h"
+#include "../include/campus.h"
+#include "../include/asset_registry.h"
+#include "../include/file_watcher.h"
+#include "../include/shader_variants.h"
+#include "../include/batch_transform.h"
+#include "../include/memory_stats.h"
+#include "../include/render_queue.h"
+#include "../include/gpu_scene.h"
+#include "../include/scene.h"
+#include "../include/texture_file.h"
+#include "../include/lightmap_baker.h"
+#include "../include/frame_pacer.h"
+#include "../include/collision.h"
+#include "../include/input_queue.h"
+#include "../include/latency_meter.h"
+#include "../include/view_uniforms.h"
+#include "../include/metrics.h"
+#include "../include/renderer_metrics.h"
+#include "../include/camera_path.h"
+#include "../include/soft_raster.h"
+#include "../include/multi_view.h"
+#include "../include/thumbnail_batch.h"
+#include "../include/sightlines.h"
+#include "../include/frame_capture.h"
+#include "../include/render_server.h"
+#include "../include/debug_view.h"
 
 // Window dimensions
 const unsigned int SCREEN_WIDTH = 1200;
@@ -22,6 +53,8 @@ Camera camera(glm::vec3(0.0f, 2.0f, 3.5f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f,
 float lastX = SCREEN_WIDTH / 2.0f;
 float lastY = SCREEN_HEIGHT / 2.0f;
 bool firstMouse = true;
+// Mouse input waiting for the frame's camera latch
+InputQueue inputQueue;
 
 // Timing
 float deltaTime = 0.0f;
@@ -32,17 +65,266 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+void latchInput(LatencyMeter& latency, bool apply);
+GLFWwindow* createWindow(int major, int minor, bool visible);
+bool parseCount(const char* text, unsigned long minimum, unsigned long maximum, unsigned int& value);
+int runThumbnails(Campus& campus, AssetRegistry& assets, ShaderVariants& shaders, RenderQueue& renderQueue,
+                  ThumbnailBatch& batch, const std::string& posesPath);
 
-int main()
+int main(int argc, char** argv)
 {
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Offline mode: compile a text scene to its binary form and exit
+    if (argc == 4 && std::string(argv[1]) == "--compile")
+    {
+        Scene scene;
+        if (!loadSceneText(argv[2], scene) || !saveSceneBinary(argv[3], scene))
+            return 1;
+        std::cout << "SCENE::Compiled " << argv[2] << " -> " << argv[3] << std::endl;
+        return 0;
+    }
+    // Offline mode: write a BC1 checkerboard texture (.dds or .ktx2) with a full mip chain and exit
+    if (argc >= 3 && std::string(argv[1]) == "--make-texture")
+    {
+        unsigned int size = 1024, tiles = 8;
+        if (argc > 3 && !parseCount(argv[3], 4, MAX_TEXTURE_DIMENSION, size))
+        {
+            std::cout << "ERROR::TEXTURE::Size must be a number from 4 to " << MAX_TEXTURE_DIMENSION << ": "
+                      << argv[3] << std::endl;
+            return 1;
+        }
+        if (argc > 4 && !parseCount(argv[4], 1, size, tiles))
+        {
+            std::cout << "ERROR::TEXTURE::Tiles must be a number from 1 to the size: " << argv[4] << std::endl;
+            return 1;
+        }
+        if (!writeCheckerTexture(argv[2], size, tiles))
+            return 1;
+        std::cout << "TEXTURE::Wrote " << argv[2] << " (" << size << "x" << size << ", " << tiles
+                  << " tiles)" << std::endl;
+        return 0;
+    }
+    // Offline mode: bake a room's static lighting next to its scene file and exit
+    if (argc >= 3 && std::string(argv[1]) == "--bake-lightmap")
+    {
+        AssetRegistry assets;
+        Classroom room;
+        if (!room.loadScene(argv[2]))
+            return 1;
+        room.buildGeometry(assets);
+        LightmapBakeSettings settings;
+        if (argc > 3)
+            settings.indirectSamples = (unsigned int)std::atoi(argv[3]);
+        LightmapImage image;
+        LightmapBakeStats stats;
+        if (!bakeLightmap(room, settings, image, stats) || !saveLightmap(room.lightmapPath, image))
+            return 1;
+        std::cout << "LIGHTMAP::Wrote " << room.lightmapPath << std::endl;
+        return 0;
+    }
+    // Offline mode: how much of the boards every seat of a room can see, as CSV and a heatmap
+    if (argc >= 3 && std::string(argv[1]) == "--sightlines")
+    {
+        AssetRegistry assets;
+        Classroom room;
+        if (!room.loadScene(argv[2]))
+            return 1;
+        room.buildGeometry(assets);
+        SightlineSettings settings;
+        if (argc > 5)
+            settings.samplesPerMeter = std::max(1.0f, (float)std::atof(argv[5]));
+        std::vector<SeatSightline> seats;
+        SightlineStats stats;
+        std::string csvPath = argc > 3 ? argv[3] : "sightlines.csv";
+        std::string heatmapPath = argc > 4 ? argv[4] : "sightlines.ppm";
+        if (!analyzeSightlines(room, settings, seats, stats) || !writeSightlineCsv(csvPath, seats) ||
+            !writeSightlineHeatmap(heatmapPath, room.scene, settings.targetMaterial, seats, 40.0f))
+            return 1;
+        std::cout << "SIGHTLINES::Wrote " << csvPath << " and " << heatmapPath << std::endl;
+        return 0;
+    }
+    // Offline mode: time capsule moves through collision grids of growing size and exit
+    if (argc >= 2 && std::string(argv[1]) == "--bench-collision")
+    {
+        benchmarkCollision(argc > 2 ? (size_t)std::atoll(argv[2]) : 100000);
+        return 0;
+    }
+    // Offline mode: time the batch transform kernels and exit
+    if (argc >= 2 && std::string(argv[1]) == "--bench-transforms")
+    {
+        benchmarkBatchTransforms(argc > 2 ? (size_t)std::atoll(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // Options, then an optional scene or campus path
+    std::string scenePath = "scenes/classroom.scene";
+    bool scenePathGiven = false;
+    bool hotReload = false;
+    bool gpuDriven = false;   // GL 4.3 compute culling and indirect draws when available
+    bool software = false;    // Rasterize on the CPU, GL only presents the image
+    unsigned int viewCount = 1;  // Views drawn side by side in one pass (stereo wall)
+    bool splitViews = false;     // ... into viewport columns even where gl_Layer is available
+    float eyeSeparation = 0.064f;
+    float convergence = 3.0f;    // Distance of the zero parallax plane
+    std::string thumbnailDir;    // Render every seat view (or --poses) into this directory, exit
+    std::string posesPath;
+    int thumbnailWidth = 320, thumbnailHeight = 240;
+    unsigned int viewsPerPass = 8;
+    unsigned int writerThreads = 0;
+    std::string capturePath;     // Video of the window: a .y4m file or "|command"
+    float captureFps = 30.0f;
+    std::string serveAddress;    // Render for thin clients connecting here, until interrupted
+    float serveRate = 30.0f;     // Ticks per second
+    float serveSeconds = 0.0f;   // 0: until Ctrl+C
+    int clientWidth = 320, clientHeight = 240;
+    DebugViewMode debugMode = DEBUG_VIEW_OFF;  // Heatmap or wireframe view to start in
+    std::string histogramPath = "debug_histogram.txt";
+    FramePacingSettings pacing;
+    bool collide = true;      // Keep the camera out of walls and furniture
+    bool rawMouse = false;    // Unaccelerated mouse motion where the platform has it
+    bool latencyOverlay = false;
+    std::string metricsAddress;  // Prometheus endpoint: "unix:<path>" or a loopback port
+    std::string recordPath;      // Camera path to write on exit
+    std::string replayPath;      // Camera path to fly, then exit
+    std::string timingsPath;     // Per-frame replay timings (CSV)
+    float replayStep = 1.0f / 60.0f;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--watch")
+            hotReload = true;
+        else if (arg == "--target-fps" && i + 1 < argc)
+            pacing.targetFrameMs = 1000.0f / std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--vsync" && i + 1 < argc)
+        {
+            std::string policy = argv[++i];
+            pacing.swapPolicy = policy == "off" ? SWAP_IMMEDIATE : policy == "adaptive" ? SWAP_ADAPTIVE : SWAP_VSYNC;
+        }
+        else if (arg == "--min-scale" && i + 1 < argc)
+            pacing.minScale = (float)std::atof(argv[++i]);
+        else if (arg == "--fixed-resolution")
+            pacing.dynamicResolution = false;
+        else if (arg == "--no-collision")
+            collide = false;
+        else if (arg == "--raw-mouse")
+            rawMouse = true;
+        else if (arg == "--latency-overlay")
+            latencyOverlay = true;
+        else if (arg == "--metrics" && i + 1 < argc)
+            metricsAddress = argv[++i];
+        else if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--replay-step" && i + 1 < argc)
+            replayStep = std::max(0.1f, (float)std::atof(argv[++i])) / 1000.0f;
+        else if (arg == "--timings" && i + 1 < argc)
+            timingsPath = argv[++i];
+        else if (arg == "--gpu-driven")
+            gpuDriven = true;
+        else if (arg == "--software")
+            software = true;
+        else if (arg == "--views" && i + 1 < argc)
+            viewCount = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--stereo")
+            viewCount = 2;
+        else if (arg == "--split-views")
+            splitViews = true;
+        else if (arg == "--eye-separation" && i + 1 < argc)
+            eyeSeparation = (float)std::atof(argv[++i]);
+        else if (arg == "--convergence" && i + 1 < argc)
+            convergence = (float)std::atof(argv[++i]);
+        else if (arg == "--thumbnails" && i + 1 < argc)
+            thumbnailDir = argv[++i];
+        else if (arg == "--poses" && i + 1 < argc)
+            posesPath = argv[++i];
+        else if (arg == "--thumbnail-size" && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &thumbnailWidth, &thumbnailHeight) != 2)
+                std::cout << "Warning: --thumbnail-size expects WxH, got " << argv[i] << std::endl;
+        }
+        else if (arg == "--views-per-pass" && i + 1 < argc)
+            viewsPerPass = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--writers" && i + 1 < argc)
+            writerThreads = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--capture" && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (arg == "--capture-fps" && i + 1 < argc)
+            captureFps = std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--serve" && i + 1 < argc)
+            serveAddress = argv[++i];
+        else if (arg == "--serve-rate" && i + 1 < argc)
+            serveRate = std::max(1.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--serve-seconds" && i + 1 < argc)
+            serveSeconds = std::max(0.0f, (float)std::atof(argv[++i]));
+        else if (arg == "--client-size" && i + 1 < argc)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &clientWidth, &clientHeight) != 2)
+                std::cout << "Warning: --client-size expects WxH, got " << argv[i] << std::endl;
+        }
+        else if (arg == "--debug-view" && i + 1 < argc)
+        {
+            if (!DebugView::parseMode(argv[++i], debugMode))
+                std::cout << "Warning: --debug-view expects overdraw, triangles, cost or wireframe, got " << argv[i]
+                          << std::endl;
+        }
+        else if (arg == "--debug-histogram" && i + 1 < argc)
+            histogramPath = argv[++i];
+        else if (arg.empty() || arg[0] == '-')
+        {
+            std::cout << "ERROR::ARGS::Unknown option (or one missing its value): " << arg << std::endl;
+            return 1;
+        }
+        else if (scenePathGiven)
+        {
+            std::cout << "ERROR::ARGS::More than one scene path: " << scenePath << " and " << arg << std::endl;
+            return 1;
+        }
+        else
+        {
+            scenePath = arg;
+            scenePathGiven = true;
+        }
+    }
+
+    // --replay: a benchmark run, so every frame does the same work: unpaced, full resolution, and
+    // the recorded positions (already collision-resolved) are used as they are
+    CameraPath replay;
+    bool replaying = !replayPath.empty();
+    if (replaying)
+    {
+        if (!replay.load(replayPath))
+            return 1;
+        pacing.swapPolicy = SWAP_IMMEDIATE;
+        pacing.targetFrameMs = 0.0f;
+        pacing.dynamicResolution = false;
+        collide = false;
+        std::cout << "REPLAY::" << replayPath << ": " << replay.samples.size() << " recorded frames, "
+                  << replay.duration() << " s at a " << replayStep * 1000.0f << " ms step" << std::endl;
+    }
+
+    // --software: the pacer's GPU timer would only see the present, so no dynamic resolution
+    if (software)
+        pacing.dynamicResolution = false;
+
+    // --views, --thumbnails, --serve: instanced through the render queue, which the other paths
+    // bypass; thumbnails and served views are drawn in batches
+    bool thumbnails = !thumbnailDir.empty();
+    bool serving = !serveAddress.empty();
+    bool batched = thumbnails || serving;
+    if ((viewCount > 1 || batched) && (gpuDriven || software))
+    {
+        std::cout << "Warning: Multi-view rendering uses the render queue, ignoring "
+                  << (software ? "--software" : "--gpu-driven") << std::endl;
+        gpuDriven = software = false;
+    }
 
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "CL-3 Classroom (South Campus)", NULL, NULL);
+    // glfw: initialize, then create the window; the GPU-driven path asks for GL 4.3 first and
+    // falls back to a 3.3 context
+    glfwInit();
+    bool headless = batched;
+    GLFWwindow* window = gpuDriven ? createWindow(4, 3, !headless) : NULL;
+    if (window == NULL)
+        window = createWindow(3, 3, !headless);
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -56,6 +338,13 @@ int main()
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (rawMouse)
+    {
+        if (glfwRawMouseMotionSupported())
+            glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        else
+            std::cout << "Warning: Raw mouse motion not supported, using the cursor" << std::endl;
+    }
 
     // glew: load all OpenGL function pointers
     if (glewInit() != GLEW_OK)
@@ -64,16 +353,225 @@ int main()
         return -1;
     }
 
+    std::cout << "TRANSFORM::Using " << transformPathName(transformPath()) << " batch kernels" << std::endl;
+
     // configure global opengl state
     glEnable(GL_DEPTH_TEST);
 
-    // build and compile our shader program
-    Shader lightingShader("shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl");
-    Shader lightCubeShader("shaders/light_vertex.glsl", "shaders/light_fragment.glsl");
+    // Frame pacing: swap interval for the target frame time, resolution scaled by GPU time
+    FramePacer pacer;
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    pacer.initialize(pacing, framebufferWidth, framebufferHeight);
+    glfwSetWindowUserPointer(window, &pacer);
+    const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    bool tearControl = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                       glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    int swapInterval = pacer.swapInterval(videoMode ? videoMode->refreshRate : 0, tearControl);
+    glfwSwapInterval(swapInterval);
+    std::cout << "PACING::Target " << pacer.settings.targetFrameMs << " ms, swap interval " << swapInterval
+              << (pacer.settings.dynamicResolution ? ", dynamic resolution from " : ", fixed resolution")
+              << (pacer.settings.dynamicResolution ? pacer.settings.minScale : 1.0f) << std::endl;
+
+    // Camera of the frame for every program, and input-to-photon timing; F7 toggles the overlay
+    ViewUniforms viewUniforms;
+    LatencyMeter latency;
+    latency.initialize();
+    latency.overlay = latencyOverlay;
+
+    // --views: every view of the frame from one pass, layered where the driver allows
+    MultiView multiView;
+    if (viewCount > 1 && !batched && multiView.initialize(viewCount, splitViews ? MULTIVIEW_SPLIT : MULTIVIEW_LAYERED))
+        std::cout << "MULTIVIEW::" << multiView.viewCount() << " views in one pass, "
+                  << MultiView::modeName(multiView.mode()) << ", " << eyeSeparation << " m apart, converging at "
+                  << convergence << " m" << std::endl;
+
+    // --thumbnails: views per pass read back into files, an offline run like the tests; --serve:
+    // the same batches, every client's view handed to the server to send
+    RenderServer renderServer;
+    ThumbnailBatch thumbnailBatch;
+    MultiViewMode batchMode = splitViews ? MULTIVIEW_SPLIT : MULTIVIEW_LAYERED;
+    if (thumbnails && !thumbnailBatch.initialize(thumbnailDir, thumbnailWidth, thumbnailHeight, viewsPerPass,
+                                                 batchMode, writerThreads))
+    {
+        glfwTerminate();
+        return -1;
+    }
+    if (serving && !thumbnails && !thumbnailBatch.initialize(&renderServer, clientWidth, clientHeight, viewsPerPass,
+                                                             batchMode, writerThreads))
+    {
+        glfwTerminate();
+        return -1;
+    }
+
+    // GPU-driven path: compute culling and indirect draws; the render queue stays the fallback
+    GpuScene gpuScene;
+    if (gpuDriven)
+    {
+        if (GpuScene::supported() && gpuScene.initialize("shaders/cull.comp"))
+            std::cout << "GPU::Using GPU-driven indirect rendering" << std::endl;
+        else
+            std::cout << "GPU::GPU-driven rendering needs OpenGL 4.3, using the CPU path" << std::endl;
+    }
+
+    // Shared models and shaders; must outlive everything that holds handles
+    AssetRegistry assets;
+    assets.enableProgramCache("shader_cache");
+    bool parallelCompile = Shader::enableParallelCompile();
+
+    // Shader permutations (lit, specular, emissive, ...) of one program, compiled on first use;
+    // the manifest's variants are built now (restored from the program cache on warm starts)
+    ShaderVariants shaders(assets, "shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl");
+    if (batched)
+        shaders.require(thumbnailBatch.shaderFeatures());
+    else if (multiView.viewCount() > 1)
+        shaders.require(multiView.shaderFeatures());
+    shaders.precompile("shaders/variants.manifest");
+
+    // --watch: recompile shaders in the background as they are saved
+    FileWatcher shaderWatcher;
+    if (hotReload)
+    {
+        shaderWatcher.watch(shaders.vertexPath());
+        shaderWatcher.watch(shaders.fragmentPath());
+        std::cout << "SHADER::Watching shaders for changes"
+                  << (parallelCompile ? " (parallel compile)" : " (no parallel compile, swaps may stall)")
+                  << std::endl;
+    }
+
+    // Initialize the campus (a single classroom scene is a one-cell campus); the software
+    // rasterizer draws from the CPU copies of the geometry
+    Campus campus(assets);
+    campus.retainGeometry = software;
+    if (!campus.load(scenePath))
+    {
+        glfwTerminate();
+        return -1;
+    }
+    camera = Camera(campus.startPosition, glm::vec3(0.0f, 1.0f, 0.0f), campus.startYaw, campus.startPitch);
+    campus.loadAround(camera.Position);
+    assets.report(std::cout);
+    assets.textures.report(std::cout);
+    campus.report(std::cout);
+    std::cout << "MEMORY::After load: RSS " << residentSetBytes() / 1024 << " KB, peak "
+              << peakResidentSetBytes() / 1024 << " KB" << std::endl;
+
+    // Static boxes of the resident rooms the camera slides along; F6 toggles it
+    CollisionWorld collision;
+    CollisionCapsule capsule;
+
+    // Sorted draw submission with redundant state elision
+    RenderQueue renderQueue;
+    renderQueue.setViewCount(batched ? thumbnailBatch.viewsPerPass() : multiView.viewCount());
+    float lastStatsReport = 0.0f;
+
+    // Overdraw, triangle density, per-draw GPU cost and wireframe views of the render queue's
+    // single-view draws; F8 cycles them, F9 writes the heatmap's histogram
+    DebugView debugView;
+    bool debugViews = !gpuScene.active() && !software && multiView.viewCount() <= 1 &&
+                      debugView.initialize("shaders/heatmap.vert", "shaders/heatmap.frag");
+    if (debugMode != DEBUG_VIEW_OFF && !debugViews)
+        std::cout << "Warning: Debug views draw through the single-view render queue, ignoring --debug-view"
+                  << std::endl;
+    else if (debugMode != DEBUG_VIEW_OFF)
+    {
+        debugView.setMode(debugMode);
+        std::cout << "DEBUG::View " << DebugView::modeName(debugMode) << std::endl;
+    }
+
+    // --record: the camera of every frame, saved on exit; --replay: per-frame timings
+    CameraPath recording;
+    double recordStart = 0.0;
+    ReplayTimings timings;
+    uint32_t frameIndex = 0;
+    double lastPresented = 0.0;
+    std::vector<std::pair<unsigned int, double> > gpuTimes;
+    pacer.keepGpuTimes(replaying);
+
+    // --metrics: counters for unattended monitoring, served from a background thread
+    std::unique_ptr<MetricsRegistry> metricsRegistry;
+    std::unique_ptr<RendererMetrics> rendererMetrics;
+    std::unique_ptr<MetricsServer> metricsServer;
+    float lastMetricsSample = 0.0f;
+    if (!metricsAddress.empty())
+    {
+        metricsRegistry.reset(new MetricsRegistry());
+        rendererMetrics.reset(new RendererMetrics(*metricsRegistry));
+        rendererMetrics->sample(assets, campus);
+        metricsServer.reset(new MetricsServer(*metricsRegistry));
+        if (metricsServer->start(metricsAddress))
+            std::cout << "METRICS::Serving Prometheus metrics on " << metricsAddress << std::endl;
+        else
+            rendererMetrics.reset();
+    }
 
-    // Initialize classroom
-    Classroom classroom;
-    classroom.initializeGeometry();
+    if (thumbnails)
+    {
+        int result = runThumbnails(campus, assets, shaders, renderQueue, thumbnailBatch, posesPath);
+        glfwTerminate();
+        return result;
+    }
+    if (serving)
+    {
+        bool served = renderServer.start(serveAddress, clientWidth, clientHeight) &&
+                      renderServer.run(campus, assets, shaders, renderQueue, thumbnailBatch, serveRate, serveSeconds);
+        renderServer.stop();
+        glfwTerminate();
+        return served ? 0 : 1;
+    }
+
+    // --capture: the frames the window shows, read back asynchronously and encoded off the render
+    // thread; a replay is captured on its path clock, so the video plays at the recorded speed
+    FrameCapture capture;
+    if (!capturePath.empty())
+    {
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (!capture.start(capturePath, captureFps, framebufferWidth, framebufferHeight))
+        {
+            glfwTerminate();
+            return -1;
+        }
+    }
+
+    SoftwareRasterizer raster;
+    SoftwarePresenter presenter;
+    if (software)
+        std::cout << "RASTER::Rendering on the CPU: " << raster.threadCount() << " threads, "
+                  << SoftwareRasterizer::pathName(SoftwareRasterizer::path()) << " edge functions" << std::endl;
+
+    // Function keys, acted on once per press
+    KeyActions keyActions;
+    // F5 reloads models and shaders whose files changed on disk
+    keyActions.bind(GLFW_KEY_F5, [&]()
+    {
+        std::cout << "ASSETS::Reloaded " << assets.reloadChanged() << " changed assets" << std::endl;
+        renderQueue.invalidatePrograms();
+        gpuScene.invalidate();
+    });
+    keyActions.bind(GLFW_KEY_F6, [&]()
+    {
+        collide = !collide;
+        std::cout << "COLLISION::" << (collide ? "On" : "Off") << std::endl;
+    });
+    keyActions.bind(GLFW_KEY_F7, [&]() { latency.overlay = !latency.overlay; });
+    // F8: the next debug view; F9: the current heatmap's histogram, over the last file
+    keyActions.bind(GLFW_KEY_F8, [&]()
+    {
+        if (debugViews)
+        {
+            debugView.setMode(debugView.next());
+            std::cout << "DEBUG::View " << DebugView::modeName(debugView.mode()) << std::endl;
+        }
+        else
+            std::cout << "Warning: Debug views need the single-view render queue path" << std::endl;
+    });
+    keyActions.bind(GLFW_KEY_F9, [&]()
+    {
+        std::vector<DebugHistogram> histograms(1);
+        if (debugView.histogram(histograms[0]) && DebugView::writeHistogram(histogramPath, histograms))
+            std::cout << "DEBUG::Wrote the " << DebugView::modeName(histograms[0].mode) << " histogram to "
+                      << histogramPath << std::endl;
+    });
 
     // render loop
     while (!glfwWindowShouldClose(window))
@@ -83,66 +581,258 @@ int main()
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        // input
-        processInput(window);
-
-        // render
+        // --replay: the camera and the animation clock follow the path at a fixed step
+        double frameStart = glfwGetTime();
+        float simDelta = deltaTime;
+        float pathTime = frameIndex * replayStep;
+        if (replaying)
+        {
+            if (pathTime > replay.duration())
+                break;
+            CameraPathSample sample = replay.at(pathTime);
+            sample.apply(camera);
+            simDelta = sample.simTime - (float)campus.animationClock();
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+                glfwSetWindowShouldClose(window, true);
+        }
+
+        // input, then the move it made resolved against the rooms around the camera
+        glm::vec3 previousPosition = camera.Position;
+        if (!replaying)
+            processInput(window);
+        keyActions.poll([window](int key) { return glfwGetKey(window, key) == GLFW_PRESS; });
+        if (collide)
+        {
+            collision.update(campus);
+            camera.Position = collision.move(previousPosition, camera.Position - previousPosition, capsule);
+        }
+
+        // Hot reload: start compiles for saved files, swap in whatever finished linking
+        std::vector<std::string> changedFiles;
+        shaderWatcher.poll(changedFiles);
+        for (size_t i = 0; i < changedFiles.size(); i++)
+            assets.shaderFileChanged(changedFiles[i]);
+        // (a program cache hit is swapped in immediately by shaderFileChanged)
+        if (assets.finishPendingShaders() > 0 || !changedFiles.empty())
+            renderQueue.invalidatePrograms();
+
+        // Stream cells around the camera, then light with the room the camera is in
+        campus.update(simDelta, camera.Position);
+        const CampusCell* cell = campus.cellAt(camera.Position);
+        // Upload streamed texture levels within this frame's slice
+        assets.textures.update();
+
+        // Queue every resident room including light fixtures (or refresh the GPU tables when
+        // rooms streamed in or out); this compiles any variant not seen before, so per-frame
+        // uniforms are set afterwards
+        if (gpuScene.active())
+        {
+            gpuScene.update(campus);
+            gpuScene.prepare(shaders);
+        }
+        else if (!software)
+        {
+            renderQueue.setViewPosition(camera.Position);
+            // Heatmaps queue their variants; the cost view queues the scene's own first, to time them
+            if (debugViews)
+                shaders.require(debugView.mode() == DEBUG_VIEW_COST ? 0 : debugView.shaderFeatures());
+            campus.submit(renderQueue, shaders);
+        }
+
+        // render, at the pacer's current resolution and timed on the GPU
+        pacer.beginFrame();
+        unsigned int pacerFrame = pacer.frameNumber();
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // be sure to activate shader when setting uniforms/drawing objects
-        lightingShader.use();
-        lightingShader.setVec3("viewPos", camera.Position);
-
-        // light properties
-        glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 0.9f);
-        glm::vec3 lightPos = glm::vec3(0.0f, 3.0f, 0.0f);
-        lightingShader.setVec3("light.position", lightPos);
-        lightingShader.setVec3("light.ambient", 0.3f * lightColor);
-        lightingShader.setVec3("light.diffuse", 0.8f * lightColor);
-        lightingShader.setVec3("light.specular", 1.0f * lightColor);
-
-        // Default material properties (will be overridden in classroom.render)
-        lightingShader.setVec3("material.ambient", glm::vec3(0.5f));
-        lightingShader.setVec3("material.diffuse", glm::vec3(0.7f));
-        lightingShader.setVec3("material.specular", glm::vec3(0.3f));
-        lightingShader.setFloat("material.shininess", 32.0f);
-
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
+        // Late latch: poll again and turn the camera by the mouse input that arrived while the
+        // frame was prepared, then upload the view the draws read
+        glfwPollEvents();
+        latchInput(latency, !replaying);
+        if (!recordPath.empty())
+        {
+            if (recording.samples.empty())
+                recordStart = frameStart;
+            recording.record((float)(frameStart - recordStart), frameIndex, (float)campus.animationClock(), camera);
+        }
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), pacer.aspect(), 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        lightingShader.setMat4("model", model);
-
-        // render the classroom
-        classroom.render(lightingShader);
-        
-        // Update and render the fan
-        classroom.updateFan(deltaTime);
-        classroom.renderFan(lightingShader);
-
-        // render light sources
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-
-        // Render ceiling lights
-        classroom.renderLights(lightCubeShader);
-
-        // glfw: swap buffers and poll IO events
+        viewUniforms.update(projection, view, camera.Position);
+        campus.setFrameUniforms(shaders, *cell);
+
+        // Cull and draw on the GPU, draw in sorted order, or rasterize on the CPU and copy the
+        // image over the cleared frame
+        if (gpuScene.active())
+            gpuScene.render(shaders, projection, view, camera.Position, (float)campus.animationClock());
+        else if (software)
+        {
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            if (raster.width() != framebufferWidth || raster.height() != framebufferHeight)
+                raster.resize(framebufferWidth, framebufferHeight);
+            campus.rasterize(raster, *cell, projection, view, camera.Position);
+            presenter.present(raster);
+        }
+        else if (multiView.viewCount() > 1)
+        {
+            // One pass for every view, each in its column of the frame
+            MultiViewCamera views[MultiView::MAX_VIEWS];
+            multiView.stereoCameras(camera, pacer.aspect() / multiView.viewCount(), eyeSeparation, convergence, views);
+            multiView.update(views);
+            multiView.begin(pacer.renderWidth(), pacer.renderHeight());
+            renderQueue.flush();
+            multiView.end();
+        }
+        else if (debugView.mode() != DEBUG_VIEW_OFF)
+            debugView.draw(campus, shaders, renderQueue, *cell);
+        else
+            renderQueue.flush();
+        pacer.endFrame();
+        if (rendererMetrics)
+        {
+            if (gpuScene.active())
+                rendererMetrics->gpuFrame(deltaTime, gpuScene.commandCount());
+            else
+                rendererMetrics->frame(deltaTime, renderQueue.lastStats);
+            if (currentFrame - lastMetricsSample > 1.0f)
+            {
+                rendererMetrics->sample(assets, campus);
+                lastMetricsSample = currentFrame;
+            }
+        }
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        // (before the latency overlay, which stays out of the video)
+        capture.frame(replaying ? pathTime : frameStart, framebufferWidth, framebufferHeight);
+        latency.endFrame(framebufferWidth, framebufferHeight);
+
+        // Report GL state changes per frame, sorted/cached versus naive submission
+        if (currentFrame - lastStatsReport > 5.0f)
+        {
+            if (gpuScene.active())
+            {
+                std::cout << "GPU::Frame: " << gpuScene.visibleCount() << " of " << gpuScene.objectCount()
+                          << " objects visible, " << gpuScene.commandCount() << " indirect commands" << std::endl;
+            }
+            else if (software)
+                raster.report(std::cout);
+            else
+            {
+                const RenderStats& s = renderQueue.lastStats;
+                const RenderStats& n = renderQueue.lastNaiveStats;
+                std::cout << "RENDER::Frame stats (naive -> sorted): draws " << s.drawCalls
+                          << ", program binds " << n.programBinds << " -> " << s.programBinds
+                          << ", VAO binds " << n.vaoBinds << " -> " << s.vaoBinds
+                          << ", uniform uploads " << n.uniformUploads << " -> " << s.uniformUploads
+                          << ", texture binds " << n.textureBinds << " -> " << s.textureBinds << std::endl;
+            }
+            assets.textures.report(std::cout);
+            const StreamingStats& st = campus.stats;
+            std::cout << "CAMPUS::Streaming: " << st.cellsLoaded << " loads, " << st.cellsEvicted
+                      << " evictions, " << st.residentBytes / 1024 << " KB resident, update avg "
+                      << (st.frames ? st.totalUpdateMs / st.frames : 0.0) << " ms, max " << st.maxUpdateMs
+                      << " ms, " << st.hitchFrames << "/" << st.frames << " frames over "
+                      << campus.hitchThresholdMs << " ms" << std::endl;
+            std::cout << "MEMORY::Steady state: RSS " << residentSetBytes() / 1024 << " KB, peak "
+                      << peakResidentSetBytes() / 1024 << " KB" << std::endl;
+            pacer.report(std::cout);
+            latency.report(std::cout);
+            if (collide)
+                collision.report(std::cout);
+            lastStatsReport = currentFrame;
+        }
+
+        // glfw: swap buffers, hold the frame rate and poll IO events (window events; mouse motion
+        // queued here waits for the next latch)
         glfwSwapBuffers(window);
+        double swapped = glfwGetTime();
+        pacer.present();
+        if (replaying)
+        {
+            double presented = glfwGetTime();
+            timings.add(frameIndex, pathTime, (swapped - frameStart) * 1000.0,
+                        frameIndex > 0 ? (presented - lastPresented) * 1000.0 : 0.0, pacerFrame);
+            lastPresented = presented;
+            pacer.drainGpuTimes(gpuTimes);
+            for (size_t i = 0; i < gpuTimes.size(); i++)
+                timings.setGpu(gpuTimes[i].first, gpuTimes[i].second);
+        }
+        frameIndex++;
         glfwPollEvents();
     }
 
+    if (capture.active())
+    {
+        capture.finish();
+        capture.report(std::cout);
+    }
+    if (!recordPath.empty() && recording.save(recordPath))
+        std::cout << "RECORD::Wrote " << recording.samples.size() << " frames (" << recording.duration()
+                  << " s) to " << recordPath << std::endl;
+    if (replaying)
+    {
+        // The last frames' GPU times are still in flight
+        pacer.finishTiming();
+        pacer.drainGpuTimes(gpuTimes);
+        for (size_t i = 0; i < gpuTimes.size(); i++)
+            timings.setGpu(gpuTimes[i].first, gpuTimes[i].second);
+        timings.report(std::cout);
+        if (!timingsPath.empty() && timings.writeCsv(timingsPath))
+            std::cout << "REPLAY::Wrote per-frame timings to " << timingsPath << std::endl;
+    }
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
     return 0;
 }
 
+// glfw window with a core profile context of the given version; NULL when unavailable
+GLFWwindow* createWindow(int major, int minor, bool visible)
+{
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+    return glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "CL-3 Classroom (South Campus)", NULL, NULL);
+}
+
+// A whole decimal argument from minimum to maximum; false for anything else (signs, suffixes, overflow)
+bool parseCount(const char* text, unsigned long minimum, unsigned long maximum, unsigned int& value)
+{
+    if (text[0] < '0' || text[0] > '9')
+        return false;
+    char* end = NULL;
+    errno = 0;
+    unsigned long parsed = std::strtoul(text, &end, 10);
+    if (errno == ERANGE || *end != '\0' || parsed < minimum || parsed > maximum)
+        return false;
+    value = (unsigned int)parsed;
+    return true;
+}
+
+// --thumbnails: render every seat of the campus (or the poses of --poses) into image files, as
+// many views per pass as the batch draws
+int runThumbnails(Campus& campus, AssetRegistry& assets, ShaderVariants& shaders, RenderQueue& renderQueue,
+                  ThumbnailBatch& batch, const std::string& posesPath)
+{
+    std::vector<ViewPose> poses;
+    if (posesPath.empty())
+        campusSeatPoses(campus, poses);
+    else if (!loadViewPoses(posesPath, poses))
+        return 1;
+    if (poses.empty())
+    {
+        std::cout << "ERROR::THUMBNAILS::No poses: no model has seats and no --poses file was given" << std::endl;
+        return 1;
+    }
+    std::cout << "THUMBNAILS::" << poses.size() << " poses, " << batch.viewsPerPass() << " views per pass ("
+              << MultiView::modeName(batch.mode()) << "), " << batch.writerCount() << " writers" << std::endl;
+
+    batch.draw(campus, assets, shaders, renderQueue, poses);
+    batch.finish();
+    batch.report(std::cout);
+    return batch.stats.failedWrites == 0 ? 0 : 1;
+}
+
 // process all input
 void processInput(GLFWwindow *window)
 {
@@ -159,13 +849,36 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
+// Apply the queued mouse input to the camera (or drop it during a replay); the meter times the
+// frame from the oldest event
+void latchInput(LatencyMeter& latency, bool apply)
+{
+    static std::vector<InputEvent> events;
+    inputQueue.drain(events);
+    if (!apply)
+        events.clear();
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (events[i].type == INPUT_MOUSE_MOVE)
+            camera.ProcessMouseMovement(events[i].x, events[i].y);
+        else
+            camera.ProcessMouseScroll(events[i].y);
+    }
+    latency.latch(events.empty() ? 0.0 : events[0].time, (unsigned int)events.size(), glfwGetTime());
+}
+
 // glfw: whenever the window size changed this callback function executes
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    // The pacer sets the viewport every frame, for its scaled target or the window
+    FramePacer* pacer = static_cast<FramePacer*>(glfwGetWindowUserPointer(window));
+    if (pacer)
+        pacer->resize(width, height);
+    else
+        glViewport(0, 0, width, height);
 }
 
-// glfw: whenever the mouse moves, this callback is called
+// glfw: whenever the mouse moves, this callback is called; the offset waits for the camera latch
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
     float xposf = static_cast<float>(xpos);
@@ -184,11 +897,11 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastX = xposf;
     lastY = yposf;
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    inputQueue.push(INPUT_MOUSE_MOVE, glfwGetTime(), xoffset, yoffset);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+    inputQueue.push(INPUT_SCROLL, glfwGetTime(), 0.0f, static_cast<float>(yoffset));
 }
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "../include/metrics.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#define METRICS_SOCKETS 1
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // A scraper hanging up must not raise SIGPIPE (macOS: no such flag)
+#endif
+#endif
+
+const int Metric::MAX_BUCKETS;
+const size_t MetricsRegistry::CAPACITY;
+
+Metric::Metric() : type(METRIC_GAUGE), boundCount(0), current(0.0)
+{
+    for (int i = 0; i < MAX_BUCKETS; i++)
+        bounds[i] = 0.0;
+    for (int i = 0; i <= MAX_BUCKETS; i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void Metric::add(double amount)
+{
+    double old = current.load(std::memory_order_relaxed);
+    while (!current.compare_exchange_weak(old, old + amount, std::memory_order_relaxed))
+        ;
+}
+
+void Metric::set(double value)
+{
+    current.store(value, std::memory_order_relaxed);
+}
+
+void Metric::observe(double value)
+{
+    int bucket = 0;
+    while (bucket < boundCount && value > bounds[bucket])
+        bucket++;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    add(value);
+}
+
+MetricsRegistry::MetricsRegistry() : slots(new Metric[CAPACITY]), published(0)
+{
+}
+
+Metric* MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels)
+{
+    return add(METRIC_COUNTER, name, help, labels, std::vector<double>());
+}
+
+Metric* MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+    return add(METRIC_GAUGE, name, help, labels, std::vector<double>());
+}
+
+Metric* MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds)
+{
+    return add(METRIC_HISTOGRAM, name, help, "", bounds);
+}
+
+Metric* MetricsRegistry::add(MetricType type, const std::string& name, const std::string& help,
+                             const std::string& labels, const std::vector<double>& bounds)
+{
+    std::string key = name + "{" + labels + "}";
+    std::map<std::string, size_t>::const_iterator existing = byKey.find(key);
+    if (existing != byKey.end())
+        return existing->second < CAPACITY ? &slots[existing->second] : &overflow;
+
+    size_t index = published.load(std::memory_order_relaxed);
+    if (index == CAPACITY)
+    {
+        if (byKey.size() == CAPACITY)
+            std::cout << "Warning: Metrics registry full, " << key << " is not served" << std::endl;
+        byKey[key] = CAPACITY;  // Warn once per registry
+        return &overflow;
+    }
+
+    Metric& metric = slots[index];
+    metric.type = type;
+    metric.name = name;
+    metric.help = help;
+    metric.labels = labels;
+    metric.boundCount = std::min((int)bounds.size(), (int)Metric::MAX_BUCKETS);
+    for (int i = 0; i < metric.boundCount; i++)
+        metric.bounds[i] = bounds[i];
+    byKey[key] = index;
+    // Publish: the server sees the slot only after its fields are written
+    published.store(index + 1, std::memory_order_release);
+    return &metric;
+}
+
+static void writeValue(std::ostream& out, double value)
+{
+    if (std::isinf(value))
+        out << (value > 0 ? "+Inf" : "-Inf");
+    else if (std::isnan(value))
+        out << "NaN";
+    else
+        out << value;
+}
+
+std::string MetricsRegistry::exposition() const
+{
+    size_t count = size();
+
+    // Series of one family must be contiguous; families keep their registration order
+    std::vector<size_t> order(count);
+    std::map<std::string, size_t> familyRank;
+    for (size_t i = 0; i < count; i++)
+    {
+        order[i] = i;
+        familyRank.insert(std::make_pair(slots[i].name, familyRank.size()));
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return familyRank[slots[a].name] < familyRank[slots[b].name];
+    });
+
+    std::ostringstream out;
+    out.precision(12);
+    const std::string* family = NULL;
+    for (size_t k = 0; k < count; k++)
+    {
+        const Metric& m = slots[order[k]];
+        if (!family || *family != m.name)
+        {
+            family = &m.name;
+            out << "# HELP " << m.name << " " << m.help << "\n# TYPE " << m.name << " "
+                << (m.type == METRIC_COUNTER ? "counter" : m.type == METRIC_GAUGE ? "gauge" : "histogram") << "\n";
+        }
+        if (m.type != METRIC_HISTOGRAM)
+        {
+            out << m.name;
+            if (!m.labels.empty())
+                out << "{" << m.labels << "}";
+            out << " ";
+            writeValue(out, m.value());
+            out << "\n";
+            continue;
+        }
+
+        // Buckets are kept per range; the format wants them cumulative
+        std::string separator = m.labels.empty() ? "" : m.labels + ",";
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= m.boundCount; b++)
+        {
+            cumulative += m.buckets[b].load(std::memory_order_relaxed);
+            out << m.name << "_bucket{" << separator << "le=\"";
+            if (b < m.boundCount)
+                writeValue(out, m.bounds[b]);
+            else
+                out << "+Inf";
+            out << "\"} " << cumulative << "\n";
+        }
+        out << m.name << "_sum";
+        if (!m.labels.empty())
+            out << "{" << m.labels << "}";
+        out << " ";
+        writeValue(out, m.value());
+        out << "\n" << m.name << "_count";
+        if (!m.labels.empty())
+            out << "{" << m.labels << "}";
+        out << " " << cumulative << "\n";
+    }
+    return out.str();
+}
+
+std::string metricLabel(const std::string& key, const std::string& value)
+{
+    std::string label = key + "=\"";
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        if (value[i] == '\\' || value[i] == '"')
+            label += '\\';
+        if (value[i] == '\n')
+            label += "\\n";
+        else
+            label += value[i];
+    }
+    return label + "\"";
+}
+
+MetricsServer::MetricsServer(const MetricsRegistry& metricsRegistry)
+    : registry(metricsRegistry), running(false), served(0), listenSocket(-1)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(const std::string& address)
+{
+    stop();
+#ifdef METRICS_SOCKETS
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        sockaddr_un local;
+        std::memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(local.sun_path))
+        {
+            std::cout << "ERROR::METRICS::Bad socket path: " << path << std::endl;
+            return false;
+        }
+        std::strcpy(local.sun_path, path.c_str());
+        unlink(path.c_str());  // Left behind by a previous run
+        listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&local, sizeof(local)) != 0)
+        {
+            std::cout << "ERROR::METRICS::Cannot bind " << path << std::endl;
+            stop();
+            return false;
+        }
+        socketPath = path;
+    }
+    else
+    {
+        int port = std::atoi(address.c_str());
+        if (port <= 0 || port > 65535)
+        {
+            std::cout << "ERROR::METRICS::Bad port: " << address << std::endl;
+            return false;
+        }
+        sockaddr_in loopback;
+        std::memset(&loopback, 0, sizeof(loopback));
+        loopback.sin_family = AF_INET;
+        loopback.sin_port = htons((unsigned short)port);
+        loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listenSocket >= 0)
+            setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&loopback, sizeof(loopback)) != 0)
+        {
+            std::cout << "ERROR::METRICS::Cannot bind 127.0.0.1:" << port << std::endl;
+            stop();
+            return false;
+        }
+    }
+    if (listen(listenSocket, 8) != 0)
+    {
+        std::cout << "ERROR::METRICS::Cannot listen on " << address << std::endl;
+        stop();
+        return false;
+    }
+    running = true;
+    thread = std::thread(&MetricsServer::serve, this);
+    return true;
+#else
+    std::cout << "Warning: Metrics endpoint needs POSIX sockets, not serving " << address << std::endl;
+    return false;
+#endif
+}
+
+void MetricsServer::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+#ifdef METRICS_SOCKETS
+    if (listenSocket >= 0)
+        close(listenSocket);
+    if (!socketPath.empty())
+        unlink(socketPath.c_str());
+#endif
+    listenSocket = -1;
+    socketPath.clear();
+}
+
+void MetricsServer::serve()
+{
+#ifdef METRICS_SOCKETS
+    while (running)
+    {
+        // Wake up now and then to notice stop()
+        pollfd waiting;
+        waiting.fd = listenSocket;
+        waiting.events = POLLIN;
+        waiting.revents = 0;
+        if (poll(&waiting, 1, 200) <= 0)
+            continue;
+        int client = accept(listenSocket, NULL, NULL);
+        if (client < 0)
+            continue;
+        answer(client);
+        close(client);
+    }
+#endif
+}
+
+void MetricsServer::answer(int client)
+{
+#ifdef METRICS_SOCKETS
+    // Read the request head (bounded, with a timeout so a silent client cannot hold the thread)
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos &&
+           request.size() < 8192)
+    {
+        pollfd readable;
+        readable.fd = client;
+        readable.events = POLLIN;
+        readable.revents = 0;
+        if (poll(&readable, 1, 1000) <= 0)
+            return;
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return;
+        request.append(buffer, (size_t)n);
+    }
+
+    std::string status, type, body;
+    if (request.compare(0, 4, "GET ") != 0)
+    {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+        body = "GET only\n";
+    }
+    else if (request.compare(4, 9, "/metrics ") == 0 || request.compare(4, 2, "/ ") == 0)
+    {
+        status = "200 OK";
+        type = "text/plain; version=0.0.4; charset=utf-8";
+        body = registry.exposition();
+    }
+    else
+    {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "Metrics are at /metrics\n";
+    }
+
+    std::ostringstream head;
+    head << "HTTP/1.0 " << status << "\r\nContent-Type: " << type << "\r\nContent-Length: " << body.size()
+         << "\r\nConnection: close\r\n\r\n";
+    std::string response = head.str() + body;
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+        ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        sent += (size_t)n;
+    }
+    served.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)client;
+#endif
+}
@@ -0,0 +1,215 @@
+#include "../include/multi_view.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+const unsigned int MultiView::MAX_VIEWS;
+
+// std140 MultiViewBlock: projections, views, positions (vec4 each), then the view count
+static const size_t MULTIVIEW_BLOCK_FLOATS = MultiView::MAX_VIEWS * (16 + 16 + 4) + 4;
+
+MultiView::MultiView()
+    : count(1), viewMode(MULTIVIEW_SPLIT), uniformBuffer(0), framebuffer(0), readFramebuffer(0), colorArray(0),
+      depthArray(0), layerWidth(0), layerHeight(0), output(0), outputWidth(0), outputHeight(0),
+      blitLayers(false)
+{
+}
+
+MultiView::~MultiView()
+{
+    releaseLayers();
+    if (uniformBuffer != 0)
+        glDeleteBuffers(1, &uniformBuffer);
+}
+
+bool MultiView::layeredSupported()
+{
+    // Not AMD_vertex_shader_layer alone: vertex_shader.glsl requires the ARB extension
+    return GLEW_ARB_shader_viewport_layer_array;
+}
+
+const char* MultiView::modeName(MultiViewMode mode)
+{
+    return mode == MULTIVIEW_LAYERED ? "layered" : "split viewport";
+}
+
+bool MultiView::initialize(unsigned int views, MultiViewMode preferred)
+{
+    if (views < 2 || views > MAX_VIEWS)
+    {
+        std::cout << "ERROR::MULTIVIEW::View count must be 2 to " << MAX_VIEWS << ", got " << views << std::endl;
+        return false;
+    }
+    count = views;
+    viewMode = preferred;
+    if (viewMode == MULTIVIEW_LAYERED && !layeredSupported())
+    {
+        std::cout << "Warning: No gl_Layer in vertex shaders, multi-view falls back to a split viewport" << std::endl;
+        viewMode = MULTIVIEW_SPLIT;
+    }
+    releaseLayers();
+    return true;
+}
+
+unsigned int MultiView::shaderFeatures() const
+{
+    return FEATURE_MULTIVIEW | (viewMode == MULTIVIEW_LAYERED ? (unsigned int)FEATURE_LAYERED : 0u);
+}
+
+void MultiView::stereoCameras(const Camera& camera, float aspect, float separation, float convergence,
+                              MultiViewCamera* cameras) const
+{
+    const float nearPlane = 0.1f, farPlane = 100.0f;
+    float top = nearPlane * std::tan(glm::radians(camera.Zoom) * 0.5f);
+    float right = top * aspect;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // Eyes centred on the camera; the frustum shifts the other way so every view agrees at
+        // the convergence distance
+        float offset = ((float)i - (float)(count - 1) * 0.5f) * separation;
+        float shift = convergence > 0.0f ? offset * nearPlane / convergence : 0.0f;
+        MultiViewCamera& view = cameras[i];
+        view.position = camera.Position + camera.Right * offset;
+        view.view = glm::lookAt(view.position, view.position + camera.Front, camera.Up);
+        view.projection = glm::frustum(-right - shift, right - shift, -top, top, nearPlane, farPlane);
+    }
+}
+
+void MultiView::update(const MultiViewCamera* cameras)
+{
+    float data[MULTIVIEW_BLOCK_FLOATS];
+    std::memset(data, 0, sizeof(data));
+    float* projections = data;
+    float* views = data + MAX_VIEWS * 16;
+    float* positions = data + MAX_VIEWS * 32;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        std::memcpy(projections + i * 16, glm::value_ptr(cameras[i].projection), 16 * sizeof(float));
+        std::memcpy(views + i * 16, glm::value_ptr(cameras[i].view), 16 * sizeof(float));
+        positions[i * 4 + 0] = cameras[i].position.x;
+        positions[i * 4 + 1] = cameras[i].position.y;
+        positions[i * 4 + 2] = cameras[i].position.z;
+        positions[i * 4 + 3] = 1.0f;
+    }
+    int viewCount = (int)count;
+    std::memcpy(data + MAX_VIEWS * 36, &viewCount, sizeof(int));
+
+    // Same upload as ViewUniforms: orphan so a frame still reading the old views never stalls
+    if (uniformBuffer == 0)
+    {
+        glGenBuffers(1, &uniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(data), data, GL_DYNAMIC_DRAW);
+    }
+    else
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(data), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), data);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, MULTIVIEW_UNIFORM_BINDING, uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void MultiView::begin(int width, int height)
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+    outputWidth = width;
+    outputHeight = height;
+    if (viewMode == MULTIVIEW_SPLIT)
+    {
+        // The vertex shader narrows each view to its column; clip distances cut it off there
+        glViewport(0, 0, width, height);
+        glEnable(GL_CLIP_DISTANCE0);
+        glEnable(GL_CLIP_DISTANCE1);
+        return;
+    }
+
+    beginLayers(std::max(1, width / (int)count), height);
+    blitLayers = true;
+}
+
+void MultiView::beginLayers(int width, int height)
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+    blitLayers = false;
+    if (framebuffer == 0 || layerWidth != width || layerHeight != height)
+        allocateLayers(width, height);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, layerWidth, layerHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void MultiView::end()
+{
+    if (viewMode == MULTIVIEW_SPLIT)
+    {
+        glDisable(GL_CLIP_DISTANCE0);
+        glDisable(GL_CLIP_DISTANCE1);
+        return;
+    }
+    if (!blitLayers)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)output);
+        return;
+    }
+
+    // One blit per layer into its column
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (unsigned int)output);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorArray, 0, (int)i);
+        int x0 = outputWidth * (int)i / (int)count, x1 = outputWidth * (int)(i + 1) / (int)count;
+        glBlitFramebuffer(0, 0, layerWidth, layerHeight, x0, 0, x1, outputHeight, GL_COLOR_BUFFER_BIT,
+                          x1 - x0 == layerWidth ? GL_NEAREST : GL_LINEAR);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)output);
+    glViewport(0, 0, outputWidth, outputHeight);
+}
+
+void MultiView::allocateLayers(int width, int height)
+{
+    releaseLayers();
+    layerWidth = width;
+    layerHeight = height;
+
+    glGenTextures(1, &colorArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, colorArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (int)count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenTextures(1, &depthArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, width, height, (int)count, 0, GL_DEPTH_COMPONENT,
+                 GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Layered attachments: gl_Layer selects the layer a primitive goes to
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorArray, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::MULTIVIEW::Layered framebuffer incomplete" << std::endl;
+    glGenFramebuffers(1, &readFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)output);
+}
+
+void MultiView::releaseLayers()
+{
+    if (framebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteFramebuffers(1, &readFramebuffer);
+        glDeleteTextures(1, &colorArray);
+        glDeleteTextures(1, &depthArray);
+    }
+    framebuffer = readFramebuffer = colorArray = depthArray = 0;
+    layerWidth = layerHeight = 0;
+}
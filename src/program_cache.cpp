@@ -0,0 +1,124 @@
+#include "../include/program_cache.h"
+#include "../include/asset_registry.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+static const char PROGRAM_MAGIC[4] = { 'C', 'P', 'R', 'G' };
+static const uint32_t PROGRAM_VERSION = 1;
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& dir)
+    : hits(0), misses(0), directory(dir), driverHash(0), supported(false)
+{
+    std::string driver;
+    const GLubyte* strings[] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+    for (int i = 0; i < 3; i++)
+    {
+        driver += strings[i] ? reinterpret_cast<const char*>(strings[i]) : "";
+        driver += '\n';
+    }
+    driverHash = hashBytes(driver.data(), driver.size());
+
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    supported = formats > 0;
+    if (supported)
+        mkdir(directory.c_str(), 0755);
+}
+
+uint64_t ProgramBinaryCache::key(const std::string& vertexCode, const std::string& fragmentCode) const
+{
+    uint64_t hash = hashBytes(vertexCode.data(), vertexCode.size(), driverHash);
+    // Separator so moving text between the two stages changes the key
+    hash = hashBytes("|", 1, hash);
+    return hashBytes(fragmentCode.data(), fragmentCode.size(), hash);
+}
+
+std::string ProgramBinaryCache::pathFor(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return directory + "/" + name;
+}
+
+unsigned int ProgramBinaryCache::load(uint64_t key)
+{
+    if (!supported)
+        return 0;
+
+    std::ifstream file(pathFor(key), std::ios::binary);
+    char magic[4];
+    uint32_t version = 0, format = 0, length = 0;
+    uint64_t storedKey = 0;
+    if (!file.is_open() || !file.read(magic, 4) || memcmp(magic, PROGRAM_MAGIC, 4) != 0 ||
+        !file.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != PROGRAM_VERSION ||
+        !file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey)) || storedKey != key ||
+        !file.read(reinterpret_cast<char*>(&format), sizeof(format)) ||
+        !file.read(reinterpret_cast<char*>(&length), sizeof(length)) || length == 0)
+    {
+        misses++;
+        return 0;
+    }
+    std::vector<char> binary(length);
+    if (!file.read(&binary[0], length))
+    {
+        misses++;
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, format, &binary[0], (GLsizei)length);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        // The driver may reject binaries even with matching strings; recompile and overwrite
+        glDeleteProgram(program);
+        remove(pathFor(key).c_str());
+        misses++;
+        return 0;
+    }
+    hits++;
+    return program;
+}
+
+bool ProgramBinaryCache::store(uint64_t key, unsigned int program)
+{
+    if (!supported || program == 0)
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, &binary[0]);
+    if (written <= 0)
+        return false;
+
+    // Write to a temporary name first so a crash never leaves a truncated entry behind
+    std::string path = pathFor(key);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        uint32_t format32 = format, length32 = (uint32_t)written;
+        file.write(PROGRAM_MAGIC, 4);
+        file.write(reinterpret_cast<const char*>(&PROGRAM_VERSION), sizeof(PROGRAM_VERSION));
+        file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char*>(&format32), sizeof(format32));
+        file.write(reinterpret_cast<const char*>(&length32), sizeof(length32));
+        file.write(&binary[0], written);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::Failed to write program binary: " << temporary << std::endl;
+            return false;
+        }
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,331 @@
+#include "../include/render_queue.h"
+#include "../include/debug_view.h"
+#include <cstring>
+
+// Depth range mapped onto the 24-bit depth field (matches the projection far plane)
+static const float SORT_MAX_DEPTH = 100.0f;
+static const unsigned int NUM_MATERIAL_UNIFORMS = 4;
+
+void GLStateCache::reset()
+{
+    currentProgram = 0;
+    currentVAO = 0;
+    currentTexture = 0;
+    currentLightmap = 0;
+    programValid = false;
+    vaoValid = false;
+    textureValid = false;
+    lightmapValid = false;
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        programs[i].material = NULL;
+        programs[i].hasModel = false;
+        programs[i].hasLightmapRect = false;
+        programs[i].hasDrawCost = false;
+    }
+}
+
+GLStateCache::ProgramState& GLStateCache::programState(const Shader& shader)
+{
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        if (programs[i].program == shader.ID)
+            return programs[i];
+    }
+
+    // First time we see this program: look up uniform locations once
+    ProgramState state;
+    state.program = shader.ID;
+    state.modelLoc = glGetUniformLocation(shader.ID, "model");
+    state.ambientLoc = glGetUniformLocation(shader.ID, "material.ambient");
+    state.diffuseLoc = glGetUniformLocation(shader.ID, "material.diffuse");
+    state.specularLoc = glGetUniformLocation(shader.ID, "material.specular");
+    state.shininessLoc = glGetUniformLocation(shader.ID, "material.shininess");
+    state.layerLoc = glGetUniformLocation(shader.ID, "diffuseLayer");
+    state.lightmapRectLoc = glGetUniformLocation(shader.ID, "lightmapRect");
+    state.drawCostLoc = glGetUniformLocation(shader.ID, "drawCost");
+    state.material = NULL;
+    state.model = glm::mat4(1.0f);
+    state.lightmapRect = glm::vec4(0.0f);
+    state.drawCost = 0.0f;
+    state.hasModel = false;
+    state.hasLightmapRect = false;
+    state.hasDrawCost = false;
+    // The sampler unit never changes; set it while the program is bound. Instanced programs have
+    // the sampler but no rect uniform.
+    int lightmapLoc = glGetUniformLocation(shader.ID, "lightmap");
+    if (lightmapLoc >= 0)
+        glUniform1i(lightmapLoc, LIGHTMAP_TEXTURE_UNIT);
+    programs.push_back(state);
+    return programs.back();
+}
+
+void GLStateCache::useProgram(const Shader& shader)
+{
+    if (programValid && currentProgram == shader.ID)
+        return;
+    glUseProgram(shader.ID);
+    currentProgram = shader.ID;
+    programValid = true;
+    stats.programBinds++;
+}
+
+void GLStateCache::bindVertexArray(unsigned int VAO)
+{
+    if (vaoValid && currentVAO == VAO)
+        return;
+    glBindVertexArray(VAO);
+    currentVAO = VAO;
+    vaoValid = true;
+    stats.vaoBinds++;
+}
+
+void GLStateCache::setMaterial(const Shader& shader, const Material& material)
+{
+    ProgramState& state = programState(shader);
+    if (state.material == &material)
+        return;
+    glUniform3fv(state.ambientLoc, 1, &material.ambient[0]);
+    glUniform3fv(state.diffuseLoc, 1, &material.diffuse[0]);
+    glUniform3fv(state.specularLoc, 1, &material.specular[0]);
+    glUniform1f(state.shininessLoc, material.shininess);
+    state.material = &material;
+    stats.uniformUploads += NUM_MATERIAL_UNIFORMS;
+
+    // Materials of a room share a few texture arrays, so most changes only move the layer
+    if (material.diffuseMap == 0)
+        return;
+    glUniform1f(state.layerLoc, material.diffuseLayer);
+    stats.uniformUploads++;
+    if (textureValid && currentTexture == material.diffuseMap)
+        return;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, material.diffuseMap);
+    currentTexture = material.diffuseMap;
+    textureValid = true;
+    stats.textureBinds++;
+}
+
+void GLStateCache::setModel(const Shader& shader, const glm::mat4& model)
+{
+    ProgramState& state = programState(shader);
+    if (state.hasModel && std::memcmp(&state.model[0][0], &model[0][0], sizeof(glm::mat4)) == 0)
+        return;
+    glUniformMatrix4fv(state.modelLoc, 1, GL_FALSE, &model[0][0]);
+    state.model = model;
+    state.hasModel = true;
+    stats.uniformUploads++;
+}
+
+void GLStateCache::setLightmap(const Shader& shader, unsigned int lightmap, const glm::vec4& rect)
+{
+    ProgramState& state = programState(shader);
+    if (state.lightmapRectLoc >= 0 &&
+        (!state.hasLightmapRect || std::memcmp(&state.lightmapRect[0], &rect[0], sizeof(glm::vec4)) != 0))
+    {
+        glUniform4fv(state.lightmapRectLoc, 1, &rect[0]);
+        state.lightmapRect = rect;
+        state.hasLightmapRect = true;
+        stats.uniformUploads++;
+    }
+    if (lightmap == 0 || (lightmapValid && currentLightmap == lightmap))
+        return;
+    glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, lightmap);
+    glActiveTexture(GL_TEXTURE0);
+    currentLightmap = lightmap;
+    lightmapValid = true;
+    stats.textureBinds++;
+}
+
+void GLStateCache::setDrawCost(const Shader& shader, float cost)
+{
+    ProgramState& state = programState(shader);
+    if (state.drawCostLoc < 0 || (state.hasDrawCost && state.drawCost == cost))
+        return;
+    glUniform1f(state.drawCostLoc, cost);
+    state.drawCost = cost;
+    state.hasDrawCost = true;
+    stats.uniformUploads++;
+}
+
+RenderQueue::RenderQueue() : viewPosition(0.0f), views(1), drawTimer(NULL), drawCosts(NULL)
+{
+}
+
+uint64_t RenderQueue::drawId(const DrawPacket& packet)
+{
+    // FNV-1a over the fields that place the geometry
+    uint64_t hash = 14695981039346656037ull;
+    const void* parts[] = { &packet.VAO, &packet.first, &packet.count, &packet.instanceCount, &packet.material,
+                            &packet.model[0][0] };
+    size_t sizes[] = { sizeof(packet.VAO), sizeof(packet.first), sizeof(packet.count), sizeof(packet.instanceCount),
+                       sizeof(packet.material), sizeof(glm::mat4) };
+    for (size_t p = 0; p < sizeof(parts) / sizeof(parts[0]); p++)
+    {
+        const unsigned char* bytes = (const unsigned char*)parts[p];
+        for (size_t i = 0; i < sizes[p]; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t RenderQueue::makeKey(RenderLayer layer, unsigned int program, unsigned int material,
+                              unsigned int VAO, float depth)
+{
+    float normalized = depth / SORT_MAX_DEPTH;
+    if (normalized < 0.0f) normalized = 0.0f;
+    if (normalized > 1.0f) normalized = 1.0f;
+    uint64_t depthBits = (uint64_t)(normalized * 0xFFFFFF);
+    // Transparent geometry must be drawn back-to-front
+    if (layer == LAYER_TRANSPARENT)
+        depthBits = 0xFFFFFF - depthBits;
+
+    return ((uint64_t)(layer & 0xF) << 60) |
+           ((uint64_t)(program & 0xFF) << 52) |
+           ((uint64_t)(material & 0xFFF) << 40) |
+           ((uint64_t)(VAO & 0xFFFF) << 24) |
+           depthBits;
+}
+
+void RenderQueue::submit(RenderLayer layer, const Shader& shader, unsigned int VAO, GLsizei count,
+                         const Material* material, const glm::mat4& model, const glm::vec3& worldCenter,
+                         unsigned int lightmap, const glm::vec4& lightmapRect)
+{
+    if (count <= 0)
+        return;
+
+    DrawPacket packet;
+    packet.key = makeKey(layer, shader.ID, material ? material->id : 0, VAO,
+                         glm::length(worldCenter - viewPosition));
+    packet.shader = &shader;
+    packet.VAO = VAO;
+    packet.first = 0;
+    packet.count = count;
+    packet.material = material;
+    packet.model = model;
+    packet.lightmap = lightmap;
+    packet.lightmapRect = lightmapRect;
+    packet.instanceCount = 0;
+    packets.push_back(packet);
+}
+
+void RenderQueue::submitInstanced(RenderLayer layer, const Shader& shader, unsigned int VAO, GLsizei count,
+                                  GLsizei instanceCount, const Material* material, const glm::vec3& worldCenter,
+                                  unsigned int lightmap)
+{
+    if (instanceCount <= 0)
+        return;
+    size_t queued = packets.size();
+    submit(layer, shader, VAO, count, material, glm::mat4(1.0f), worldCenter, lightmap);
+    if (packets.size() > queued)
+        packets.back().instanceCount = instanceCount;
+}
+
+void radixSortEntries(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch)
+{
+    size_t n = entries.size();
+    scratch.resize(n);
+    if (n < 2)
+        return;
+
+    // LSD radix sort, 8 bits per pass; passes where every key shares the same byte are skipped
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < n; i++)
+            counts[(entries[i].key >> shift) & 0xFF]++;
+        if (counts[(entries[0].key >> shift) & 0xFF] == n)
+            continue;
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            size_t c = counts[b];
+            counts[b] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++)
+            scratch[counts[(entries[i].key >> shift) & 0xFF]++] = entries[i];
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::radixSort()
+{
+    size_t n = packets.size();
+    sortEntries.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sortEntries[i].key = packets[i].key;
+        sortEntries[i].index = (uint32_t)i;
+    }
+    radixSortEntries(sortEntries, sortScratch);
+}
+
+void RenderQueue::countNaiveCalls()
+{
+    // Submission order, no state tracking: every packet binds its VAO and uploads all its uniforms
+    lastNaiveStats.reset();
+    unsigned int program = 0;
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        const DrawPacket& p = packets[i];
+        if (i == 0 || p.shader->ID != program)
+            lastNaiveStats.programBinds++;
+        program = p.shader->ID;
+        lastNaiveStats.vaoBinds++;
+        lastNaiveStats.uniformUploads += (p.instanceCount > 0 ? 0 : 1) + (p.material ? NUM_MATERIAL_UNIFORMS : 0);
+        if (p.material && p.material->diffuseMap != 0)
+        {
+            lastNaiveStats.uniformUploads++;
+            lastNaiveStats.textureBinds++;
+        }
+        if (p.lightmap != 0)
+        {
+            lastNaiveStats.uniformUploads += p.instanceCount > 0 ? 0 : 1;  // Instanced rects are attributes
+            lastNaiveStats.textureBinds++;
+        }
+        lastNaiveStats.drawCalls++;
+    }
+}
+
+void RenderQueue::flush()
+{
+    countNaiveCalls();
+    radixSort();
+
+    stateCache.reset();
+    stateCache.stats.reset();
+    if (drawTimer)
+        drawTimer->beginFrame();
+    for (size_t i = 0; i < sortEntries.size(); i++)
+    {
+        const DrawPacket& p = packets[sortEntries[i].index];
+        stateCache.useProgram(*p.shader);
+        stateCache.bindVertexArray(p.VAO);
+        if (p.material)
+            stateCache.setMaterial(*p.shader, *p.material);
+        if (p.instanceCount == 0)
+            stateCache.setModel(*p.shader, p.model);
+        if (p.lightmap != 0)
+            stateCache.setLightmap(*p.shader, p.lightmap, p.lightmapRect);
+        if (drawCosts)
+            stateCache.setDrawCost(*p.shader, drawCosts->cost(drawId(p)));
+        // Several views: one instance per view of each placement, still a single call
+        GLsizei instances = (p.instanceCount > 0 ? p.instanceCount : 1) * (GLsizei)views;
+        if (p.instanceCount > 0 || views > 1)
+            glDrawArraysInstanced(GL_TRIANGLES, p.first, p.count, instances);
+        else
+            glDrawArrays(GL_TRIANGLES, p.first, p.count);
+        stateCache.stats.drawCalls++;
+        stateCache.stats.triangles += (unsigned long long)(p.count / 3) * instances;
+        if (drawTimer)
+            drawTimer->drawn(drawId(p));
+    }
+    if (drawTimer)
+        drawTimer->endFrame();
+    lastStats = stateCache.stats;
+
+    packets.clear();
+}
@@ -0,0 +1,734 @@
+#include "../include/render_server.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cerrno>
+#include <csignal>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SERVER_SOCKETS 1
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // A client hanging up must not raise SIGPIPE (macOS: no such flag)
+#endif
+#endif
+
+const unsigned int RenderServer::MAX_IN_FLIGHT;
+
+static void put32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void put64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void putFloat(uint8_t* out, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    put32(out, bits);
+}
+
+static uint32_t get32(const uint8_t* in)
+{
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static uint64_t get64(const uint8_t* in)
+{
+    return (uint64_t)get32(in) | (uint64_t)get32(in + 4) << 32;
+}
+
+static float getFloat(const uint8_t* in)
+{
+    uint32_t bits = get32(in);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+void encodeCameraUpdate(const CameraUpdate& update, uint8_t out[CAMERA_MESSAGE_SIZE])
+{
+    std::memcpy(out, "CCAM", 4);
+    put32(out + 4, update.sequence);
+    putFloat(out + 8, update.position.x);
+    putFloat(out + 12, update.position.y);
+    putFloat(out + 16, update.position.z);
+    putFloat(out + 20, update.yaw);
+    putFloat(out + 24, update.pitch);
+    put64(out + 28, update.stamp);
+}
+
+bool decodeCameraUpdate(const uint8_t in[CAMERA_MESSAGE_SIZE], CameraUpdate& update)
+{
+    if (std::memcmp(in, "CCAM", 4) != 0)
+        return false;
+    update.sequence = get32(in + 4);
+    update.position = glm::vec3(getFloat(in + 8), getFloat(in + 12), getFloat(in + 16));
+    update.yaw = getFloat(in + 20);
+    update.pitch = getFloat(in + 24);
+    update.stamp = get64(in + 28);
+    // A camera the renderer cannot use (NaN, far outside any campus) is a broken client
+    const float LIMIT = 1.0e6f;
+    return std::fabs(update.position.x) < LIMIT && std::fabs(update.position.y) < LIMIT &&
+           std::fabs(update.position.z) < LIMIT && std::fabs(update.yaw) < LIMIT && std::fabs(update.pitch) <= 90.0f;
+}
+
+void encodeFrameHeader(const FrameHeader& header, uint8_t out[FRAME_HEADER_SIZE])
+{
+    std::memcpy(out, "CFRM", 4);
+    put32(out + 4, header.sequence);
+    put32(out + 8, header.tick);
+    out[12] = (uint8_t)header.width;
+    out[13] = (uint8_t)(header.width >> 8);
+    out[14] = (uint8_t)header.height;
+    out[15] = (uint8_t)(header.height >> 8);
+    put64(out + 16, header.stamp);
+    put32(out + 24, header.size);
+}
+
+bool decodeFrameHeader(const uint8_t in[FRAME_HEADER_SIZE], FrameHeader& header)
+{
+    if (std::memcmp(in, "CFRM", 4) != 0)
+        return false;
+    header.sequence = get32(in + 4);
+    header.tick = get32(in + 8);
+    header.width = (unsigned int)in[12] | (unsigned int)in[13] << 8;
+    header.height = (unsigned int)in[14] | (unsigned int)in[15] << 8;
+    header.stamp = get64(in + 16);
+    header.size = get32(in + 24);
+    return true;
+}
+
+#ifdef SERVER_SOCKETS
+static void setNonBlocking(int descriptor)
+{
+    fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL, 0) | O_NONBLOCK);
+}
+#endif
+
+RenderServer::RenderServer()
+    : nextKey(0), nextClient(1), frameWidth(0), frameHeight(0), running(false), listenSocket(-1)
+{
+    wakePipe[0] = wakePipe[1] = -1;
+}
+
+RenderServer::~RenderServer()
+{
+    stop();
+}
+
+bool RenderServer::start(const std::string& address, int width, int height)
+{
+    stop();
+    frameWidth = width;
+    frameHeight = height;
+#ifdef SERVER_SOCKETS
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        sockaddr_un local;
+        std::memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(local.sun_path))
+        {
+            std::cout << "ERROR::SERVER::Bad socket path: " << path << std::endl;
+            return false;
+        }
+        std::strcpy(local.sun_path, path.c_str());
+        unlink(path.c_str());  // Left behind by a previous run
+        listenSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&local, sizeof(local)) != 0)
+        {
+            std::cout << "ERROR::SERVER::Cannot bind " << path << std::endl;
+            stop();
+            return false;
+        }
+        socketPath = path;
+    }
+    else
+    {
+        // A port on the loopback interface, or "*:<port>" for clients on the LAN
+        bool everywhere = address.compare(0, 2, "*:") == 0;
+        int port = std::atoi(address.c_str() + (everywhere ? 2 : 0));
+        if (port <= 0 || port > 65535)
+        {
+            std::cout << "ERROR::SERVER::Bad port: " << address << std::endl;
+            return false;
+        }
+        sockaddr_in inet;
+        std::memset(&inet, 0, sizeof(inet));
+        inet.sin_family = AF_INET;
+        inet.sin_port = htons((unsigned short)port);
+        inet.sin_addr.s_addr = htonl(everywhere ? INADDR_ANY : INADDR_LOOPBACK);
+        listenSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listenSocket >= 0)
+            setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&inet, sizeof(inet)) != 0)
+        {
+            std::cout << "ERROR::SERVER::Cannot bind " << (everywhere ? "*:" : "127.0.0.1:") << port << std::endl;
+            stop();
+            return false;
+        }
+    }
+    if (listen(listenSocket, 16) != 0 || pipe(wakePipe) != 0)
+    {
+        std::cout << "ERROR::SERVER::Cannot listen on " << address << std::endl;
+        stop();
+        return false;
+    }
+    setNonBlocking(listenSocket);
+    setNonBlocking(wakePipe[0]);
+    setNonBlocking(wakePipe[1]);
+    reportStart = std::chrono::steady_clock::now();
+    running = true;
+    thread = std::thread(&RenderServer::serve, this);
+    std::cout << "SERVER::Listening on " << address << ", " << width << "x" << height << " frames" << std::endl;
+    return true;
+#else
+    std::cout << "Warning: Render server needs POSIX sockets, not serving " << address << std::endl;
+    return false;
+#endif
+}
+
+void RenderServer::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+#ifdef SERVER_SOCKETS
+    std::lock_guard<std::mutex> lock(mutex);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (std::map<unsigned int, Client>::iterator it = clients.begin(); it != clients.end(); ++it)
+    {
+        if (!it->second.closed)
+            drop(it->second);
+        it->second.stats.seconds = std::chrono::duration<double>(now - it->second.since).count();
+        departed.push_back(it->second.stats);
+    }
+    clients.clear();
+    pending.clear();
+    if (listenSocket >= 0)
+        ::close(listenSocket);
+    for (int i = 0; i < 2; i++)
+    {
+        if (wakePipe[i] >= 0)
+            ::close(wakePipe[i]);
+        wakePipe[i] = -1;
+    }
+    if (!socketPath.empty())
+        unlink(socketPath.c_str());
+#endif
+    listenSocket = -1;
+    socketPath.clear();
+}
+
+// Ctrl+C ends run() with a final report
+static volatile std::sig_atomic_t serverInterrupted = 0;
+
+static void interruptServer(int)
+{
+    serverInterrupted = 1;
+}
+
+bool RenderServer::run(Campus& campus, AssetRegistry& assets, ShaderVariants& shaders, RenderQueue& queue,
+                       ThumbnailBatch& batch, float tickRate, float seconds)
+{
+    typedef std::chrono::steady_clock Clock;
+    serverInterrupted = 0;
+    void (*previousHandler)(int) = std::signal(SIGINT, interruptServer);
+    Clock::duration period =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tickRate));
+    Clock::time_point start = Clock::now(), nextTick = start, lastReport = start;
+    uint32_t tick = 0;
+    std::vector<ViewPose> poses;
+    std::chrono::duration<double> runFor(seconds);
+    while (!serverInterrupted && (seconds <= 0.0f || Clock::now() - start < runFor))
+    {
+        Clock::time_point now = Clock::now();
+        if (now < nextTick)
+        {
+            batch.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        // A late tick starts the next period now instead of catching up
+        nextTick = std::max(nextTick + period, now);
+
+        poses.clear();
+        views(tick, poses);
+        std::stable_sort(poses.begin(), poses.end(), [&campus](const ViewPose& a, const ViewPose& b)
+                         { return campus.cellAt(a.position) < campus.cellAt(b.position); });
+        campus.update(1.0f / tickRate, poses.empty() ? campus.startPosition : poses[0].position);
+        batch.draw(campus, assets, shaders, queue, poses);
+        batch.poll();
+        tick++;
+
+        if (now - lastReport >= std::chrono::seconds(5))
+        {
+            report(std::cout);
+            lastReport = now;
+        }
+    }
+    batch.finish();
+    report(std::cout);
+    batch.report(std::cout);
+    std::signal(SIGINT, previousHandler);
+    return batch.stats.failedWrites == 0;
+}
+
+size_t RenderServer::clientCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return clients.size();
+}
+
+void RenderServer::views(uint32_t tick, std::vector<ViewPose>& poses)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::map<unsigned int, Client>::iterator it = clients.begin(); it != clients.end(); ++it)
+    {
+        Client& client = it->second;
+        if (client.closed || !client.hasCamera)
+            continue;
+        if (client.inFlight >= MAX_IN_FLIGHT)
+        {
+            client.stats.skipped++;
+            continue;
+        }
+        PendingFrame frame;
+        frame.client = it->first;
+        frame.sequence = client.camera.sequence;
+        frame.tick = tick;
+        frame.stamp = client.camera.stamp;
+        frame.arrival = client.arrival;
+        pending[nextKey] = frame;
+        client.inFlight++;
+
+        ViewPose pose;
+        pose.name = std::to_string(nextKey);
+        pose.position = client.camera.position;
+        pose.yaw = client.camera.yaw;
+        pose.pitch = client.camera.pitch;
+        poses.push_back(pose);
+        nextKey++;
+    }
+}
+
+void RenderServer::thumbnail(const std::string& name, std::vector<uint8_t>& qoi)
+{
+    uint32_t key = (uint32_t)std::strtoul(name.c_str(), NULL, 10);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<uint32_t, PendingFrame>::iterator found = pending.find(key);
+        if (found == pending.end())
+            return;
+        PendingFrame frame = found->second;
+        pending.erase(found);
+        std::map<unsigned int, Client>::iterator owner = clients.find(frame.client);
+        if (owner == clients.end() || owner->second.closed)
+            return;
+        Client& client = owner->second;
+
+        // Newest frame wins: writers can finish out of order, and a frame still waiting to be
+        // sent is replaced (one partly sent must go out whole)
+        client.inFlight--;
+        if ((long long)frame.tick < client.newestTick)
+        {
+            client.stats.dropped++;
+            return;
+        }
+        client.newestTick = frame.tick;
+        size_t started = !client.outbox.empty() && client.outbox.front().sent > 0 ? 1 : 0;
+        while (client.outbox.size() > started)
+        {
+            client.outbox.pop_back();
+            client.stats.dropped++;
+            client.inFlight--;
+        }
+
+        FrameHeader header;
+        header.sequence = frame.sequence;
+        header.tick = frame.tick;
+        header.width = (unsigned int)frameWidth;
+        header.height = (unsigned int)frameHeight;
+        header.stamp = frame.stamp;
+        header.size = (uint32_t)qoi.size();
+        client.outbox.push_back(OutgoingFrame());
+        OutgoingFrame& out = client.outbox.back();
+        out.bytes.resize(FRAME_HEADER_SIZE + qoi.size());
+        encodeFrameHeader(header, &out.bytes[0]);
+        std::memcpy(&out.bytes[FRAME_HEADER_SIZE], &qoi[0], qoi.size());
+        out.sent = 0;
+        out.frame = frame;
+        client.inFlight++;
+    }
+#ifdef SERVER_SOCKETS
+    char wake = 1;
+    ssize_t written = write(wakePipe[1], &wake, 1);  // Full pipe: a wakeup is already pending
+    (void)written;
+#endif
+}
+
+void RenderServer::serve()
+{
+#ifdef SERVER_SOCKETS
+    std::vector<pollfd> waiting;
+    std::vector<unsigned int> ids;
+    while (running)
+    {
+        waiting.clear();
+        ids.clear();
+        pollfd entry;
+        entry.fd = listenSocket;
+        entry.events = POLLIN;
+        entry.revents = 0;
+        waiting.push_back(entry);
+        entry.fd = wakePipe[0];
+        waiting.push_back(entry);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::map<unsigned int, Client>::iterator it = clients.begin(); it != clients.end(); ++it)
+            {
+                entry.fd = it->second.connection;
+                entry.events = (short)(POLLIN | (it->second.outbox.empty() ? 0 : POLLOUT));
+                waiting.push_back(entry);
+                ids.push_back(it->first);
+            }
+        }
+
+        // Wake up now and then to notice stop()
+        if (poll(&waiting[0], (nfds_t)waiting.size(), 100) <= 0)
+            continue;
+        if (waiting[1].revents & POLLIN)
+        {
+            char drained[64];
+            while (read(wakePipe[0], drained, sizeof(drained)) > 0)
+                ;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            std::map<unsigned int, Client>::iterator it = clients.find(ids[i]);
+            if (it == clients.end())
+                continue;
+            short events = waiting[i + 2].revents;
+            if (events & (POLLIN | POLLHUP | POLLERR))
+                receiveFrom(it->second);
+            if (!it->second.closed)
+                sendTo(it->second);
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (std::map<unsigned int, Client>::iterator it = clients.begin(); it != clients.end();)
+        {
+            if (!it->second.closed)
+            {
+                ++it;
+                continue;
+            }
+            ServerClientStats& stats = it->second.stats;
+            stats.seconds = std::chrono::duration<double>(now - it->second.since).count();
+            departed.push_back(stats);
+            std::cout << "SERVER::Client " << it->first << " disconnected" << std::endl;
+            clients.erase(it++);
+        }
+
+        if (waiting[0].revents & POLLIN)
+        {
+            int connection = accept(listenSocket, NULL, NULL);
+            if (connection >= 0)
+            {
+                setNonBlocking(connection);
+                int noDelay = 1;  // (fails harmlessly on Unix sockets)
+                setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                unsigned int id = nextClient++;
+                Client& client = clients[id];
+                client.connection = connection;
+                client.closed = false;
+                client.hasCamera = false;
+                client.lastSentSequence = 0;
+                client.sentAny = false;
+                client.inFlight = 0;
+                client.newestTick = -1;
+                client.stats.id = id;
+                client.since = now;
+                std::cout << "SERVER::Client " << id << " connected (" << clients.size() << " connected)" << std::endl;
+            }
+        }
+    }
+#endif
+}
+
+void RenderServer::receiveFrom(Client& client)
+{
+#ifdef SERVER_SOCKETS
+    uint8_t buffer[4096];
+    while (true)
+    {
+        ssize_t n = recv(client.connection, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            client.inbox.insert(client.inbox.end(), buffer, buffer + n);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            break;
+        drop(client);  // Hung up or failed
+        return;
+    }
+
+    // Only the newest camera matters; it is drawn at the next tick
+    size_t used = 0;
+    while (client.inbox.size() - used >= CAMERA_MESSAGE_SIZE)
+    {
+        CameraUpdate update;
+        if (!decodeCameraUpdate(&client.inbox[used], update))
+        {
+            std::cout << "Warning: Client " << client.stats.id << " sent a malformed camera update, disconnecting"
+                      << std::endl;
+            drop(client);
+            return;
+        }
+        client.camera = update;
+        client.hasCamera = true;
+        client.arrival = std::chrono::steady_clock::now();
+        used += CAMERA_MESSAGE_SIZE;
+    }
+    client.inbox.erase(client.inbox.begin(), client.inbox.begin() + used);
+#endif
+}
+
+void RenderServer::sendTo(Client& client)
+{
+#ifdef SERVER_SOCKETS
+    while (!client.outbox.empty())
+    {
+        OutgoingFrame& out = client.outbox.front();
+        ssize_t n = ::send(client.connection, &out.bytes[out.sent], out.bytes.size() - out.sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                drop(client);
+            return;
+        }
+        out.sent += (size_t)n;
+        if (out.sent < out.bytes.size())
+            return;
+
+        client.stats.frames++;
+        client.stats.bytes += out.bytes.size();
+        if (!client.sentAny || out.frame.sequence != client.lastSentSequence)
+        {
+            std::chrono::duration<float, std::milli> latency = std::chrono::steady_clock::now() - out.frame.arrival;
+            client.stats.latencyMs.push_back(latency.count());
+        }
+        client.lastSentSequence = out.frame.sequence;
+        client.sentAny = true;
+        client.inFlight--;
+        client.outbox.pop_front();
+    }
+#endif
+}
+
+void RenderServer::drop(Client& client)
+{
+#ifdef SERVER_SOCKETS
+    ::close(client.connection);
+#endif
+    client.connection = -1;
+    client.closed = true;
+    client.outbox.clear();
+}
+
+void RenderServer::report(std::ostream& out)
+{
+    std::vector<ServerClientStats> interval;
+    double seconds;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        interval.swap(departed);
+        for (std::map<unsigned int, Client>::iterator it = clients.begin(); it != clients.end(); ++it)
+        {
+            Client& client = it->second;
+            client.stats.seconds = std::chrono::duration<double>(now - client.since).count();
+            interval.push_back(client.stats);
+            client.stats = ServerClientStats();
+            client.stats.id = it->first;
+            client.since = now;
+        }
+        seconds = std::chrono::duration<double>(now - reportStart).count();
+        reportStart = now;
+    }
+
+    size_t frames = 0, bytes = 0;
+    for (size_t i = 0; i < interval.size(); i++)
+    {
+        ServerClientStats& stats = interval[i];
+        std::vector<float>& latency = stats.latencyMs;
+        std::sort(latency.begin(), latency.end());
+        double mean = 0.0;
+        for (size_t j = 0; j < latency.size(); j++)
+            mean += latency[j];
+        mean = latency.empty() ? 0.0 : mean / latency.size();
+        float p95 = latency.empty() ? 0.0f : latency[std::min(latency.size() - 1, latency.size() * 95 / 100)];
+        double rate = stats.seconds > 0.0 ? stats.frames / stats.seconds : 0.0;
+        out << "SERVER::Client " << stats.id << ": " << stats.frames << " frames (" << rate << "/s, "
+            << (stats.seconds > 0.0 ? stats.bytes / 1024.0 / stats.seconds : 0.0) << " KB/s), latency mean " << mean
+            << " ms, p95 " << p95 << " ms, " << stats.dropped << " dropped, " << stats.skipped << " skipped"
+            << std::endl;
+        frames += stats.frames;
+        bytes += stats.bytes;
+    }
+    out << "SERVER::" << interval.size() << " clients: " << frames << " frames in " << seconds << " s, "
+        << (seconds > 0.0 ? frames / seconds : 0.0) << " frames/s, "
+        << (seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0) << " MB/s" << std::endl;
+}
+
+RenderClient::RenderClient() : connection(-1)
+{
+}
+
+RenderClient::~RenderClient()
+{
+    disconnect();
+}
+
+bool RenderClient::connect(const std::string& address)
+{
+    disconnect();
+#ifdef SERVER_SOCKETS
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        sockaddr_un local;
+        std::memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(local.sun_path))
+            return false;
+        std::strcpy(local.sun_path, path.c_str());
+        connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connection >= 0 && ::connect(connection, (sockaddr*)&local, sizeof(local)) == 0)
+            return true;
+    }
+    else
+    {
+        // "<host>:<port>", or a port on this machine
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos || address.compare(0, 2, "*:") == 0 ? "127.0.0.1" :
+                           address.substr(0, colon);
+        int port = std::atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+        sockaddr_in inet;
+        std::memset(&inet, 0, sizeof(inet));
+        inet.sin_family = AF_INET;
+        inet.sin_port = htons((unsigned short)port);
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &inet.sin_addr) != 1)
+            return false;
+        connection = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (connection >= 0 && ::connect(connection, (sockaddr*)&inet, sizeof(inet)) == 0)
+        {
+            int noDelay = 1;
+            setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            return true;
+        }
+    }
+    disconnect();
+#endif
+    return false;
+}
+
+void RenderClient::disconnect()
+{
+#ifdef SERVER_SOCKETS
+    if (connection >= 0)
+        ::close(connection);
+#endif
+    connection = -1;
+    buffer.clear();
+}
+
+bool RenderClient::send(const CameraUpdate& update)
+{
+#ifdef SERVER_SOCKETS
+    uint8_t message[CAMERA_MESSAGE_SIZE];
+    encodeCameraUpdate(update, message);
+    size_t sent = 0;
+    while (connection >= 0 && sent < CAMERA_MESSAGE_SIZE)
+    {
+        ssize_t n = ::send(connection, message + sent, CAMERA_MESSAGE_SIZE - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            disconnect();
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    return sent == CAMERA_MESSAGE_SIZE;
+#else
+    (void)update;
+    return false;
+#endif
+}
+
+bool RenderClient::receive(FrameHeader& header, std::vector<uint8_t>& qoi, int timeoutMs)
+{
+#ifdef SERVER_SOCKETS
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (connection >= 0)
+    {
+        if (buffer.size() >= FRAME_HEADER_SIZE)
+        {
+            if (!decodeFrameHeader(&buffer[0], header))
+            {
+                disconnect();
+                return false;
+            }
+            if (buffer.size() >= FRAME_HEADER_SIZE + header.size)
+            {
+                qoi.assign(buffer.begin() + FRAME_HEADER_SIZE, buffer.begin() + FRAME_HEADER_SIZE + header.size);
+                buffer.erase(buffer.begin(), buffer.begin() + FRAME_HEADER_SIZE + header.size);
+                return true;
+            }
+        }
+        int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        pollfd readable;
+        readable.fd = connection;
+        readable.events = POLLIN;
+        readable.revents = 0;
+        if (poll(&readable, 1, std::max(0, remaining)) <= 0)
+            return false;
+        uint8_t chunk[65536];
+        ssize_t n = recv(connection, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+        {
+            disconnect();
+            return false;
+        }
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    }
+#else
+    (void)header;
+    (void)qoi;
+    (void)timeoutMs;
+#endif
+    return false;
+}
@@ -0,0 +1,96 @@
+#include "../include/renderer_metrics.h"
+#include "../include/asset_registry.h"
+#include "../include/campus.h"
+#include "../include/memory_stats.h"
+
+static std::vector<double> bucketBounds(const double* bounds, size_t count)
+{
+    return std::vector<double>(bounds, bounds + count);
+}
+
+RendererMetrics::RendererMetrics(MetricsRegistry& metricsRegistry) : registry(metricsRegistry), samples(0)
+{
+    // Around the common refresh intervals, out to multi-frame hitches
+    static const double frameBounds[] = { 0.004, 0.007, 0.0111, 0.0167, 0.0222, 0.0333, 0.05, 0.1, 0.25, 1.0 };
+    static const double compileBounds[] = { 0.001, 0.005, 0.02, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 10.0 };
+
+    frames = registry.counter("classroom_frames_total", "Frames rendered");
+    frameSeconds = registry.histogram("classroom_frame_seconds", "CPU time between frames",
+                                      bucketBounds(frameBounds, sizeof(frameBounds) / sizeof(frameBounds[0])));
+    drawCalls = registry.counter("classroom_draw_calls_total", "Draw calls (indirect commands on the GPU-driven path)");
+    triangles = registry.counter("classroom_triangles_total", "Triangles submitted by the render queue");
+    const char* stateHelp = "GL state changes made by the render queue";
+    programBinds = registry.counter("classroom_state_changes_total", stateHelp, metricLabel("state", "program"));
+    vaoBinds = registry.counter("classroom_state_changes_total", stateHelp, metricLabel("state", "vertex_array"));
+    uniformUploads = registry.counter("classroom_state_changes_total", stateHelp, metricLabel("state", "uniform"));
+    textureBinds = registry.counter("classroom_state_changes_total", stateHelp, metricLabel("state", "texture"));
+    const char* uploadHelp = "Bytes uploaded to the GPU by streaming";
+    textureUploadBytes = registry.counter("classroom_upload_bytes_total", uploadHelp, metricLabel("kind", "texture"));
+    geometryUploadBytes = registry.counter("classroom_upload_bytes_total", uploadHelp, metricLabel("kind", "geometry"));
+    const char* residentHelp = "Bytes resident";
+    textureResidentBytes = registry.gauge("classroom_resident_bytes", residentHelp, metricLabel("pool", "textures"));
+    campusResidentBytes = registry.gauge("classroom_resident_bytes", residentHelp, metricLabel("pool", "campus_gpu"));
+    processResidentBytes = registry.gauge("classroom_resident_bytes", residentHelp, metricLabel("pool", "process_rss"));
+    compileSeconds = registry.histogram("classroom_shader_compile_seconds",
+                                        "Shader program builds, compile and link or program cache load",
+                                        bucketBounds(compileBounds, sizeof(compileBounds) / sizeof(compileBounds[0])));
+}
+
+void RendererMetrics::countFrame(double seconds, unsigned int draws)
+{
+    frames->add(1.0);
+    frameSeconds->observe(seconds);
+    drawCalls->add(draws);
+}
+
+void RendererMetrics::frame(double seconds, const RenderStats& stats)
+{
+    countFrame(seconds, stats.drawCalls);
+    triangles->add((double)stats.triangles);
+    programBinds->add(stats.programBinds);
+    vaoBinds->add(stats.vaoBinds);
+    uniformUploads->add(stats.uniformUploads);
+    textureBinds->add(stats.textureBinds);
+}
+
+void RendererMetrics::gpuFrame(double seconds, size_t commands)
+{
+    countFrame(seconds, (unsigned int)commands);
+}
+
+void RendererMetrics::sample(AssetRegistry& assets, Campus& campus)
+{
+    // The sources keep running totals
+    textureUploadBytes->set((double)assets.textures.stats.bytesStreamed);
+    geometryUploadBytes->set((double)campus.stats.bytesUploaded);
+    textureResidentBytes->set((double)assets.textures.residentBytes());
+    campusResidentBytes->set((double)campus.residentBytes());
+    processResidentBytes->set((double)residentSetBytes());
+
+    assets.drainCompileTimes(compileScratch);
+    for (size_t i = 0; i < compileScratch.size(); i++)
+        compileSeconds->observe(compileScratch[i]);
+
+    samples++;
+    assets.assetGpuBytes(assetScratch);
+    for (size_t i = 0; i < assetScratch.size(); i++)
+    {
+        std::map<std::string, AssetSeries>::iterator it = assetBytes.find(assetScratch[i].first);
+        if (it == assetBytes.end())
+        {
+            AssetSeries series;
+            series.metric = registry.gauge("classroom_asset_gpu_bytes",
+                                           "GPU memory per shared asset (models and shader programs)",
+                                           metricLabel("asset", assetScratch[i].first));
+            it = assetBytes.insert(std::make_pair(assetScratch[i].first, series)).first;
+        }
+        it->second.metric->set((double)assetScratch[i].second);
+        it->second.sampled = samples;
+    }
+    // Evicted assets drop to zero rather than disappear from the registry
+    for (std::map<std::string, AssetSeries>::iterator it = assetBytes.begin(); it != assetBytes.end(); ++it)
+    {
+        if (it->second.sampled != samples)
+            it->second.metric->set(0.0);
+    }
+}
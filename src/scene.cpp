@@ -0,0 +1,650 @@
+#include "../include/scene.h"
+#include "../include/asset_registry.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <sys/stat.h>
+
+static const uint32_t SCENE_BINARY_MAGIC = 0x4E435343;  // "CSCN"
+static const uint32_t SCENE_BINARY_VERSION = 6;
+
+void SceneBoxes::push(uint16_t mat, bool light, const glm::vec3& center, const glm::vec3& dims)
+{
+    material.push_back(mat);
+    emissive.push_back(light ? 1 : 0);
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    sizeX.push_back(dims.x);
+    sizeY.push_back(dims.y);
+    sizeZ.push_back(dims.z);
+}
+
+void SceneInstances::push(uint16_t mdl, uint16_t mat, const glm::vec3& pos, float yawDeg, float s, float spinDeg)
+{
+    model.push_back(mdl);
+    material.push_back(mat);
+    posX.push_back(pos.x);
+    posY.push_back(pos.y);
+    posZ.push_back(pos.z);
+    yaw.push_back(yawDeg);
+    scale.push_back(s);
+    spin.push_back(spinDeg);
+}
+
+template <typename T>
+static void permute(std::vector<T>& values, const std::vector<uint32_t>& order)
+{
+    std::vector<T> sorted(values.size());
+    for (size_t i = 0; i < order.size(); i++)
+        sorted[i] = values[order[i]];
+    values.swap(sorted);
+}
+
+void SceneInstances::sortByModel()
+{
+    std::vector<uint32_t> order(size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (uint32_t)i;
+    const std::vector<uint16_t>& m = model;
+    const std::vector<uint16_t>& mat = material;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return m[a] != m[b] ? m[a] < m[b] : mat[a] < mat[b];
+    });
+
+    permute(model, order);
+    permute(material, order);
+    permute(posX, order);
+    permute(posY, order);
+    permute(posZ, order);
+    permute(yaw, order);
+    permute(scale, order);
+    permute(spin, order);
+}
+
+Scene::Scene()
+{
+    clear();
+}
+
+void Scene::clear()
+{
+    room = RoomShell();
+    materialNames.clear();
+    materials.clear();
+    materialTextures.clear();
+    models.clear();
+    boxes = SceneBoxes();
+    instances = SceneInstances();
+    modelRanges.clear();
+    lightPosition = glm::vec3(0.0f, 3.0f, 0.0f);
+    lightColor = glm::vec3(1.0f, 1.0f, 0.9f);
+    cameraPosition = glm::vec3(0.0f, 2.0f, 3.5f);
+    cameraYaw = -90.0f;
+    cameraPitch = 0.0f;
+    sourceSize = 0;
+    sourceHash = 0;
+}
+
+void Scene::buildModelRanges()
+{
+    instances.sortByModel();
+    modelRanges.assign(models.size(), InstanceRange());
+    for (size_t i = 0; i < modelRanges.size(); i++)
+    {
+        modelRanges[i].first = 0;
+        modelRanges[i].count = 0;
+    }
+    for (size_t i = instances.size(); i-- > 0;)
+    {
+        InstanceRange& range = modelRanges[instances.model[i]];
+        range.first = (uint32_t)i;
+        range.count++;
+    }
+    // Material ids are only used to group draws in sort keys
+    for (size_t i = 0; i < materials.size(); i++)
+        materials[i].id = (unsigned int)(i + 1);
+}
+
+// Text loading
+
+static int findName(const std::vector<std::string>& names, const std::string& name)
+{
+    for (size_t i = 0; i < names.size(); i++)
+        if (names[i] == name)
+            return (int)i;
+    return -1;
+}
+
+static int findModel(const std::vector<SceneModel>& models, const std::string& name)
+{
+    for (size_t i = 0; i < models.size(); i++)
+        if (models[i].name == name)
+            return (int)i;
+    return -1;
+}
+
+static bool readVec3(std::istringstream& iss, glm::vec3& v)
+{
+    return (bool)(iss >> v.x >> v.y >> v.z);
+}
+
+// Every dimension finite and positive, and few enough ceiling tiles; error says which is wrong
+static bool checkRoom(const RoomShell& r, std::string& error)
+{
+    const float values[4] = { r.width, r.length, r.height, r.wallThickness };
+    const char* names[4] = { "width", "length", "height", "wall thickness" };
+    for (int i = 0; i < 4; i++)
+    {
+        if (!std::isfinite(values[i]) || values[i] <= 0.0f)
+        {
+            error = std::string("room ") + names[i] + " must be a positive number";
+            return false;
+        }
+    }
+    double tiles = std::floor(r.width / CEILING_TILE_SIZE) * std::floor(r.length / CEILING_TILE_SIZE);
+    if (tiles > MAX_CEILING_TILES)
+    {
+        std::ostringstream message;
+        message << "room too large: more than " << MAX_CEILING_TILES << " ceiling tiles of " << CEILING_TILE_SIZE << " m";
+        error = message.str();
+        return false;
+    }
+    return true;
+}
+
+// The whole text file; false when it cannot be read
+static bool readText(const std::string& path, std::string& text)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    text = contents.str();
+    return true;
+}
+
+bool loadSceneText(const std::string& path, Scene& scene)
+{
+    std::string text;
+    if (!readText(path, text))
+    {
+        std::cout << "ERROR::SCENE::Failed to open scene file: " << path << std::endl;
+        return false;
+    }
+
+    scene.clear();
+    scene.sourceSize = text.size();
+    scene.sourceHash = hashBytes(text.data(), text.size());
+    std::istringstream file(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream iss(line);
+        std::string directive;
+        if (!(iss >> directive))
+            continue;
+
+        bool ok = true;
+        std::string error;
+        if (directive == "room")
+        {
+            RoomShell& r = scene.room;
+            ok = (bool)(iss >> r.width >> r.length >> r.height >> r.wallThickness);
+            ok = ok && checkRoom(r, error);
+        }
+        else if (directive == "material")
+        {
+            std::string name;
+            Material m;
+            ok = (iss >> name) && readVec3(iss, m.ambient) && readVec3(iss, m.diffuse) &&
+                 readVec3(iss, m.specular) && (iss >> m.shininess);
+            if (ok && findName(scene.materialNames, name) >= 0)
+            {
+                ok = false;
+                error = "duplicate material '" + name + "'";
+            }
+            if (ok)
+            {
+                scene.materialNames.push_back(name);
+                scene.materials.push_back(m);
+                scene.materialTextures.push_back("");
+            }
+        }
+        else if (directive == "texture")
+        {
+            std::string material, texture;
+            ok = (bool)(iss >> material >> texture);
+            int mat = findName(scene.materialNames, material);
+            if (ok && mat < 0)
+            {
+                ok = false;
+                error = "unknown material '" + material + "'";
+            }
+            if (ok)
+                scene.materialTextures[mat] = texture;
+        }
+        else if (directive == "shell")
+        {
+            std::string surface, material;
+            ok = (bool)(iss >> surface >> material);
+            int mat = findName(scene.materialNames, material);
+            if (ok && mat < 0)
+            {
+                ok = false;
+                error = "unknown material '" + material + "'";
+            }
+            else if (ok && surface == "floor")
+                scene.room.floorMaterial = (uint16_t)mat;
+            else if (ok && surface == "ceiling")
+                scene.room.ceilingMaterial = (uint16_t)mat;
+            else if (ok && surface == "walls")
+                scene.room.wallMaterial = (uint16_t)mat;
+            else if (ok)
+            {
+                ok = false;
+                error = "unknown shell surface '" + surface + "'";
+            }
+        }
+        else if (directive == "model")
+        {
+            SceneModel model;
+            model.fallback = FALLBACK_NONE;
+            model.fallbackSize = glm::vec3(0.0f);
+            model.seatCount = 0;
+            model.seatSpacing = model.seatOffset = 0.0f;
+            ok = (bool)(iss >> model.name >> model.path);
+            std::string keyword, kind;
+            while (ok && (iss >> keyword))
+            {
+                if (keyword == "spin")
+                {
+                    ok = (bool)(iss >> model.spinGroup);
+                    continue;
+                }
+                if (keyword == "seats")
+                {
+                    ok = (bool)(iss >> model.seatCount >> model.seatSpacing >> model.seatOffset);
+                    continue;
+                }
+                ok = keyword == "fallback" && (iss >> kind);
+                if (ok && kind == "box")
+                {
+                    model.fallback = FALLBACK_BOX;
+                    ok = readVec3(iss, model.fallbackSize);
+                }
+                else if (ok && kind == "bench")
+                    model.fallback = FALLBACK_BENCH;
+                else
+                    ok = false;
+            }
+            if (ok && findModel(scene.models, model.name) >= 0)
+            {
+                ok = false;
+                error = "duplicate model '" + model.name + "'";
+            }
+            if (ok)
+                scene.models.push_back(model);
+        }
+        else if (directive == "box" || directive == "fixture")
+        {
+            bool light = directive == "fixture";
+            std::string material;
+            glm::vec3 center, size;
+            int mat = 0;
+            if (!light)
+            {
+                ok = (bool)(iss >> material);
+                mat = findName(scene.materialNames, material);
+                if (ok && mat < 0)
+                {
+                    ok = false;
+                    error = "unknown material '" + material + "'";
+                }
+            }
+            ok = ok && readVec3(iss, center) && readVec3(iss, size);
+            if (ok)
+                scene.boxes.push((uint16_t)mat, light, center, size);
+        }
+        else if (directive == "instance")
+        {
+            std::string model, material;
+            glm::vec3 pos;
+            float yaw = 0.0f, scale = 1.0f, spin = 0.0f;
+            ok = (iss >> model >> material) && readVec3(iss, pos) && (iss >> yaw >> scale);
+            if (ok && !(iss >> spin))
+                spin = 0.0f;
+            int mdl = findModel(scene.models, model);
+            int mat = findName(scene.materialNames, material);
+            if (ok && mdl < 0)
+            {
+                ok = false;
+                error = "unknown model '" + model + "'";
+            }
+            else if (ok && mat < 0)
+            {
+                ok = false;
+                error = "unknown material '" + material + "'";
+            }
+            if (ok)
+                scene.instances.push((uint16_t)mdl, (uint16_t)mat, pos, yaw, scale, spin);
+        }
+        else if (directive == "light")
+        {
+            ok = readVec3(iss, scene.lightPosition) && readVec3(iss, scene.lightColor);
+        }
+        else if (directive == "camera")
+        {
+            ok = readVec3(iss, scene.cameraPosition) && (iss >> scene.cameraYaw >> scene.cameraPitch);
+        }
+        else
+        {
+            ok = false;
+            error = "unknown directive '" + directive + "'";
+        }
+
+        if (!ok)
+        {
+            std::cout << "ERROR::SCENE::" << path << ":" << lineNumber << ": "
+                      << (error.empty() ? "malformed '" + directive + "' directive" : error) << std::endl;
+            return false;
+        }
+    }
+
+    if (scene.materials.empty())
+    {
+        std::cout << "ERROR::SCENE::" << path << ": scene defines no materials" << std::endl;
+        return false;
+    }
+
+    scene.buildModelRanges();
+    return true;
+}
+
+// Binary loading
+
+template <typename T>
+static void writePOD(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void writeArray(std::ofstream& out, const std::vector<T>& values)
+{
+    uint32_t count = (uint32_t)values.size();
+    writePOD(out, count);
+    if (count)
+        out.write(reinterpret_cast<const char*>(values.data()), count * sizeof(T));
+}
+
+static void writeString(std::ofstream& out, const std::string& s)
+{
+    uint32_t length = (uint32_t)s.size();
+    writePOD(out, length);
+    out.write(s.data(), length);
+}
+
+// Structs are written field by field, so the file layout does not depend on struct padding
+static void writeVec3(std::ofstream& out, const glm::vec3& v)
+{
+    writePOD(out, v.x);
+    writePOD(out, v.y);
+    writePOD(out, v.z);
+}
+
+static void writeRoom(std::ofstream& out, const RoomShell& r)
+{
+    writePOD(out, r.width);
+    writePOD(out, r.length);
+    writePOD(out, r.height);
+    writePOD(out, r.wallThickness);
+    writePOD(out, r.floorMaterial);
+    writePOD(out, r.ceilingMaterial);
+    writePOD(out, r.wallMaterial);
+}
+
+// Only the authored values; ids and texture layers are assigned at load
+static void writeMaterial(std::ofstream& out, const Material& m)
+{
+    writeVec3(out, m.ambient);
+    writeVec3(out, m.diffuse);
+    writeVec3(out, m.specular);
+    writePOD(out, m.shininess);
+}
+
+template <typename T>
+static bool readPOD(std::ifstream& in, T& value)
+{
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// Bytes between the read position and end; counts read from the file are checked against it
+// before anything is allocated for them
+static uint64_t bytesLeft(std::ifstream& in, std::streamoff end)
+{
+    std::streamoff position = in.tellg();
+    return position < 0 || position > end ? 0 : (uint64_t)(end - position);
+}
+
+template <typename T>
+static bool readArray(std::ifstream& in, std::streamoff end, std::vector<T>& values)
+{
+    uint32_t count = 0;
+    if (!readPOD(in, count) || (uint64_t)count * sizeof(T) > bytesLeft(in, end))
+        return false;
+    values.resize(count);
+    return count == 0 || (bool)in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+}
+
+static bool readString(std::ifstream& in, std::streamoff end, std::string& s)
+{
+    uint32_t length = 0;
+    if (!readPOD(in, length) || length > bytesLeft(in, end))
+        return false;
+    s.resize(length);
+    return length == 0 || (bool)in.read(&s[0], length);
+}
+
+static bool readVec3(std::ifstream& in, glm::vec3& v)
+{
+    return readPOD(in, v.x) && readPOD(in, v.y) && readPOD(in, v.z);
+}
+
+static bool readRoom(std::ifstream& in, RoomShell& r)
+{
+    return readPOD(in, r.width) && readPOD(in, r.length) && readPOD(in, r.height) && readPOD(in, r.wallThickness) &&
+           readPOD(in, r.floorMaterial) && readPOD(in, r.ceilingMaterial) && readPOD(in, r.wallMaterial);
+}
+
+static bool readMaterial(std::ifstream& in, Material& m)
+{
+    return readVec3(in, m.ambient) && readVec3(in, m.diffuse) && readVec3(in, m.specular) &&
+           readPOD(in, m.shininess);
+}
+
+bool saveSceneBinary(const std::string& path, const Scene& scene)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cout << "ERROR::SCENE::Failed to write compiled scene: " << path << std::endl;
+        return false;
+    }
+
+    writePOD(out, SCENE_BINARY_MAGIC);
+    writePOD(out, SCENE_BINARY_VERSION);
+    writePOD(out, scene.sourceSize);
+    writePOD(out, scene.sourceHash);
+    writeRoom(out, scene.room);
+
+    writePOD(out, (uint32_t)scene.materials.size());
+    for (size_t i = 0; i < scene.materials.size(); i++)
+    {
+        writeString(out, scene.materialNames[i]);
+        writeMaterial(out, scene.materials[i]);
+        writeString(out, scene.materialTextures[i]);
+    }
+
+    writePOD(out, (uint32_t)scene.models.size());
+    for (size_t i = 0; i < scene.models.size(); i++)
+    {
+        writeString(out, scene.models[i].name);
+        writeString(out, scene.models[i].path);
+        writePOD(out, scene.models[i].fallback);
+        writeVec3(out, scene.models[i].fallbackSize);
+        writeString(out, scene.models[i].spinGroup);
+        writePOD(out, scene.models[i].seatCount);
+        writePOD(out, scene.models[i].seatSpacing);
+        writePOD(out, scene.models[i].seatOffset);
+    }
+
+    const SceneBoxes& b = scene.boxes;
+    writeArray(out, b.material);
+    writeArray(out, b.emissive);
+    writeArray(out, b.centerX);
+    writeArray(out, b.centerY);
+    writeArray(out, b.centerZ);
+    writeArray(out, b.sizeX);
+    writeArray(out, b.sizeY);
+    writeArray(out, b.sizeZ);
+
+    const SceneInstances& inst = scene.instances;
+    writeArray(out, inst.model);
+    writeArray(out, inst.material);
+    writeArray(out, inst.posX);
+    writeArray(out, inst.posY);
+    writeArray(out, inst.posZ);
+    writeArray(out, inst.yaw);
+    writeArray(out, inst.scale);
+    writeArray(out, inst.spin);
+
+    writeVec3(out, scene.lightPosition);
+    writeVec3(out, scene.lightColor);
+    writeVec3(out, scene.cameraPosition);
+    writePOD(out, scene.cameraYaw);
+    writePOD(out, scene.cameraPitch);
+    return (bool)out;
+}
+
+bool loadSceneBinary(const std::string& path, Scene& scene)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cout << "ERROR::SCENE::Failed to open compiled scene: " << path << std::endl;
+        return false;
+    }
+
+    in.seekg(0, std::ios::end);
+    std::streamoff end = in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    scene.clear();
+    uint32_t magic = 0, version = 0, count = 0;
+    bool ok = readPOD(in, magic) && readPOD(in, version) &&
+              magic == SCENE_BINARY_MAGIC && version == SCENE_BINARY_VERSION &&
+              readPOD(in, scene.sourceSize) && readPOD(in, scene.sourceHash);
+    ok = ok && readRoom(in, scene.room) && readPOD(in, count);
+    for (uint32_t i = 0; ok && i < count; i++)
+    {
+        std::string name, texture;
+        Material m;
+        ok = readString(in, end, name) && readMaterial(in, m) && readString(in, end, texture);
+        scene.materialNames.push_back(name);
+        scene.materials.push_back(m);
+        scene.materialTextures.push_back(texture);
+    }
+
+    ok = ok && readPOD(in, count);
+    for (uint32_t i = 0; ok && i < count; i++)
+    {
+        SceneModel model;
+        ok = readString(in, end, model.name) && readString(in, end, model.path) &&
+             readPOD(in, model.fallback) && readVec3(in, model.fallbackSize) &&
+             readString(in, end, model.spinGroup) &&
+             readPOD(in, model.seatCount) && readPOD(in, model.seatSpacing) && readPOD(in, model.seatOffset);
+        scene.models.push_back(model);
+    }
+
+    SceneBoxes& b = scene.boxes;
+    ok = ok && readArray(in, end, b.material) && readArray(in, end, b.emissive) &&
+         readArray(in, end, b.centerX) && readArray(in, end, b.centerY) && readArray(in, end, b.centerZ) &&
+         readArray(in, end, b.sizeX) && readArray(in, end, b.sizeY) && readArray(in, end, b.sizeZ);
+
+    SceneInstances& inst = scene.instances;
+    ok = ok && readArray(in, end, inst.model) && readArray(in, end, inst.material) &&
+         readArray(in, end, inst.posX) && readArray(in, end, inst.posY) && readArray(in, end, inst.posZ) &&
+         readArray(in, end, inst.yaw) && readArray(in, end, inst.scale) && readArray(in, end, inst.spin);
+
+    ok = ok && readVec3(in, scene.lightPosition) && readVec3(in, scene.lightColor) &&
+         readVec3(in, scene.cameraPosition) && readPOD(in, scene.cameraYaw) && readPOD(in, scene.cameraPitch);
+
+    // Reject truncated or inconsistent files rather than indexing out of range later: every array
+    // as long as the boxes or instances it belongs to, every index in range
+    size_t boxCount = b.size(), instanceCount = inst.size();
+    ok = ok && b.emissive.size() == boxCount && b.centerX.size() == boxCount && b.centerY.size() == boxCount &&
+         b.centerZ.size() == boxCount && b.sizeX.size() == boxCount && b.sizeY.size() == boxCount &&
+         b.sizeZ.size() == boxCount;
+    ok = ok && inst.material.size() == instanceCount && inst.posX.size() == instanceCount &&
+         inst.posY.size() == instanceCount && inst.posZ.size() == instanceCount && inst.yaw.size() == instanceCount &&
+         inst.scale.size() == instanceCount && inst.spin.size() == instanceCount;
+    for (size_t i = 0; ok && i < instanceCount; i++)
+        ok = inst.model[i] < scene.models.size() && inst.material[i] < scene.materials.size();
+    for (size_t i = 0; ok && i < boxCount; i++)
+        ok = b.material[i] < scene.materials.size();
+    const RoomShell& r = scene.room;
+    ok = ok && r.floorMaterial < scene.materials.size() && r.ceilingMaterial < scene.materials.size() &&
+         r.wallMaterial < scene.materials.size();
+    std::string roomError;
+    ok = ok && checkRoom(r, roomError);
+
+    if (!ok)
+    {
+        std::cout << "ERROR::SCENE::Corrupt or outdated compiled scene: " << path
+                  << (roomError.empty() ? "" : " (" + roomError + ")") << std::endl;
+        scene.clear();
+        return false;
+    }
+
+    scene.buildModelRanges();
+    return true;
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool loadScene(const std::string& path, Scene& scene)
+{
+    if (endsWith(path, ".sceneb"))
+        return loadSceneBinary(path, scene);
+
+    // Prefer an up-to-date compiled copy next to the text file. Modification times only have
+    // second resolution, so the copy must also have been compiled from this very text.
+    std::string compiledPath = path + "b";
+    struct stat textInfo, compiledInfo;
+    std::string text;
+    if (stat(path.c_str(), &textInfo) == 0 && stat(compiledPath.c_str(), &compiledInfo) == 0 &&
+        compiledInfo.st_mtime >= textInfo.st_mtime && readText(path, text))
+    {
+        if (loadSceneBinary(compiledPath, scene) && scene.sourceSize == text.size() &&
+            scene.sourceHash == hashBytes(text.data(), text.size()))
+            return true;
+    }
+
+    if (!loadSceneText(path, scene))
+        return false;
+    saveSceneBinary(compiledPath, scene);
+    return true;
+}
@@ -0,0 +1,73 @@
+#include "../include/seating.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+
+// Eye of someone seated: height above the seat's floor, and a slight downward look so the
+// desk is in view along with the board
+static const float SEAT_EYE_HEIGHT = 1.15f;
+static const float SEAT_PITCH = -10.0f;
+
+void sceneSeatPoses(const Scene& scene, const glm::vec3& origin, const std::string& prefix,
+                    std::vector<ViewPose>& poses)
+{
+    const SceneInstances& inst = scene.instances;
+    for (size_t i = 0; i < inst.size(); i++)
+    {
+        const SceneModel& model = scene.models[inst.model[i]];
+        if (model.seatCount == 0)
+            continue;
+        // Seats along the instance's X axis behind its origin, facing its -Z like the desk
+        float yaw = glm::radians(inst.yaw[i]);
+        glm::vec3 right(std::cos(yaw), 0.0f, -std::sin(yaw));
+        glm::vec3 back(std::sin(yaw), 0.0f, std::cos(yaw));
+        glm::vec3 base = origin + glm::vec3(inst.posX[i], inst.posY[i], inst.posZ[i]);
+        float cameraYaw = glm::degrees(std::atan2(-back.z, -back.x));
+        for (uint32_t k = 0; k < model.seatCount; k++)
+        {
+            float across = ((float)k - (float)(model.seatCount - 1) * 0.5f) * model.seatSpacing;
+            ViewPose pose;
+            std::ostringstream name;
+            name << prefix << model.name << i << "_s" << k;
+            pose.name = name.str();
+            pose.position = base + right * across + back * model.seatOffset + glm::vec3(0.0f, SEAT_EYE_HEIGHT, 0.0f);
+            pose.yaw = cameraYaw;
+            pose.pitch = SEAT_PITCH;
+            poses.push_back(pose);
+        }
+    }
+}
+
+bool loadViewPoses(const std::string& path, std::vector<ViewPose>& poses)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+    {
+        std::cout << "ERROR::SEATING::Could not open pose file " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        std::istringstream iss(line);
+        std::string keyword;
+        if (!(iss >> keyword))
+            continue;
+        ViewPose pose;
+        if (keyword != "pose" ||
+            !(iss >> pose.name >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch))
+        {
+            std::cout << "ERROR::SEATING::" << path << ":" << lineNumber << ": expected pose <name> x y z yaw pitch"
+                      << std::endl;
+            return false;
+        }
+        poses.push_back(pose);
+    }
+    return true;
+}
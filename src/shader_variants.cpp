@@ -0,0 +1,93 @@
+#include "../include/shader_variants.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+ShaderVariants::ShaderVariants(AssetRegistry& registry, const std::string& vertexPath,
+                               const std::string& fragmentPath)
+    : assets(registry), vertex(vertexPath), fragment(fragmentPath), required(0)
+{
+}
+
+ShaderVariants::~ShaderVariants()
+{
+    for (std::map<unsigned int, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+        assets.release(it->second.handle);
+}
+
+Shader& ShaderVariants::get(unsigned int features)
+{
+    features |= required;
+    std::map<unsigned int, Variant>::iterator it = variants.find(features);
+    if (it != variants.end())
+        return *it->second.shader;
+
+    Variant variant;
+    variant.handle = assets.acquireShader(vertex, fragment, features);
+    variant.shader = assets.shader(variant.handle);
+    variants[features] = variant;
+
+    std::cout << "SHADER::Compiled variant " << fragment << " [";
+    for (unsigned int bit = 0; bit < SHADER_FEATURE_COUNT; bit++)
+    {
+        if (features & (1u << bit))
+            std::cout << " " << Shader::featureName(bit);
+    }
+    std::cout << " ]" << std::endl;
+    return *variant.shader;
+}
+
+bool ShaderVariants::precompile(const std::string& manifestPath)
+{
+    std::ifstream file(manifestPath);
+    if (!file.is_open())
+    {
+        std::cout << "ERROR::SHADER::Failed to open variant manifest: " << manifestPath << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream iss(line);
+        std::string directive, vertexPath, fragmentPath;
+        if (!(iss >> directive))
+            continue;
+        if (directive != "variant" || !(iss >> vertexPath >> fragmentPath))
+        {
+            std::cout << "ERROR::SHADER::" << manifestPath << ":" << lineNumber << ": invalid '" << directive
+                      << "' directive" << std::endl;
+            return false;
+        }
+
+        unsigned int features = 0;
+        std::string name;
+        while (iss >> name)
+        {
+            unsigned int bit = Shader::featureFromName(name);
+            if (bit == 0)
+            {
+                std::cout << "ERROR::SHADER::" << manifestPath << ":" << lineNumber << ": unknown feature '"
+                          << name << "'" << std::endl;
+                return false;
+            }
+            features |= bit;
+        }
+
+        if (vertexPath == vertex && fragmentPath == fragment)
+            get(features);
+    }
+    return true;
+}
+
+void ShaderVariants::compiled(std::vector<Shader*>& shaders) const
+{
+    for (std::map<unsigned int, Variant>::const_iterator it = variants.begin(); it != variants.end(); ++it)
+        shaders.push_back(it->second.shader);
+}
@@ -0,0 +1,324 @@
+#include "../include/sightlines.h"
+#include "../include/bvh.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+static const float RAY_OFFSET = 1e-3f;  // Lifts samples off the target so it does not hide itself
+static const float SEAT_RADIUS = 0.2f;  // Heatmap disc, meters
+
+// Front face of a target box: the face across its thinnest axis that looks into the room
+struct TargetFace
+{
+    glm::vec3 corner, edgeU, edgeV;  // Spans the face
+    glm::vec3 normal;
+    unsigned int samplesU, samplesV;
+};
+
+// Append a mesh's triangles, transformed into room space
+static void addTriangles(std::vector<glm::vec3>& triangles, const float* vertices, size_t count,
+                         const glm::mat4& transform)
+{
+    for (size_t i = 0; i + 2 < count; i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const float* v = vertices + (i + k) * 8;
+            triangles.push_back(glm::vec3(transform * glm::vec4(v[0], v[1], v[2], 1.0f)));
+        }
+    }
+}
+
+static TargetFace targetFace(const SceneBoxes& boxes, size_t index, float samplesPerMeter)
+{
+    glm::vec3 center(boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]);
+    glm::vec3 size(boxes.sizeX[index], boxes.sizeY[index], boxes.sizeZ[index]);
+    int thin = size.x <= size.y && size.x <= size.z ? 0 : size.y <= size.z ? 1 : 2;
+    int u = (thin + 1) % 3, v = (thin + 2) % 3;
+
+    // Boards hang on walls, so the face towards the room's centre is the one in front
+    TargetFace face;
+    face.normal = glm::vec3(0.0f);
+    face.normal[thin] = center[thin] > 0.0f ? -1.0f : 1.0f;
+    face.edgeU = glm::vec3(0.0f);
+    face.edgeU[u] = size[u];
+    face.edgeV = glm::vec3(0.0f);
+    face.edgeV[v] = size[v];
+    face.corner = center + face.normal * (size[thin] * 0.5f + RAY_OFFSET) - face.edgeU * 0.5f - face.edgeV * 0.5f;
+    face.samplesU = std::max(1u, (unsigned int)std::ceil(size[u] * samplesPerMeter));
+    face.samplesV = std::max(1u, (unsigned int)std::ceil(size[v] * samplesPerMeter));
+    return face;
+}
+
+bool analyzeSightlines(const Classroom& room, const SightlineSettings& settings, std::vector<SeatSightline>& seats,
+                       SightlineStats& stats)
+{
+    const Scene& scene = room.scene;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<ViewPose> poses;
+    sceneSeatPoses(scene, glm::vec3(0.0f), "", poses);
+    if (poses.empty())
+    {
+        std::cout << "ERROR::SIGHTLINES::Scene has no seats (see the seats option of model)" << std::endl;
+        return false;
+    }
+    std::vector<TargetFace> faces;
+    for (size_t i = 0; i < scene.boxes.size(); i++)
+    {
+        if (scene.materialNames[scene.boxes.material[i]] == settings.targetMaterial)
+            faces.push_back(targetFace(scene.boxes, i, settings.samplesPerMeter));
+    }
+    if (faces.empty())
+    {
+        std::cout << "ERROR::SIGHTLINES::Scene has no boxes of material " << settings.targetMaterial << std::endl;
+        return false;
+    }
+
+    // Everything that can stand in the way: the boxes (fixtures included) and every instance,
+    // placed like updateTransforms() at animation time zero. Floor, ceiling and walls (the
+    // first three shell parts) are left out: no segment between two points inside the room
+    // crosses them, and their room-sized triangles would make every ray visit the whole tree.
+    std::vector<glm::vec3> triangles;
+    for (size_t i = 3; i < room.shellParts.size(); i++)
+    {
+        const MeshPart& part = room.shellParts[i];
+        if (part.vertices == NULL)
+        {
+            std::cout << "ERROR::SIGHTLINES::Room geometry was already released" << std::endl;
+            return false;
+        }
+        addTriangles(triangles, part.vertices, part.count, glm::mat4(1.0f));
+    }
+    const SceneInstances& inst = scene.instances;
+    for (size_t i = 0; i < inst.size(); i++)
+    {
+        const Model& model = *room.models[inst.model[i]];
+        const MeshPart& fallback = room.fallbackParts[inst.model[i]];
+        bool loaded = model.loaded() && !model.vertices.empty();
+        if (!loaded && fallback.vertices == NULL)
+            continue;
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(inst.posX[i], inst.posY[i], inst.posZ[i]));
+        transform = glm::rotate(transform, glm::radians(inst.yaw[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+        if (loaded)
+        {
+            transform = glm::scale(transform, glm::vec3(inst.scale[i]));
+            addTriangles(triangles, &model.vertices[0], model.vertexCount, transform);
+        }
+        else
+            addTriangles(triangles, fallback.vertices, fallback.count, transform);
+    }
+    TriangleBVH bvh;
+    bvh.build(triangles);
+
+    // Where the targets are as a whole, weighted by area
+    glm::vec3 center(0.0f), facing(0.0f);
+    float totalArea = 0.0f;
+    std::vector<float> areas(faces.size());
+    for (size_t f = 0; f < faces.size(); f++)
+    {
+        areas[f] = glm::length(faces[f].edgeU) * glm::length(faces[f].edgeV);
+        center += (faces[f].corner + (faces[f].edgeU + faces[f].edgeV) * 0.5f) * areas[f];
+        facing += faces[f].normal * areas[f];
+        totalArea += areas[f];
+    }
+    center /= totalArea;
+    facing = glm::normalize(facing);
+
+    // Workers take one seat at a time: a seat is a few thousand rays
+    seats.assign(poses.size(), SeatSightline());
+    unsigned int threadCount = settings.threads ? settings.threads : std::thread::hardware_concurrency();
+    threadCount = std::max(1u, threadCount);
+    std::atomic<size_t> nextSeat(0), rayTotal(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threadCount; t++)
+    {
+        workers.push_back(std::thread([&]()
+        {
+            size_t rays = 0;
+            while (true)
+            {
+                size_t s = nextSeat.fetch_add(1);
+                if (s >= poses.size())
+                    break;
+                SeatSightline& result = seats[s];
+                result.seat = poses[s];
+                const glm::vec3 eye = poses[s].position;
+                result.targets.assign(faces.size(), 0.0f);
+                float visibleArea = 0.0f;
+                float minAngle = 0.0f, maxAngle = 0.0f;
+                glm::vec3 toCenter = center - eye;
+                float centerYaw = std::atan2(toCenter.x, -toCenter.z);
+                for (size_t f = 0; f < faces.size(); f++)
+                {
+                    const TargetFace& face = faces[f];
+                    // From behind, none of the face is in view
+                    if (glm::dot(face.normal, eye - face.corner) > 0.0f)
+                    {
+                        unsigned int clear = 0;
+                        for (unsigned int j = 0; j < face.samplesV; j++)
+                        {
+                            for (unsigned int i = 0; i < face.samplesU; i++)
+                            {
+                                glm::vec3 point = face.corner + face.edgeU * ((i + 0.5f) / face.samplesU) +
+                                                  face.edgeV * ((j + 0.5f) / face.samplesV);
+                                if (!bvh.occluded(eye, point - eye, 1.0f))
+                                    clear++;
+                            }
+                        }
+                        rays += (size_t)face.samplesU * face.samplesV;
+                        result.targets[f] = (float)clear / (face.samplesU * face.samplesV);
+                        visibleArea += result.targets[f] * areas[f];
+                    }
+
+                    // Horizontal extent of the face's corners around the direction to the centre
+                    for (int c = 0; c < 4; c++)
+                    {
+                        glm::vec3 corner = face.corner + face.edgeU * (float)(c & 1) + face.edgeV * (float)(c >> 1);
+                        glm::vec3 toCorner = corner - eye;
+                        float a = std::atan2(toCorner.x, -toCorner.z) - centerYaw;
+                        a = std::atan2(std::sin(a), std::cos(a));
+                        minAngle = std::min(minAngle, a);
+                        maxAngle = std::max(maxAngle, a);
+                    }
+                }
+                result.visible = visibleArea / totalArea;
+                result.distance = glm::length(toCenter);
+                result.angle = glm::degrees(std::acos(glm::clamp(glm::dot(facing, -toCenter) / result.distance,
+                                                                 -1.0f, 1.0f)));
+                result.elevation = glm::degrees(std::asin(glm::clamp(toCenter.y / result.distance, -1.0f, 1.0f)));
+                result.span = glm::degrees(maxAngle - minAngle);
+            }
+            rayTotal += rays;
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    stats.seats = seats.size();
+    stats.targets = faces.size();
+    stats.triangles = bvh.triangleCount();
+    stats.rays = rayTotal;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double meanVisible = 0.0;
+    size_t worst = 0, blocked = 0;
+    for (size_t s = 0; s < seats.size(); s++)
+    {
+        meanVisible += seats[s].visible / seats.size();
+        if (seats[s].visible < seats[worst].visible)
+            worst = s;
+        if (seats[s].visible < 0.99f)
+            blocked++;
+    }
+    std::cout << "SIGHTLINES::" << stats.seats << " seats, " << stats.targets << " " << settings.targetMaterial
+              << " faces, " << stats.triangles << " triangles: " << stats.rays << " rays in " << stats.seconds
+              << " s on " << threadCount << " threads, " << stats.rays / std::max(stats.seconds, 1e-6) / 1e6
+              << " Mrays/s" << std::endl;
+    std::cout << "SIGHTLINES::Mean " << meanVisible * 100.0 << "% visible, " << blocked
+              << " seats partly blocked, worst " << seats[worst].seat.name << " at " << seats[worst].visible * 100.0f
+              << "%" << std::endl;
+    return true;
+}
+
+bool writeSightlineCsv(const std::string& path, const std::vector<SeatSightline>& seats)
+{
+    std::ofstream file(path.c_str());
+    if (!file)
+    {
+        std::cout << "ERROR::SIGHTLINES::Could not write " << path << std::endl;
+        return false;
+    }
+    file << "seat,x,y,z,visible";
+    size_t targets = seats.empty() ? 0 : seats[0].targets.size();
+    for (size_t t = 0; t < targets; t++)
+        file << ",target" << t;
+    file << ",distance,angle,elevation,span\n";
+    for (size_t s = 0; s < seats.size(); s++)
+    {
+        const SeatSightline& seat = seats[s];
+        file << seat.seat.name << "," << seat.seat.position.x << "," << seat.seat.position.y << ","
+             << seat.seat.position.z << "," << seat.visible;
+        for (size_t t = 0; t < seat.targets.size(); t++)
+            file << "," << seat.targets[t];
+        file << "," << seat.distance << "," << seat.angle << "," << seat.elevation << "," << seat.span << "\n";
+    }
+    return (bool)file;
+}
+
+// Red through yellow to green
+static glm::vec3 heatColor(float value)
+{
+    value = glm::clamp(value, 0.0f, 1.0f);
+    return value < 0.5f ? glm::vec3(1.0f, value * 2.0f, 0.0f) : glm::vec3(2.0f - value * 2.0f, 1.0f, 0.0f);
+}
+
+static void putPixel(std::vector<unsigned char>& pixels, int width, int x, int y, const glm::vec3& color)
+{
+    unsigned char* p = &pixels[((size_t)y * width + x) * 3];
+    p[0] = (unsigned char)(color.r * 255.0f);
+    p[1] = (unsigned char)(color.g * 255.0f);
+    p[2] = (unsigned char)(color.b * 255.0f);
+}
+
+bool writeSightlineHeatmap(const std::string& path, const Scene& scene, const std::string& targetMaterial,
+                           const std::vector<SeatSightline>& seats, float pixelsPerMeter)
+{
+    const RoomShell& room = scene.room;
+    int width = std::max(1, (int)std::ceil(room.width * pixelsPerMeter));
+    int height = std::max(1, (int)std::ceil(room.length * pixelsPerMeter));
+    std::vector<unsigned char> pixels((size_t)width * height * 3, 48);
+    float left = -room.width * 0.5f, top = -room.length * 0.5f;
+
+    // Box footprints, at least a pixel across (boards are thin)
+    const SceneBoxes& boxes = scene.boxes;
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        float halfX = std::max(boxes.sizeX[i] * 0.5f, 0.5f / pixelsPerMeter);
+        float halfZ = std::max(boxes.sizeZ[i] * 0.5f, 0.5f / pixelsPerMeter);
+        int x0 = std::max(0, (int)std::floor((boxes.centerX[i] - halfX - left) * pixelsPerMeter));
+        int y0 = std::max(0, (int)std::floor((boxes.centerZ[i] - halfZ - top) * pixelsPerMeter));
+        int x1 = std::min(width, (int)std::ceil((boxes.centerX[i] + halfX - left) * pixelsPerMeter));
+        int y1 = std::min(height, (int)std::ceil((boxes.centerZ[i] + halfZ - top) * pixelsPerMeter));
+        bool target = scene.materialNames[boxes.material[i]] == targetMaterial;
+        glm::vec3 color = boxes.emissive[i] ? glm::vec3(0.3f) : target ? glm::vec3(1.0f) : glm::vec3(0.55f);
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = x0; x < x1; x++)
+                putPixel(pixels, width, x, y, color);
+        }
+    }
+
+    // Seats over them
+    float radius = SEAT_RADIUS * pixelsPerMeter;
+    for (size_t s = 0; s < seats.size(); s++)
+    {
+        glm::vec3 color = heatColor(seats[s].visible);
+        float cx = (seats[s].seat.position.x - left) * pixelsPerMeter;
+        float cy = (seats[s].seat.position.z - top) * pixelsPerMeter;
+        for (int y = std::max(0, (int)(cy - radius)); y < std::min(height, (int)(cy + radius) + 1); y++)
+        {
+            for (int x = std::max(0, (int)(cx - radius)); x < std::min(width, (int)(cx + radius) + 1); x++)
+            {
+                float dx = x + 0.5f - cx, dy = y + 0.5f - cy;
+                if (dx * dx + dy * dy <= radius * radius)
+                    putPixel(pixels, width, x, y, color);
+            }
+        }
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::SIGHTLINES::Could not write " << path << std::endl;
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write((const char*)&pixels[0], (std::streamsize)pixels.size());
+    return (bool)file;
+}
@@ -0,0 +1,1072 @@
+#include "../include/soft_raster.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SOFT_RASTER_X86 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+const int SoftwareRasterizer::TILE_SIZE;
+const int SoftwareRasterizer::BLOCK_SIZE;
+
+static const size_t CHUNK_TRIANGLES = 1024;       // At most 6 clipped pieces each, so indices fit 16 bits
+static const size_t MAX_CHUNKS = 0xFFFF;
+static const uint32_t NO_TRIANGLE = 0xFFFFFFFFu;
+static const float GUARD_BAND = 4.0f;             // x and y are clipped at 4x the viewport
+static const float SUBPIXEL_STEPS = 256.0f;       // Vertices snap to 1/256 pixel, like GL rasterizers
+
+// Clip-space vertex: position (4), world position (3), normal (3), lightmap UV (2)
+static const int CLIP_FLOATS = 12;
+static const int CLIP_PLANES = 5;                 // Near, then the four guard-band planes
+static const int MAX_CLIPPED = 3 + CLIP_PLANES;
+
+static RasterPath bestPath()
+{
+#ifdef SOFT_RASTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return RASTER_AVX2;
+#endif
+    return RASTER_SCALAR;
+}
+
+static RasterPath activePath = bestPath();
+
+RasterPath SoftwareRasterizer::path()
+{
+    return activePath;
+}
+
+void SoftwareRasterizer::setPath(RasterPath path)
+{
+    activePath = std::min(path, bestPath());
+}
+
+const char* SoftwareRasterizer::pathName(RasterPath path)
+{
+    return path == RASTER_AVX2 ? "AVX2" : "scalar";
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned int threads)
+    : viewWidth(0), viewHeight(0), tilesX(0), tilesY(0), bufferWidth(0), bufferHeight(0), viewProjection(1.0f),
+      eye(0.0f), frameTime(0.0f), background(0.0f), chunkCount(0), frameNumber(0), jobItems(0), nextItem(0),
+      generation(0), busy(0), quit(false)
+{
+    unsigned int count = threads ? threads : std::thread::hardware_concurrency();
+    count = std::max(1u, count);
+    threadStats.resize(count);
+    for (unsigned int t = 1; t < count; t++)
+        workers.push_back(std::thread(&SoftwareRasterizer::workerLoop, this, t));
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void SoftwareRasterizer::run(size_t items, const std::function<void(size_t, unsigned int)>& work)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = work;
+        jobItems = items;
+        nextItem.store(0);
+        busy = (unsigned int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    this->work(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+}
+
+void SoftwareRasterizer::workerLoop(unsigned int index)
+{
+    unsigned int seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+        work(index);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+void SoftwareRasterizer::work(unsigned int thread)
+{
+    for (size_t item = nextItem.fetch_add(1); item < jobItems; item = nextItem.fetch_add(1))
+        job(item, thread);
+}
+
+void SoftwareRasterizer::resize(int width, int height)
+{
+    viewWidth = std::max(1, width);
+    viewHeight = std::max(1, height);
+    tilesX = (viewWidth + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (viewHeight + TILE_SIZE - 1) / TILE_SIZE;
+    bufferWidth = tilesX * TILE_SIZE;
+    bufferHeight = tilesY * TILE_SIZE;
+    color.assign((size_t)viewWidth * viewHeight * 4, 0);
+    depth.assign((size_t)bufferWidth * bufferHeight, 1.0f);
+    visible.assign((size_t)bufferWidth * bufferHeight, NO_TRIANGLE);
+    blockMaxDepth.assign((size_t)(bufferWidth / BLOCK_SIZE) * (bufferHeight / BLOCK_SIZE), 1.0f);
+    for (size_t i = 0; i < chunks.size(); i++)
+        chunks[i].bins.clear();
+}
+
+void SoftwareRasterizer::begin(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPosition,
+                               const SoftwareLight& light, float time, const glm::vec3& clearColor)
+{
+    if (viewWidth == 0)
+        resize(1, 1);
+    viewProjection = projection * view;
+    eye = viewPosition;
+    frameLight = light;
+    frameTime = time;
+    background = clearColor;
+    draws.clear();
+    frameNumber++;
+}
+
+void SoftwareRasterizer::draw(const SoftwareDraw& draw)
+{
+    if (draw.vertices && draw.count >= 3)
+        draws.push_back(draw);
+}
+
+const glm::vec3* SoftwareRasterizer::decodeLightmap(const LightmapImage* image)
+{
+    if (image->texels.empty())
+        return NULL;
+    for (size_t i = 0; i < lightmaps.size(); i++)
+    {
+        DecodedLightmap& decoded = lightmaps[i].second;
+        if (lightmaps[i].first == image && decoded.layoutHash == image->layoutHash &&
+            decoded.width == image->width && decoded.height == image->height)
+        {
+            decoded.frame = frameNumber;
+            return &decoded.texels[0];
+        }
+    }
+
+    // Decoded once while the room stays in view; RGB9_E5 sampled as the GL texture would be
+    lightmaps.push_back(std::make_pair(image, DecodedLightmap()));
+    DecodedLightmap& decoded = lightmaps.back().second;
+    decoded.layoutHash = image->layoutHash;
+    decoded.width = image->width;
+    decoded.height = image->height;
+    decoded.frame = frameNumber;
+    decoded.texels.resize(image->texels.size());
+    for (size_t i = 0; i < image->texels.size(); i++)
+        decoded.texels[i] = unpackRGB9E5(image->texels[i]);
+    return &decoded.texels[0];
+}
+
+void SoftwareRasterizer::end()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SoftwareRasterStats stats;
+    stats.draws = draws.size();
+
+    // Per-draw state; rooms' lightmaps are decoded the first time they are drawn, and ones not
+    // drawn this frame are dropped (moving the entries keeps the texel arrays in place)
+    drawStates.resize(draws.size());
+    for (size_t i = 0; i < draws.size(); i++)
+    {
+        const SoftwareDraw& d = draws[i];
+        DrawState& state = drawStates[i];
+        state.normalMatrix = glm::mat3(glm::transpose(glm::inverse(d.model)));
+        state.specular = d.material && glm::dot(d.material->specular, d.material->specular) > 0.0f;
+        if (d.material)
+        {
+            state.ambientTerm = frameLight.ambient * d.material->ambient;
+            state.diffuseTerm = frameLight.diffuse * d.material->diffuse;
+            state.specularTerm = frameLight.specular * d.material->specular;
+            state.materialDiffuse = d.material->diffuse;
+            state.shininess = d.material->shininess;
+            bool whole = state.shininess >= 0.0f && state.shininess <= 1024.0f &&
+                         state.shininess == std::floor(state.shininess);
+            state.exponent = whole ? (int)state.shininess : -1;
+        }
+        state.lightmap = d.lightmap && d.lightmapUVs && d.material ? decodeLightmap(d.lightmap) : NULL;
+        state.lightmapWidth = state.lightmap ? d.lightmap->width : 0;
+        state.lightmapHeight = state.lightmap ? d.lightmap->height : 0;
+    }
+    for (size_t i = 0; i < lightmaps.size();)
+    {
+        if (lightmaps[i].second.frame != frameNumber)
+        {
+            if (i + 1 < lightmaps.size())
+                lightmaps[i] = std::move(lightmaps.back());
+            lightmaps.pop_back();
+        }
+        else
+            i++;
+    }
+
+    // Fixed-size chunks of triangles in submission order
+    chunkCount = 0;
+    for (uint32_t d = 0; d < draws.size() && chunkCount < MAX_CHUNKS; d++)
+    {
+        size_t triangles = draws[d].count / 3;
+        stats.triangles += triangles;
+        for (size_t first = 0; first < triangles && chunkCount < MAX_CHUNKS; first += CHUNK_TRIANGLES)
+        {
+            if (chunks.size() <= chunkCount)
+                chunks.push_back(Chunk());
+            Chunk& chunk = chunks[chunkCount++];
+            chunk.draw = d;
+            chunk.first = first;
+            chunk.count = std::min(CHUNK_TRIANGLES, triangles - first);
+        }
+    }
+
+    for (size_t t = 0; t < threadStats.size(); t++)
+        threadStats[t] = SoftwareRasterStats();
+    run(chunkCount, [this](size_t chunk, unsigned int thread)
+    {
+        processChunk(chunks[chunk], threadStats[thread]);
+    });
+    std::chrono::steady_clock::time_point binned = std::chrono::steady_clock::now();
+
+    run((size_t)tilesX * tilesY, [this](size_t tile, unsigned int thread)
+    {
+        rasterTile((int)tile, threadStats[thread]);
+        shadeTile((int)tile, threadStats[thread]);
+    });
+    std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+    for (size_t t = 0; t < threadStats.size(); t++)
+    {
+        const SoftwareRasterStats& s = threadStats[t];
+        stats.setupTriangles += s.setupTriangles;
+        stats.binnedTriangles += s.binnedTriangles;
+        stats.blocks += s.blocks;
+        stats.hizRejected += s.hizRejected;
+        stats.shadedPixels += s.shadedPixels;
+    }
+    stats.geometryMs = std::chrono::duration<double, std::milli>(binned - start).count();
+    stats.rasterMs = std::chrono::duration<double, std::milli>(finished - binned).count();
+    lastStats = stats;
+}
+
+void SoftwareRasterizer::report(std::ostream& out) const
+{
+    const SoftwareRasterStats& s = lastStats;
+    out << "RASTER::Software frame (" << threadCount() << " threads, " << pathName(path()) << "): " << s.draws
+        << " draws, " << s.triangles << " triangles (" << s.setupTriangles << " after clipping, " << s.binnedTriangles
+        << " in tile bins), " << s.hizRejected << " of " << s.blocks << " blocks rejected by depth, "
+        << s.shadedPixels << " pixels shaded; geometry " << s.geometryMs << " ms, raster " << s.rasterMs << " ms"
+        << std::endl;
+}
+
+// Signed distance to a clip plane: near, then the guard band in x and y
+static float clipDistance(const float* v, int plane)
+{
+    switch (plane)
+    {
+    case 0: return v[2] + v[3];
+    case 1: return GUARD_BAND * v[3] - v[0];
+    case 2: return GUARD_BAND * v[3] + v[0];
+    case 3: return GUARD_BAND * v[3] - v[1];
+    default: return GUARD_BAND * v[3] + v[1];
+    }
+}
+
+void SoftwareRasterizer::processChunk(Chunk& chunk, SoftwareRasterStats& stats)
+{
+    size_t tileCount = (size_t)tilesX * tilesY;
+    chunk.triangles.clear();
+    if (chunk.bins.size() != tileCount)
+        chunk.bins.resize(tileCount);
+    for (size_t i = 0; i < tileCount; i++)
+        chunk.bins[i].clear();
+
+    const SoftwareDraw& d = draws[chunk.draw];
+    const DrawState& state = drawStates[chunk.draw];
+
+    // Spin of the ANIMATED vertex shader: radians(mod(spin * time, 360)) about Y
+    float c = 1.0f, s = 0.0f;
+    if (d.spinCount > 0)
+    {
+        float degrees = d.spin * frameTime;
+        degrees -= 360.0f * std::floor(degrees / 360.0f);
+        float angle = glm::radians(degrees);
+        c = std::cos(angle);
+        s = std::sin(angle);
+    }
+    bool baked = state.lightmap != NULL && d.lightmapRect.x > 0.0f;
+
+    float vertex[3][CLIP_FLOATS];
+    for (size_t t = chunk.first; t < chunk.first + chunk.count; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            size_t index = t * 3 + k;
+            const float* in = d.vertices + index * 8;
+            glm::vec3 position(in[0], in[1], in[2]);
+            glm::vec3 normal(in[3], in[4], in[5]);
+            if (index >= d.spinFirst && index < d.spinFirst + d.spinCount)
+            {
+                position = glm::vec3(c * position.x + s * position.z, position.y, -s * position.x + c * position.z);
+                normal = glm::vec3(c * normal.x + s * normal.z, normal.y, -s * normal.x + c * normal.z);
+            }
+            glm::vec4 world = d.model * glm::vec4(position, 1.0f);
+            glm::vec4 clip = viewProjection * world;
+            normal = state.normalMatrix * normal;
+            glm::vec2 lightmapUV(-1.0f);
+            if (baked && d.lightmapUVs[index * 2] >= 0.0f)
+            {
+                lightmapUV = glm::vec2(d.lightmapUVs[index * 2], d.lightmapUVs[index * 2 + 1]) *
+                             glm::vec2(d.lightmapRect.x, d.lightmapRect.y) + glm::vec2(d.lightmapRect.z, d.lightmapRect.w);
+            }
+
+            float* out = vertex[k];
+            out[0] = clip.x; out[1] = clip.y; out[2] = clip.z; out[3] = clip.w;
+            out[4] = world.x; out[5] = world.y; out[6] = world.z;
+            out[7] = normal.x; out[8] = normal.y; out[9] = normal.z;
+            out[10] = lightmapUV.x; out[11] = lightmapUV.y;
+        }
+        clipTriangle(chunk, vertex, stats);
+    }
+}
+
+void SoftwareRasterizer::clipTriangle(Chunk& chunk, const float (*vertex)[CLIP_FLOATS], SoftwareRasterStats& stats)
+{
+    // Outside one frustum plane entirely: nothing to draw
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if ((vertex[0][axis] > vertex[0][3] && vertex[1][axis] > vertex[1][3] && vertex[2][axis] > vertex[2][3]) ||
+            (vertex[0][axis] < -vertex[0][3] && vertex[1][axis] < -vertex[1][3] && vertex[2][axis] < -vertex[2][3]))
+            return;
+    }
+
+    bool inside = true;
+    for (int plane = 0; plane < CLIP_PLANES && inside; plane++)
+    {
+        for (int k = 0; k < 3; k++)
+            inside = inside && clipDistance(vertex[k], plane) >= 0.0f;
+    }
+    if (inside)
+    {
+        setupTriangle(chunk, vertex[0], vertex[1], vertex[2], stats);
+        return;
+    }
+
+    // Sutherland-Hodgman against the near plane and the guard band, then a fan; attributes are
+    // interpolated in clip space, as GL clipping does
+    float polygon[2][MAX_CLIPPED][CLIP_FLOATS];
+    int count = 3;
+    for (int k = 0; k < 3; k++)
+        std::copy(vertex[k], vertex[k] + CLIP_FLOATS, polygon[0][k]);
+    int current = 0;
+    for (int plane = 0; plane < CLIP_PLANES && count >= 3; plane++)
+    {
+        float (*in)[CLIP_FLOATS] = polygon[current];
+        float (*out)[CLIP_FLOATS] = polygon[1 - current];
+        int written = 0;
+        for (int k = 0; k < count; k++)
+        {
+            const float* a = in[k];
+            const float* b = in[(k + 1) % count];
+            float da = clipDistance(a, plane), db = clipDistance(b, plane);
+            if (da >= 0.0f)
+                std::copy(a, a + CLIP_FLOATS, out[written++]);
+            if ((da >= 0.0f) != (db >= 0.0f))
+            {
+                float t = da / (da - db);
+                for (int f = 0; f < CLIP_FLOATS; f++)
+                    out[written][f] = a[f] + (b[f] - a[f]) * t;
+                written++;
+            }
+        }
+        count = written;
+        current = 1 - current;
+    }
+    for (int k = 1; k + 1 < count; k++)
+        setupTriangle(chunk, polygon[current][0], polygon[current][k], polygon[current][k + 1], stats);
+}
+
+void SoftwareRasterizer::setupTriangle(Chunk& chunk, const float* v0, const float* v1, const float* v2,
+                                       SoftwareRasterStats& stats)
+{
+    // Window coordinates, snapped to the subpixel grid so shared vertices land identically
+    const float* v[3] = {v0, v1, v2};
+    float x[3], y[3], z[3], inverseW[3];
+    for (int k = 0; k < 3; k++)
+    {
+        inverseW[k] = 1.0f / v[k][3];
+        x[k] = std::floor((v[k][0] * inverseW[k] * 0.5f + 0.5f) * viewWidth * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+        y[k] = std::floor((v[k][1] * inverseW[k] * 0.5f + 0.5f) * viewHeight * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+        z[k] = v[k][2] * inverseW[k] * 0.5f + 0.5f;
+    }
+
+    // No face culling (GL_CULL_FACE is off): clockwise triangles are flipped
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f)
+        return;
+    int order[3] = {0, 1, 2};
+    if (area < 0.0f)
+    {
+        std::swap(order[1], order[2]);
+        area = -area;
+    }
+
+    // Pixels whose centres the bounding box contains
+    float minX = std::min(x[0], std::min(x[1], x[2])), maxX = std::max(x[0], std::max(x[1], x[2]));
+    float minY = std::min(y[0], std::min(y[1], y[2])), maxY = std::max(y[0], std::max(y[1], y[2]));
+    Triangle t;
+    t.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+    t.maxX = std::min(viewWidth - 1, (int)std::floor(maxX - 0.5f));
+    t.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+    t.maxY = std::min(viewHeight - 1, (int)std::floor(maxY - 0.5f));
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+
+    for (int e = 0; e < 3; e++)
+    {
+        // Edge opposite vertex e, from a to b. The coefficients come from the endpoints in a
+        // fixed order and are negated for the other direction, so both triangles sharing an edge
+        // compute exactly opposite values and no pixel is lost or drawn twice along it.
+        int a = order[(e + 1) % 3], b = order[(e + 2) % 3];
+        bool swapped = x[b] < x[a] || (x[b] == x[a] && y[b] < y[a]);
+        int p = swapped ? b : a, q = swapped ? a : b;
+        float dx = x[q] - x[p], dy = y[q] - y[p];
+        float sign = swapped ? -1.0f : 1.0f;
+        t.edgeA[e] = -dy * sign;
+        t.edgeB[e] = dx * sign;
+        t.edgeC[e] = (dy * x[p] - dx * y[p]) * sign;
+        // Top-left rule (y up, counter-clockwise): pixels exactly on a left or top edge belong
+        // to the triangle
+        float edgeDx = dx * sign, edgeDy = dy * sign;
+        bool topLeft = edgeDy < 0.0f || (edgeDy == 0.0f && edgeDx < 0.0f);
+        t.edgeBias[e] = topLeft ? -FLT_MIN : 0.0f;
+    }
+
+    // Depth is affine in window coordinates
+    int i0 = order[0], i1 = order[1], i2 = order[2];
+    float dx1 = x[i1] - x[i0], dy1 = y[i1] - y[i0], dz1 = z[i1] - z[i0];
+    float dx2 = x[i2] - x[i0], dy2 = y[i2] - y[i0], dz2 = z[i2] - z[i0];
+    t.inverseArea = 1.0f / area;
+    t.depthA = (dz1 * dy2 - dy1 * dz2) * t.inverseArea;
+    t.depthB = (dx1 * dz2 - dz1 * dx2) * t.inverseArea;
+    t.depthC = z[i0] - t.depthA * x[i0] - t.depthB * y[i0];
+    t.minDepth = std::max(0.0f, std::min(z[0], std::min(z[1], z[2])));
+    t.draw = chunk.draw;
+    for (int k = 0; k < 3; k++)
+    {
+        const float* in = v[order[k]];
+        t.inverseW[k] = inverseW[order[k]];
+        t.position[k] = glm::vec3(in[4], in[5], in[6]);
+        t.normal[k] = glm::vec3(in[7], in[8], in[9]);
+        t.lightmapUV[k] = glm::vec2(in[10], in[11]);
+    }
+    stats.setupTriangles++;
+
+    // Bin into every tile the bounding box touches that no edge excludes
+    uint16_t index = (uint16_t)chunk.triangles.size();
+    chunk.triangles.push_back(t);
+    for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+    {
+        for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++)
+        {
+            if (!edgesReach(t, tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE))
+                continue;
+            chunk.bins[ty * tilesX + tx].push_back(index);
+            stats.binnedTriangles++;
+        }
+    }
+}
+
+// Whether some pixel centre of a size x size square may be inside all three edges. Conservative:
+// the corner estimate gets a margin for rounding, the per-pixel test decides.
+bool SoftwareRasterizer::edgesReach(const Triangle& t, int x0, int y0, int size)
+{
+    float left = x0 + 0.5f, right = x0 + size - 0.5f;
+    float bottom = y0 + 0.5f, top = y0 + size - 0.5f;
+    for (int e = 0; e < 3; e++)
+    {
+        float a = t.edgeA[e], b = t.edgeB[e], c = t.edgeC[e];
+        float best = a * (a > 0.0f ? right : left) + (b * (b > 0.0f ? top : bottom) + c);
+        float margin = 1e-4f * (std::fabs(a) * right + std::fabs(b) * top + std::fabs(c));
+        if (best + margin < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// Coverage and depth of one 8x8 block, writing the triangle id where it passes GL_LESS.
+// Returns whether any pixel was written.
+static bool rasterBlockScalar(const float* edgeA, const float* edgeB, const float* edgeC, const float* edgeBias,
+                              float depthA, float depthB, float depthC, uint32_t id, int x0, int y0, int rows,
+                              int columns, float* depth, uint32_t* visible, int stride)
+{
+    bool written = false;
+    for (int r = 0; r < rows; r++)
+    {
+        float py = y0 + r + 0.5f;
+        float row0 = edgeB[0] * py + edgeC[0], row1 = edgeB[1] * py + edgeC[1], row2 = edgeB[2] * py + edgeC[2];
+        float rowDepth = depthB * py + depthC;
+        float* depthRow = depth + (size_t)(y0 + r) * stride + x0;
+        uint32_t* visibleRow = visible + (size_t)(y0 + r) * stride + x0;
+        for (int i = 0; i < columns; i++)
+        {
+            float px = x0 + i + 0.5f;
+            if (edgeA[0] * px + row0 > edgeBias[0] && edgeA[1] * px + row1 > edgeBias[1] &&
+                edgeA[2] * px + row2 > edgeBias[2])
+            {
+                float z = depthA * px + rowDepth;
+                if (z < depthRow[i])
+                {
+                    depthRow[i] = z;
+                    visibleRow[i] = id;
+                    written = true;
+                }
+            }
+        }
+    }
+    return written;
+}
+
+#ifdef SOFT_RASTER_X86
+
+// The same arithmetic as the scalar path, one block row per iteration
+AVX2_TARGET static bool rasterBlockAVX2(const float* edgeA, const float* edgeB, const float* edgeC,
+                                        const float* edgeBias, float depthA, float depthB, float depthC, uint32_t id,
+                                        int x0, int y0, int rows, int columns, float* depth, uint32_t* visible,
+                                        int stride)
+{
+    __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x0 + 0.5f), lanes);
+    __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps((float)columns), _CMP_LT_OQ);
+    __m256 e0 = _mm256_mul_ps(_mm256_set1_ps(edgeA[0]), px);
+    __m256 e1 = _mm256_mul_ps(_mm256_set1_ps(edgeA[1]), px);
+    __m256 e2 = _mm256_mul_ps(_mm256_set1_ps(edgeA[2]), px);
+    __m256 bias0 = _mm256_set1_ps(edgeBias[0]), bias1 = _mm256_set1_ps(edgeBias[1]), bias2 = _mm256_set1_ps(edgeBias[2]);
+    __m256 zx = _mm256_mul_ps(_mm256_set1_ps(depthA), px);
+    __m256 ids = _mm256_castsi256_ps(_mm256_set1_epi32((int)id));
+    bool written = false;
+    for (int r = 0; r < rows; r++)
+    {
+        float py = y0 + r + 0.5f;
+        __m256 inside = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(e0, _mm256_set1_ps(edgeB[0] * py + edgeC[0])),
+                                                           bias0, _CMP_GT_OQ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(e1, _mm256_set1_ps(edgeB[1] * py + edgeC[1])),
+                                                     bias1, _CMP_GT_OQ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(e2, _mm256_set1_ps(edgeB[2] * py + edgeC[2])),
+                                                     bias2, _CMP_GT_OQ));
+        if (_mm256_movemask_ps(inside) == 0)
+            continue;
+        float* depthRow = depth + (size_t)(y0 + r) * stride + x0;
+        float* visibleRow = reinterpret_cast<float*>(visible + (size_t)(y0 + r) * stride + x0);
+        __m256 z = _mm256_add_ps(zx, _mm256_set1_ps(depthB * py + depthC));
+        __m256 stored = _mm256_loadu_ps(depthRow);
+        __m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+        if (_mm256_movemask_ps(pass) == 0)
+            continue;
+        _mm256_storeu_ps(depthRow, _mm256_blendv_ps(stored, z, pass));
+        _mm256_storeu_ps(visibleRow, _mm256_blendv_ps(_mm256_loadu_ps(visibleRow), ids, pass));
+        written = true;
+    }
+    return written;
+}
+
+#endif
+
+void SoftwareRasterizer::rasterTile(int tile, SoftwareRasterStats& stats)
+{
+    int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+    int blocksPerRow = bufferWidth / BLOCK_SIZE;
+    const int TILE_BLOCKS = TILE_SIZE / BLOCK_SIZE;
+
+    // Clear the tile: far depth, no triangle
+    for (int y = tileY; y < tileY + TILE_SIZE; y++)
+    {
+        std::fill(depth.begin() + (size_t)y * bufferWidth + tileX, depth.begin() + (size_t)y * bufferWidth + tileX + TILE_SIZE, 1.0f);
+        std::fill(visible.begin() + (size_t)y * bufferWidth + tileX,
+                  visible.begin() + (size_t)y * bufferWidth + tileX + TILE_SIZE, NO_TRIANGLE);
+    }
+    for (int by = 0; by < TILE_BLOCKS; by++)
+    {
+        for (int bx = 0; bx < TILE_BLOCKS; bx++)
+            blockMaxDepth[(size_t)(tileY / BLOCK_SIZE + by) * blocksPerRow + tileX / BLOCK_SIZE + bx] = 1.0f;
+    }
+
+    // Hierarchical depth: the farthest depth stored in each block and in the whole tile; a
+    // triangle whose nearest point is no nearer cannot pass GL_LESS anywhere in it
+    float tileMaxDepth = 1.0f;
+#ifdef SOFT_RASTER_X86
+    bool simd = activePath == RASTER_AVX2;
+#endif
+    for (size_t c = 0; c < chunkCount; c++)
+    {
+        const Chunk& chunk = chunks[c];
+        const std::vector<uint16_t>& bin = chunk.bins[tile];
+        for (size_t k = 0; k < bin.size(); k++)
+        {
+            const Triangle& t = chunk.triangles[bin[k]];
+            if (t.minDepth >= tileMaxDepth)
+            {
+                stats.hizRejected++;
+                continue;
+            }
+            uint32_t id = (uint32_t)c << 16 | bin[k];
+            int firstX = std::max(t.minX, tileX) / BLOCK_SIZE, lastX = std::min(t.maxX, tileX + TILE_SIZE - 1) / BLOCK_SIZE;
+            int firstY = std::max(t.minY, tileY) / BLOCK_SIZE, lastY = std::min(t.maxY, tileY + TILE_SIZE - 1) / BLOCK_SIZE;
+            bool changed = false;
+            for (int by = firstY; by <= lastY; by++)
+            {
+                for (int bx = firstX; bx <= lastX; bx++)
+                {
+                    int x0 = bx * BLOCK_SIZE, y0 = by * BLOCK_SIZE;
+                    if (!edgesReach(t, x0, y0, BLOCK_SIZE))
+                        continue;
+                    stats.blocks++;
+                    float& blockMax = blockMaxDepth[(size_t)by * blocksPerRow + bx];
+                    if (t.minDepth >= blockMax)
+                    {
+                        stats.hizRejected++;
+                        continue;
+                    }
+                    int rows = std::min(BLOCK_SIZE, viewHeight - y0);
+                    int columns = std::min(BLOCK_SIZE, viewWidth - x0);
+                    bool written;
+#ifdef SOFT_RASTER_X86
+                    if (simd)
+                        written = rasterBlockAVX2(t.edgeA, t.edgeB, t.edgeC, t.edgeBias, t.depthA, t.depthB, t.depthC,
+                                                  id, x0, y0, rows, columns, &depth[0], &visible[0], bufferWidth);
+                    else
+#endif
+                        written = rasterBlockScalar(t.edgeA, t.edgeB, t.edgeC, t.edgeBias, t.depthA, t.depthB,
+                                                    t.depthC, id, x0, y0, rows, columns, &depth[0], &visible[0],
+                                                    bufferWidth);
+                    if (!written)
+                        continue;
+                    float farthest = 0.0f;
+                    for (int y = y0; y < y0 + BLOCK_SIZE; y++)
+                    {
+                        const float* row = &depth[(size_t)y * bufferWidth + x0];
+                        for (int x = 0; x < BLOCK_SIZE; x++)
+                            farthest = std::max(farthest, row[x]);
+                    }
+                    blockMax = farthest;
+                    changed = true;
+                }
+            }
+            if (changed)
+            {
+                tileMaxDepth = 0.0f;
+                for (int by = 0; by < TILE_BLOCKS; by++)
+                {
+                    for (int bx = 0; bx < TILE_BLOCKS; bx++)
+                    {
+                        tileMaxDepth = std::max(tileMaxDepth,
+                            blockMaxDepth[(size_t)(tileY / BLOCK_SIZE + by) * blocksPerRow + tileX / BLOCK_SIZE + bx]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Per-pixel shading: fragment_shader.glsl with albedo 1. The scalar and AVX2 kernels do the same
+// operations in the same order (no fused multiply-adds), so both paths produce the same bytes.
+struct SoftwareShading
+{
+    typedef SoftwareRasterizer::Triangle Triangle;
+    typedef SoftwareRasterizer::DrawState DrawState;
+
+    static void pixel(const SoftwareRasterizer& raster, const Triangle& t, const DrawState& state, int x, int y,
+                      uint8_t* out);
+#ifdef SOFT_RASTER_X86
+    AVX2_TARGET static void span(const SoftwareRasterizer& raster, const Triangle& t, const DrawState& state, int x,
+                                 int y, uint8_t* out);
+#endif
+};
+
+// Clamp to [0, 1] (NaN to 0, like maxps/minps) and round to 8 bits
+static inline uint8_t toUnorm8(float value)
+{
+    value = value > 0.0f ? value : 0.0f;
+    value = value < 1.0f ? value : 1.0f;
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+static inline float interpolate(float a, float b, float c, float w0, float w1, float w2)
+{
+    return (a * w0 + b * w1) + c * w2;
+}
+
+// pow() for the specular term; integral shininess (the usual case) by repeated squaring
+static inline float specularPower(float base, float shininess, int exponent)
+{
+    if (exponent < 0)
+        return std::pow(base, shininess);
+    float result = 1.0f;
+    for (; exponent > 0; exponent >>= 1)
+    {
+        if (exponent & 1)
+            result *= base;
+        base *= base;
+    }
+    return result;
+}
+
+void SoftwareShading::pixel(const SoftwareRasterizer& raster, const Triangle& t, const DrawState& state, int x, int y,
+                            uint8_t* out)
+{
+    // Perspective-correct barycentrics at the pixel centre
+    float px = x + 0.5f, py = y + 0.5f;
+    float l0 = (t.edgeA[0] * px + (t.edgeB[0] * py + t.edgeC[0])) * t.inverseArea;
+    float l1 = (t.edgeA[1] * px + (t.edgeB[1] * py + t.edgeC[1])) * t.inverseArea;
+    float l2 = (1.0f - l0) - l1;
+    float w0 = (l0 > 0.0f ? l0 : 0.0f) * t.inverseW[0];
+    float w1 = (l1 > 0.0f ? l1 : 0.0f) * t.inverseW[1];
+    float w2 = (l2 > 0.0f ? l2 : 0.0f) * t.inverseW[2];
+    float scale = 1.0f / ((w0 + w1) + w2);
+    w0 *= scale;
+    w1 *= scale;
+    w2 *= scale;
+
+    float posX = interpolate(t.position[0].x, t.position[1].x, t.position[2].x, w0, w1, w2);
+    float posY = interpolate(t.position[0].y, t.position[1].y, t.position[2].y, w0, w1, w2);
+    float posZ = interpolate(t.position[0].z, t.position[1].z, t.position[2].z, w0, w1, w2);
+    float nX = interpolate(t.normal[0].x, t.normal[1].x, t.normal[2].x, w0, w1, w2);
+    float nY = interpolate(t.normal[0].y, t.normal[1].y, t.normal[2].y, w0, w1, w2);
+    float nZ = interpolate(t.normal[0].z, t.normal[1].z, t.normal[2].z, w0, w1, w2);
+    float inverseLength = 1.0f / std::sqrt((nX * nX + nY * nY) + nZ * nZ);
+    nX *= inverseLength;
+    nY *= inverseLength;
+    nZ *= inverseLength;
+
+    // ambient + diffuse
+    const glm::vec3& light = raster.frameLight.position;
+    float lX = light.x - posX, lY = light.y - posY, lZ = light.z - posZ;
+    inverseLength = 1.0f / std::sqrt((lX * lX + lY * lY) + lZ * lZ);
+    lX *= inverseLength;
+    lY *= inverseLength;
+    lZ *= inverseLength;
+    float cosine = (nX * lX + nY * lY) + nZ * lZ;
+    float diff = cosine > 0.0f ? cosine : 0.0f;
+    float r = state.ambientTerm.r + state.diffuseTerm.r * diff;
+    float g = state.ambientTerm.g + state.diffuseTerm.g * diff;
+    float b = state.ambientTerm.b + state.diffuseTerm.b * diff;
+
+    // Baked lighting replaces them; GL_LINEAR, clamped to the edge
+    if (state.lightmap)
+    {
+        float lu = interpolate(t.lightmapUV[0].x, t.lightmapUV[1].x, t.lightmapUV[2].x, w0, w1, w2);
+        float lv = interpolate(t.lightmapUV[0].y, t.lightmapUV[1].y, t.lightmapUV[2].y, w0, w1, w2);
+        if (lu >= 0.0f)
+        {
+            float u = lu * (float)state.lightmapWidth - 0.5f, v = lv * (float)state.lightmapHeight - 0.5f;
+            float fu = std::floor(u), fv = std::floor(v);
+            float su = u - fu, sv = v - fv;
+            int maxU = (int)state.lightmapWidth - 1, maxV = (int)state.lightmapHeight - 1;
+            int u0 = std::min(std::max((int)fu, 0), maxU), u1 = std::min(std::max((int)fu + 1, 0), maxU);
+            int v0 = std::min(std::max((int)fv, 0), maxV), v1 = std::min(std::max((int)fv + 1, 0), maxV);
+            const float* t00 = &state.lightmap[v0 * (int)state.lightmapWidth + u0].x;
+            const float* t01 = &state.lightmap[v0 * (int)state.lightmapWidth + u1].x;
+            const float* t10 = &state.lightmap[v1 * (int)state.lightmapWidth + u0].x;
+            const float* t11 = &state.lightmap[v1 * (int)state.lightmapWidth + u1].x;
+            float baked[3];
+            for (int c = 0; c < 3; c++)
+                baked[c] = (t00[c] * (1.0f - su) + t01[c] * su) * (1.0f - sv) + (t10[c] * (1.0f - su) + t11[c] * su) * sv;
+            r = baked[0] * state.materialDiffuse.r;
+            g = baked[1] * state.materialDiffuse.g;
+            b = baked[2] * state.materialDiffuse.b;
+        }
+    }
+
+    // specular
+    if (state.specular)
+    {
+        const glm::vec3& eye = raster.eye;
+        float vX = eye.x - posX, vY = eye.y - posY, vZ = eye.z - posZ;
+        inverseLength = 1.0f / std::sqrt((vX * vX + vY * vY) + vZ * vZ);
+        vX *= inverseLength;
+        vY *= inverseLength;
+        vZ *= inverseLength;
+        float twice = cosine + cosine;
+        float rX = nX * twice - lX, rY = nY * twice - lY, rZ = nZ * twice - lZ;
+        float along = (vX * rX + vY * rY) + vZ * rZ;
+        float spec = specularPower(along > 0.0f ? along : 0.0f, state.shininess, state.exponent);
+        r += state.specularTerm.r * spec;
+        g += state.specularTerm.g * spec;
+        b += state.specularTerm.b * spec;
+    }
+    out[0] = toUnorm8(r);
+    out[1] = toUnorm8(g);
+    out[2] = toUnorm8(b);
+    out[3] = 255;
+}
+
+#ifdef SOFT_RASTER_X86
+
+AVX2_TARGET static inline __m256 interpolate8(float a, float b, float c, __m256 w0, __m256 w1, __m256 w2)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a), w0), _mm256_mul_ps(_mm256_set1_ps(b), w1)),
+                         _mm256_mul_ps(_mm256_set1_ps(c), w2));
+}
+
+AVX2_TARGET static inline __m256 dot8(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+}
+
+AVX2_TARGET static inline void normalize8(__m256& x, __m256& y, __m256& z)
+{
+    __m256 inverseLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(dot8(x, y, z, x, y, z)));
+    x = _mm256_mul_ps(x, inverseLength);
+    y = _mm256_mul_ps(y, inverseLength);
+    z = _mm256_mul_ps(z, inverseLength);
+}
+
+AVX2_TARGET static inline __m256i toUnorm8x8(__m256 value)
+{
+    value = _mm256_max_ps(value, _mm256_setzero_ps());
+    value = _mm256_min_ps(value, _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+// Eight pixels of a row covered by one triangle
+AVX2_TARGET void SoftwareShading::span(const SoftwareRasterizer& raster, const Triangle& t, const DrawState& state,
+                                       int x, int y, uint8_t* out)
+{
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x + 0.5f), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    float py = y + 0.5f;
+    __m256 area = _mm256_set1_ps(t.inverseArea);
+    __m256 l0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.edgeA[0]), px),
+                                            _mm256_set1_ps(t.edgeB[0] * py + t.edgeC[0])), area);
+    __m256 l1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.edgeA[1]), px),
+                                            _mm256_set1_ps(t.edgeB[1] * py + t.edgeC[1])), area);
+    __m256 l2 = _mm256_sub_ps(_mm256_sub_ps(one, l0), l1);
+    __m256 w0 = _mm256_mul_ps(_mm256_max_ps(l0, zero), _mm256_set1_ps(t.inverseW[0]));
+    __m256 w1 = _mm256_mul_ps(_mm256_max_ps(l1, zero), _mm256_set1_ps(t.inverseW[1]));
+    __m256 w2 = _mm256_mul_ps(_mm256_max_ps(l2, zero), _mm256_set1_ps(t.inverseW[2]));
+    __m256 scale = _mm256_div_ps(one, _mm256_add_ps(_mm256_add_ps(w0, w1), w2));
+    w0 = _mm256_mul_ps(w0, scale);
+    w1 = _mm256_mul_ps(w1, scale);
+    w2 = _mm256_mul_ps(w2, scale);
+
+    __m256 posX = interpolate8(t.position[0].x, t.position[1].x, t.position[2].x, w0, w1, w2);
+    __m256 posY = interpolate8(t.position[0].y, t.position[1].y, t.position[2].y, w0, w1, w2);
+    __m256 posZ = interpolate8(t.position[0].z, t.position[1].z, t.position[2].z, w0, w1, w2);
+    __m256 nX = interpolate8(t.normal[0].x, t.normal[1].x, t.normal[2].x, w0, w1, w2);
+    __m256 nY = interpolate8(t.normal[0].y, t.normal[1].y, t.normal[2].y, w0, w1, w2);
+    __m256 nZ = interpolate8(t.normal[0].z, t.normal[1].z, t.normal[2].z, w0, w1, w2);
+    normalize8(nX, nY, nZ);
+
+    const glm::vec3& light = raster.frameLight.position;
+    __m256 lX = _mm256_sub_ps(_mm256_set1_ps(light.x), posX);
+    __m256 lY = _mm256_sub_ps(_mm256_set1_ps(light.y), posY);
+    __m256 lZ = _mm256_sub_ps(_mm256_set1_ps(light.z), posZ);
+    normalize8(lX, lY, lZ);
+    __m256 cosine = dot8(nX, nY, nZ, lX, lY, lZ);
+    __m256 diff = _mm256_max_ps(cosine, zero);
+    __m256 r = _mm256_add_ps(_mm256_set1_ps(state.ambientTerm.r), _mm256_mul_ps(_mm256_set1_ps(state.diffuseTerm.r), diff));
+    __m256 g = _mm256_add_ps(_mm256_set1_ps(state.ambientTerm.g), _mm256_mul_ps(_mm256_set1_ps(state.diffuseTerm.g), diff));
+    __m256 b = _mm256_add_ps(_mm256_set1_ps(state.ambientTerm.b), _mm256_mul_ps(_mm256_set1_ps(state.diffuseTerm.b), diff));
+
+    if (state.lightmap)
+    {
+        __m256 lu = interpolate8(t.lightmapUV[0].x, t.lightmapUV[1].x, t.lightmapUV[2].x, w0, w1, w2);
+        __m256 lv = interpolate8(t.lightmapUV[0].y, t.lightmapUV[1].y, t.lightmapUV[2].y, w0, w1, w2);
+        __m256 baked = _mm256_cmp_ps(lu, zero, _CMP_GE_OQ);
+        if (_mm256_movemask_ps(baked) != 0)
+        {
+            __m256 half = _mm256_set1_ps(0.5f);
+            __m256 u = _mm256_sub_ps(_mm256_mul_ps(lu, _mm256_set1_ps((float)state.lightmapWidth)), half);
+            __m256 v = _mm256_sub_ps(_mm256_mul_ps(lv, _mm256_set1_ps((float)state.lightmapHeight)), half);
+            __m256 fu = _mm256_floor_ps(u), fv = _mm256_floor_ps(v);
+            __m256 su = _mm256_sub_ps(u, fu), sv = _mm256_sub_ps(v, fv);
+            __m256 ru = _mm256_sub_ps(one, su), rv = _mm256_sub_ps(one, sv);
+            __m256i iu = _mm256_cvttps_epi32(fu), iv = _mm256_cvttps_epi32(fv);
+            __m256i zeroI = _mm256_setzero_si256(), oneI = _mm256_set1_epi32(1);
+            __m256i maxU = _mm256_set1_epi32((int)state.lightmapWidth - 1);
+            __m256i maxV = _mm256_set1_epi32((int)state.lightmapHeight - 1);
+            __m256i u0 = _mm256_min_epi32(_mm256_max_epi32(iu, zeroI), maxU);
+            __m256i u1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iu, oneI), zeroI), maxU);
+            __m256i v0 = _mm256_min_epi32(_mm256_max_epi32(iv, zeroI), maxV);
+            __m256i v1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iv, oneI), zeroI), maxV);
+            // Texels are 3 floats
+            __m256i width = _mm256_set1_epi32((int)state.lightmapWidth), three = _mm256_set1_epi32(3);
+            __m256i row0 = _mm256_mullo_epi32(v0, width), row1 = _mm256_mullo_epi32(v1, width);
+            __m256i i00 = _mm256_mullo_epi32(_mm256_add_epi32(row0, u0), three);
+            __m256i i01 = _mm256_mullo_epi32(_mm256_add_epi32(row0, u1), three);
+            __m256i i10 = _mm256_mullo_epi32(_mm256_add_epi32(row1, u0), three);
+            __m256i i11 = _mm256_mullo_epi32(_mm256_add_epi32(row1, u1), three);
+            const float* texels = &state.lightmap[0].x;
+            __m256 channels[3];
+            for (int c = 0; c < 3; c++)
+            {
+                __m256 t00 = _mm256_i32gather_ps(texels + c, i00, 4), t01 = _mm256_i32gather_ps(texels + c, i01, 4);
+                __m256 t10 = _mm256_i32gather_ps(texels + c, i10, 4), t11 = _mm256_i32gather_ps(texels + c, i11, 4);
+                __m256 top = _mm256_add_ps(_mm256_mul_ps(t00, ru), _mm256_mul_ps(t01, su));
+                __m256 bottom = _mm256_add_ps(_mm256_mul_ps(t10, ru), _mm256_mul_ps(t11, su));
+                channels[c] = _mm256_add_ps(_mm256_mul_ps(top, rv), _mm256_mul_ps(bottom, sv));
+            }
+            r = _mm256_blendv_ps(r, _mm256_mul_ps(channels[0], _mm256_set1_ps(state.materialDiffuse.r)), baked);
+            g = _mm256_blendv_ps(g, _mm256_mul_ps(channels[1], _mm256_set1_ps(state.materialDiffuse.g)), baked);
+            b = _mm256_blendv_ps(b, _mm256_mul_ps(channels[2], _mm256_set1_ps(state.materialDiffuse.b)), baked);
+        }
+    }
+
+    if (state.specular)
+    {
+        const glm::vec3& eye = raster.eye;
+        __m256 vX = _mm256_sub_ps(_mm256_set1_ps(eye.x), posX);
+        __m256 vY = _mm256_sub_ps(_mm256_set1_ps(eye.y), posY);
+        __m256 vZ = _mm256_sub_ps(_mm256_set1_ps(eye.z), posZ);
+        normalize8(vX, vY, vZ);
+        __m256 twice = _mm256_add_ps(cosine, cosine);
+        __m256 rX = _mm256_sub_ps(_mm256_mul_ps(nX, twice), lX);
+        __m256 rY = _mm256_sub_ps(_mm256_mul_ps(nY, twice), lY);
+        __m256 rZ = _mm256_sub_ps(_mm256_mul_ps(nZ, twice), lZ);
+        __m256 base = _mm256_max_ps(dot8(vX, vY, vZ, rX, rY, rZ), zero);
+        __m256 spec;
+        if (state.exponent < 0)
+        {
+            float lanes[8];
+            _mm256_storeu_ps(lanes, base);
+            for (int i = 0; i < 8; i++)
+                lanes[i] = std::pow(lanes[i], state.shininess);
+            spec = _mm256_loadu_ps(lanes);
+        }
+        else
+        {
+            spec = one;
+            for (int exponent = state.exponent; exponent > 0; exponent >>= 1)
+            {
+                if (exponent & 1)
+                    spec = _mm256_mul_ps(spec, base);
+                base = _mm256_mul_ps(base, base);
+            }
+        }
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(state.specularTerm.r), spec));
+        g = _mm256_add_ps(g, _mm256_mul_ps(_mm256_set1_ps(state.specularTerm.g), spec));
+        b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_set1_ps(state.specularTerm.b), spec));
+    }
+
+    __m256i rgba = _mm256_or_si256(toUnorm8x8(r), _mm256_slli_epi32(toUnorm8x8(g), 8));
+    rgba = _mm256_or_si256(rgba, _mm256_slli_epi32(toUnorm8x8(b), 16));
+    rgba = _mm256_or_si256(rgba, _mm256_set1_epi32((int)0xFF000000u));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), rgba);
+}
+
+#endif
+
+void SoftwareRasterizer::shadeTile(int tile, SoftwareRasterStats& stats)
+{
+    int tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+    int endX = std::min(tileX + TILE_SIZE, viewWidth), endY = std::min(tileY + TILE_SIZE, viewHeight);
+    uint8_t clear[4] = {toUnorm8(background.r), toUnorm8(background.g), toUnorm8(background.b), 255};
+#ifdef SOFT_RASTER_X86
+    bool simd = activePath == RASTER_AVX2;
+#endif
+
+    for (int y = tileY; y < endY; y++)
+    {
+        const uint32_t* ids = &visible[(size_t)y * bufferWidth];
+        for (int x = tileX; x < endX; x += BLOCK_SIZE)
+        {
+            uint8_t* out = &color[((size_t)y * viewWidth + x) * 4];
+#ifdef SOFT_RASTER_X86
+            // Runs of one lit triangle (most of the image) eight pixels at a time
+            uint32_t id = ids[x];
+            if (simd && x + BLOCK_SIZE <= endX && id != NO_TRIANGLE && draws[chunks[id >> 16].triangles[id & 0xFFFF].draw].material &&
+                std::count(ids + x, ids + x + BLOCK_SIZE, id) == BLOCK_SIZE)
+            {
+                const Triangle& t = chunks[id >> 16].triangles[id & 0xFFFF];
+                SoftwareShading::span(*this, t, drawStates[t.draw], x, y, out);
+                stats.shadedPixels += BLOCK_SIZE;
+                continue;
+            }
+#endif
+            for (int i = x; i < std::min(x + BLOCK_SIZE, endX); i++, out += 4)
+            {
+                uint32_t id = ids[i];
+                if (id == NO_TRIANGLE)
+                {
+                    std::copy(clear, clear + 4, out);
+                    continue;
+                }
+                stats.shadedPixels++;
+                const Triangle& t = chunks[id >> 16].triangles[id & 0xFFFF];
+                if (!draws[t.draw].material)
+                {
+                    // Light fixtures: the EMISSIVE variant
+                    out[0] = out[1] = out[2] = out[3] = 255;
+                    continue;
+                }
+                SoftwareShading::pixel(*this, t, drawStates[t.draw], i, y, out);
+            }
+        }
+    }
+}
+
+SoftwarePresenter::SoftwarePresenter() : texture(0), framebuffer(0), textureWidth(0), textureHeight(0)
+{
+}
+
+SoftwarePresenter::~SoftwarePresenter()
+{
+    if (texture != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+    }
+}
+
+void SoftwarePresenter::present(const SoftwareRasterizer& raster)
+{
+    if (texture == 0)
+    {
+        glGenTextures(1, &texture);
+        glGenFramebuffers(1, &framebuffer);
+    }
+    int target;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (textureWidth != raster.width() || textureHeight != raster.height())
+    {
+        textureWidth = raster.width();
+        textureHeight = raster.height();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     &raster.pixels()[0]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                        &raster.pixels()[0]);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, textureWidth, textureHeight, 0, 0, textureWidth, textureHeight, GL_COLOR_BUFFER_BIT,
+                      GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (unsigned int)target);
+}
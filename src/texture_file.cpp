@@ -0,0 +1,458 @@
+#include "../include/texture_file.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// DDS: "DDS " magic, 124-byte header, optional 20-byte DX10 extension
+static const uint32_t DDS_MAGIC = 0x20534444;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+
+static uint32_t fourCC(const char* code)
+{
+    return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+}
+
+// KTX2 file identifier
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct FormatInfo
+{
+    GLenum internalFormat;
+    uint32_t dxgi;      // DXGI_FORMAT (DDS DX10 header)
+    uint32_t vkFormat;  // VkFormat (KTX2)
+    unsigned int blockBytes;  // Bytes per 4x4 block; 0 for RGBA8
+    const char* name;
+};
+
+static const FormatInfo FORMATS[] =
+{
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 71, 133, 8, "BC1" },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 72, 134, 8, "BC1 sRGB" },
+    { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 74, 135, 16, "BC2" },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 75, 136, 16, "BC2 sRGB" },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 77, 137, 16, "BC3" },
+    { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 78, 138, 16, "BC3 sRGB" },
+    { GL_COMPRESSED_RED_RGTC1, 80, 139, 8, "BC4" },
+    { GL_COMPRESSED_RG_RGTC2, 83, 141, 16, "BC5" },
+    { GL_COMPRESSED_RGBA_BPTC_UNORM, 98, 145, 16, "BC7" },
+    { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 99, 146, 16, "BC7 sRGB" },
+    { GL_RGBA8, 28, 37, 0, "RGBA8" },
+    { GL_SRGB8_ALPHA8, 29, 43, 0, "RGBA8 sRGB" }
+};
+static const size_t FORMAT_COUNT = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+static const FormatInfo* findFormat(GLenum internalFormat)
+{
+    for (size_t i = 0; i < FORMAT_COUNT; i++)
+    {
+        if (FORMATS[i].internalFormat == internalFormat)
+            return &FORMATS[i];
+    }
+    return NULL;
+}
+
+size_t textureLevelSize(GLenum internalFormat, unsigned int width, unsigned int height)
+{
+    const FormatInfo* info = findFormat(internalFormat);
+    if (info == NULL)
+        return 0;
+    if (info->blockBytes == 0)
+        return (size_t)width * height * 4;
+    return (size_t)std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * info->blockBytes;
+}
+
+const char* textureFormatName(GLenum internalFormat)
+{
+    const FormatInfo* info = findFormat(internalFormat);
+    return info ? info->name : "unknown";
+}
+
+bool textureFormatSupported(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return GLEW_EXT_texture_compression_s3tc;
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+    default:
+        // RGTC and RGBA8 are core in 3.0
+        return findFormat(internalFormat) != NULL;
+    }
+}
+
+size_t TextureFile::bytes() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < levels.size(); i++)
+        total += levels[i].size;
+    return total;
+}
+
+// Levels of a full mip chain down to 1x1, floor(log2(max(width, height))) + 1; no file may hold
+// more, so counts read from headers are checked against it before any level is listed
+static unsigned int fullChainLevels(unsigned int width, unsigned int height)
+{
+    unsigned int levels = 1;
+    for (unsigned int size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+// Fill levels for a chain stored level 0 first, tightly packed from offset
+static void packedLevels(TextureFile& file, unsigned int count, uint64_t offset)
+{
+    unsigned int w = file.width, h = file.height;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        TextureLevel level;
+        level.width = w;
+        level.height = h;
+        level.offset = offset;
+        level.size = textureLevelSize(file.internalFormat, w, h);
+        file.levels.push_back(level);
+        offset += level.size;
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+}
+
+static bool readDDS(std::ifstream& in, TextureFile& file, std::string& error)
+{
+    uint32_t header[31];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != 124)
+    {
+        error = "bad DDS header";
+        return false;
+    }
+    file.height = header[2];
+    file.width = header[3];
+    if (file.width > MAX_TEXTURE_DIMENSION || file.height > MAX_TEXTURE_DIMENSION)
+    {
+        error = "larger than the maximum texture size";
+        return false;
+    }
+    // The mip count field only counts when its flag says so
+    unsigned int mipCount = (header[1] & DDSD_MIPMAPCOUNT) ? std::max(1u, header[6]) : 1;
+    if (mipCount > fullChainLevels(file.width, file.height))
+    {
+        error = "more mip levels than a full chain";
+        return false;
+    }
+    const uint32_t* pixelFormat = &header[18];  // size, flags, fourCC, bit count, masks
+    uint32_t caps2 = header[27];
+    uint64_t dataOffset = 4 + 124;
+
+    const FormatInfo* info = NULL;
+    if (pixelFormat[1] & DDPF_FOURCC)
+    {
+        uint32_t code = pixelFormat[2];
+        uint32_t dxgi = 0;
+        if (code == fourCC("DX10"))
+        {
+            uint32_t dx10[5];
+            if (!in.read(reinterpret_cast<char*>(dx10), sizeof(dx10)))
+            {
+                error = "truncated DX10 header";
+                return false;
+            }
+            if (dx10[1] != 3 || dx10[3] > 1)  // TEXTURE2D, single image
+            {
+                error = "only single 2D textures are supported";
+                return false;
+            }
+            dxgi = dx10[0];
+            dataOffset += sizeof(dx10);
+        }
+        else if (code == fourCC("DXT1")) dxgi = 71;
+        else if (code == fourCC("DXT3")) dxgi = 74;
+        else if (code == fourCC("DXT5")) dxgi = 77;
+        else if (code == fourCC("ATI1") || code == fourCC("BC4U")) dxgi = 80;
+        else if (code == fourCC("ATI2") || code == fourCC("BC5U")) dxgi = 83;
+        for (size_t i = 0; i < FORMAT_COUNT && info == NULL; i++)
+        {
+            if (FORMATS[i].dxgi == dxgi)
+                info = &FORMATS[i];
+        }
+    }
+    else if ((pixelFormat[1] & DDPF_RGB) && pixelFormat[3] == 32 && pixelFormat[4] == 0x000000FF &&
+             pixelFormat[5] == 0x0000FF00 && pixelFormat[6] == 0x00FF0000)
+    {
+        info = findFormat(GL_RGBA8);
+    }
+    if (info == NULL)
+    {
+        error = "unsupported pixel format";
+        return false;
+    }
+    if (caps2 & 0x200)  // DDSCAPS2_CUBEMAP
+    {
+        error = "cube maps are not supported";
+        return false;
+    }
+
+    file.internalFormat = info->internalFormat;
+    file.compressed = info->blockBytes != 0;
+    packedLevels(file, mipCount, dataOffset);
+    return true;
+}
+
+static bool readKTX2(std::ifstream& in, TextureFile& file, std::string& error)
+{
+    // vkFormat, typeSize, width, height, depth, layers, faces, levels, supercompression
+    uint32_t header[9];
+    uint32_t index[4];
+    uint64_t superIndex[2];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        !in.read(reinterpret_cast<char*>(index), sizeof(index)) ||
+        !in.read(reinterpret_cast<char*>(superIndex), sizeof(superIndex)))
+    {
+        error = "truncated KTX2 header";
+        return false;
+    }
+    if (header[4] > 1 || header[5] > 1 || header[6] != 1)
+    {
+        error = "only single 2D textures are supported";
+        return false;
+    }
+    if (header[8] != 0)
+    {
+        error = "supercompressed (Basis/zstd) KTX2 is not supported";
+        return false;
+    }
+    const FormatInfo* info = NULL;
+    for (size_t i = 0; i < FORMAT_COUNT && info == NULL; i++)
+    {
+        if (FORMATS[i].vkFormat == header[0])
+            info = &FORMATS[i];
+    }
+    if (info == NULL)
+    {
+        error = "unsupported vkFormat";
+        return false;
+    }
+
+    file.internalFormat = info->internalFormat;
+    file.compressed = info->blockBytes != 0;
+    file.width = header[2];
+    file.height = header[3];
+    if (file.width > MAX_TEXTURE_DIMENSION || file.height > MAX_TEXTURE_DIMENSION)
+    {
+        error = "larger than the maximum texture size";
+        return false;
+    }
+    unsigned int levelCount = std::max(1u, header[7]);
+    if (levelCount > fullChainLevels(file.width, file.height))
+    {
+        error = "more mip levels than a full chain";
+        return false;
+    }
+    unsigned int w = file.width, h = file.height;
+    for (unsigned int i = 0; i < levelCount; i++)
+    {
+        uint64_t entry[3];  // offset, length, uncompressed length
+        if (!in.read(reinterpret_cast<char*>(entry), sizeof(entry)))
+        {
+            error = "truncated level index";
+            return false;
+        }
+        TextureLevel level;
+        level.width = w;
+        level.height = h;
+        level.offset = entry[0];
+        level.size = (size_t)entry[1];
+        if (level.size != textureLevelSize(file.internalFormat, w, h))
+        {
+            error = "level size does not match its dimensions";
+            return false;
+        }
+        file.levels.push_back(level);
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+    return true;
+}
+
+bool readTextureHeader(const std::string& path, TextureFile& file)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cout << "ERROR::TEXTURE::Failed to open texture: " << path << std::endl;
+        return false;
+    }
+
+    file = TextureFile();
+    file.path = path;
+    unsigned char magic[12];
+    std::string error;
+    bool ok = false;
+    if (!in.read(reinterpret_cast<char*>(magic), 4))
+        error = "file too short";
+    else if (std::memcmp(magic, &DDS_MAGIC, 4) == 0)
+        ok = readDDS(in, file, error);
+    else if (in.read(reinterpret_cast<char*>(magic) + 4, 8) && std::memcmp(magic, KTX2_IDENTIFIER, 12) == 0)
+        ok = readKTX2(in, file, error);
+    else
+        error = "not a DDS or KTX2 file";
+
+    if (ok && (file.width == 0 || file.height == 0 || file.levels.empty()))
+    {
+        ok = false;
+        error = "empty image";
+    }
+    if (ok)
+    {
+        // The whole chain must be inside the file (KTX2 offsets come from the file: no overflow)
+        in.clear();
+        in.seekg(0, std::ios::end);
+        uint64_t fileSize = (uint64_t)in.tellg();
+        for (size_t i = 0; ok && i < file.levels.size(); i++)
+            ok = file.levels[i].offset <= fileSize && file.levels[i].size <= fileSize - file.levels[i].offset;
+        if (!ok)
+            error = "truncated mip chain";
+    }
+    if (!ok)
+    {
+        std::cout << "ERROR::TEXTURE::" << path << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool readTextureLevel(const TextureFile& file, size_t level, std::vector<unsigned char>& data)
+{
+    if (level >= file.levels.size())
+        return false;
+    std::ifstream in(file.path.c_str(), std::ios::binary);
+    const TextureLevel& l = file.levels[level];
+    data.resize(l.size);
+    if (!in.is_open() || !in.seekg((std::streamoff)l.offset) || !in.read(reinterpret_cast<char*>(&data[0]), l.size))
+    {
+        std::cout << "ERROR::TEXTURE::Failed to read level " << level << " of " << file.path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Checker generator
+
+static uint16_t rgb565(float grey)
+{
+    unsigned int r = (unsigned int)(grey * 31.0f + 0.5f);
+    unsigned int g = (unsigned int)(grey * 63.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | r);
+}
+
+static void checkerLevel(unsigned int size, unsigned int tiles, unsigned int level, std::vector<unsigned char>& out)
+{
+    // Average of the level-0 pixels each block covers, as solid BC1 blocks
+    const float light = 0.95f, dark = 0.7f;
+    unsigned int levelSize = std::max(1u, size >> level);
+    unsigned int blocks = std::max(1u, (levelSize + 3) / 4);
+    unsigned int footprint = std::min(size, (size / levelSize) * 4);  // Level-0 pixels per block side
+    unsigned int tileSize = std::max(1u, size / tiles);
+    out.resize((size_t)blocks * blocks * 8);
+    for (unsigned int by = 0; by < blocks; by++)
+    {
+        for (unsigned int bx = 0; bx < blocks; bx++)
+        {
+            unsigned int lightCount = 0;
+            for (unsigned int y = by * footprint; y < (by + 1) * footprint; y++)
+                for (unsigned int x = bx * footprint; x < (bx + 1) * footprint; x++)
+                    lightCount += ((x / tileSize + y / tileSize) & 1) == 0;
+            float fraction = (float)lightCount / (footprint * footprint);
+            uint16_t color = rgb565(dark + (light - dark) * fraction);
+            unsigned char* block = &out[((size_t)by * blocks + bx) * 8];
+            block[0] = block[2] = (unsigned char)(color & 0xFF);
+            block[1] = block[3] = (unsigned char)(color >> 8);
+            block[4] = block[5] = block[6] = block[7] = 0;  // Every texel uses color 0
+        }
+    }
+}
+
+bool writeCheckerTexture(const std::string& path, unsigned int size, unsigned int tiles)
+{
+    if (size < 4 || size > MAX_TEXTURE_DIMENSION || (size & (size - 1)) != 0 || tiles == 0)
+    {
+        std::cout << "ERROR::TEXTURE::Checker size must be a power of two from 4 to " << MAX_TEXTURE_DIMENSION
+                  << ", with at least one tile" << std::endl;
+        return false;
+    }
+    unsigned int levels = 1;
+    while ((size >> (levels - 1)) > 1)
+        levels++;
+    std::vector<std::vector<unsigned char> > data(levels);
+    for (unsigned int i = 0; i < levels; i++)
+        checkerLevel(size, tiles, i, data[i]);
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cout << "ERROR::TEXTURE::Failed to write texture: " << path << std::endl;
+        return false;
+    }
+    bool ktx2 = path.size() > 5 && path.compare(path.size() - 5, 5, ".ktx2") == 0;
+    if (ktx2)
+    {
+        // Basic data format descriptor: one BC1 (with alpha) sample over a 4x4 block of 8 bytes
+        uint32_t dfd[11] = { 44, 0, 2 | (40u << 16), 128 | (1u << 8) | (1u << 16), 3 | (3u << 8), 8, 0,
+                             63u << 16, 0, 0, 0xFFFFFFFFu };
+        uint32_t dfdOffset = (uint32_t)(sizeof(KTX2_IDENTIFIER) + 9 * 4 + 4 * 4 + 2 * 8 + levels * 24);
+        uint32_t header[9] = { 133, 1, size, size, 0, 0, 1, levels, 0 };
+        uint32_t index[4] = { dfdOffset, sizeof(dfd), 0, 0 };  // No key/value data
+        uint64_t superIndex[2] = { 0, 0 };
+        out.write(reinterpret_cast<const char*>(KTX2_IDENTIFIER), sizeof(KTX2_IDENTIFIER));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(index), sizeof(index));
+        out.write(reinterpret_cast<const char*>(superIndex), sizeof(superIndex));
+        // KTX2 stores the smallest level first, each aligned to the 8-byte block size
+        uint64_t offset = (dfdOffset + sizeof(dfd) + 7) & ~(uint64_t)7;
+        std::vector<uint64_t> offsets(levels);
+        for (unsigned int i = levels; i-- > 0;)
+        {
+            offsets[i] = offset;
+            offset += data[i].size();
+        }
+        for (unsigned int i = 0; i < levels; i++)
+        {
+            uint64_t entry[3] = { offsets[i], data[i].size(), data[i].size() };
+            out.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+        }
+        out.write(reinterpret_cast<const char*>(dfd), sizeof(dfd));
+        static const char padding[8] = { 0 };
+        out.write(padding, (std::streamsize)(offsets[levels - 1] - dfdOffset - sizeof(dfd)));
+        for (unsigned int i = levels; i-- > 0;)
+            out.write(reinterpret_cast<const char*>(&data[i][0]), data[i].size());
+    }
+    else
+    {
+        uint32_t header[31];
+        std::memset(header, 0, sizeof(header));
+        header[0] = 124;
+        header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;  // caps, height, width, pixel format, mips, linear size
+        header[2] = size;
+        header[3] = size;
+        header[4] = (uint32_t)data[0].size();
+        header[6] = levels;
+        header[18] = 32;
+        header[19] = DDPF_FOURCC;
+        header[20] = fourCC("DXT1");
+        header[26] = 0x1000 | 0x8 | 0x400000;  // texture, complex, mipmap
+        out.write(reinterpret_cast<const char*>(&DDS_MAGIC), 4);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (unsigned int i = 0; i < levels; i++)
+            out.write(reinterpret_cast<const char*>(&data[i][0]), data[i].size());
+    }
+    return (bool)out;
+}
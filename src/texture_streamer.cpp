@@ -0,0 +1,472 @@
+#include "../include/texture_streamer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+// Levels up to this size are uploaded synchronously by acquire()
+static const unsigned int MIP_TAIL_SIZE = 64;
+
+TextureStreamer::TextureStreamer()
+    : memoryBudget(64u << 20), uploadBytesPerFrame(512u << 10), nextSerial(1), ringNext(0), quit(false)
+{
+    for (size_t i = 0; i < 3; i++)
+    {
+        ring[i].buffer = 0;
+        ring[i].size = 0;
+        ring[i].fence = 0;
+    }
+    reader = std::thread(&TextureStreamer::readerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_one();
+    reader.join();
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (ring[i].fence != 0) glDeleteSync(ring[i].fence);
+        if (ring[i].buffer != 0) glDeleteBuffers(1, &ring[i].buffer);
+    }
+    for (size_t i = 0; i < pools.size(); i++)
+    {
+        if (pools[i].texture != 0) glDeleteTextures(1, &pools[i].texture);
+    }
+}
+
+void TextureStreamer::readerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return quit || !requests.empty(); });
+        if (quit)
+            return;
+        Read read = requests.front();
+        requests.pop_front();
+
+        lock.unlock();
+        read.ok = readTextureLevel(read.file, read.level, read.data);
+        lock.lock();
+        finished.push_back(read);
+    }
+}
+
+size_t TextureStreamer::levelBytes(const Pool& pool, unsigned int level) const
+{
+    return textureLevelSize(pool.format, std::max(1u, pool.width >> level), std::max(1u, pool.height >> level)) *
+           POOL_LAYERS;
+}
+
+size_t TextureStreamer::poolBytes(const Pool& pool) const
+{
+    size_t bytes = 0;
+    for (unsigned int l = 0; l < pool.allocated.size(); l++)
+        bytes += pool.allocated[l] ? levelBytes(pool, l) : 0;
+    return bytes;
+}
+
+size_t TextureStreamer::residentBytes() const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < pools.size(); i++)
+        bytes += poolBytes(pools[i]);
+    return bytes;
+}
+
+unsigned int TextureStreamer::texture(const TextureRef& ref) const
+{
+    return ref.valid() ? pools[ref.pool].texture : 0;
+}
+
+int TextureStreamer::findPool(const TextureFile& file)
+{
+    for (size_t i = 0; i < pools.size(); i++)
+    {
+        const Pool& pool = pools[i];
+        if (pool.texture == 0 || pool.format != file.internalFormat || pool.width != file.width ||
+            pool.height != file.height || pool.levelCount != file.levels.size())
+            continue;
+        for (size_t l = 0; l < pool.layers.size(); l++)
+        {
+            if (pool.layers[l].refs == 0)
+                return (int)i;
+        }
+    }
+    return -1;
+}
+
+void TextureStreamer::allocateLevel(Pool& pool, unsigned int level)
+{
+    if (pool.allocated[level])
+        return;
+    unsigned int w = std::max(1u, pool.width >> level), h = std::max(1u, pool.height >> level);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pool.texture);
+    if (pool.format == GL_RGBA8 || pool.format == GL_SRGB8_ALPHA8)
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, pool.format, w, h, POOL_LAYERS, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    else
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, pool.format, w, h, POOL_LAYERS, 0,
+                               (GLsizei)levelBytes(pool, level), NULL);
+    pool.allocated[level] = true;
+}
+
+void TextureStreamer::freeLevel(Pool& pool, unsigned int level)
+{
+    // A zero-sized image releases the level's storage; levels below the base level are not
+    // part of texture completeness, so the array stays usable
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pool.texture);
+    if (pool.format == GL_RGBA8 || pool.format == GL_SRGB8_ALPHA8)
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, pool.format, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    else
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, pool.format, 0, 0, 0, 0, 0, NULL);
+    pool.allocated[level] = false;
+    for (size_t l = 0; l < pool.layers.size(); l++)
+    {
+        if (!pool.layers[l].uploaded.empty())
+            pool.layers[l].uploaded[level] = false;
+    }
+}
+
+void TextureStreamer::uploadLevel(Pool& pool, int layer, unsigned int level, const unsigned char* data, size_t size)
+{
+    unsigned int w = std::max(1u, pool.width >> level), h = std::max(1u, pool.height >> level);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pool.texture);
+    if (pool.format == GL_RGBA8 || pool.format == GL_SRGB8_ALPHA8)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    else
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, pool.format, (GLsizei)size, data);
+}
+
+bool TextureStreamer::uploadThroughRing(Pool& pool, int layer, unsigned int level, const std::vector<unsigned char>& data)
+{
+    // Never wait: a buffer the GPU may still be reading from means try again next frame
+    RingSlot& slot = ring[ringNext];
+    if (slot.fence != 0)
+    {
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    if (slot.buffer == 0)
+        glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (slot.size < data.size())
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)data.size(), NULL, GL_STREAM_DRAW);
+        slot.size = data.size();
+    }
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)data.size(),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped == NULL)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        uploadLevel(pool, layer, level, &data[0], data.size());
+    }
+    else
+    {
+        std::memcpy(mapped, &data[0], data.size());
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        uploadLevel(pool, layer, level, NULL, data.size());  // Offset 0 into the bound buffer
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ringNext = (ringNext + 1) % 3;
+    }
+    return true;
+}
+
+void TextureStreamer::updateBase(Pool& pool)
+{
+    // Finest level below which every live layer has a complete chain
+    unsigned int base = pool.levelCount;
+    for (unsigned int l = pool.levelCount; l-- > 0;)
+    {
+        bool complete = pool.allocated[l];
+        for (size_t i = 0; complete && i < pool.layers.size(); i++)
+        {
+            if (pool.layers[i].refs > 0 && !pool.layers[i].uploaded[l])
+                complete = false;
+        }
+        if (!complete)
+            break;
+        base = l;
+    }
+    if (base == pool.base || base == pool.levelCount)
+        return;
+    pool.base = base;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pool.texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)base);
+}
+
+TextureRef TextureStreamer::acquire(const std::string& path)
+{
+    TextureRef ref;
+    for (size_t i = 0; i < pools.size(); i++)
+    {
+        for (size_t l = 0; l < pools[i].layers.size(); l++)
+        {
+            Layer& layer = pools[i].layers[l];
+            if (layer.refs > 0 && layer.path == path)
+            {
+                layer.refs++;
+                ref.pool = (int)i;
+                ref.layer = (int)l;
+                return ref;
+            }
+        }
+    }
+
+    TextureFile file;
+    if (!readTextureHeader(path, file))
+        return ref;
+    if (!textureFormatSupported(file.internalFormat))
+    {
+        std::cout << "ERROR::TEXTURE::" << path << ": " << textureFormatName(file.internalFormat)
+                  << " is not supported by this OpenGL context" << std::endl;
+        return ref;
+    }
+
+    int poolIndex = findPool(file);
+    if (poolIndex < 0)
+    {
+        // Reuse an emptied pool slot so existing refs keep their indices
+        poolIndex = (int)pools.size();
+        for (size_t i = 0; i < pools.size(); i++)
+        {
+            if (pools[i].texture == 0)
+            {
+                poolIndex = (int)i;
+                break;
+            }
+        }
+        if (poolIndex == (int)pools.size())
+            pools.push_back(Pool());
+
+        Pool& pool = pools[poolIndex];
+        pool.format = file.internalFormat;
+        pool.width = file.width;
+        pool.height = file.height;
+        pool.levelCount = (unsigned int)file.levels.size();
+        pool.tail = pool.levelCount - 1;
+        while (pool.tail > 0 && std::max(file.levels[pool.tail - 1].width, file.levels[pool.tail - 1].height) <= MIP_TAIL_SIZE)
+            pool.tail--;
+        pool.base = pool.levelCount;
+        pool.allocated.assign(pool.levelCount, false);
+        pool.layers.assign(POOL_LAYERS, Layer());
+        for (size_t l = 0; l < pool.layers.size(); l++)
+        {
+            pool.layers[l].refs = 0;
+            pool.layers[l].serial = 0;
+        }
+        pool.readsInFlight = 0;
+
+        glGenTextures(1, &pool.texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, pool.texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)pool.levelCount - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)pool.levelCount - 1);
+    }
+
+    Pool& pool = pools[poolIndex];
+    int layerIndex = 0;
+    while (pool.layers[layerIndex].refs > 0)
+        layerIndex++;
+    Layer& layer = pool.layers[layerIndex];
+    layer.path = path;
+    layer.file = file;
+    layer.refs = 1;
+    layer.serial = nextSerial++;
+    layer.uploaded.assign(pool.levelCount, false);
+
+    // The tail now, so the texture is usable this frame; finer levels stream in
+    std::vector<unsigned char> data;
+    for (unsigned int l = pool.levelCount; l-- > pool.tail;)
+    {
+        if (!readTextureLevel(file, l, data))
+            break;
+        allocateLevel(pool, l);
+        uploadLevel(pool, layerIndex, l, &data[0], data.size());
+        layer.uploaded[l] = true;
+    }
+    updateBase(pool);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    ref.pool = poolIndex;
+    ref.layer = layerIndex;
+    return ref;
+}
+
+void TextureStreamer::release(const TextureRef& ref)
+{
+    if (!ref.valid())
+        return;
+    Pool& pool = pools[ref.pool];
+    Layer& layer = pool.layers[ref.layer];
+    if (--layer.refs > 0)
+        return;
+    layer.path.clear();
+    layer.file = TextureFile();
+    layer.uploaded.clear();
+    layer.serial = 0;  // Reads in flight for it are dropped on arrival
+
+    for (size_t l = 0; l < pool.layers.size(); l++)
+    {
+        if (pool.layers[l].refs > 0)
+            return;
+    }
+    // Last layer gone: free the whole array
+    glDeleteTextures(1, &pool.texture);
+    pool.texture = 0;
+    pool.allocated.assign(pool.levelCount, false);
+    pool.base = pool.levelCount;
+}
+
+void TextureStreamer::requestLevel(size_t poolIndex, unsigned int level)
+{
+    Pool& pool = pools[poolIndex];
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t l = 0; l < pool.layers.size(); l++)
+    {
+        const Layer& layer = pool.layers[l];
+        if (layer.refs == 0 || layer.uploaded[level])
+            continue;
+        Read read;
+        read.pool = (int)poolIndex;
+        read.layer = (int)l;
+        read.serial = layer.serial;
+        read.level = level;
+        read.file = layer.file;
+        read.ok = false;
+        requests.push_back(read);
+        pool.readsInFlight++;
+    }
+    wake.notify_one();
+}
+
+void TextureStreamer::enforceBudget()
+{
+    size_t resident = residentBytes();
+    while (resident > memoryBudget)
+    {
+        // Drop the finest level of the largest pool that has one above its tail
+        Pool* largest = NULL;
+        size_t largestBytes = 0;
+        for (size_t i = 0; i < pools.size(); i++)
+        {
+            Pool& pool = pools[i];
+            size_t bytes = poolBytes(pool);
+            if (pool.texture != 0 && pool.base < pool.tail && bytes > largestBytes)
+            {
+                largest = &pool;
+                largestBytes = bytes;
+            }
+        }
+        if (largest == NULL)
+            return;
+
+        unsigned int level = largest->base;
+        largest->base = level + 1;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, largest->texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint)largest->base);
+        freeLevel(*largest, level);
+        // Levels finer than the base that were still being filled go too
+        for (unsigned int l = 0; l < level; l++)
+        {
+            if (largest->allocated[l])
+                freeLevel(*largest, l);
+        }
+        stats.levelsEvicted++;
+        resident = residentBytes();
+    }
+}
+
+void TextureStreamer::update()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!finished.empty())
+        {
+            ready.push_back(finished.front());
+            finished.pop_front();
+        }
+    }
+
+    // Upload finished reads within this frame's slice
+    size_t budget = uploadBytesPerFrame;
+    bool uploaded = false;
+    while (!ready.empty() && (budget > 0 || !uploaded))
+    {
+        Read& read = ready.front();
+        Pool& pool = pools[read.pool];
+        bool current = pool.texture != 0 && pool.layers[read.layer].refs > 0 &&
+                       pool.layers[read.layer].serial == read.serial;
+        // Only a level directly above a complete one can be used; anything else was evicted
+        // or released while it was being read
+        bool useful = current && read.ok && !pool.layers[read.layer].uploaded[read.level] &&
+                      read.level + 1 < pool.levelCount && pool.allocated[read.level + 1];
+        if (useful)
+        {
+            allocateLevel(pool, read.level);
+            if (!uploadThroughRing(pool, read.layer, read.level, read.data))
+            {
+                stats.ringStalls++;
+                break;
+            }
+            pool.layers[read.layer].uploaded[read.level] = true;
+            stats.levelsStreamed++;
+            stats.bytesStreamed += read.data.size();
+            budget = read.data.size() < budget ? budget - read.data.size() : 0;
+            uploaded = true;
+            updateBase(pool);
+        }
+        if (pool.readsInFlight > 0)
+            pool.readsInFlight--;
+        ready.pop_front();
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    enforceBudget();
+
+    // Request the next finer level of pools that are idle, if it fits in the budget
+    size_t resident = residentBytes();
+    for (size_t i = 0; i < pools.size(); i++)
+    {
+        Pool& pool = pools[i];
+        if (pool.texture == 0 || pool.readsInFlight > 0 || pool.base == 0 || pool.base >= pool.levelCount)
+            continue;
+        unsigned int level = pool.base - 1;
+        size_t extra = pool.allocated[level] ? 0 : levelBytes(pool, level);
+        if (resident + extra > memoryBudget)
+            continue;
+        requestLevel(i, level);
+        resident += extra;
+    }
+}
+
+void TextureStreamer::report(std::ostream& out) const
+{
+    for (size_t i = 0; i < pools.size(); i++)
+    {
+        const Pool& pool = pools[i];
+        if (pool.texture == 0)
+            continue;
+        int layers = 0;
+        for (size_t l = 0; l < pool.layers.size(); l++)
+            layers += pool.layers[l].refs > 0;
+        out << "TEXTURE::Pool " << i << ": " << textureFormatName(pool.format) << " " << pool.width << "x"
+            << pool.height << ", " << layers << "/" << POOL_LAYERS << " layers, base level " << pool.base
+            << " of " << pool.levelCount << ", " << poolBytes(pool) / 1024 << " KB" << std::endl;
+    }
+    out << "TEXTURE::Resident " << residentBytes() / 1024 << " KB of " << memoryBudget / 1024
+        << " KB budget; streamed " << stats.levelsStreamed << " levels (" << stats.bytesStreamed / 1024
+        << " KB), evicted " << stats.levelsEvicted << ", " << stats.ringStalls << " ring stalls" << std::endl;
+}
@@ -0,0 +1,495 @@
+#include "../include/thumbnail_batch.h"
+#include "../include/camera.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+const unsigned int ThumbnailBatch::RING_SIZE;
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void campusSeatPoses(const Campus& campus, std::vector<ViewPose>& poses)
+{
+    for (size_t c = 0; c < campus.cellCount(); c++)
+    {
+        const CampusCell& cell = campus.cell(c);
+        sceneSeatPoses(cell.scene, cell.origin, cell.name + "_", poses);
+    }
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+void encodeQoi(const uint8_t* pixels, unsigned int width, unsigned int height, std::vector<uint8_t>& out)
+{
+    out.clear();
+    out.reserve((size_t)width * height + 22);
+    const char magic[4] = { 'q', 'o', 'i', 'f' };
+    out.insert(out.end(), magic, magic + 4);
+    putBigEndian(out, width);
+    putBigEndian(out, height);
+    out.push_back(3);  // RGB
+    out.push_back(0);  // sRGB
+
+    // Pixels are packed r | g << 8 | b << 16 | a << 24; alpha is written as opaque
+    uint32_t index[64];
+    std::memset(index, 0, sizeof(index));
+    uint32_t previous = 0xff000000u;
+    unsigned int run = 0;
+    size_t count = (size_t)width * height;
+    for (size_t p = 0; p < count; p++)
+    {
+        const uint8_t* px = pixels + p * 4;
+        uint8_t r = px[0], g = px[1], b = px[2];
+        uint32_t pixel = r | (uint32_t)g << 8 | (uint32_t)b << 16 | 0xff000000u;
+        if (pixel == previous)
+        {
+            run++;
+            if (run == 62 || p + 1 == count)
+            {
+                out.push_back((uint8_t)(0xc0 | (run - 1)));  // QOI_OP_RUN
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0)
+        {
+            out.push_back((uint8_t)(0xc0 | (run - 1)));
+            run = 0;
+        }
+
+        unsigned int slot = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+        if (index[slot] == pixel)
+            out.push_back((uint8_t)slot);  // QOI_OP_INDEX
+        else
+        {
+            index[slot] = pixel;
+            int dr = (int8_t)(r - (uint8_t)previous);
+            int dg = (int8_t)(g - (uint8_t)(previous >> 8));
+            int db = (int8_t)(b - (uint8_t)(previous >> 16));
+            int drg = dr - dg, dbg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                out.push_back((uint8_t)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));  // QOI_OP_DIFF
+            else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+            {
+                out.push_back((uint8_t)(0x80 | (dg + 32)));  // QOI_OP_LUMA
+                out.push_back((uint8_t)((drg + 8) << 4 | (dbg + 8)));
+            }
+            else
+            {
+                out.push_back(0xfe);  // QOI_OP_RGB
+                out.push_back(r);
+                out.push_back(g);
+                out.push_back(b);
+            }
+        }
+        previous = pixel;
+    }
+    const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    out.insert(out.end(), padding, padding + 8);
+}
+
+ThumbnailBatch::ThumbnailBatch()
+    : sink(NULL), viewWidth(0), viewHeight(0), splitFramebuffer(0), splitColor(0), splitDepth(0), previousFramebuffer(0),
+      ringNext(0), started(false), maxJobs(0), busy(0), quit(false)
+{
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        ring[i].buffer = 0;
+        ring[i].size = 0;
+        ring[i].fence = 0;
+    }
+}
+
+ThumbnailBatch::~ThumbnailBatch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < writers.size(); i++)
+        writers[i].join();
+    release();
+}
+
+void ThumbnailBatch::release()
+{
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        if (ring[i].fence != 0)
+            glDeleteSync(ring[i].fence);
+        if (ring[i].buffer != 0)
+            glDeleteBuffers(1, &ring[i].buffer);
+        ring[i].buffer = 0;
+        ring[i].size = 0;
+        ring[i].fence = 0;
+        ring[i].names.clear();
+    }
+    if (splitFramebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &splitFramebuffer);
+        glDeleteTextures(1, &splitColor);
+        glDeleteTextures(1, &splitDepth);
+    }
+    splitFramebuffer = splitColor = splitDepth = 0;
+}
+
+bool ThumbnailBatch::initialize(const std::string& outputDirectory, int width, int height, unsigned int viewsPerPass,
+                                MultiViewMode preferred, unsigned int writerThreads)
+{
+    mkdir(outputDirectory.c_str(), 0755);
+    struct stat info;
+    if (stat(outputDirectory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        std::cout << "ERROR::THUMBNAILS::Could not create output directory " << outputDirectory << std::endl;
+        return false;
+    }
+    directory = outputDirectory;
+    sink = NULL;
+    return setup(width, height, viewsPerPass, preferred, writerThreads);
+}
+
+bool ThumbnailBatch::initialize(ThumbnailSink* viewSink, int width, int height, unsigned int viewsPerPass,
+                                MultiViewMode preferred, unsigned int writerThreads)
+{
+    directory.clear();
+    sink = viewSink;
+    return setup(width, height, viewsPerPass, preferred, writerThreads);
+}
+
+bool ThumbnailBatch::setup(int width, int height, unsigned int viewsPerPass, MultiViewMode preferred,
+                           unsigned int writerThreads)
+{
+    if (width <= 0 || height <= 0)
+    {
+        std::cout << "ERROR::THUMBNAILS::Invalid thumbnail size " << width << "x" << height << std::endl;
+        return false;
+    }
+    if (!multiView.initialize(viewsPerPass, preferred))
+        return false;
+    viewWidth = width;
+    viewHeight = height;
+    release();
+
+    if (multiView.mode() == MULTIVIEW_SPLIT)
+    {
+        // Columns side by side, sampled by nothing: a plain colour texture and depth
+        int splitWidth = width * (int)viewsPerPass;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGenTextures(1, &splitColor);
+        glBindTexture(GL_TEXTURE_2D, splitColor);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, splitWidth, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenTextures(1, &splitDepth);
+        glBindTexture(GL_TEXTURE_2D, splitDepth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, splitWidth, height, 0, GL_DEPTH_COMPONENT,
+                     GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &splitFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, splitFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, splitColor, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, splitDepth, 0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)previousFramebuffer);
+        if (!complete)
+        {
+            std::cout << "ERROR::THUMBNAILS::Split framebuffer incomplete (" << splitWidth << "x" << height << ")"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (writers.empty())
+    {
+        unsigned int count = writerThreads > 0 ? writerThreads : std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned int i = 0; i < count; i++)
+            writers.push_back(std::thread(&ThumbnailBatch::writerLoop, this));
+    }
+    // A few passes' worth of images queued before readback waits for the disk
+    maxJobs = std::max<size_t>(writers.size() * 2, viewsPerPass * 2);
+    return true;
+}
+
+void ThumbnailBatch::beginPass(const ViewPose* poses, unsigned int count)
+{
+    passStart = std::chrono::steady_clock::now();
+    if (!started)
+    {
+        batchStart = passStart;
+        started = true;
+    }
+
+    unsigned int views = multiView.viewCount();
+    count = std::max(1u, std::min(count, views));
+    MultiViewCamera cameras[MultiView::MAX_VIEWS];
+    passNames.clear();
+    for (unsigned int i = 0; i < views; i++)
+    {
+        const ViewPose& pose = poses[std::min(i, count - 1)];
+        Camera camera(pose.position, glm::vec3(0.0f, 1.0f, 0.0f), pose.yaw, pose.pitch);
+        cameras[i].position = pose.position;
+        cameras[i].view = camera.GetViewMatrix();
+        cameras[i].projection = glm::perspective(glm::radians(camera.Zoom), (float)viewWidth / viewHeight, 0.1f,
+                                                 100.0f);
+        if (i < count)
+            passNames.push_back(pose.name);
+    }
+    multiView.update(cameras);
+
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    if (multiView.mode() == MULTIVIEW_LAYERED)
+        multiView.beginLayers(viewWidth, viewHeight);
+    else
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, splitFramebuffer);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        multiView.begin(viewWidth * (int)views, viewHeight);
+    }
+}
+
+void ThumbnailBatch::endPass()
+{
+    // The slot's previous pass must be copied out first; still in flight means the ring is
+    // too short for this GPU
+    Slot& slot = ring[ringNext];
+    if (slot.fence != 0)
+    {
+        if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            stats.ringStalls++;
+        collect(slot);
+    }
+
+    unsigned int views = multiView.viewCount();
+    size_t size = (size_t)viewWidth * viewHeight * 4 * views;
+    if (slot.buffer == 0)
+        glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.size != size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_READ);
+        slot.size = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    if (multiView.mode() == MULTIVIEW_LAYERED)
+    {
+        // Every layer, one after another; into the bound buffer at offset 0
+        glBindTexture(GL_TEXTURE_2D_ARRAY, multiView.layerTexture());
+        glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        multiView.end();
+    }
+    else
+    {
+        multiView.end();
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, 0, viewWidth * (int)views, viewHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindFramebuffer(GL_FRAMEBUFFER, (unsigned int)previousFramebuffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.names.swap(passNames);
+    ringNext = (ringNext + 1) % RING_SIZE;
+
+    stats.passes++;
+    stats.views += slot.names.size();
+    stats.bytesRead += size;
+    stats.renderMs += elapsedMs(passStart);
+}
+
+void ThumbnailBatch::collect(Slot& slot)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GLenum status = GL_TIMEOUT_EXPIRED;
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const uint8_t* mapped = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)slot.size,
+                                                              GL_MAP_READ_BIT);
+    if (status == GL_WAIT_FAILED || mapped == NULL)
+    {
+        std::cout << "ERROR::THUMBNAILS::Readback of " << slot.names.size() << " views failed" << std::endl;
+        if (mapped != NULL)
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.failedWrites += (unsigned int)slot.names.size();
+        slot.names.clear();
+        return;
+    }
+
+    // Layers are whole images; split columns share rows. Both are bottom row first.
+    bool layered = multiView.mode() == MULTIVIEW_LAYERED;
+    size_t rowBytes = (size_t)viewWidth * 4;
+    size_t stride = layered ? rowBytes : rowBytes * multiView.viewCount();
+    std::vector<Job> done(slot.names.size());
+    for (size_t v = 0; v < slot.names.size(); v++)
+    {
+        Job& job = done[v];
+        job.path = sink ? slot.names[v] : directory + "/" + slot.names[v] + ".qoi";
+        job.pixels.resize(rowBytes * viewHeight);
+        const uint8_t* source = layered ? mapped + v * rowBytes * viewHeight : mapped + v * rowBytes;
+        for (int y = 0; y < viewHeight; y++)
+            std::memcpy(&job.pixels[(size_t)(viewHeight - 1 - y) * rowBytes], source + (size_t)y * stride, rowBytes);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.names.clear();
+    stats.readbackMs += elapsedMs(start);
+
+    for (size_t v = 0; v < done.size(); v++)
+        push(done[v]);
+}
+
+void ThumbnailBatch::push(Job& job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (jobs.size() >= maxJobs)
+    {
+        stats.queueStalls++;
+        space.wait(lock, [this] { return jobs.size() < maxJobs; });
+    }
+    jobs.push_back(Job());
+    jobs.back().path.swap(job.path);
+    jobs.back().pixels.swap(job.pixels);
+    lock.unlock();
+    wake.notify_one();
+}
+
+void ThumbnailBatch::writerLoop()
+{
+    std::vector<uint8_t> encoded;
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job.path.swap(jobs.front().path);
+            job.pixels.swap(jobs.front().pixels);
+            jobs.pop_front();
+            busy++;
+        }
+        space.notify_one();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        encodeQoi(&job.pixels[0], (unsigned int)viewWidth, (unsigned int)viewHeight, encoded);
+        size_t bytes = encoded.size();
+        bool written = true;
+        if (sink)
+            sink->thumbnail(job.path, encoded);
+        else
+        {
+            std::ofstream file(job.path.c_str(), std::ios::binary);
+            file.write((const char*)&encoded[0], (std::streamsize)encoded.size());
+            written = (bool)file;
+            file.close();
+        }
+        double ms = elapsedMs(start);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+            stats.encodeMs += ms;
+            if (written)
+                stats.bytesWritten += bytes;
+            else
+            {
+                stats.failedWrites++;
+                std::cout << "ERROR::THUMBNAILS::Could not write " << job.path << std::endl;
+            }
+        }
+        idle.notify_all();
+    }
+}
+
+void ThumbnailBatch::poll()
+{
+    // Oldest first: the slot endPass would reuse next
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        Slot& slot = ring[(ringNext + i) % RING_SIZE];
+        if (slot.fence == 0)
+            continue;
+        if (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+            return;
+        collect(slot);
+    }
+}
+
+void ThumbnailBatch::finish()
+{
+    // Oldest pass first, so images are queued in the order they were rendered
+    for (unsigned int i = 0; i < RING_SIZE; i++)
+    {
+        Slot& slot = ring[(ringNext + i) % RING_SIZE];
+        if (slot.fence != 0)
+            collect(slot);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return jobs.empty() && busy == 0; });
+    }
+    if (started)
+        stats.totalMs = elapsedMs(batchStart);
+}
+
+void ThumbnailBatch::draw(Campus& campus, AssetRegistry& assets, ShaderVariants& shaders, RenderQueue& queue,
+                          const std::vector<ViewPose>& poses)
+{
+    size_t first = 0;
+    while (first < poses.size())
+    {
+        const CampusCell* cell = campus.cellAt(poses[first].position);
+        size_t count = 1;
+        while (count < viewsPerPass() && first + count < poses.size() &&
+               campus.cellAt(poses[first + count].position) == cell)
+            count++;
+
+        // Stream like the frame loop would with the camera at the pass's first pose
+        campus.loadAround(poses[first].position);
+        campus.update(0.0f, poses[first].position);
+        assets.textures.update();
+
+        queue.setViewPosition(poses[first].position);
+        campus.submit(queue, shaders);
+        campus.setFrameUniforms(shaders, *cell);
+        beginPass(&poses[first], (unsigned int)count);
+        queue.flush();
+        endPass();
+        first += count;
+    }
+}
+
+void ThumbnailBatch::report(std::ostream& out) const
+{
+    double seconds = stats.totalMs / 1000.0;
+    out << "THUMBNAILS::" << stats.views << " views in " << stats.passes << " passes of " << multiView.viewCount()
+        << " (" << MultiView::modeName(multiView.mode()) << ", " << viewWidth << "x" << viewHeight << "): "
+        << stats.totalMs << " ms, " << (seconds > 0.0 ? stats.views / seconds : 0.0) << " views/s" << std::endl;
+    out << "THUMBNAILS::Render " << stats.renderMs << " ms, readback " << stats.readbackMs << " ms ("
+        << stats.bytesRead / 1024 << " KB, " << stats.ringStalls << " ring stalls), encode " << stats.encodeMs
+        << " ms on " << writers.size() << " writers (" << stats.bytesWritten / 1024 << " KB QOI, "
+        << stats.queueStalls << " queue stalls, " << stats.failedWrites << " failed)" << std::endl;
+}
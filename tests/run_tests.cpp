@@ -0,0 +1,177 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tests.h"
+
+// Headless tests: CPU-only tests of the loaders and kernels, then tests of the renderer against
+// the default scene, drawn offscreen in a hidden window (only created when a GL test is run):
+//   make test                               (every test)
+//   ./build/classroom_tests gpu-driven      (the named ones)
+// In CI under Mesa llvmpipe:
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run make test
+
+struct CpuTestCase
+{
+    const char* name;
+    bool (*run)();
+};
+
+static const CpuTestCase CPU_TESTS[] =
+{
+    { "scene-formats", testSceneFormats },
+    { "batch-transforms", testBatchTransforms },
+    { "render-sort", testRenderSort },
+    { "collision", testCollision },
+    { "camera-path", testCameraPath },
+    { "metrics", testMetrics },
+    { "texture-file", testTextureFile },
+};
+static const size_t CPU_TEST_COUNT = sizeof(CPU_TESTS) / sizeof(CPU_TESTS[0]);
+
+struct TestCase
+{
+    const char* name;
+    bool (*run)(TestScene& scene);
+};
+
+static const TestCase TESTS[] =
+{
+    { "state-cache", testStateCache },
+    { "gpu-driven", testGpuDriven },
+    { "software-raster", testSoftwareRaster },
+    { "multi-view", testMultiView },
+    { "frame-capture", testFrameCapture },
+    { "debug-view", testDebugView },
+    { "render-server", testRenderServer },  // Last: advances the animation clock
+};
+static const size_t TEST_COUNT = sizeof(TESTS) / sizeof(TESTS[0]);
+
+TestScene::TestScene()
+    : shaders(assets, "shaders/vertex_shader.glsl", "shaders/fragment_shader.glsl"), campus(assets)
+{
+}
+
+bool TestScene::load(const std::string& path)
+{
+    shaders.precompile("shaders/variants.manifest");
+    campus.retainGeometry = true;
+    if (!campus.load(path))
+        return false;
+    camera = Camera(campus.startPosition, glm::vec3(0.0f, 1.0f, 0.0f), campus.startYaw, campus.startPitch);
+    campus.loadAround(camera.Position);
+    return true;
+}
+
+glm::mat4 TestScene::projection() const
+{
+    return glm::perspective(glm::radians(camera.Zoom), (float)TEST_WIDTH / TEST_HEIGHT, 0.1f, 100.0f);
+}
+
+// Hidden window with a core profile context of the given version; NULL when unavailable
+static GLFWwindow* createTestWindow(int major, int minor)
+{
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    return glfwCreateWindow(TEST_WIDTH, TEST_HEIGHT, "classroom tests", NULL, NULL);
+}
+
+static bool report(const char* name, bool passed)
+{
+    std::cout << "TEST::" << name << (passed ? " passed" : " FAILED") << std::endl;
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<const CpuTestCase*> selectedCpu;
+    std::vector<const TestCase*> selected;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string name = argv[i];
+        const CpuTestCase* cpuTest = NULL;
+        const TestCase* test = NULL;
+        for (size_t t = 0; t < CPU_TEST_COUNT && !cpuTest; t++)
+        {
+            if (name == CPU_TESTS[t].name)
+                cpuTest = &CPU_TESTS[t];
+        }
+        for (size_t t = 0; t < TEST_COUNT && !test; t++)
+        {
+            if (name == TESTS[t].name)
+                test = &TESTS[t];
+        }
+        if (!cpuTest && !test)
+        {
+            std::cout << "ERROR::TEST::Unknown test " << name << "; the tests are:";
+            for (size_t t = 0; t < CPU_TEST_COUNT; t++)
+                std::cout << " " << CPU_TESTS[t].name;
+            for (size_t t = 0; t < TEST_COUNT; t++)
+                std::cout << " " << TESTS[t].name;
+            std::cout << std::endl;
+            return 1;
+        }
+        if (cpuTest)
+            selectedCpu.push_back(cpuTest);
+        else
+            selected.push_back(test);
+    }
+    if (selectedCpu.empty() && selected.empty())
+    {
+        for (size_t t = 0; t < CPU_TEST_COUNT; t++)
+            selectedCpu.push_back(&CPU_TESTS[t]);
+        for (size_t t = 0; t < TEST_COUNT; t++)
+            selected.push_back(&TESTS[t]);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < selectedCpu.size(); i++)
+        failed += report(selectedCpu[i]->name, selectedCpu[i]->run()) ? 0 : 1;
+    size_t total = selectedCpu.size() + selected.size();
+    if (selected.empty())
+    {
+        std::cout << "TEST::" << total - failed << " of " << total << " tests passed" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+
+    // GL 4.3 for the GPU-driven path, else 3.3 (that test then fails)
+    glfwInit();
+    GLFWwindow* window = createTestWindow(4, 3);
+    if (window == NULL)
+        window = createTestWindow(3, 3);
+    if (window == NULL)
+    {
+        std::cout << "ERROR::TEST::Failed to create a GL context" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (glewInit() != GLEW_OK)
+    {
+        std::cout << "ERROR::TEST::Failed to initialize GLEW" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    // The scene's GL objects go before the context
+    {
+        TestScene scene;
+        if (!scene.load("scenes/classroom.scene"))
+        {
+            glfwTerminate();
+            return 1;
+        }
+        for (size_t i = 0; i < selected.size(); i++)
+            failed += report(selected[i]->name, selected[i]->run(scene)) ? 0 : 1;
+    }
+    std::cout << "TEST::" << total - failed << " of " << total << " tests passed on "
+              << glGetString(GL_RENDERER) << std::endl;
+    glfwTerminate();
+    return failed == 0 ? 0 : 1;
+}
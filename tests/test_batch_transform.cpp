@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include "tests.h"
+#include "../include/batch_transform.h"
+
+// Relative to the value's magnitude, floored at 1: positions reach 50 m, and the SIMD paths use
+// polynomial sine and cosine
+static const float TOLERANCE = 1e-4f;
+
+static bool nearlyEqual(float a, float b)
+{
+    return std::fabs(a - b) <= TOLERANCE * std::max(1.0f, std::fabs(b));
+}
+
+// Index of the first instance whose matrix or bounds differ from the reference, or count
+static size_t firstMismatch(const InstanceTransforms& out, const InstanceTransforms& reference, size_t first,
+                            size_t count)
+{
+    for (size_t i = first; i < first + count; i++)
+    {
+        bool same = true;
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                same = same && nearlyEqual(out.models[i][c][r], reference.models[i][c][r]);
+        const std::vector<float>* bounds[] = { &out.minX, &out.minY, &out.minZ, &out.maxX, &out.maxY, &out.maxZ };
+        const std::vector<float>* expected[] = { &reference.minX, &reference.minY, &reference.minZ,
+                                                 &reference.maxX, &reference.maxY, &reference.maxZ };
+        for (int b = 0; b < 6; b++)
+            same = same && nearlyEqual((*bounds[b])[i], (*expected[b])[i]);
+        if (!same)
+            return i - first;
+    }
+    return count;
+}
+
+// Every SIMD path the CPU supports against the scalar path on random instances: all 16 matrix
+// values and all six bounds, with and without scales, with a count that leaves a scalar tail and
+// an output offset
+bool testBatchTransforms()
+{
+    const size_t COUNT = 1003, FIRST = 5;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(-720.0f, 720.0f), size(0.1f, 3.0f);
+    std::vector<float> px(COUNT), py(COUNT), pz(COUNT), yaw(COUNT), scale(COUNT);
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        px[i] = position(rng);
+        py[i] = position(rng);
+        pz[i] = position(rng);
+        yaw[i] = angle(rng);
+        scale[i] = size(rng);
+    }
+    glm::vec3 localMin(-0.7f, -0.2f, -0.3f), localMax(0.5f, 1.4f, 0.9f);
+
+    TransformPath previous = transformPath();
+    setTransformPath(TRANSFORM_AVX2);
+    TransformPath best = transformPath();
+    bool passed = true;
+    for (int scaled = 0; scaled < 2; scaled++)
+    {
+        TransformInput in;
+        in.posX = &px[0];
+        in.posY = &py[0];
+        in.posZ = &pz[0];
+        in.yaw = &yaw[0];
+        in.scale = scaled ? &scale[0] : NULL;
+        in.count = COUNT;
+        in.origin = glm::vec3(3.0f, 0.5f, -7.0f);
+
+        InstanceTransforms reference;
+        reference.resize(FIRST + COUNT);
+        setTransformPath(TRANSFORM_SCALAR);
+        batchTransform(in, localMin, localMax, reference, FIRST);
+        for (int p = TRANSFORM_SCALAR + 1; p <= best; p++)
+        {
+            setTransformPath((TransformPath)p);
+            InstanceTransforms out;
+            out.resize(FIRST + COUNT);
+            batchTransform(in, localMin, localMax, out, FIRST);
+            size_t mismatch = firstMismatch(out, reference, FIRST, COUNT);
+            if (mismatch < COUNT)
+            {
+                std::cout << "TRANSFORM::" << transformPathName((TransformPath)p) << (scaled ? " (scaled)" : "")
+                          << " differs from the scalar path at instance " << mismatch << " of " << COUNT << std::endl;
+                passed = false;
+            }
+        }
+    }
+    setTransformPath(previous);
+
+    if (best == TRANSFORM_SCALAR)
+        std::cout << "TRANSFORM::No SIMD path on this CPU; only the scalar path ran" << std::endl;
+    else if (passed)
+        std::cout << "TRANSFORM::SSE2" << (best == TRANSFORM_AVX2 ? " and AVX2 match" : " matches")
+                  << " the scalar path on " << COUNT << " instances" << std::endl;
+    return passed;
+}
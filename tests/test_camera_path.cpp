@@ -0,0 +1,158 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include "tests.h"
+#include "../include/camera_path.h"
+
+static const char* PATH = "camera_path_test.campath";
+static const size_t HEADER_BYTES = 12;
+static const size_t SAMPLE_BYTES = 36;
+
+static bool sameSample(const CameraPathSample& a, const CameraPathSample& b)
+{
+    return a.time == b.time && a.tick == b.tick && a.simTime == b.simTime && a.position == b.position &&
+           a.yaw == b.yaw && a.pitch == b.pitch && a.zoom == b.zoom;
+}
+
+static bool nearlyEqual(float a, float b)
+{
+    return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::fabs(b));
+}
+
+// at(time) must match the expected state
+static bool sampleAt(const CameraPath& path, float time, const CameraPathSample& expected, const char* what)
+{
+    CameraPathSample s = path.at(time);
+    bool same = nearlyEqual(s.simTime, expected.simTime) && nearlyEqual(s.position.x, expected.position.x) &&
+                nearlyEqual(s.position.y, expected.position.y) && nearlyEqual(s.position.z, expected.position.z) &&
+                nearlyEqual(s.yaw, expected.yaw) && nearlyEqual(s.pitch, expected.pitch) &&
+                nearlyEqual(s.zoom, expected.zoom);
+    if (!same)
+        std::cout << "CAMERA_PATH::Sample " << what << " (t = " << time << ") is at (" << s.position.x << ", "
+                  << s.position.y << ", " << s.position.z << ") yaw " << s.yaw << ", expected (" << expected.position.x
+                  << ", " << expected.position.y << ", " << expected.position.z << ") yaw " << expected.yaw
+                  << std::endl;
+    return same;
+}
+
+// Load with the log captured; the path must be rejected with a message containing `message`
+static bool rejects(const std::string& bytes, const std::string& message, const char* what)
+{
+    {
+        std::ofstream out(PATH, std::ios::binary | std::ios::trunc);
+        out << bytes;
+    }
+    CameraPath path;
+    std::ostringstream captured;
+    std::streambuf* previous = std::cout.rdbuf(captured.rdbuf());
+    bool loaded = path.load(PATH);
+    std::cout.rdbuf(previous);
+    if (loaded || !path.samples.empty() || captured.str().find(message) == std::string::npos)
+    {
+        std::cout << "CAMERA_PATH::" << what << ": expected \"" << message << "\", got "
+                  << (loaded ? "a loaded path\n" : captured.str());
+        return false;
+    }
+    return true;
+}
+
+// A recorded path survives a save/load round-trip; at() clamps before the start and after the
+// end and interpolates between samples; truncated and out-of-order files are rejected
+bool testCameraPath()
+{
+    CameraPath recorded;
+    Camera camera(glm::vec3(0.0f, 1.7f, 4.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+    recorded.record(0.0f, 0, 10.0f, camera);
+    camera.Position = glm::vec3(2.0f, 1.7f, 0.0f);
+    camera.SetOrientation(270.0f, -20.0f);  // Unwrapped: a full turn and a quarter
+    camera.Zoom = 30.0f;
+    recorded.record(1.0f, 60, 11.0f, camera);
+    camera.Position = glm::vec3(2.0f, 1.7f, -6.0f);
+    recorded.record(4.0f, 240, 14.0f, camera);
+    bool passed = true;
+
+    CameraPath loaded;
+    if (!recorded.save(PATH) || !loaded.load(PATH) || loaded.samples.size() != recorded.samples.size())
+    {
+        std::cout << "CAMERA_PATH::Failed to save and load " << PATH << std::endl;
+        passed = false;
+    }
+    for (size_t i = 0; passed && i < loaded.samples.size(); i++)
+    {
+        if (!sameSample(loaded.samples[i], recorded.samples[i]))
+        {
+            std::cout << "CAMERA_PATH::Sample " << i << " differs after loading" << std::endl;
+            passed = false;
+        }
+    }
+
+    const std::vector<CameraPathSample>& s = recorded.samples;
+    CameraPathSample middle;
+    middle.simTime = 10.25f;
+    middle.position = glm::vec3(0.5f, 1.7f, 3.0f);
+    middle.yaw = -90.0f + 360.0f * 0.25f;
+    middle.pitch = -5.0f;
+    middle.zoom = 45.0f - 15.0f * 0.25f;
+    passed = sampleAt(loaded, -1.0f, s[0], "before the start") && passed;
+    passed = sampleAt(loaded, 0.0f, s[0], "at the start") && passed;
+    passed = sampleAt(loaded, 0.25f, middle, "a quarter into the first span") && passed;
+    passed = sampleAt(loaded, 1.0f, s[1], "at the middle sample") && passed;
+    CameraPathSample later = s[1];
+    later.simTime = 12.5f;
+    later.position.z = -3.0f;
+    passed = sampleAt(loaded, 2.5f, later, "halfway through the second span") && passed;
+    passed = sampleAt(loaded, 4.0f, s[2], "at the end") && passed;
+    passed = sampleAt(loaded, 100.0f, s[2], "after the end") && passed;
+    if (loaded.duration() != 4.0f)
+    {
+        std::cout << "CAMERA_PATH::Duration " << loaded.duration() << ", expected 4" << std::endl;
+        passed = false;
+    }
+
+    std::string bytes;
+    {
+        std::ifstream in(PATH, std::ios::binary);
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        bytes = contents.str();
+    }
+    if (bytes.size() != HEADER_BYTES + 3 * SAMPLE_BYTES)
+    {
+        std::cout << "CAMERA_PATH::File is " << bytes.size() << " bytes, expected "
+                  << HEADER_BYTES + 3 * SAMPLE_BYTES << std::endl;
+        passed = false;
+    }
+    else
+    {
+        // Every truncation: the header check or the sample count against the file size
+        for (size_t length = 0; length < bytes.size(); length++)
+        {
+            const char* message = length < HEADER_BYTES ? "Not a camera path" : "is shorter than its 3 samples";
+            if (!rejects(bytes.substr(0, length), message, "Truncated file"))
+            {
+                passed = false;
+                break;
+            }
+        }
+
+        // The last sample's time before the middle one's, then not a number
+        std::string unordered = bytes;
+        float earlier = 0.5f;
+        std::memcpy(&unordered[HEADER_BYTES + 2 * SAMPLE_BYTES], &earlier, sizeof(float));
+        passed = rejects(unordered, "Sample 2 of", "Out-of-order sample") && passed;
+        float nan = std::nanf("");
+        std::memcpy(&unordered[HEADER_BYTES + 2 * SAMPLE_BYTES], &nan, sizeof(float));
+        passed = rejects(unordered, "is out of order", "NaN sample time") && passed;
+    }
+
+    std::remove(PATH);
+    if (passed)
+        std::cout << "CAMERA_PATH::Round-trip exact; interpolation clamped and linear; " << bytes.size()
+                  << " truncations and out-of-order times rejected" << std::endl;
+    return passed;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <cmath>
+#include "tests.h"
+#include "../include/collision.h"
+#include "../include/classroom.h"
+
+static const float TOLERANCE = 1e-3f;
+
+// A move from `from` by `delta` must end at `expected`
+static bool endsAt(CollisionWorld& world, const glm::vec3& from, const glm::vec3& delta, const glm::vec3& expected,
+                   const char* what)
+{
+    CollisionCapsule capsule;
+    glm::vec3 eye = world.move(from, delta, capsule);
+    glm::vec3 error = glm::abs(eye - expected);
+    if (error.x <= TOLERANCE && error.y <= TOLERANCE && error.z <= TOLERANCE)
+        return true;
+    std::cout << "COLLISION::" << what << " ended at (" << eye.x << ", " << eye.y << ", " << eye.z << "), expected ("
+              << expected.x << ", " << expected.y << ", " << expected.z << ")" << std::endl;
+    return false;
+}
+
+// CollisionWorld::move against zero-thickness walls: stopping at a wall and sliding along it,
+// settling in a corner that needs two push-outs per step, a long move that must not pass
+// through; and the swept bounds a room gives a spinning instance
+bool testCollision()
+{
+    const float EYE = 1.75f;  // Feet just above the floor
+    const float R = CollisionCapsule().radius;
+    bool passed = true;
+
+    // A floor, a wall across x = 2 and a wall across z = 2
+    CollisionWorld world;
+    world.addBox(glm::vec3(-10.0f, 0.0f, -10.0f), glm::vec3(10.0f, 0.0f, 10.0f));
+    world.addBox(glm::vec3(2.0f, 0.0f, -10.0f), glm::vec3(2.0f, 3.0f, 10.0f));
+    world.addBox(glm::vec3(-10.0f, 0.0f, 2.0f), glm::vec3(10.0f, 3.0f, 2.0f));
+    world.build();
+    glm::vec3 start(0.0f, EYE, -5.0f);
+    passed = endsAt(world, start, glm::vec3(5.0f, 0.0f, 0.0f), glm::vec3(2.0f - R, EYE, -5.0f),
+                    "Walking into a wall") && passed;
+    passed = endsAt(world, start, glm::vec3(3.0f, 0.0f, 3.0f), glm::vec3(2.0f - R, EYE, -2.0f),
+                    "Sliding along a wall") && passed;
+    passed = endsAt(world, glm::vec3(0.0f, EYE, 0.0f), glm::vec3(5.0f, 0.0f, 5.0f), glm::vec3(2.0f - R, EYE, 2.0f - R),
+                    "Walking into a corner") && passed;
+    // Far more than 256 steps of half the radius
+    passed = endsAt(world, start, glm::vec3(100.0f, 0.0f, 0.0f), glm::vec3(2.0f - R, EYE, -5.0f),
+                    "A 100 m move into a wall") && passed;
+
+    // A blade 2 m across and 0.2 m deep at table height, still at x = -3 and spinning at x = 3:
+    // the spinning one blocks the whole circle it sweeps
+    Classroom room;
+    room.scene.room.width = 10.0f;
+    room.scene.room.length = 10.0f;
+    room.scene.room.height = 3.0f;
+    room.fallbackParts.resize(1);
+    room.fallbackParts[0].count = 1;
+    room.fallbackParts[0].boundsMin = glm::vec3(-1.0f, 0.0f, -0.1f);
+    room.fallbackParts[0].boundsMax = glm::vec3(1.0f, 0.2f, 0.1f);
+    room.scene.instances.push(0, 0, glm::vec3(-3.0f, 1.0f, 0.0f), 0.0f, 1.0f, 0.0f);
+    room.scene.instances.push(0, 0, glm::vec3(3.0f, 1.0f, 0.0f), 0.0f, 1.0f, 120.0f);
+    CollisionWorld roomWorld;
+    roomWorld.addRoom(room);
+    roomWorld.build();
+    if (roomWorld.boxCount() != 8)
+    {
+        std::cout << "COLLISION::Room gave " << roomWorld.boxCount() << " boxes, expected 8" << std::endl;
+        passed = false;
+    }
+    float swept = std::sqrt(1.0f + 0.1f * 0.1f);
+    passed = endsAt(roomWorld, glm::vec3(-3.0f, EYE, 4.0f), glm::vec3(0.0f, 0.0f, -4.0f),
+                    glm::vec3(-3.0f, EYE, 0.1f + R), "Walking into a still blade") && passed;
+    passed = endsAt(roomWorld, glm::vec3(3.0f, EYE, 4.0f), glm::vec3(0.0f, 0.0f, -4.0f),
+                    glm::vec3(3.0f, EYE, swept + R), "Walking into a spinning blade") && passed;
+    // Room walls hold too
+    passed = endsAt(roomWorld, glm::vec3(0.0f, EYE, 4.0f), glm::vec3(0.0f, 0.0f, 3.0f),
+                    glm::vec3(0.0f, EYE, 5.0f - R), "Walking into a room wall") && passed;
+
+    if (passed)
+        std::cout << "COLLISION::Stopped at walls, in a corner and after a 100 m move; spinning instance blocks its "
+                  << "sweep" << std::endl;
+    return passed;
+}
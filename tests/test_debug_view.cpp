@@ -0,0 +1,90 @@
+#include <GL/glew.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include "tests.h"
+#include "../include/debug_view.h"
+#include "../include/view_uniforms.h"
+
+// The start view drawn normally and in every debug view, the heatmaps' histograms written out and
+// checked against each other: overdraw, triangle density and cost cover the same pixels, stacked
+// parts give pixels several fragments, every draw and covered pixel has a time once the
+// timestamps are back, and the wireframe colours fewer pixels than the filled scene
+bool testDebugView(TestScene& scene)
+{
+    const char* histogramPath = "debug_view_test.txt";
+    DebugView debugView;
+    if (!debugView.initialize("shaders/heatmap.vert", "shaders/heatmap.frag"))
+        return false;
+    TestTarget target;
+    Camera& camera = scene.camera;
+    const CampusCell& cell = scene.cell();
+    RenderQueue& renderQueue = scene.renderQueue;
+    ViewUniforms viewUniforms;
+    viewUniforms.update(scene.projection(), camera.GetViewMatrix(), camera.Position);
+
+    std::vector<DebugHistogram> histograms;
+    std::vector<unsigned char> pixels;
+    size_t drawnPixels[2] = { 0, 0 };  // Filled, wireframe: pixels other than the black clear colour
+    unsigned int draws = 0;
+    bool complete = true;
+    for (int m = DEBUG_VIEW_OFF; m < DEBUG_VIEW_MODE_COUNT; m++)
+    {
+        DebugViewMode mode = (DebugViewMode)m;
+        debugView.setMode(mode);
+        // The cost view's first frame only times the draws; the second is coloured by the times
+        for (int frame = 0; frame < (mode == DEBUG_VIEW_COST ? 2 : 1); frame++)
+        {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderQueue.setViewPosition(camera.Position);
+            scene.shaders.require(mode == DEBUG_VIEW_COST ? 0 : debugView.shaderFeatures());
+            scene.campus.submit(renderQueue, scene.shaders);
+            scene.campus.setFrameUniforms(scene.shaders, cell);
+            if (mode == DEBUG_VIEW_OFF)
+                renderQueue.flush();
+            else
+                debugView.draw(scene.campus, scene.shaders, renderQueue, cell);
+            glFinish();
+            debugView.costs.finish();
+        }
+        draws = renderQueue.lastStats.drawCalls;
+        if (debugView.heatmap())
+        {
+            histograms.push_back(DebugHistogram());
+            complete = debugView.histogram(histograms.back()) && complete;
+            const DebugHistogram& h = histograms.back();
+            std::cout << "DEBUG::" << DebugView::modeName(mode) << ": " << h.covered << " pixels covered, mean "
+                      << h.mean << ", max " << h.max << std::endl;
+            continue;
+        }
+        target.read(pixels);
+        for (size_t i = 0; i < pixels.size(); i += 4)
+        {
+            if (pixels[i] != 0 || pixels[i + 1] != 0 || pixels[i + 2] != 0)
+                drawnPixels[mode == DEBUG_VIEW_WIREFRAME]++;
+        }
+    }
+    scene.shaders.require(0);
+
+    // The histogram file, as F9 writes it
+    bool written = complete && DebugView::writeHistogram(histogramPath, histograms) &&
+                   std::ifstream(histogramPath).peek() != std::ifstream::traits_type::eof();
+    std::remove(histogramPath);
+
+    bool passed = written && histograms.size() == 3;
+    if (passed)
+    {
+        const DebugHistogram& overdraw = histograms[0];
+        const DebugHistogram& triangles = histograms[1];
+        const DebugHistogram& cost = histograms[2];
+        passed = overdraw.covered > 0 && triangles.covered == overdraw.covered && cost.covered == overdraw.covered &&
+                 overdraw.max >= 2.0f && overdraw.mean >= 1.0 && triangles.mean > 0.0 && cost.pixels[0] == 0 &&
+                 debugView.costs.lastDraws() == draws;
+    }
+    passed = passed && drawnPixels[1] > 0 && drawnPixels[1] < drawnPixels[0];
+    std::cout << "DEBUG::" << draws << " draws timed; wireframe draws " << drawnPixels[1] << " of the filled "
+              << drawnPixels[0] << " pixels" << (written ? "" : "; histogram file not written") << std::endl;
+    return passed;
+}
@@ -0,0 +1,118 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include "tests.h"
+#include "../include/frame_capture.h"
+#include "../include/view_uniforms.h"
+
+// A camera sweep drawn with and without capture at a frame per draw, comparing the average frame
+// time (glFinish stands in for the buffer swap, so the readback overlaps the next frame as it
+// would in the window), then the first frame of the video checked against that frame read back
+// directly: luma and the 2x2 chroma averages within rounding. Timing is reported, not judged; on
+// a software driver the encoders share the cores with the rasterizer.
+bool testFrameCapture(TestScene& scene)
+{
+    const int FRAMES = 60;
+    const char* path = "capture_test.y4m";
+    TestTarget target;
+    const CampusCell& cell = scene.cell();
+    const Camera& start = scene.camera;
+    ViewUniforms viewUniforms;
+    std::vector<unsigned char> reference;
+    double frameMs[2] = { 0.0, 0.0 };
+    FrameCapture capture;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1 && !capture.start(path, 30.0f, TEST_WIDTH, TEST_HEIGHT))
+            return false;
+        // The first frame (variant compiles) is not timed
+        for (int frame = 0; frame <= FRAMES; frame++)
+        {
+            double frameStart = glfwGetTime();
+            Camera camera(start.Position, glm::vec3(0.0f, 1.0f, 0.0f), start.Yaw + frame, start.Pitch);
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)TEST_WIDTH / TEST_HEIGHT,
+                                                    0.1f, 100.0f);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            viewUniforms.update(projection, camera.GetViewMatrix(), camera.Position);
+            scene.renderQueue.setViewPosition(camera.Position);
+            scene.campus.submit(scene.renderQueue, scene.shaders);
+            scene.campus.setFrameUniforms(scene.shaders, cell);
+            scene.renderQueue.flush();
+            glFinish();
+            if (pass == 1)
+                capture.frame(frame / 30.0, TEST_WIDTH, TEST_HEIGHT);
+            if (frame > 0)
+                frameMs[pass] += (glfwGetTime() - frameStart) * 1000.0;
+            else if (pass == 0)
+                target.read(reference);
+        }
+    }
+    capture.finish();
+    capture.report(std::cout);
+
+    // The file: header, then every frame whole
+    std::ifstream file(path, std::ios::binary);
+    std::string header;
+    std::getline(file, header);
+    size_t frameSize = TEST_WIDTH * TEST_HEIGHT * 3 / 2;
+    std::vector<unsigned char> video(6 + frameSize);
+    file.read((char*)&video[0], (std::streamsize)video.size());
+    bool complete = (bool)file && std::string((const char*)&video[0], 6) == "FRAME\n";
+    file.seekg(0, std::ios::end);
+    size_t expectedSize = header.size() + 1 + (size_t)capture.stats.written * (6 + frameSize);
+    bool sized = (size_t)file.tellg() == expectedSize;
+    file.close();
+    std::remove(path);
+
+    size_t lumaOff = 0, chromaOff = 0;
+    if (complete)
+    {
+        const unsigned char* luma = &video[6];
+        const unsigned char* cb = luma + TEST_WIDTH * TEST_HEIGHT;
+        const unsigned char* cr = cb + TEST_WIDTH * TEST_HEIGHT / 4;
+        for (int y = 0; y < TEST_HEIGHT; y += 2)
+        {
+            for (int x = 0; x < TEST_WIDTH; x += 2)
+            {
+                float r = 0.0f, g = 0.0f, b = 0.0f;
+                for (int i = 0; i < 4; i++)
+                {
+                    int px = x + (i & 1), py = y + (i >> 1);
+                    const unsigned char* p = &reference[((TEST_HEIGHT - 1 - py) * TEST_WIDTH + px) * 4];
+                    float expected = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+                    if (std::fabs(luma[py * TEST_WIDTH + px] - expected) > 1.0f)
+                        lumaOff++;
+                    r += p[0] / 4.0f;
+                    g += p[1] / 4.0f;
+                    b += p[2] / 4.0f;
+                }
+                size_t c = (y / 2) * (TEST_WIDTH / 2) + x / 2;
+                float expectedCb = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+                float expectedCr = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+                if (std::fabs(cb[c] - expectedCb) > 1.0f || std::fabs(cr[c] - expectedCr) > 1.0f)
+                    chromaOff++;
+            }
+        }
+    }
+
+    const CaptureStats& stats = capture.stats;
+    unsigned int dropped = stats.gpuDrops + stats.encoderDrops + stats.sizeDrops;
+    bool passed = complete && sized && lumaOff == 0 && chromaOff == 0 && stats.failedWrites == 0 &&
+                  stats.captured + dropped == FRAMES + 1 && stats.written == FRAMES + 1;
+    double off = frameMs[0] / FRAMES, on = frameMs[1] / FRAMES;
+    std::cout << "CAPTURE::Frame time " << off << " ms without capture, " << on << " ms with ("
+              << (off > 0.0 ? (on - off) / off * 100.0 : 0.0) << "% more); render thread "
+              << stats.renderMs / stats.frames << " ms per frame; " << dropped << " of " << FRAMES + 1
+              << " frames dropped" << std::endl;
+    std::cout << "CAPTURE::First frame: " << lumaOff << " luma and " << chromaOff << " chroma samples off"
+              << (complete && sized ? "" : ", video file incomplete") << std::endl;
+    return passed;
+}
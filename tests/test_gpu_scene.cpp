@@ -0,0 +1,59 @@
+#include <GL/glew.h>
+#include <iostream>
+#include <vector>
+#include "tests.h"
+#include "../include/gpu_scene.h"
+#include "../include/view_uniforms.h"
+
+// The start view drawn with the render queue and with the GPU-driven path: the same image within
+// rounding (matrices are built differently on each path) and the objects the CPU frustum test
+// keeps
+bool testGpuDriven(TestScene& scene)
+{
+    GpuScene gpuScene;
+    if (!GpuScene::supported() || !gpuScene.initialize("shaders/cull.comp"))
+    {
+        std::cout << "GPU::Test FAILED: GPU-driven path unavailable" << std::endl;
+        return false;
+    }
+    TestTarget target;
+
+    // Same geometry both ways: no LOD switching
+    gpuScene.lodScale = 0.0f;
+    gpuScene.update(scene.campus);
+    gpuScene.prepare(scene.shaders);
+    Camera& camera = scene.camera;
+    glm::mat4 projection = scene.projection();
+    glm::mat4 view = camera.GetViewMatrix();
+    ViewUniforms viewUniforms;
+    viewUniforms.update(projection, view, camera.Position);
+
+    std::vector<unsigned char> images[2];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (pass == 0)
+        {
+            scene.renderQueue.setViewPosition(camera.Position);
+            scene.campus.submit(scene.renderQueue, scene.shaders);
+        }
+        scene.campus.setFrameUniforms(scene.shaders, scene.cell());
+        if (pass == 0)
+            scene.renderQueue.flush();
+        else
+            gpuScene.render(scene.shaders, projection, view, camera.Position,
+                            (float)scene.campus.animationClock());
+        target.read(images[pass]);
+    }
+
+    size_t differing = differingPixels(images[0], images[1], 2);
+    double differingPercent = 100.0 * differing / (TEST_WIDTH * TEST_HEIGHT);
+    unsigned int gpuVisible = gpuScene.visibleCount();
+    unsigned int cpuVisible = GpuScene::cpuVisibleCount(scene.campus, projection * view);
+
+    bool passed = gpuVisible == cpuVisible && differingPercent < 0.5;
+    std::cout << "GPU::" << gpuVisible << " of " << gpuScene.objectCount() << " objects visible (CPU frustum test: "
+              << cpuVisible << "), " << differing << " pixels differ (" << differingPercent << "%)" << std::endl;
+    return passed;
+}
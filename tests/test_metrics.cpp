@@ -0,0 +1,105 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include "tests.h"
+#include "../include/metrics.h"
+
+// The exposition must hold this whole line
+static bool expectLine(const std::string& exposition, const std::string& line)
+{
+    if (("\n" + exposition).find("\n" + line + "\n") != std::string::npos)
+        return true;
+    std::cout << "METRICS::Missing line: " << line << std::endl;
+    return false;
+}
+
+// Each family's HELP and TYPE once, followed by all of its series and nothing else's
+static bool familiesContiguous(const std::string& exposition)
+{
+    std::istringstream in(exposition);
+    std::string line, family;
+    std::map<std::string, int> headers;
+    bool contiguous = true;
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, 7, "# HELP ") == 0)
+        {
+            family = line.substr(7, line.find(' ', 7) - 7);
+            if (++headers[family] > 1)
+            {
+                std::cout << "METRICS::Family " << family << " is split" << std::endl;
+                contiguous = false;
+            }
+            continue;
+        }
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::string name = line.substr(0, line.find_first_of("{ "));
+        std::string suffix = name.compare(0, family.size(), family) == 0 ? name.substr(family.size()) : "?";
+        if (family.empty() || (suffix != "" && suffix != "_bucket" && suffix != "_sum" && suffix != "_count"))
+        {
+            std::cout << "METRICS::Series " << name << " listed under family " << family << std::endl;
+            contiguous = false;
+        }
+    }
+    return contiguous;
+}
+
+// The exposition groups the series of a family even when registered apart, lists histogram
+// buckets cumulatively up to le="+Inf", and metricLabel escapes backslashes, quotes and newlines
+bool testMetrics()
+{
+    MetricsRegistry registry;
+    const std::string help = "Test counter";
+    Metric* programs = registry.counter("test_changes_total", help, metricLabel("state", "program"));
+    Metric* resident = registry.gauge("test_resident_bytes", "Test gauge");
+    Metric* textures = registry.counter("test_changes_total", help, metricLabel("state", "texture"));
+    std::vector<double> bounds;
+    bounds.push_back(1.0);
+    bounds.push_back(5.0);
+    bounds.push_back(10.0);
+    Metric* frames = registry.histogram("test_frame_ms", "Test histogram", bounds);
+    Metric* asset = registry.gauge("test_asset_bytes", "Test labels", metricLabel("asset", "a\\b\"c\nd"));
+    bool passed = true;
+
+    if (registry.counter("test_changes_total", help, metricLabel("state", "program")) != programs ||
+        registry.size() != 5)
+    {
+        std::cout << "METRICS::Registering an existing series added another" << std::endl;
+        passed = false;
+    }
+    programs->add(3.0);
+    textures->add(2.0);
+    resident->set(1024.0);
+    asset->set(7.0);
+    double observations[] = { 0.5, 1.0, 3.0, 7.0, 50.0 };  // 1.0 is on a bound: le is inclusive
+    for (size_t i = 0; i < sizeof(observations) / sizeof(observations[0]); i++)
+        frames->observe(observations[i]);
+
+    std::string text = registry.exposition();
+    passed = familiesContiguous(text) && passed;
+    passed = expectLine(text, "test_changes_total{state=\"program\"} 3") && passed;
+    passed = expectLine(text, "test_changes_total{state=\"texture\"} 2") && passed;
+    passed = expectLine(text, "test_resident_bytes 1024") && passed;
+    passed = expectLine(text, "# TYPE test_frame_ms histogram") && passed;
+    passed = expectLine(text, "test_frame_ms_bucket{le=\"1\"} 2") && passed;
+    passed = expectLine(text, "test_frame_ms_bucket{le=\"5\"} 3") && passed;
+    passed = expectLine(text, "test_frame_ms_bucket{le=\"10\"} 4") && passed;
+    passed = expectLine(text, "test_frame_ms_bucket{le=\"+Inf\"} 5") && passed;
+    passed = expectLine(text, "test_frame_ms_sum 61.5") && passed;
+    passed = expectLine(text, "test_frame_ms_count 5") && passed;
+    passed = expectLine(text, "test_asset_bytes{asset=\"a\\\\b\\\"c\\nd\"} 7") && passed;
+
+    if (metricLabel("k", "plain") != "k=\"plain\"" || metricLabel("k", "") != "k=\"\"")
+    {
+        std::cout << "METRICS::metricLabel changed a value needing no escapes" << std::endl;
+        passed = false;
+    }
+    if (!passed)
+        std::cout << "METRICS::Exposition:\n" << text;
+    else
+        std::cout << "METRICS::Families contiguous, buckets cumulative to +Inf, labels escaped" << std::endl;
+    return passed;
+}
@@ -0,0 +1,111 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <vector>
+#include "tests.h"
+#include "../include/multi_view.h"
+#include "../include/view_uniforms.h"
+
+// Two and four stereo views of the start position drawn in one pass (layered when the driver has
+// gl_Layer in vertex shaders, and split), each column compared with that view drawn on its own.
+// Submission (queueing plus the GL calls, from an idle GPU) is timed both ways; on a software
+// driver such as llvmpipe the draw calls include vertex shading, so the one-pass time grows with
+// the views there.
+bool testMultiView(TestScene& scene)
+{
+    const int TIMED_FRAMES = 20;
+    const float SEPARATION = 0.064f, CONVERGENCE = 3.0f;
+    TestTarget target;
+    Camera& camera = scene.camera;
+    const CampusCell& cell = scene.cell();
+    RenderQueue& renderQueue = scene.renderQueue;
+    ViewUniforms viewUniforms;
+    MultiView multiView;
+    std::vector<unsigned char> separate, combined;
+    bool passed = true;
+
+    for (unsigned int views = 2; views <= 4; views *= 2)
+    {
+        for (int m = 0; m < 2; m++)
+        {
+            MultiViewMode mode = m == 0 ? MULTIVIEW_LAYERED : MULTIVIEW_SPLIT;
+            if (mode == MULTIVIEW_LAYERED && !MultiView::layeredSupported())
+                continue;
+            multiView.initialize(views, mode);
+            MultiViewCamera cameras[MultiView::MAX_VIEWS];
+            multiView.stereoCameras(camera, (float)TEST_WIDTH / views / TEST_HEIGHT, SEPARATION, CONVERGENCE,
+                                    cameras);
+
+            // A pass per view into its column, the way two runs of the frame loop would draw it;
+            // the first frame (variant compiles, instance divisors) is not timed
+            double separateMs = 0.0, combinedMs = 0.0;
+            unsigned int separateDraws = 0, combinedDraws = 0, separateCalls = 0, combinedCalls = 0;
+            scene.shaders.require(0);
+            renderQueue.setViewCount(1);
+            for (int frame = 0; frame <= TIMED_FRAMES; frame++)
+            {
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glFinish();
+                double start = glfwGetTime();
+                separateDraws = separateCalls = 0;
+                for (unsigned int v = 0; v < views; v++)
+                {
+                    int x0 = TEST_WIDTH * v / views, x1 = TEST_WIDTH * (v + 1) / views;
+                    glViewport(x0, 0, x1 - x0, TEST_HEIGHT);
+                    viewUniforms.update(cameras[v].projection, cameras[v].view, cameras[v].position);
+                    renderQueue.setViewPosition(cameras[v].position);
+                    scene.campus.submit(renderQueue, scene.shaders);
+                    scene.campus.setFrameUniforms(scene.shaders, cell);
+                    renderQueue.flush();
+                    separateDraws += renderQueue.lastStats.drawCalls;
+                    separateCalls += renderQueue.lastStats.glCalls();
+                }
+                if (frame > 0)
+                    separateMs += (glfwGetTime() - start) * 1000.0;
+                glFinish();
+            }
+            target.read(separate);
+
+            // Every view from one pass
+            scene.shaders.require(multiView.shaderFeatures());
+            renderQueue.setViewCount(views);
+            for (int frame = 0; frame <= TIMED_FRAMES; frame++)
+            {
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                multiView.begin(TEST_WIDTH, TEST_HEIGHT);
+                glFinish();
+                double start = glfwGetTime();
+                multiView.update(cameras);
+                renderQueue.setViewPosition(camera.Position);
+                scene.campus.submit(renderQueue, scene.shaders);
+                scene.campus.setFrameUniforms(scene.shaders, cell);
+                renderQueue.flush();
+                if (frame > 0)
+                    combinedMs += (glfwGetTime() - start) * 1000.0;
+                multiView.end();
+                combinedDraws = renderQueue.lastStats.drawCalls;
+                combinedCalls = renderQueue.lastStats.glCalls();
+                glFinish();
+            }
+            target.read(combined);
+
+            // Within rounding: the split path moves x after projection
+            size_t differing = differingPixels(separate, combined, 2);
+            double differingPercent = 100.0 * differing / (TEST_WIDTH * TEST_HEIGHT);
+            bool ok = differingPercent < 0.5 && combinedDraws * views == separateDraws;
+            passed = passed && ok;
+            std::cout << "MULTIVIEW::" << views << " views, " << MultiView::modeName(mode) << ": " << differing
+                      << " pixels differ (" << differingPercent << "%); one pass: " << combinedDraws << " draws, "
+                      << combinedCalls << " GL calls, " << combinedMs / TIMED_FRAMES << " ms to submit; pass per view: "
+                      << separateDraws << " draws, " << separateCalls << " GL calls, " << separateMs / TIMED_FRAMES
+                      << " ms" << (ok ? "" : " FAILED") << std::endl;
+        }
+    }
+
+    scene.shaders.require(0);
+    renderQueue.setViewCount(1);
+    glViewport(0, 0, TEST_WIDTH, TEST_HEIGHT);
+    return passed;
+}
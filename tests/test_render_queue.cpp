@@ -0,0 +1,136 @@
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "tests.h"
+#include "../include/render_queue.h"
+
+static bool byKey(const DrawSortEntry& a, const DrawSortEntry& b)
+{
+    return a.key < b.key;
+}
+
+// Radix-sorts entries and compares with std::stable_sort: same keys in the same order, equal keys
+// in submission order
+static bool sortsLikeStableSort(std::vector<DrawSortEntry> entries, const char* what)
+{
+    std::vector<DrawSortEntry> expected = entries, scratch;
+    std::stable_sort(expected.begin(), expected.end(), byKey);
+    radixSortEntries(entries, scratch);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].key != expected[i].key || entries[i].index != expected[i].index)
+        {
+            std::cout << "QUEUE::Radix sort of " << what << " differs from std::stable_sort at entry " << i
+                      << " of " << entries.size() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// The packet sort against std::stable_sort on random keys, on keys sharing most bytes (the pass
+// skipping shortcut) and on many equal keys (stability)
+bool testRenderSort()
+{
+    std::mt19937_64 rng(7);
+    const size_t COUNT = 5000;
+    std::vector<DrawSortEntry> random(COUNT), sharedBytes(COUNT), equalKeys(COUNT);
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        uint32_t index = (uint32_t)i;
+        random[i].key = rng();
+        random[i].index = index;
+        // Only the layer and depth bytes vary; the passes over the bytes in between are skipped
+        sharedBytes[i].key = 0x0012345678000000ull | ((rng() & 0x3) << 60) | (rng() & 0xFFFF);
+        sharedBytes[i].index = index;
+        equalKeys[i].key = ((rng() % 4) << 40) | (rng() % 4);  // 16 distinct keys over two passes
+        equalKeys[i].index = index;
+    }
+
+    bool passed = sortsLikeStableSort(random, "random keys");
+    passed = sortsLikeStableSort(sharedBytes, "keys sharing bytes") && passed;
+    passed = sortsLikeStableSort(equalKeys, "equal keys") && passed;
+    passed = sortsLikeStableSort(std::vector<DrawSortEntry>(1, random[0]), "one key") && passed;
+    passed = sortsLikeStableSort(std::vector<DrawSortEntry>(), "no keys") && passed;
+
+    // Presorted and reversed input
+    std::vector<DrawSortEntry> sorted = random, scratch;
+    radixSortEntries(sorted, scratch);
+    std::vector<DrawSortEntry> reversed(sorted.rbegin(), sorted.rend());
+    passed = sortsLikeStableSort(sorted, "sorted keys") && sortsLikeStableSort(reversed, "reversed keys") && passed;
+    if (passed)
+        std::cout << "QUEUE::Radix sort matches std::stable_sort on " << COUNT << " keys" << std::endl;
+    return passed;
+}
+
+static bool expectCalls(const RenderStats& stats, unsigned int programBinds, unsigned int vaoBinds,
+                        unsigned int uniformUploads, const char* step)
+{
+    if (stats.programBinds == programBinds && stats.vaoBinds == vaoBinds && stats.uniformUploads == uniformUploads)
+        return true;
+    std::cout << "QUEUE::After " << step << ": " << stats.programBinds << " program binds, " << stats.vaoBinds
+              << " VAO binds and " << stats.uniformUploads << " uniform uploads; expected " << programBinds << ", "
+              << vaoBinds << " and " << uniformUploads << std::endl;
+    return false;
+}
+
+// GLStateCache skips repeated program, VAO, material and matrix changes until reset(), and a
+// flush of packets sharing them binds each once
+bool testStateCache(TestScene& scene)
+{
+    Shader& plain = scene.shaders.get(0);
+    Shader& specular = scene.shaders.get(FEATURE_SPECULAR);
+    Material wood(glm::vec3(0.4f, 0.3f, 0.2f), glm::vec3(0.6f, 0.4f, 0.3f), glm::vec3(0.0f), 8.0f);
+    Material metal(glm::vec3(0.3f), glm::vec3(0.5f), glm::vec3(0.8f), 64.0f);
+    wood.id = 1;
+    metal.id = 2;
+    glm::mat4 placement = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, -2.0f));
+    unsigned int VAO;
+    glGenVertexArrays(1, &VAO);
+
+    GLStateCache cache;
+    bool passed = true;
+    for (int i = 0; i < 3; i++)
+    {
+        cache.useProgram(plain);
+        cache.bindVertexArray(VAO);
+        cache.setMaterial(plain, wood);
+        cache.setModel(plain, placement);
+    }
+    passed = expectCalls(cache.stats, 1, 1, 5, "repeating one draw's state") && passed;
+    cache.setMaterial(plain, metal);
+    passed = expectCalls(cache.stats, 1, 1, 9, "a material change") && passed;
+    cache.useProgram(specular);
+    cache.useProgram(plain);
+    cache.setMaterial(plain, metal);  // Still set in this program
+    passed = expectCalls(cache.stats, 3, 1, 9, "switching programs and back") && passed;
+    cache.reset();
+    cache.useProgram(plain);
+    cache.bindVertexArray(VAO);
+    cache.setMaterial(plain, metal);
+    passed = expectCalls(cache.stats, 4, 2, 13, "a reset") && passed;
+
+    // Interleaved submissions sorted into one program and VAO bind, one upload per material
+    RenderQueue queue;
+    for (int i = 0; i < 6; i++)
+        queue.submit(LAYER_OPAQUE, plain, VAO, 3, i % 2 ? &metal : &wood, placement, glm::vec3(0.0f));
+    queue.flush();
+    passed = expectCalls(queue.lastStats, 1, 1, 9, "flushing six draws of two materials") && passed;
+    if (queue.lastStats.drawCalls != 6 || queue.lastStats.glCalls() >= queue.lastNaiveStats.glCalls())
+    {
+        std::cout << "QUEUE::Flush issued " << queue.lastStats.drawCalls << " draws in " << queue.lastStats.glCalls()
+                  << " GL calls, unsorted " << queue.lastNaiveStats.glCalls() << std::endl;
+        passed = false;
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDeleteVertexArrays(1, &VAO);
+    if (passed)
+        std::cout << "QUEUE::Repeated binds suppressed; six draws in " << queue.lastStats.glCalls()
+                  << " GL calls instead of " << queue.lastNaiveStats.glCalls() << std::endl;
+    return passed;
+}
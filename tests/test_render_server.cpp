@@ -0,0 +1,140 @@
+#include <GL/glew.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include "tests.h"
+#include "../include/render_server.h"
+#include "../include/thumbnail_batch.h"
+
+// What one thin client saw
+struct ServerTestClient
+{
+    bool connected;
+    unsigned int frames, invalid;
+    std::vector<float> roundTripMs;  // Camera sent to the first frame showing it received
+
+    ServerTestClient() : connected(false), frames(0), invalid(0) {}
+};
+
+// A thin client: sends a camera swaying around center at 60 Hz for seconds and checks every frame
+// that comes back
+static void runServerTestClient(std::string address, glm::vec3 center, float yaw, int width, int height,
+                                double seconds, ServerTestClient* result)
+{
+    typedef std::chrono::steady_clock Clock;
+    RenderClient client;
+    if (!client.connect(address))
+        return;
+    result->connected = true;
+    Clock::time_point start = Clock::now(), nextSend = start;
+    uint32_t sequence = 0, shown = 0;
+    FrameHeader header;
+    std::vector<uint8_t> qoi;
+    while (client.connected() && Clock::now() - start < std::chrono::duration<double>(seconds))
+    {
+        if (Clock::now() >= nextSend)
+        {
+            float t = std::chrono::duration<float>(Clock::now() - start).count();
+            CameraUpdate update;
+            update.sequence = ++sequence;
+            update.position = center + glm::vec3(0.5f * std::sin(t), 0.0f, 0.5f * std::cos(t));
+            update.yaw = yaw + 30.0f * std::sin(2.0f * t);
+            update.pitch = -5.0f;
+            update.stamp = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now().time_since_epoch()).count();
+            client.send(update);
+            nextSend += std::chrono::microseconds(16667);
+        }
+        if (!client.receive(header, qoi, 2))
+            continue;
+
+        // A QOI image of the agreed size, showing a camera this client sent, never older than
+        // the last one shown
+        bool valid = header.width == (unsigned int)width && header.height == (unsigned int)height &&
+                     qoi.size() >= 22 && std::memcmp(&qoi[0], "qoif", 4) == 0 &&
+                     (qoi[4] << 24 | qoi[5] << 16 | qoi[6] << 8 | qoi[7]) == width &&
+                     (qoi[8] << 24 | qoi[9] << 16 | qoi[10] << 8 | qoi[11]) == height &&
+                     header.sequence >= std::max(1u, shown) && header.sequence <= sequence;
+        if (!valid)
+        {
+            result->invalid++;
+            continue;
+        }
+        result->frames++;
+        if (header.sequence != shown)
+        {
+            uint64_t now = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now().time_since_epoch()).count();
+            result->roundTripMs.push_back((now - header.stamp) / 1000.0f);
+        }
+        shown = header.sequence;
+    }
+}
+
+// 1, 2, 4 and then 8 thin clients served over a Unix socket, each a thread that sends a moving
+// camera at 60 Hz for a few seconds and checks the frames coming back, with per-client latency
+// and the aggregate throughput reported as the count grows. Passes when every client received
+// valid frames; rates are reported, not judged (on a software driver the clients, writers and
+// rasterizer share the cores). Advances the animation clock, so it runs last.
+bool testRenderServer(TestScene& scene)
+{
+    const char* address = "unix:serve_test.sock";
+    const float SECONDS = 3.0f, TICK_RATE = 30.0f;
+    const int WIDTH = 320, HEIGHT = 240;
+    RenderServer server;
+    ThumbnailBatch batch;
+    if (!batch.initialize(&server, WIDTH, HEIGHT, 8, MULTIVIEW_LAYERED, 0) || !server.start(address, WIDTH, HEIGHT))
+        return false;
+    scene.shaders.require(batch.shaderFeatures());
+    scene.renderQueue.setViewCount(batch.viewsPerPass());
+
+    bool passed = true;
+    for (unsigned int count = 1; count <= 8; count *= 2)
+    {
+        std::vector<ServerTestClient> results(count);
+        std::vector<std::thread> clients;
+        for (unsigned int c = 0; c < count; c++)
+            clients.push_back(std::thread(runServerTestClient, std::string(address), scene.camera.Position,
+                                          scene.camera.Yaw + 45.0f * c, WIDTH, HEIGHT, (double)SECONDS,
+                                          &results[c]));
+        // A little longer than the clients, for the frames still in flight
+        std::cout << "SERVER::" << count << " clients for " << SECONDS << " s at " << TICK_RATE << " ticks/s"
+                  << std::endl;
+        passed = server.run(scene.campus, scene.assets, scene.shaders, scene.renderQueue, batch, TICK_RATE,
+                            SECONDS + 0.5f) && passed;
+        for (unsigned int c = 0; c < count; c++)
+            clients[c].join();
+
+        unsigned int frames = 0;
+        for (unsigned int c = 0; c < count; c++)
+        {
+            ServerTestClient& result = results[c];
+            std::vector<float>& roundTrip = result.roundTripMs;
+            std::sort(roundTrip.begin(), roundTrip.end());
+            double mean = 0.0;
+            for (size_t i = 0; i < roundTrip.size(); i++)
+                mean += roundTrip[i];
+            mean = roundTrip.empty() ? 0.0 : mean / roundTrip.size();
+            float p95 = roundTrip.empty() ? 0.0f :
+                        roundTrip[std::min(roundTrip.size() - 1, roundTrip.size() * 95 / 100)];
+            bool ok = result.connected && result.frames > 0 && result.invalid == 0;
+            passed = passed && ok;
+            frames += result.frames;
+            std::cout << "SERVER::Test client " << c << ": " << result.frames << " frames received ("
+                      << result.frames / SECONDS << "/s), round trip mean " << mean << " ms, p95 " << p95 << " ms, "
+                      << result.invalid << " invalid" << (ok ? "" : " FAILED") << std::endl;
+        }
+        std::cout << "SERVER::" << count << " clients: " << frames / SECONDS << " frames/s received in total"
+                  << std::endl;
+    }
+    server.stop();
+    scene.shaders.require(0);
+    scene.renderQueue.setViewCount(1);
+    glViewport(0, 0, TEST_WIDTH, TEST_HEIGHT);
+    return passed;
+}
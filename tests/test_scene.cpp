@@ -0,0 +1,191 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "tests.h"
+#include "../include/scene.h"
+
+static const char* TEXT_PATH = "scene_test.scene";
+static const char* COMPILED_PATH = "scene_test.sceneb";
+
+static const char* SCENE_TEXT =
+    "# Scene format test\n"
+    "room 10 6 3 0.25\n"
+    "material floor 0.5 0.5 0.5  0.7 0.7 0.7  0.4 0.4 0.4  32\n"
+    "material wood  0.4 0.3 0.2  0.6 0.4 0.3  0.0 0.0 0.0  8\n"
+    "texture wood textures/wood.dds\n"
+    "shell floor floor\n"
+    "shell ceiling wood\n"
+    "shell walls floor\n"
+    "model desk models/desk.obj fallback box 1.2 0.75 0.6 seats 2 0.6 0.3\n"
+    "model fan models/fan.obj fallback bench spin blades\n"
+    "box wood 1 0.5 -2  2 1 0.5\n"
+    "fixture 0 2.95 0  1.5 0.1 0.3\n"
+    "instance fan floor 0 2.9 0 0 1 120\n"
+    "instance desk wood -2 0 1 90 0.5\n"
+    "instance desk floor 2 0 1 -90 0.5\n"
+    "light 0 2.5 0  1 1 0.9\n"
+    "camera 0 1.7 2.5  -90 -10\n";
+
+static void writeText(const char* path, const std::string& text)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+}
+
+// Load through a parser with its log captured; the log is returned in `log`
+static bool loadCaptured(bool (*load)(const std::string&, Scene&), const char* path, Scene& scene,
+                         std::string& log)
+{
+    std::ostringstream captured;
+    std::streambuf* previous = std::cout.rdbuf(captured.rdbuf());
+    bool loaded = load(path, scene);
+    std::cout.rdbuf(previous);
+    log = captured.str();
+    return loaded;
+}
+
+// Field by field: ids and texture layers are assigned later and not part of either format
+static bool sameScene(const Scene& a, const Scene& b)
+{
+    const RoomShell& ra = a.room;
+    const RoomShell& rb = b.room;
+    bool same = ra.width == rb.width && ra.length == rb.length && ra.height == rb.height &&
+                ra.wallThickness == rb.wallThickness && ra.floorMaterial == rb.floorMaterial &&
+                ra.ceilingMaterial == rb.ceilingMaterial && ra.wallMaterial == rb.wallMaterial;
+    same = same && a.materialNames == b.materialNames && a.materialTextures == b.materialTextures &&
+           a.materials.size() == b.materials.size() && a.models.size() == b.models.size();
+    for (size_t i = 0; same && i < a.materials.size(); i++)
+    {
+        const Material& ma = a.materials[i];
+        const Material& mb = b.materials[i];
+        same = ma.ambient == mb.ambient && ma.diffuse == mb.diffuse && ma.specular == mb.specular &&
+               ma.shininess == mb.shininess;
+    }
+    for (size_t i = 0; same && i < a.models.size(); i++)
+    {
+        const SceneModel& ma = a.models[i];
+        const SceneModel& mb = b.models[i];
+        same = ma.name == mb.name && ma.path == mb.path && ma.fallback == mb.fallback &&
+               ma.fallbackSize == mb.fallbackSize && ma.spinGroup == mb.spinGroup && ma.seatCount == mb.seatCount &&
+               ma.seatSpacing == mb.seatSpacing && ma.seatOffset == mb.seatOffset;
+    }
+    const SceneBoxes& ba = a.boxes;
+    const SceneBoxes& bb = b.boxes;
+    same = same && ba.material == bb.material && ba.emissive == bb.emissive && ba.centerX == bb.centerX &&
+           ba.centerY == bb.centerY && ba.centerZ == bb.centerZ && ba.sizeX == bb.sizeX && ba.sizeY == bb.sizeY &&
+           ba.sizeZ == bb.sizeZ;
+    const SceneInstances& ia = a.instances;
+    const SceneInstances& ib = b.instances;
+    same = same && ia.model == ib.model && ia.material == ib.material && ia.posX == ib.posX && ia.posY == ib.posY &&
+           ia.posZ == ib.posZ && ia.yaw == ib.yaw && ia.scale == ib.scale && ia.spin == ib.spin;
+    same = same && a.modelRanges.size() == b.modelRanges.size();
+    for (size_t i = 0; same && i < a.modelRanges.size(); i++)
+        same = a.modelRanges[i].first == b.modelRanges[i].first && a.modelRanges[i].count == b.modelRanges[i].count;
+    return same && a.lightPosition == b.lightPosition && a.lightColor == b.lightColor &&
+           a.cameraPosition == b.cameraPosition && a.cameraYaw == b.cameraYaw && a.cameraPitch == b.cameraPitch &&
+           a.sourceSize == b.sourceSize && a.sourceHash == b.sourceHash;
+}
+
+// A malformed text scene must fail with an ERROR::SCENE line naming the offending line
+static bool rejectsLine(const std::string& text, int line, const std::string& message)
+{
+    writeText(TEXT_PATH, text);
+    Scene scene;
+    std::string log;
+    bool loaded = loadCaptured(loadSceneText, TEXT_PATH, scene, log);
+    std::ostringstream expected;
+    expected << "ERROR::SCENE::" << TEXT_PATH << ":" << line << ": " << message;
+    if (loaded || log.find(expected.str()) == std::string::npos)
+    {
+        std::cout << "SCENE::Expected \"" << expected.str() << "\", got " << (loaded ? "a loaded scene" : log);
+        return false;
+    }
+    return true;
+}
+
+// The text and compiled forms load into the same scene; truncated, outdated and stale compiled
+// files are rejected; malformed text is reported with its line.
+bool testSceneFormats()
+{
+    bool passed = true;
+    std::string log;
+
+    // Text, compiled, and back: identical scenes
+    writeText(TEXT_PATH, SCENE_TEXT);
+    Scene text, compiled;
+    if (!loadSceneText(TEXT_PATH, text) || !saveSceneBinary(COMPILED_PATH, text) ||
+        !loadSceneBinary(COMPILED_PATH, compiled))
+    {
+        std::cout << "SCENE::Failed to load or compile " << TEXT_PATH << std::endl;
+        passed = false;
+    }
+    else if (text.instances.size() != 3 || text.models.size() != 2 || text.boxes.size() != 2 ||
+             !sameScene(text, compiled))
+    {
+        std::cout << "SCENE::The compiled scene differs from the text it was compiled from" << std::endl;
+        passed = false;
+    }
+
+    // Every truncation of the compiled file is rejected
+    std::string bytes;
+    {
+        std::ifstream in(COMPILED_PATH, std::ios::binary);
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        bytes = contents.str();
+    }
+    size_t truncationsLoaded = 0;
+    for (size_t length = 0; length < bytes.size(); length++)
+    {
+        writeText(COMPILED_PATH, bytes.substr(0, length));
+        Scene truncated;
+        if (loadCaptured(loadSceneBinary, COMPILED_PATH, truncated, log))
+            truncationsLoaded++;
+    }
+    if (truncationsLoaded > 0)
+    {
+        std::cout << "SCENE::" << truncationsLoaded << " of " << bytes.size()
+                  << " truncations of the compiled scene loaded" << std::endl;
+        passed = false;
+    }
+
+    // Another format version is rejected
+    std::string outdated = bytes;
+    outdated[4] = (char)(outdated[4] + 1);
+    writeText(COMPILED_PATH, outdated);
+    Scene old;
+    if (loadCaptured(loadSceneBinary, COMPILED_PATH, old, log))
+    {
+        std::cout << "SCENE::A compiled scene of another format version loaded" << std::endl;
+        passed = false;
+    }
+
+    // A compiled copy of other text is not used in place of the edited text
+    writeText(COMPILED_PATH, bytes);
+    std::string edited = std::string(SCENE_TEXT) + "instance desk wood 0 0 -2 0 0.5\n";
+    writeText(TEXT_PATH, edited);
+    Scene current;
+    if (!loadCaptured(loadScene, TEXT_PATH, current, log) || current.instances.size() != 4)
+    {
+        std::cout << "SCENE::A stale compiled scene was used instead of the edited text" << std::endl;
+        passed = false;
+    }
+
+    // Errors with their line numbers
+    std::string header = "material floor 0.5 0.5 0.5  0.7 0.7 0.7  0.4 0.4 0.4  32\n";
+    passed = rejectsLine(header + "\nwindow 1 2 3\n", 3, "unknown directive 'window'") && passed;
+    passed = rejectsLine(header + header, 2, "duplicate material 'floor'") && passed;
+    passed = rejectsLine(header + "# Too narrow\nroom 10 -6 3 0.2\n", 3, "room length must be a positive number") &&
+             passed;
+    passed = rejectsLine(header + "room 10 6 3 0\n", 2, "room wall thickness must be a positive number") && passed;
+    passed = rejectsLine("room 1e6 1e6 3 0.2\n", 1, "room too large") && passed;
+
+    std::remove(TEXT_PATH);
+    std::remove(COMPILED_PATH);
+    if (passed)
+        std::cout << "SCENE::Compiled scene matches its text; " << bytes.size() << " truncations, an outdated and "
+                  << "a stale compiled scene rejected; errors reported with their lines" << std::endl;
+    return passed;
+}
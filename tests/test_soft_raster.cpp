@@ -0,0 +1,89 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "tests.h"
+#include "../include/soft_raster.h"
+#include "../include/view_uniforms.h"
+
+// The start view drawn with GL and with the software rasterizer: the same image within rounding
+// and edge tie-breaks, the scalar and AVX2 kernels agreeing exactly, and the image presented
+// unchanged. Both renderers are timed; under Mesa llvmpipe this compares the CPU renderers.
+bool testSoftwareRaster(TestScene& scene)
+{
+    const int TIMED_FRAMES = 30;
+    Camera& camera = scene.camera;
+    const CampusCell& cell = scene.cell();
+    glm::mat4 projection = scene.projection();
+    glm::mat4 view = camera.GetViewMatrix();
+    ViewUniforms viewUniforms;
+    viewUniforms.update(projection, view, camera.Position);
+
+    // GL, timed to completion of every frame
+    std::vector<unsigned char> reference;
+    double glSeconds;
+    std::string renderer = (const char*)glGetString(GL_RENDERER);
+    {
+        TestTarget target;
+        double glStart = glfwGetTime();
+        for (int frame = 0; frame <= TIMED_FRAMES; frame++)
+        {
+            if (frame == 1)
+                glStart = glfwGetTime();  // The first frame compiles variants
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene.renderQueue.setViewPosition(camera.Position);
+            scene.campus.submit(scene.renderQueue, scene.shaders);
+            scene.campus.setFrameUniforms(scene.shaders, cell);
+            scene.renderQueue.flush();
+            glFinish();
+        }
+        glSeconds = glfwGetTime() - glStart;
+        target.read(reference);
+    }
+
+    SoftwareRasterizer raster;
+    raster.resize(TEST_WIDTH, TEST_HEIGHT);
+    RasterPath best = SoftwareRasterizer::path();
+    bool kernelsAgree = true;
+    if (best != RASTER_SCALAR)
+    {
+        SoftwareRasterizer::setPath(RASTER_SCALAR);
+        scene.campus.rasterize(raster, cell, projection, view, camera.Position);
+        std::vector<uint8_t> scalar = raster.pixels();
+        SoftwareRasterizer::setPath(best);
+        scene.campus.rasterize(raster, cell, projection, view, camera.Position);
+        kernelsAgree = scalar == raster.pixels();
+    }
+    double softwareStart = glfwGetTime();
+    for (int frame = 0; frame < TIMED_FRAMES; frame++)
+        scene.campus.rasterize(raster, cell, projection, view, camera.Position);
+    double softwareSeconds = glfwGetTime() - softwareStart;
+
+    // The window's path: the image blitted into the bound framebuffer
+    std::vector<unsigned char> presented;
+    {
+        TestTarget target;
+        SoftwarePresenter presenter;
+        presenter.present(raster);
+        target.read(presented);
+    }
+    bool presentedExact = presented == raster.pixels();
+
+    size_t differing = differingPixels(reference, raster.pixels(), 3);
+    double differingPercent = 100.0 * differing / (TEST_WIDTH * TEST_HEIGHT);
+    double glFps = TIMED_FRAMES / std::max(glSeconds, 1e-6);
+    double softwareFps = TIMED_FRAMES / std::max(softwareSeconds, 1e-6);
+
+    bool passed = kernelsAgree && presentedExact && differingPercent < 1.0;
+    std::cout << "RASTER::" << differing << " pixels differ from " << renderer << " (" << differingPercent
+              << "%), scalar and " << SoftwareRasterizer::pathName(best) << " kernels "
+              << (kernelsAgree ? "agree" : "DIFFER") << (presentedExact ? "" : ", presented image DIFFERS")
+              << std::endl;
+    std::cout << "RASTER::" << renderer << " " << glFps << " fps, software " << softwareFps << " fps on "
+              << raster.threadCount() << " threads (" << softwareFps / glFps << "x)" << std::endl;
+    raster.report(std::cout);
+    return passed;
+}
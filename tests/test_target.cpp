@@ -0,0 +1,47 @@
+#include "test_target.h"
+#include <GL/glew.h>
+#include <cstdlib>
+
+TestTarget::TestTarget(int width, int height) : framebuffer(0), targetWidth(width), targetHeight(height)
+{
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glViewport(0, 0, width, height);
+}
+
+TestTarget::~TestTarget()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+void TestTarget::read(std::vector<unsigned char>& pixels) const
+{
+    pixels.resize((size_t)targetWidth * targetHeight * 4);
+    glReadPixels(0, 0, targetWidth, targetHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+size_t differingPixels(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance)
+{
+    size_t differing = 0;
+    for (size_t i = 0; i + 3 < a.size() && i + 3 < b.size(); i += 4)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            if (std::abs((int)a[i + c] - (int)b[i + c]) > tolerance)
+            {
+                differing++;
+                break;
+            }
+        }
+    }
+    return differing;
+}
@@ -0,0 +1,36 @@
+#ifndef TEST_TARGET_H
+#define TEST_TARGET_H
+
+#include <vector>
+#include <cstddef>
+
+// Size of every test image, the window size of the application
+const int TEST_WIDTH = 1200;
+const int TEST_HEIGHT = 800;
+
+// Offscreen framebuffer (colour and depth renderbuffers) the headless tests draw into: bound,
+// with the viewport covering it, while the target lives
+class TestTarget
+{
+public:
+    TestTarget(int width = TEST_WIDTH, int height = TEST_HEIGHT);
+    ~TestTarget();
+    TestTarget(const TestTarget&) = delete;
+    TestTarget& operator=(const TestTarget&) = delete;
+
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+
+    // RGBA of the bound read framebuffer at the target's size, bottom row first
+    void read(std::vector<unsigned char>& pixels) const;
+
+private:
+    unsigned int framebuffer;
+    unsigned int renderbuffers[2];  // Colour, depth
+    int targetWidth, targetHeight;
+};
+
+// Pixels of two RGBA images whose colour differs by more than tolerance in any channel
+size_t differingPixels(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance);
+
+#endif
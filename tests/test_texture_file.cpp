@@ -0,0 +1,133 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include "tests.h"
+#include "../include/texture_file.h"
+
+static const char* DDS_PATH = "texture_test.dds";
+static const char* KTX2_PATH = "texture_test.ktx2";
+static const char* PATCHED_PATH = "texture_test_patched";
+// Header fields patched below: DDS height and width after the magic, KTX2 width and height and
+// the first level's offset after the identifier
+static const size_t DDS_HEIGHT = 12, DDS_WIDTH = 16;
+static const size_t KTX2_WIDTH = 20, KTX2_HEIGHT = 24, KTX2_LEVEL_INDEX = 80;
+
+static std::string readBytes(const char* path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+template <typename T>
+static std::string patched(std::string bytes, size_t offset, T value)
+{
+    std::memcpy(&bytes[offset], &value, sizeof(T));
+    return bytes;
+}
+
+// The header must be rejected with an ERROR::TEXTURE line containing `message`
+static bool rejects(const std::string& bytes, const std::string& message, const std::string& what)
+{
+    {
+        std::ofstream out(PATCHED_PATH, std::ios::binary | std::ios::trunc);
+        out << bytes;
+    }
+    TextureFile file;
+    std::ostringstream captured;
+    std::streambuf* previous = std::cout.rdbuf(captured.rdbuf());
+    bool read = readTextureHeader(PATCHED_PATH, file);
+    std::cout.rdbuf(previous);
+    if (read || captured.str().find(message) == std::string::npos)
+    {
+        std::cout << "TEXTURE::" << what << ": expected \"" << message << "\", got "
+                  << (read ? "a valid header\n" : captured.str());
+        return false;
+    }
+    return true;
+}
+
+// A written checker texture reads back with its full chain
+static bool readsBack(const char* path)
+{
+    TextureFile file;
+    std::vector<unsigned char> level;
+    if (!readTextureHeader(path, file) || file.width != 64 || file.height != 64 || !file.compressed ||
+        file.levels.size() != 7 || file.levels[0].size != 16 * 16 * 8 || file.levels[6].size != 8 ||
+        !readTextureLevel(file, 6, level))
+    {
+        std::cout << "TEXTURE::" << path << " did not read back as a 64x64 BC1 texture with 7 levels" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Every truncation of the file is rejected
+static bool rejectsTruncations(const std::string& bytes, const char* path)
+{
+    for (size_t length = 0; length < bytes.size(); length++)
+    {
+        if (!rejects(bytes.substr(0, length), "ERROR::TEXTURE::", std::string("Truncated ") + path))
+            return false;
+    }
+    return true;
+}
+
+// DDS and KTX2 checker textures read back; truncated files, headers declaring more than
+// MAX_TEXTURE_DIMENSION or more levels than a full chain, and level offsets past the end are
+// rejected; the writer refuses sizes it cannot produce
+bool testTextureFile()
+{
+    bool passed = true;
+    if (!writeCheckerTexture(DDS_PATH, 64, 4) || !writeCheckerTexture(KTX2_PATH, 64, 4))
+    {
+        std::cout << "TEXTURE::Failed to write the checker textures" << std::endl;
+        passed = false;
+    }
+    passed = passed && readsBack(DDS_PATH) && readsBack(KTX2_PATH);
+    std::string dds = readBytes(DDS_PATH), ktx2 = readBytes(KTX2_PATH);
+
+    if (passed)
+    {
+        passed = rejectsTruncations(dds, DDS_PATH) && passed;
+        passed = rejectsTruncations(ktx2, KTX2_PATH) && passed;
+
+        const char* tooLarge = "larger than the maximum texture size";
+        uint32_t over = MAX_TEXTURE_DIMENSION * 2, huge = 0xFFFFFFFFu;
+        passed = rejects(patched(dds, DDS_WIDTH, over), tooLarge, "DDS width") && passed;
+        passed = rejects(patched(dds, DDS_HEIGHT, huge), tooLarge, "DDS height") && passed;
+        passed = rejects(patched(ktx2, KTX2_WIDTH, huge), tooLarge, "KTX2 width") && passed;
+        passed = rejects(patched(ktx2, KTX2_HEIGHT, over), tooLarge, "KTX2 height") && passed;
+        // 64x64 with 8 levels claimed; a 4x4 header keeping the 64x64 data's level count
+        passed = rejects(patched(dds, 4 + 6 * 4, (uint32_t)8), "more mip levels", "DDS mip count") && passed;
+        passed = rejects(patched(patched(ktx2, KTX2_WIDTH, (uint32_t)4), KTX2_HEIGHT, (uint32_t)4), "more mip levels",
+                         "KTX2 level count") && passed;
+        // An offset that wraps past 2^64 once the level's size is added
+        passed = rejects(patched(ktx2, KTX2_LEVEL_INDEX, ~(uint64_t)0 - 100), "truncated mip chain",
+                         "KTX2 level offset") && passed;
+    }
+
+    std::ostringstream captured;
+    std::streambuf* previous = std::cout.rdbuf(captured.rdbuf());
+    bool wrote = writeCheckerTexture(PATCHED_PATH, MAX_TEXTURE_DIMENSION * 2, 8) ||
+                 writeCheckerTexture(PATCHED_PATH, 48, 8) || writeCheckerTexture(PATCHED_PATH, 64, 0);
+    std::cout.rdbuf(previous);
+    if (wrote)
+    {
+        std::cout << "TEXTURE::Wrote a checker of an invalid size or tile count" << std::endl;
+        passed = false;
+    }
+
+    std::remove(DDS_PATH);
+    std::remove(KTX2_PATH);
+    std::remove(PATCHED_PATH);
+    if (passed)
+        std::cout << "TEXTURE::DDS and KTX2 read back; " << dds.size() + ktx2.size() << " truncations and "
+                  << "oversized headers rejected" << std::endl;
+    return passed;
+}
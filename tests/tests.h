@@ -0,0 +1,51 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include "../include/asset_registry.h"
+#include "../include/shader_variants.h"
+#include "../include/campus.h"
+#include "../include/render_queue.h"
+#include "../include/camera.h"
+#include "test_target.h"
+
+// The scene every test draws, loaded once as the application loads it: registry, shader
+// variants, campus (keeping the CPU geometry for the software rasterizer) and render queue, with
+// the camera at the start view. A test leaves the shared state (required features, view count,
+// GL state it changed) as it found it.
+struct TestScene
+{
+    AssetRegistry assets;
+    ShaderVariants shaders;
+    Campus campus;
+    RenderQueue renderQueue;
+    Camera camera;
+
+    TestScene();
+    bool load(const std::string& path);
+
+    const CampusCell& cell() const { return *campus.cellAt(camera.Position); }
+    // The camera's projection over a test image
+    glm::mat4 projection() const;
+};
+
+// One test each; true when it passed, with its report on stdout. The CPU tests need no GL
+// context and run first.
+bool testSceneFormats();
+bool testBatchTransforms();
+bool testRenderSort();
+bool testCollision();
+bool testCameraPath();
+bool testMetrics();
+bool testTextureFile();
+
+bool testStateCache(TestScene& scene);
+bool testGpuDriven(TestScene& scene);
+bool testSoftwareRaster(TestScene& scene);
+bool testMultiView(TestScene& scene);
+bool testFrameCapture(TestScene& scene);
+bool testDebugView(TestScene& scene);
+bool testRenderServer(TestScene& scene);
+
+#endif